@@ -0,0 +1,96 @@
+#include "boot.h"
+
+void bootLoader(void);
+static void bootTx32(uint32_t value);
+static uint32_t bootPageCrc(uint16_t address);
+static uint8_t bootWrite(void);
+
+void bootLoader(void) {
+    uint8_t command;
+    uint8_t page;
+    uint8_t written = FALSE;
+
+    for (;;) {
+        // Idle, give up unless an image is half written
+        if (!bootUartRx(&command)) {
+            if (written) {
+                continue;
+            } else {
+                return;
+            }
+        } else {}
+
+        if (command == BOOTSYNC) {
+            bootUartTx(BOOTSYNC);
+            bootUartTx(BOOTVERSION);
+            bootUartTx((uint8_t) (BOOTPAGESIZE/2));
+            bootUartTx(BOOTAPPPAGES);
+        } else if (command == BOOTPAGECRCS) {
+            for (page = 0; page < BOOTAPPPAGES; page++) {
+                bootTx32(bootPageCrc(page*BOOTPAGESIZE));
+            }
+        } else if (command == BOOTWRITE) {
+            written = TRUE;
+            bootUartTx(bootWrite() ? BOOTOK : BOOTERROR);
+        } else if (command == BOOTEXIT) {
+            bootUartTx(BOOTEXIT);
+            return;
+        } else {}
+    }
+}
+
+static void bootTx32(uint32_t value) {
+    uint8_t i;
+
+    for (i = 0; i < 4; i++) {
+        bootUartTx((uint8_t) value);
+        value >>= 8;
+    }
+}
+
+static uint32_t bootPageCrc(uint16_t address) {
+    uint32_t crc = 0xffffffff;
+    uint8_t i;
+
+    for (i = 0; i < BOOTPAGESIZE; i++) {
+        crc = bootCrc32Update(crc, bootFlashRead(address+i));
+    }
+    return (~crc);
+}
+
+/******************************************************************************
+* Takes page number, page data & CRC-32 of the data, then programs the page    *
+* and checks it reads back. Returns FALSE on a timeout, bad page number, bad   *
+* CRC or failed verify, the page is only touched if everything received is    *
+* good.                                                                       *
+******************************************************************************/
+static uint8_t bootWrite(void) {
+    uint8_t data[BOOTPAGESIZE];
+    uint8_t page;
+    uint8_t byte;
+    uint32_t crc = 0xffffffff;
+    uint32_t sent = 0;
+    uint8_t i;
+
+    if (!bootUartRx(&page)) {
+        return (FALSE);
+    } else {}
+    for (i = 0; i < BOOTPAGESIZE; i++) {
+        if (!bootUartRx(&data[i])) {
+            return (FALSE);
+        } else {}
+        crc = bootCrc32Update(crc, data[i]);
+    }
+    for (i = 0; i < 32; i += 8) {
+        if (!bootUartRx(&byte)) {
+            return (FALSE);
+        } else {}
+        sent |= (((uint32_t) byte)<<i);
+    }
+
+    if ((~crc != sent) || (page >= BOOTAPPPAGES)) {
+        return (FALSE);
+    } else {}
+    bootFlashWritePage(page*BOOTPAGESIZE, data);
+    return (bootPageCrc(page*BOOTPAGESIZE) == sent);
+}
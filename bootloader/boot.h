@@ -0,0 +1,73 @@
+/******************************************************************************
+* Bootloader Module                                                           *
+*                                                                             *
+* Serial bootloader living in the 1KB boot section. The host drives it with   *
+* single byte commands, multi-byte values go LSB first:                       *
+*                                                                             *
+* 'S'                  Sync, replies 'S', version, page size/2 & app pages.   *
+* 'A'                  Replies CRC-32 of every app page, so the host can      *
+*                      diff its image against the one on the unit.            *
+* 'W' page data crc    Writes one page if the CRC-32 of the data matches,     *
+*                      replies 'K' once it reads back correctly, else 'E'.    *
+* 'X'                  Replies 'X' and starts the application.                *
+*                                                                             *
+* Anything else is ignored, so bytes sent at the application's baud rate do   *
+* no harm. Once a page has been written the loader no longer times out to     *
+* the application, a half written image waits for the host to finish it.      *
+*                                                                             *
+* The protocol code is in boot.c and only reaches hardware through the        *
+* functions below, so it builds for the host simulator as well.               *
+*                                                                             *
+* (void) bootLoader(void)              Function runs the command loop until   *
+*                                      'X' or an idle timeout with nothing    *
+*                                      written.                               *
+* (uint8_t) bootUartRx(uint8_t*)       Function waits up to BOOTTIMEOUT for a *
+*                                      byte, returns FALSE on timeout.        *
+* (void) bootUartTx(uint8_t)           Function sends a byte.                 *
+* (uint8_t) bootFlashRead(uint16_t)    Function reads a flash byte.           *
+* (void) bootFlashWritePage(uint16_t, uint8_t*)                               *
+*                                      Function erases & writes a page.       *
+*                                                                             *
+******************************************************************************/
+
+#include <stdint.h>
+
+#define FALSE 0
+#define TRUE 1
+
+#define BOOTVERSION ((uint8_t) 1)
+#define BOOTPAGESIZE ((uint16_t) 128)
+#define BOOTAPPPAGES ((uint8_t) 248) // 31KB below the boot section
+
+#define BOOTSYNC ((uint8_t) 'S')
+#define BOOTPAGECRCS ((uint8_t) 'A')
+#define BOOTWRITE ((uint8_t) 'W')
+#define BOOTEXIT ((uint8_t) 'X')
+#define BOOTOK ((uint8_t) 'K')
+#define BOOTERROR ((uint8_t) 'E')
+
+// Application asks for the loader by leaving this in the top word of RAM and
+// letting the watchdog reset it, must match firmware includes.h
+#define BOOTREQUESTADDRESS ((uint16_t) 0x08fe)
+#define BOOTREQUESTMAGIC ((uint16_t) 0xb007)
+
+extern void bootLoader(void);
+extern uint8_t bootUartRx(uint8_t *byte);
+extern void bootUartTx(uint8_t byte);
+extern uint8_t bootFlashRead(uint16_t address);
+extern void bootFlashWritePage(uint16_t address, uint8_t *data);
+
+// CRC-32 as used by zlib, bitwise to stay small. Shared with the host uploader.
+static inline uint32_t bootCrc32Update(uint32_t crc, uint8_t data) {
+    uint8_t i;
+
+    crc ^= data;
+    for (i = 0; i < 8; i++) {
+        if (crc & 1) {
+            crc = ((crc>>1) ^ 0xedb88320);
+        } else {
+            crc >>= 1;
+        }
+    }
+    return (crc);
+}
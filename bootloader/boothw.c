@@ -0,0 +1,91 @@
+#include <avr/io.h>
+#include <avr/boot.h>
+#include <avr/pgmspace.h>
+#include <avr/wdt.h>
+#include "boot.h"
+
+// 500k baud is exact from 16MHz with double speed, as is 1M
+#define BOOT_UART_CODE ((uint16_t) ((F_CPU/8/BOOT_BAUD)-1))
+#define BOOTTIMEOUT ((uint16_t) (F_CPU/1024)) // 1 second of timer 1 at /1024
+
+int main(void) __attribute__ ((naked, section (".init9")));
+uint8_t bootUartRx(uint8_t *byte);
+void bootUartTx(uint8_t byte);
+uint8_t bootFlashRead(uint16_t address);
+void bootFlashWritePage(uint16_t address, uint8_t *data);
+static void bootStartApp(void);
+
+/******************************************************************************
+* Reset lands here, no startup code runs and the stack is at RAMEND. The loader *
+* only runs when the application asked for it or on an external reset, any     *
+* other reset goes straight to the application with MCUSR untouched so its     *
+* warm restart still sees watchdog and brownout resets.                        *
+******************************************************************************/
+int main(void) {
+    __asm__ volatile ("clr __zero_reg__");
+
+    if (*((volatile uint16_t *) BOOTREQUESTADDRESS) == BOOTREQUESTMAGIC) {
+        // Watchdog is still running from the reset, WDRF must clear before it stops
+        *((volatile uint16_t *) BOOTREQUESTADDRESS) = 0x0000;
+        MCUSR = 0x00;
+        wdt_disable();
+    } else if ((MCUSR & ((1<<EXTRF)|(1<<WDRF))) != (1<<EXTRF)) {
+        bootStartApp();
+    } else {}
+
+    UCSR0A = (1<<U2X0);
+    UBRR0H = (uint8_t) (BOOT_UART_CODE>>8);
+    UBRR0L = (uint8_t) BOOT_UART_CODE;
+    UCSR0B = ((1<<RXEN0) | (1<<TXEN0));
+    TCCR1B = ((1<<CS12) | (1<<CS10));
+
+    bootLoader();
+
+    // Leave UART & timer as reset left them, the application sets up from scratch
+    UCSR0B = 0x00;
+    UCSR0A = 0x00;
+    UBRR0H = 0x00;
+    UBRR0L = 0x00;
+    TCCR1B = 0x00;
+    TCNT1 = 0x0000;
+    bootStartApp();
+}
+
+uint8_t bootUartRx(uint8_t *byte) {
+    TCNT1 = 0x0000;
+    while (!(UCSR0A & (1<<RXC0))) {
+        if (TCNT1 >= BOOTTIMEOUT) {
+            return (FALSE);
+        } else {}
+    }
+    *byte = UDR0;
+    return (TRUE);
+}
+
+void bootUartTx(uint8_t byte) {
+    // Wait for the byte to be fully out, nothing is left sending when the application starts
+    UDR0 = byte;
+    while (!(UCSR0A & (1<<TXC0))) {}
+    UCSR0A |= (1<<TXC0);
+}
+
+uint8_t bootFlashRead(uint16_t address) {
+    return (pgm_read_byte(address));
+}
+
+void bootFlashWritePage(uint16_t address, uint8_t *data) {
+    uint8_t i;
+
+    boot_page_erase(address);
+    boot_spm_busy_wait();
+    for (i = 0; i < BOOTPAGESIZE; i += 2) {
+        boot_page_fill(address+i, (data[i] | (((uint16_t) data[i+1])<<8)));
+    }
+    boot_page_write(address);
+    boot_spm_busy_wait();
+    boot_rww_enable(); // Application section readable again for the verify
+}
+
+static void bootStartApp(void) {
+    ((void (*)(void)) 0x0000)();
+}
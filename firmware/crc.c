@@ -1,9 +1,8 @@
 #include "includes.h"
 
-// g(x) = x^10 + x^8 + x^7 + x^5 + x^4 + x^3 + 1
-static const uint16_t crcGenTable[16] PROGMEM = {0x01b9, 0x0372, 0x035d, 0x0303, 0x03bf, 0x02c7, 0x0037, 0x006e, 0x00dc, 0x01b8, 0x0370, 0x0359, 0x030b, 0x03af, 0x02e7, 0x0077};
+static const uint16_t crcGenTable[16] PROGMEM = {CRCGEN0, CRCGEN1, CRCGEN2, CRCGEN3, CRCGEN4, CRCGEN5, CRCGEN6, CRCGEN7, CRCGEN8, CRCGEN9, CRCGEN10, CRCGEN11, CRCGEN12, CRCGEN13, CRCGEN14, CRCGEN15};
 
-static const uint16_t crcOffsetTable[6] PROGMEM = {0x00fc, 0x0198, 0x0168, 0x0350, 0x01b4, 0x0000};
+static const uint16_t crcOffsetTable[6] PROGMEM = {CRCOFFSETWORDA, CRCOFFSETWORDB, CRCOFFSETWORDC, CRCOFFSETWORDC2, CRCOFFSETWORDD, CRCOFFSETWORDE};
 
 uint16_t crcChecksum(rbds_t *rbds, uint8_t offset) {
     uint16_t crcReturnValue = 0;
@@ -20,3 +19,14 @@ uint16_t crcChecksum(rbds_t *rbds, uint8_t offset) {
     crcReturnValue &= ~(0xfc00); // Strip off excess high bites
     return (crcReturnValue);
 }
+
+uint16_t crcCcitt(uint8_t *data, uint16_t length) {
+    uint16_t crc = 0xffff;
+
+    while (length != 0) {
+        crc = _crc_ccitt_update(crc, *data);
+        data++;
+        length--;
+    }
+    return (crc);
+}
@@ -13,7 +13,58 @@
 * (uint16_t) uartInit(rbds_t, uint8_t) Function computes checksum of rbds     *
 *                                      data structure with designated group   *
 *                                      offset.                                *
+* (uint16_t) crcCcitt(uint8_t*, uint16_t) Function computes CRC-CCITT of a    *
+*                                      buffer, used to check stored state.    *
+*                                                                             *
+* CRCCHECKWORD(info, offset)           Macro computes the same checkword as   *
+*                                      crcChecksum from constants, for blocks *
+*                                      built at compile time.                 *
+* CRCBLOCK(info, offset)               Macro builds a whole rbds_t hex value  *
+*                                      with checkword from constants.         *
 *                                                                             *
 ******************************************************************************/
 
-extern uint16_t crcChecksum(rbds_t *rbds, uint8_t offset);
\ No newline at end of file
+// g(x) = x^10 + x^8 + x^7 + x^5 + x^4 + x^3 + 1, checkword of each info bit
+#define CRCGEN0 ((uint16_t) 0x01b9)
+#define CRCGEN1 ((uint16_t) 0x0372)
+#define CRCGEN2 ((uint16_t) 0x035d)
+#define CRCGEN3 ((uint16_t) 0x0303)
+#define CRCGEN4 ((uint16_t) 0x03bf)
+#define CRCGEN5 ((uint16_t) 0x02c7)
+#define CRCGEN6 ((uint16_t) 0x0037)
+#define CRCGEN7 ((uint16_t) 0x006e)
+#define CRCGEN8 ((uint16_t) 0x00dc)
+#define CRCGEN9 ((uint16_t) 0x01b8)
+#define CRCGEN10 ((uint16_t) 0x0370)
+#define CRCGEN11 ((uint16_t) 0x0359)
+#define CRCGEN12 ((uint16_t) 0x030b)
+#define CRCGEN13 ((uint16_t) 0x03af)
+#define CRCGEN14 ((uint16_t) 0x02e7)
+#define CRCGEN15 ((uint16_t) 0x0077)
+
+// Offset words in OFFSETA to OFFSETE order
+#define CRCOFFSETWORDA ((uint16_t) 0x00fc)
+#define CRCOFFSETWORDB ((uint16_t) 0x0198)
+#define CRCOFFSETWORDC ((uint16_t) 0x0168)
+#define CRCOFFSETWORDC2 ((uint16_t) 0x0350)
+#define CRCOFFSETWORDD ((uint16_t) 0x01b4)
+#define CRCOFFSETWORDE ((uint16_t) 0x0000)
+
+#define CRCOFFSETWORD(offset) ((offset) == OFFSETA ? CRCOFFSETWORDA : (offset) == OFFSETB ? CRCOFFSETWORDB : \
+    (offset) == OFFSETC ? CRCOFFSETWORDC : (offset) == OFFSETC2 ? CRCOFFSETWORDC2 : \
+    (offset) == OFFSETD ? CRCOFFSETWORDD : CRCOFFSETWORDE)
+
+#define CRCBIT(info, bit) ((((info)>>(bit)) & 1) ? CRCGEN##bit : 0)
+
+// Folds to a constant, never use with variables
+#define CRCCHECKWORD(info, offset) ((uint16_t) (( \
+    CRCBIT(info, 0) ^ CRCBIT(info, 1) ^ CRCBIT(info, 2) ^ CRCBIT(info, 3) ^ \
+    CRCBIT(info, 4) ^ CRCBIT(info, 5) ^ CRCBIT(info, 6) ^ CRCBIT(info, 7) ^ \
+    CRCBIT(info, 8) ^ CRCBIT(info, 9) ^ CRCBIT(info, 10) ^ CRCBIT(info, 11) ^ \
+    CRCBIT(info, 12) ^ CRCBIT(info, 13) ^ CRCBIT(info, 14) ^ CRCBIT(info, 15) ^ \
+    CRCOFFSETWORD(offset)) & 0x03ff))
+
+#define CRCBLOCK(info, offset) ((((uint32_t) (info))<<16) | (((uint32_t) CRCCHECKWORD(info, offset))<<6))
+
+extern uint16_t crcChecksum(rbds_t *rbds, uint8_t offset);
+extern uint16_t crcCcitt(uint8_t *data, uint16_t length);
\ No newline at end of file
@@ -0,0 +1,120 @@
+#include "includes.h"
+
+// Config slots are a ring at the bottom of EEPROM, each save goes to the slot
+// after the newest one so writes are spread across the ring. Encoded messages
+// live above the ring, one slot per carousel message, each with its checksum
+// in the config so a torn message is dropped rather than sent.
+#define EEPROM_CONFIG_SLOTS ((uint8_t) 4)
+#define EEPROM_CONFIG_SLOTSIZE ((uint16_t) 64)
+#define EEPROM_MESSAGE_BASE ((uint16_t) 0x100)
+#define EEPROM_MESSAGE_SLOTSIZE ((uint16_t) (MAXRTGROUPS*2*sizeof(rbds_t)))
+
+// Fails the build if the config outgrows its slot or the ring runs into the
+// messages, a negative array size being the only error C99 offers here
+typedef uint8_t eepromConfigFits[(sizeof(config_t) <= EEPROM_CONFIG_SLOTSIZE) ? 1 : -1];
+typedef uint8_t eepromRingFits[((EEPROM_CONFIG_SLOTS*EEPROM_CONFIG_SLOTSIZE) <= EEPROM_MESSAGE_BASE) ? 1 : -1];
+
+uint8_t eepromLoadConfig(config_t *config);
+void eepromSaveConfig(config_t *config);
+void eepromSaveConfigStart(config_t *config);
+uint8_t eepromSaveConfigStep(void);
+void eepromSaveConfigFinish(void);
+uint8_t eepromCheckMessage(uint8_t slot, uint8_t length, uint16_t checksum);
+void eepromReadBlocks(uint8_t slot, uint8_t block, rbds_t *blocks, uint8_t count);
+uint16_t eepromSaveMessage(uint8_t slot, rbds_t *blocks, uint8_t length);
+
+static uint8_t eepromConfigSlot = (EEPROM_CONFIG_SLOTS-1);
+static config_t eepromPending;
+static uint8_t eepromPendingIndex = sizeof(config_t); // Next byte of eepromPending to write, sizeof when none
+
+uint8_t eepromLoadConfig(config_t *config) {
+    config_t slotConfig;
+    uint8_t slot;
+    uint8_t found = FALSE;
+
+    for (slot = 0; slot < EEPROM_CONFIG_SLOTS; slot++) {
+        eeprom_read_block(&slotConfig, (void *) (slot*EEPROM_CONFIG_SLOTSIZE), sizeof(config_t));
+        // Skip erased or torn slots
+        if (crcCcitt((uint8_t *) &slotConfig, sizeof(config_t)-2) != slotConfig.checksum) {
+            continue;
+        } else {}
+        // Sequence wraps, newer slot is at most half the ring of sequence numbers ahead
+        if (!found || ((int8_t) (slotConfig.sequence - config->sequence)) > 0) {
+            *config = slotConfig;
+            eepromConfigSlot = slot;
+            found = TRUE;
+        } else {}
+    }
+    return (found);
+}
+
+void eepromSaveConfig(config_t *config) {
+    eepromSaveConfigStart(config);
+    eepromSaveConfigFinish();
+}
+
+// A save still under way is started over in the same slot, the slot before
+// it stays the newest valid one until the checksum, written last, is in
+void eepromSaveConfigStart(config_t *config) {
+    if (eepromPendingIndex >= sizeof(config_t)) {
+        eepromConfigSlot = ((eepromConfigSlot+1) % EEPROM_CONFIG_SLOTS);
+    } else {}
+    config->sequence++;
+    config->checksum = crcCcitt((uint8_t *) config, sizeof(config_t)-2);
+    eepromPending = *config;
+    eepromPendingIndex = 0;
+}
+
+// Never waits on the EEPROM, starts at most one byte write a call
+uint8_t eepromSaveConfigStep(void) {
+    uint8_t *address;
+    uint8_t byte;
+
+    while (eepromPendingIndex < sizeof(config_t)) {
+        if (!eeprom_is_ready()) {
+            return (TRUE);
+        } else {}
+        address = (uint8_t *) ((eepromConfigSlot*EEPROM_CONFIG_SLOTSIZE)+eepromPendingIndex);
+        byte = ((uint8_t *) &eepromPending)[eepromPendingIndex];
+        eepromPendingIndex++;
+        if (eeprom_read_byte(address) != byte) {
+            eeprom_write_byte(address, byte);
+            return (TRUE);
+        } else {}
+    }
+    return (FALSE);
+}
+
+void eepromSaveConfigFinish(void) {
+    while (eepromSaveConfigStep()) {
+        eeprom_busy_wait();
+    }
+}
+
+uint8_t eepromCheckMessage(uint8_t slot, uint8_t length, uint16_t checksum) {
+    uint8_t *address = (uint8_t *) (EEPROM_MESSAGE_BASE+(slot*EEPROM_MESSAGE_SLOTSIZE));
+    uint16_t size = (((uint16_t) length)*2*sizeof(rbds_t));
+    uint16_t crc = 0xffff;
+
+    if ((slot >= MAXRTMESSAGES) || (length == 0) || (length > MAXRTGROUPS)) {
+        return (FALSE);
+    } else {}
+    while (size != 0) {
+        crc = _crc_ccitt_update(crc, eeprom_read_byte(address));
+        address++;
+        size--;
+    }
+    return (crc == checksum);
+}
+
+void eepromReadBlocks(uint8_t slot, uint8_t block, rbds_t *blocks, uint8_t count) {
+    eeprom_read_block(blocks, (void *) (EEPROM_MESSAGE_BASE+(slot*EEPROM_MESSAGE_SLOTSIZE)+(block*sizeof(rbds_t))), (count*sizeof(rbds_t)));
+}
+
+uint16_t eepromSaveMessage(uint8_t slot, rbds_t *blocks, uint8_t length) {
+    uint16_t size = (((uint16_t) length)*2*sizeof(rbds_t));
+
+    // Update only rewrites bytes that differ, small edits cost few erase cycles
+    eeprom_update_block(blocks, (void *) (EEPROM_MESSAGE_BASE+(slot*EEPROM_MESSAGE_SLOTSIZE)), size);
+    return (crcCcitt((uint8_t *) blocks, size));
+}
@@ -0,0 +1,38 @@
+/******************************************************************************
+* EEPROM Configuration Module                                                 *
+*                                                                             *
+* Contains functions and definitions required for persistent configuration   *
+*                                                                             *
+* (uint8_t) eepromLoadConfig(config_t*) Function finds newest valid config    *
+*                                       slot and copies it out, returns FALSE *
+*                                       if no slot passes its checksum.       *
+* (void) eepromSaveConfig(config_t*)    Function writes config into the next  *
+*                                       slot in the wear levelling ring.      *
+* (void) eepromSaveConfigStart(config_t*)                                     *
+*                                       Function stamps config and queues it  *
+*                                       for the next slot without writing.    *
+* (uint8_t) eepromSaveConfigStep(void)  Function writes the queued config a   *
+*                                       byte at a time without waiting on the *
+*                                       EEPROM, returns TRUE until it is in.  *
+* (void) eepromSaveConfigFinish(void)   Function waits out the queued config. *
+* (uint8_t) eepromCheckMessage(uint8_t, uint8_t, uint16_t)                    *
+*                                       Function verifies encoded radiotext   *
+*                                       in a message slot against checksum.   *
+* (void) eepromReadBlocks(uint8_t, uint8_t, rbds_t*, uint8_t)                 *
+*                                       Function reads encoded radiotext      *
+*                                       blocks starting at given block.       *
+* (uint16_t) eepromSaveMessage(uint8_t, rbds_t*, uint8_t)                     *
+*                                       Function writes encoded radiotext     *
+*                                       blocks to a message slot, returns     *
+*                                       their checksum.                       *
+*                                                                             *
+******************************************************************************/
+
+extern uint8_t eepromLoadConfig(config_t *config);
+extern void eepromSaveConfig(config_t *config);
+extern void eepromSaveConfigStart(config_t *config);
+extern uint8_t eepromSaveConfigStep(void);
+extern void eepromSaveConfigFinish(void);
+extern uint8_t eepromCheckMessage(uint8_t slot, uint8_t length, uint16_t checksum);
+extern void eepromReadBlocks(uint8_t slot, uint8_t block, rbds_t *blocks, uint8_t count);
+extern uint16_t eepromSaveMessage(uint8_t slot, rbds_t *blocks, uint8_t length);
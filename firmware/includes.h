@@ -10,6 +10,10 @@
 #include <avr/interrupt.h>
 #include <avr/pgmspace.h>
 #include <avr/sleep.h>
+#include <avr/eeprom.h>
+#include <util/crc16.h>
+#include <util/atomic.h>
+#include <avr/wdt.h>
 
 #define FALSE 0
 #define TRUE 1
@@ -25,9 +29,35 @@
 #define SHUTDOWN ((uint8_t) 0)
 #define HZPERMV ((uint16_t) 5225)
 #define FREERUNNINGFREQUENCY ((uint32_t) 40000000)
+#define DACMAX ((uint16_t) 0x0fff)
+#define DACMID ((uint16_t) 0x0800)       // Subcarrier zero on channel B
+#define DACSWING ((int32_t) 0x07ff)      // Most channel B swings either side of DACMID
+#define SINTABLEMID ((uint16_t) 0x0fff)  // sintables.txt zero, built for 13 bits
+#define SINTABLESWING ((int32_t) 0x0ffa) // sintables.txt peak above its zero
 
+// Channel A code for a frequency in 10khz steps, as mainFrequencyConverter()
+#define TUNINGCODE(frequency) ((uint16_t) (((((uint32_t) (frequency))*10000)-FREERUNNINGFREQUENCY)/HZPERMV))
+#define TUNINGTABLEFIRST ((uint16_t) 8750) // FM band on the 100khz raster is tabled
+#define TUNINGTABLELAST ((uint16_t) 10800)
+#define TUNINGTABLESTEP ((uint16_t) 10)
+
+// Retune settle, the VCO loop is taken to close half its gap each symbol. The
+// first quiet symbol overshoots by a whole step so the loop lands on the new
+// code, then it holds there until what overshoot couldn't cover is settled.
+#define TUNEOVERSHOOT ((uint8_t) 16)     // Sixteenths of the step added for the first symbol
+#define TUNESETTLESYMBOLS ((uint8_t) 5)  // Quiet symbols at least, 4.2ms
+#define TUNESETTLEMAX ((uint8_t) 16)     // Quiet symbols at most, 13.5ms
+#define TUNESETTLECODES ((uint16_t) 1)   // Gap left to the new code when data resumes
+
+// Block A and every 2A block B are built from these at compile time, so PI,
+// PTY & TP are set per build rather than kept in the EEPROM config
 #define PICODE ((uint16_t) 0x54a8)
-#define PICODECHECKWORD ((uint16_t) 0x0000)
+#define PTYCODE NOPROGRAMTYPE
+#define TPFLAG ((uint8_t) 0)
+#define PSNAME "        "
+#define MSFLAG ((uint8_t) 1)       // Music
+#define DIFLAGS ((uint8_t) 0x00)   // Decoder identification d3..d0, one a segment
+#define PSNOAF ((uint16_t) 0xe0cd) // 0A block C, no alternative frequencies then filler
 
 #define OFFSETA ((uint8_t) 0x00)
 #define OFFSETB ((uint8_t) 0x01)
@@ -36,15 +66,124 @@
 #define OFFSETD ((uint8_t) 0x04)
 #define OFFSETE ((uint8_t) 0x05)
 
+#define GROUP0A ((uint8_t) 0x00)
 #define GROUP2A ((uint8_t) 0x04)
+#define GROUP4A ((uint8_t) 0x08)
 #define NOPROGRAMTYPE ((uint8_t) 0x00)
 #define A ((uint8_t) 0x00)
 
+#define TELEMETRYREQUEST ((uint8_t) '?')
+#define BOOTREQUEST ((uint8_t) 'B') // Then BOOTREQUESTCONFIRM whole
+#define BOOTREQUESTCONFIRM "#boot" // Can't turn up in a hex argument
+#define TRACEDUMP ((uint8_t) 'D')
+#define TRACESAMPLES ((uint8_t) 'S')
+#define PROFILEDUMP ((uint8_t) 'P')
+#define CLOCKSET ((uint8_t) 'C')
+#define URGENTGROUP ((uint8_t) 'U')
+#define CHANNELSET ((uint8_t) 'F') // Then frequency in 10khz steps, LSB first
+#define PSSET ((uint8_t) 'N')
+#define INJECTIONSET ((uint8_t) 'L') // Then level as two hex digits
+#define GROUPMIXSET ((uint8_t) 'M')  // Then group mix as two hex digits
+
+#define TELEMETRYREPORT ((uint8_t) 'T')
+#define TRACEREPORT ((uint8_t) 'R')
+#define PROFILEREPORT ((uint8_t) 'H')
+#define ACKREPORT ((uint8_t) 'A') // Command letter, 01 done or 00 refused, then a space and the setting in decimal
+#define AIRREPORT ((uint8_t) 'O') // Transmitting on and the frequency in 10khz steps, on going on air
+
+#define UARTLINESIZE ((uint8_t) 32) // Longest formatted line, CR LF included
+#define UARTCONTROL ((uint8_t) ((1<<RXCIE0)|(1<<RXEN0)|(1<<TXEN0))) // UCSR0B with the Tx interrupt off, written whole
+
+// Trace event types, data byte in brackets
+#define TRACEEPOCH ((uint8_t) 0)  // High 16 bits of time for the entries after it
+#define TRACESAMPLE ((uint8_t) 1) // Sample sent (compare match to interrupt in cycles/2)
+#define TRACEGROUP ((uint8_t) 2)  // Group boundary (1 if the last group was resent)
+#define TRACELATE ((uint8_t) 3)   // Sample late (0)
+#define TRACEUARTRX ((uint8_t) 4) // UART byte received (byte)
+#define TRACELCD ((uint8_t) 5)    // LCD update (screen, top bit set at the end)
+#define TRACESTATE ((uint8_t) 6)  // Main loop entering state (mainSystemState)
+#define TRACEDEFAULTMASK ((uint8_t) ((1<<TRACEGROUP)|(1<<TRACELATE)|(1<<TRACEUARTRX)|(1<<TRACELCD)|(1<<TRACESTATE)))
+
+#define TRACELCDFREQUENCY ((uint8_t) 1)
+#define TRACELCDMESSAGE ((uint8_t) 2)
+#define TRACELCDDWELL ((uint8_t) 3)
+#define TRACELCDTRANSMIT ((uint8_t) 4)
+#define TRACELCDEND ((uint8_t) 0x80)
+
+// PC sampling histogram, profiling builds only
+#define PROFILEBUCKETS ((uint16_t) 256)
+#define PROFILEWATCHDOGTICKS ((uint8_t) 16) // 16ms interrupts without a kick before reset
+
+// Left in the top word of RAM over a watchdog reset to start the serial
+// bootloader, must match bootloader/boot.h
+#define BOOTREQUESTADDRESS ((uint16_t) (RAMEND-1))
+#define BOOTREQUESTMAGIC ((uint16_t) 0xb007)
+
+// Clock plan, every timer rate from F_CPU. Plain numbers so main.c & uart.c
+// can check the errors in #if. Each timer toggles its pin on compare match,
+// so the pin runs at half the match rate. Samples go out on every pilot
+// toggle and an RBDS bit is 16 pilot cycles, 1187.5bps with the carrier at
+// 3x pilot, though the carrier divides down on its own and isn't locked.
+#define PILOTHZ 19000
+#define CARRIERHZ 57000
+#define TONEHZ 26000
+#define UARTBAUD 9600
+#define SYMBOLPILOTS 16
+#define TONEPRESCALE 8
+#define SAMPLEPERIOD ((F_CPU+PILOTHZ)/(2*PILOTHZ)) // Timer 1 cycles, 421 at 16MHz
+#define CARRIERPERIOD ((F_CPU+CARRIERHZ)/(2*CARRIERHZ)) // Timer 0 cycles, 140 at 16MHz
+#define TONEPERIOD ((F_CPU+(TONEPRESCALE*TONEHZ))/(2*TONEPRESCALE*TONEHZ)) // Timer 2 ticks, 38 at 16MHz
+#define UARTBAUDCODE (((F_CPU+(8*UARTBAUD))/(16*UARTBAUD))-1) // 103 at 16MHz
+
+// Error of a rate made by dividing F_CPU by cycles, in ppm of the target.
+// Broadcast limits (pilot +-2Hz, carrier +-6Hz) are past what any single
+// crystal division reaches, these are what this design holds to: the pilot
+// and with it samples & bit rate, 126ppm on 16MHz & 601ppm on 20MHz, the
+// carrier 2506ppm on either, and half the UART's 2% for 8N1 so the host can
+// have the rest.
+#define CLOCKERRORPPM(cycles, hz) ((((F_CPU) > ((cycles)*(hz))) ? ((F_CPU)-((cycles)*(hz))) : (((cycles)*(hz))-(F_CPU))) \
+    *1000000/((cycles)*(hz)))
+#define PILOTTOLERANCEPPM 1000
+#define CARRIERTOLERANCEPPM 5000
+#define TONETOLERANCEPPM 20000
+#define UARTTOLERANCEPPM 10000
+
+#define SAMPLESPERSYMBOL ((uint8_t) (2*SYMBOLPILOTS))
+#define CYCLESPERSYMBOL ((uint32_t) (SAMPLESPERSYMBOL*SAMPLEPERIOD))
+#define GROUPSAMPLES ((uint16_t) (104*SAMPLESPERSYMBOL))
+
+// Sample stub alignment, plain numbers as they go into its asm. Entry is 4
+// cycles response and 3 for the vector jump, up to 3 more to finish an
+// instruction or 4 to wake from idle. On air interrupts are only ever off for
+// the UART stubs in sample.c and atomic blocks cut down to an index or a
+// snapshot, 27 cycles at most counted by hand, so the window takes those too.
+// Erring low only costs cycles, each one in the window is one every sample.
+#define SAMPLEENTRYMIN 13     // Fewest cycles from compare match to the stub's TCNT1 read
+#define SAMPLEJITTERWINDOW 32 // Most extra entry cycles padded out
+
+// Clock seconds in timer 1 sample periods, a period longer as the remainder adds up
+#define RTCSAMPLEPERIOD ((uint16_t) SAMPLEPERIOD)
+#define RTCSAMPLESPERSECOND ((uint16_t) (F_CPU/RTCSAMPLEPERIOD))
+#define RTCSAMPLEREMAINDER ((uint16_t) (F_CPU%RTCSAMPLEPERIOD))
+
+// Off air timer 1 is prescaled by 1024, compare B matching once per this many sample periods
+#define IDLEPERIODS ((uint16_t) 1024)
+
 #define STARTTHEMUSIC ((uint8_t) 0x01)
 #define STOPTHEMUSIC ((uint8_t) 0x00)
 
-#define PERIODDELAY 26.315
-#define COMPUTATIONTIME 2.14
+#define MAXRTGROUPS ((uint8_t) 16)
+#define MAXRTMESSAGES ((uint8_t) 6)
+#define DEFAULTDWELL ((uint8_t) 10)
+#define URGENTQUEUESIZE ((uint8_t) 8)
+#define NOGROUP ((uint8_t) 0xff)
+#define PSTEXTSIZE ((uint8_t) 24)
+#define PSREPEATSMIN ((uint8_t) 2)     // Whole names sent before a scroll step, 1.4s with 2A between
+#define PSREPEATSDEFAULT ((uint8_t) 3)
+#define GROUPMIX0A ((uint8_t) 0x01)    // PS every other group
+#define GROUPMIXACQUIRE ((uint8_t) 0x02) // PS share set by the radiotext length, for fastest tune in
+#define PSSHAREHALF ((uint8_t) 128)    // PS share of carousel groups in 256ths, every other group
+#define INJECTIONFULL ((uint8_t) 255)  // Injection level of a DACSWING sine, 0 mutes
 
 typedef enum {FREQUENCY_INPUT_MODE, DATA_INPUT_MODE, ENCODING_MODE, TRANSMISSION_MODE} mainSystemState_t;
 
@@ -61,51 +200,195 @@ typedef union dac_t {
     bit_t bit;
 } dac_t;
 
+// Blocks are stored as they go on air, MSB first: 16 information bits in
+// 31..16, 10 check bits in 15..6. Bitfields are allocated LSB first, so each
+// struct lists its fields from the end of the block backwards.
 typedef struct {
-    uint16_t picode    : 16;
-    uint16_t checkword : 10;
     uint8_t            : 6;
+    uint16_t checkword : 10;
+    uint16_t picode    : 16;
 } groupa_t;
 
 typedef struct {
-    uint8_t grouptype  : 5;
-    uint8_t tp         : 1;
-    uint8_t pty        : 5;
-    uint8_t ta         : 1;
-    uint8_t ms         : 1;
-    uint8_t di         : 1;
-    uint8_t c          : 2;
-    uint16_t checkword : 10;
     uint8_t            : 6;
+    uint16_t checkword : 10;
+    uint8_t c          : 2;
+    uint8_t di         : 1;
+    uint8_t ms         : 1;
+    uint8_t ta         : 1;
+    uint8_t pty        : 5;
+    uint8_t tp         : 1;
+    uint8_t grouptype  : 5;
 } type0groupb_t;
 
 typedef struct {
-    uint8_t grouptype      : 5;
-    uint8_t tp             : 1;
-    uint8_t pty            : 5;
-    uint8_t textab         : 1;
-    uint8_t segmentaddress : 4;
-    uint16_t checkword     : 10;
     uint8_t                : 6;
+    uint16_t checkword     : 10;
+    uint8_t segmentaddress : 4;
+    uint8_t textab         : 1;
+    uint8_t pty            : 5;
+    uint8_t tp             : 1;
+    uint8_t grouptype      : 5;
 } type2groupb_t;
 
 typedef struct {
-    uint8_t hichar     : 8;
+    uint8_t            : 6;
+    uint16_t checkword : 10;
     uint8_t lowchar    : 8;
+    uint8_t hichar     : 8;
+} type2groupcd_t;
+
+// Clock time, MJD bits 16 & 15 go in block B, 14..0 in block C with hour bit 4
+typedef struct {
+    uint8_t            : 6;
     uint16_t checkword : 10;
+    uint8_t mjdhigh    : 2;
+    uint8_t            : 3;
+    uint8_t pty        : 5;
+    uint8_t tp         : 1;
+    uint8_t grouptype  : 5;
+} type4agroupb_t;
+
+typedef struct {
     uint8_t            : 6;
-} type2groupcd_t;
+    uint16_t checkword : 10;
+    uint8_t hourhigh   : 1;
+    uint16_t mjdlow    : 15;
+} type4agroupc_t;
+
+typedef struct {
+    uint8_t            : 6;
+    uint16_t checkword : 10;
+    uint8_t offset     : 5;
+    uint8_t offsetsign : 1;
+    uint8_t minute     : 6;
+    uint8_t hourlow    : 4;
+} type4agroupd_t;
 
 typedef union rbds_t {
     groupa_t groupa;
     type0groupb_t type0groupb;
     type2groupb_t type2groupb;
     type2groupcd_t type2groupcd;
+    type4agroupb_t type4agroupb;
+    type4agroupc_t type4agroupc;
+    type4agroupd_t type4agroupd;
     uint32_t hex;
 } rbds_t;
 
+// UTC, sent to set the clock as 'C' then each byte as two hex digits, fields
+// LSB first
+typedef struct {
+    uint32_t mjd;          // Modified Julian Day
+    uint8_t hour;
+    uint8_t minute;
+    uint8_t second;
+    int8_t offset;         // Local time offset in half hours
+} rtc_t;
+
+// Group to send ahead of the carousel, sent as 'U' then each byte as two hex
+// digits, fields LSB first. Information words only, checkwords are added.
+typedef struct {
+    uint8_t priority;      // Highest goes first
+    uint8_t repeats;       // Times to send, 0 sends once
+    uint16_t expiry;       // Seconds to keep it queued, 0 for no limit
+    uint16_t blockB;
+    uint16_t blockC;
+    uint16_t blockD;
+} urgent_t;
+
+// Programme service name, sent as 'N' then each byte as two hex digits. Up to
+// 8 chars is a static name padded with spaces, longer scrolls a char at a time
+// and wraps round, only ever stepping between whole names.
+typedef struct {
+    uint8_t length;        // Chars of text used, 0 stops sending PS
+    uint8_t repeats;       // Whole names sent before each step, PSREPEATSMIN at least
+    uint8_t text[PSTEXTSIZE];
+} pstext_t;
+
+typedef struct {
+    rbds_t blocks[3];      // B, C & D ready to send
+    uint8_t priority;
+    uint8_t repeats;       // Sends left
+    uint16_t groupsLeft;   // Groups before it expires, 0 for no limit
+} urgentslot_t;
+
+// Persistent configuration, one copy per 64 byte EEPROM slot
+#define CONFIGINITIALIZED ((uint8_t) 0xa5)
+typedef struct {
+    uint8_t sequence;      // Wear levelling sequence, newest slot wins
+    uint16_t frequency;    // Transmit frequency in 10khz steps
+    uint16_t tuningCode;   // DAC channel A code for frequency
+    uint8_t initialized;   // CONFIGINITIALIZED once defaults are filled in
+    uint8_t psName[PSTEXTSIZE]; // PS text, scrolled when longer than 8 chars
+    uint8_t psLength;      // Chars of psName used
+    uint8_t psRepeats;     // Whole names sent before each scroll step
+    uint8_t groupMix;      // Group types sent alongside 2A, 0 for radiotext only
+    uint8_t injection;     // Subcarrier level in 255ths of the sine table
+    uint8_t rtCount;       // Radiotext messages in carousel, message n in EEPROM slot n
+    uint8_t rtLength[MAXRTMESSAGES];    // Radiotext length in 2A groups
+    uint8_t rtDwell[MAXRTMESSAGES];     // Seconds on air before moving to next message
+    uint16_t rtChecksum[MAXRTMESSAGES]; // CRC of encoded radiotext blocks
+    uint16_t checksum;     // CRC of all preceding fields
+} config_t;
+
+// Transmit telemetry, sent over UART as 'T' then each byte as two hex digits,
+// fields LSB first, then CR LF
+typedef struct {
+    uint32_t groups;       // Groups sent since reset
+    uint32_t blocks;       // Blocks sent since reset
+    uint32_t symbols;      // Symbols sent since reset
+    uint16_t underruns;    // Late samples plus groups resent for want of the next
+    uint16_t maxLatency;   // Most cycles from compare match into sample interrupt
+    uint16_t minIdle;      // Fewest cycles asleep in one symbol
+    uint16_t lastIdle;     // Cycles asleep in the last symbol
+    uint32_t sleepCycles;  // Cycles asleep on air since reset, wraps after ~4 min asleep
+    uint16_t dutyCycle;    // Active permille since last report
+    uint16_t uartOverruns; // UART bytes lost to receive overrun
+    uint16_t bootTime;     // Reset to air in 1024 cycle ticks (64us at 16MHz), 0 if booted to entry
+    uint8_t resetFlags;    // MCUSR at the last reset
+    uint16_t warmRestarts; // Watchdog or brownout resets straight back to air since power on
+    uint16_t urgentDropped; // Urgent groups dropped for a full queue or expired
+    uint16_t uartTxDropped; // UART Tx bytes dropped for a full ring
+} telemetry_t;
+
+// Line being formatted for the UART, on the caller's stack
+typedef struct {
+    uint8_t length;
+    uint8_t text[UARTLINESIZE];
+} uartline_t;
+
+// Trace ring entry, time in sample periods
+typedef struct {
+    uint8_t event;
+    uint8_t data;
+    uint16_t time;
+} trace_t;
+
+// Transmit state kept in .noinit RAM over a watchdog or brownout reset, so the
+// unit can resume where it was without entry, LCD setup or EEPROM checks
+typedef struct {
+    config_t config;
+    uint8_t rtValid;
+    uint8_t rtCurrent;
+    uint8_t rtSegment;
+    uint8_t rtTextAb;
+    uint16_t rtChanged;
+    uint16_t rtSentEarly;
+    uint16_t rtDwellLeft;
+    uint16_t restarts;     // Warm restarts since the state was last cold
+    uint16_t checksum;     // CRC of all preceding fields
+} warm_t;
+
 // These includes require some structs defined above
 #include "spi.h"
+#include "sample.h"
 #include "uart.h"
 #include "lcd.h"
 #include "crc.h"
+#include "eeprom.h"
+#include "rbds.h"
+#include "trace.h"
+#include "rtc.h"
+#include "urgent.h"
+#include "profile.h"
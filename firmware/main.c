@@ -7,6 +7,20 @@
 
 #include "includes.h"
 
+// Timer rates from F_CPU, see the clock plan in includes.h
+#if (SAMPLEPERIOD > 65536) || (CARRIERPERIOD > 256) || (TONEPERIOD > 256)
+#error "F_CPU too fast for a timer's compare register"
+#endif
+#if CLOCKERRORPPM(2*SAMPLEPERIOD, PILOTHZ) > PILOTTOLERANCEPPM
+#error "Pilot, sample & bit rate too far off at this F_CPU"
+#endif
+#if CLOCKERRORPPM(2*CARRIERPERIOD, CARRIERHZ) > CARRIERTOLERANCEPPM
+#error "57khz carrier too far off at this F_CPU"
+#endif
+#if CLOCKERRORPPM(2*TONEPRESCALE*TONEPERIOD, TONEHZ) > TONETOLERANCEPPM
+#error "Tone too far off at this F_CPU"
+#endif
+
 // Function prototypes
 void mainGpioInit(void);
 void mainPwmInit(void);
@@ -16,36 +30,206 @@ void mainDataInputTask(void);
 void mainEncodingTask(void);
 void mainTransmissionTask(void);
 uint16_t mainFrequencyConverter(uint16_t frequency);
+uint16_t mainTuningCode(uint16_t frequency);
+uint8_t mainChannelSet(uint16_t frequency);
+void mainTuneSymbol(void);
 void mainFrequencyInputLcdDisp(void);
 void mainDelayOneSec(void);
 void mainDataInputLcdDisp(void);
 void mainPwmControl(uint8_t command);
+void mainIdleCredit(uint32_t cycles);
+uint8_t mainConfigLoad(void);
+void mainConfigSave(void);
+void mainConfigQueue(void);
+void mainConfigPrepare(void);
+void mainFrequencyBufferFill(uint16_t frequency);
+uint8_t mainDwellInput(void);
+void mainCarouselStart(void);
+void mainCarouselNextGroup(rbds_t *group);
+uint16_t mainCarouselChanges(uint8_t from, uint8_t to);
+uint16_t mainDwellGroups(uint8_t seconds);
+void mainPsStart(void);
+void mainPsNextGroup(rbds_t *group);
+uint8_t mainPsSet(pstext_t *ps);
+uint8_t mainPsDue(void);
+uint8_t mainGroupMixSet(uint8_t mix);
+void mainInjectionFill(uint16_t *wave, uint8_t level);
+uint8_t mainInjectionSet(uint8_t level);
+void mainInjectionUpdate(void);
+void mainTelemetryStart(void);
+void mainTraceDumpStart(void);
+void mainProfileDumpStart(void);
+void mainReportSend(void);
+void mainCommandAck(uint8_t command, uint8_t done);
+void mainAirReport(void);
+uint8_t mainCommandChar(uint8_t c);
+void mainTxFill(void);
+uint8_t mainTxFreeBuffer(void);
+uint8_t mainUrgentFill(rbds_t *group);
+void mainUrgentPreempt(void);
+void mainClockPrepare(void);
+uint8_t mainClockSplice(rbds_t *group);
+void mainSleep(void);
+uint8_t mainWaitForChar(void);
+void mainTxStart(void);
+void mainResetInit(void) __attribute__ ((naked, used, section (".init3")));
+uint8_t mainWarmRestore(void);
+void mainWarmResume(void);
+void mainWarmSave(void);
+void mainBootRequest(void);
 
 // Global variables
 #include "sintables.txt"
 uint8_t mainEnterFreqStrg[] PROGMEM = "Enter Frequency:";
 uint8_t mainEnterMsgStrg[] PROGMEM = "Enter a message:";
+uint8_t mainNextMsgStrg[] PROGMEM = "Enter message ";
+uint8_t mainDwellStrg[] PROGMEM = "Dwell seconds:";
 uint8_t mainEncodingStrg[] PROGMEM = "Encoding Message";
 uint8_t mainTransmittingStrg[] PROGMEM = "Transmitting on";
 uint8_t mainFreqStrg[] PROGMEM = "freq";
+uint8_t mainBootConfirmStrg[] PROGMEM = BOOTREQUESTCONFIRM;
+
+// Channel A codes for the FM band, a MHz to a row
+#define MAINTUNINGROW(frequency) TUNINGCODE(frequency), TUNINGCODE((frequency)+10), TUNINGCODE((frequency)+20), \
+    TUNINGCODE((frequency)+30), TUNINGCODE((frequency)+40), TUNINGCODE((frequency)+50), TUNINGCODE((frequency)+60), \
+    TUNINGCODE((frequency)+70), TUNINGCODE((frequency)+80), TUNINGCODE((frequency)+90)
+uint16_t mainTuningTable[] PROGMEM = {
+    MAINTUNINGROW(8750), MAINTUNINGROW(8850), MAINTUNINGROW(8950), MAINTUNINGROW(9050), MAINTUNINGROW(9150),
+    MAINTUNINGROW(9250), MAINTUNINGROW(9350), MAINTUNINGROW(9450), MAINTUNINGROW(9550), MAINTUNINGROW(9650),
+    MAINTUNINGROW(9750), MAINTUNINGROW(9850), MAINTUNINGROW(9950), MAINTUNINGROW(10050), MAINTUNINGROW(10150),
+    MAINTUNINGROW(10250), MAINTUNINGROW(10350), MAINTUNINGROW(10450), MAINTUNINGROW(10550), MAINTUNINGROW(10650),
+    TUNINGCODE(10750), TUNINGCODE(10760), TUNINGCODE(10770), TUNINGCODE(10780), TUNINGCODE(10790), TUNINGCODE(10800)
+};
+
+// PS share of carousel groups in 256ths by radiotext length in groups. A
+// receiver tuning in waits about 4/share groups for the PS segments and
+// length/(1-share) for the radiotext, least in sum at 2/(2+sqrt(length)).
+// Held to 90 at least, 0A at 4 a second.
+uint8_t mainPsShare[MAXRTGROUPS] PROGMEM = {
+    171, 150, 137, 128, 121, 115, 110, 106, 102, 99, 96, 94, 91, 90, 90, 90
+};
 
 mainSystemState_t mainSystemState = FREQUENCY_INPUT_MODE;
-uint8_t mainFrequencyBuffer[5];
+uint8_t mainFrequencyBuffer[6]; // Null terminated for the UART
 uint16_t mainTransitFrequency;
 uint8_t mainDataBuffer[65];
-uint8_t mainRbdsPacketBuffer[208];
 uint8_t mainRbdsPacketLength;
+config_t mainConfig;
+telemetry_t mainTelemetry = {0, 0, 0, 0, 0, 0xffff, 0, 0, 0, 0, 0, 0, 0, 0, 0};
+telemetry_t mainTelemetryReport;
+uint8_t mainReportType = 0; // Report being sent, 0 when idle
+uint16_t mainReportIndex;
+uint16_t mainReportLength;
+uint32_t mainTelemetrySleepMark;
+uint32_t mainTelemetrySymbolMark;
+
+// Sample engine, owned by the timer 1 compare interrupt while on air. The
+// interrupt sends from one group buffer while the main loop fills the next,
+// the third lets an urgent group take the place of a next already filled.
+dac_t mainTxDac;
+uint16_t mainTxWaves[2][SAMPLESPERSYMBOL]; // Sine table at the injection level, one on air
+uint16_t *mainTxWave;
+uint16_t * volatile mainTxWaveNext = NULL; // Goes on air at the next symbol, NULL for none
+uint8_t mainInjectionLevel; // Level for mainInjectionUpdate to put on air
+uint8_t mainInjectionDue = FALSE;
+rbds_t mainTxGroup[3][4];
+volatile uint8_t mainTxActive;
+volatile uint8_t mainTxNext;
+volatile uint8_t mainTxNextReady;
+uint8_t mainTxNextClock; // Next holds the 4A group, which can't wait
+uint8_t mainTxHeld = NOGROUP; // Filled group put back by an urgent one, sent after it
+rbds_t mainTxBlock;
+uint8_t mainTxBlockIndex;
+uint8_t mainTxBitsLeft;
+uint8_t mainTxSample;
+uint8_t mainTxLastBit;
+uint8_t mainTxQuiet; // Symbol is held flat while the VCO settles
+uint16_t mainTxIdle;
+volatile uint8_t mainSleeping = FALSE;
+uint16_t mainSleepStart;
+uint16_t mainIdleCarry; // Timer 1 cycles short of a sample period, not yet ticked
+uint8_t mainRtValid;
+uint8_t mainRtCurrent;
+uint8_t mainRtSegment;
+uint16_t mainRtChanged; // Segments of a new message still to send ahead of order
+uint16_t mainRtSentEarly; // Segments the in order pass skips, sent ahead already
+uint8_t mainRtTextAb = A;
+uint16_t mainRtDwellLeft;
+rbds_t mainPsPairs[PSTEXTSIZE]; // Block D from each char of the PS text
+uint8_t mainPsLength; // Pairs, 8 or more
+uint8_t mainPsFrame; // Char the name on air starts at
+uint8_t mainPsSegment;
+uint8_t mainPsRepeatsLeft;
+uint16_t mainPsCredit; // Share built up, PS goes in the group that takes it past 256
+uint8_t mainCommandType = 0; // Command taking hex digits, 0 when idle
+uint8_t mainCommandIndex; // Hex digits taken
+union {
+    rtc_t clock;
+    urgent_t urgent;
+    uint16_t channel;
+    pstext_t ps;
+    uint8_t injection;
+    uint8_t groupMix;
+} mainCommand;
+rbds_t mainClockGroup[3]; // Blocks B, C & D of the 4A group for the next minute edge
+uint8_t mainClockMinute = 0xff; // Minute of the group built, 0xff for none
+uint8_t mainClockReady = FALSE;
+
+// Retune, worked out by the main loop and played out on channel A by the
+// sample interrupt from the next group boundary
+dac_t mainTuneDac;
+uint16_t mainTuneProfile[2]; // Overshoot for the first quiet symbol, then the new code
+uint8_t mainTuneSymbols; // Quiet symbols to hold
+volatile uint8_t mainTuneReady = FALSE;
+volatile uint8_t mainTuneLeft = 0; // Quiet symbols still to go, 0 when not retuning
+
+// Survive a reset, startup code leaves .noinit alone
+uint8_t mainResetFlags __attribute__ ((section (".noinit")));
+warm_t mainWarm __attribute__ ((section (".noinit")));
+uint8_t mainWarmStart = FALSE;
+uint8_t mainLcdReady = FALSE;
 
 int main(void) {
+    // Time the boot path with timer 1 until it is needed for the pilot, 1024 cycles (64us at 16MHz) per tick
+    TCCR1B = ((1<<CS12)|(1<<CS10));
+
     // Initialize all functions
     mainGpioInit();
-    mainPwmInit();
     spiInit();
     uartInit();
-    mainLcdInit();
+
+    // After a watchdog or brownout reset pick up where transmission left off,
+    // otherwise with a valid stored config go straight to air, skipping entry & encoding
+    if (mainWarmRestore()) {
+        mainSystemState = TRANSMISSION_MODE;
+    } else if (mainConfigLoad()) {
+        mainSystemState = TRANSMISSION_MODE;
+    } else {}
+    mainTelemetry.resetFlags = mainResetFlags;
+    mainTelemetry.warmRestarts = mainWarm.restarts;
+
+    // LCD keeps its contents over a warm restart and its init alone takes 20ms
+    if (!mainWarmStart) {
+        mainLcdInit();
+    } else {}
+
+    // Reset to first sample is this plus a fixed few us, startup fuses add 1ms before main
+    if (mainSystemState == TRANSMISSION_MODE) {
+        mainTelemetry.bootTime = TCNT1;
+    } else {}
+    TCCR1B = 0x00;
+    TCNT1 = 0x0000;
+    mainPwmInit();
+    mainPwmControl(STOPTHEMUSIC); // Off air until transmission starts, trace clock running
+
+    sei(); // UART Rx & sample engine run on interrupts
+#ifdef PROFILE
+    profileStart();
+#endif
 
     // Main control loop
     for (;;) {
+        TRACE(TRACESTATE, mainSystemState);
         switch (mainSystemState) {
             case FREQUENCY_INPUT_MODE:
                 mainFrequencyInputTask();
@@ -73,27 +257,43 @@ void mainGpioInit(void) {
     DDRD |= ((1<<PD2) | (1<<PD3) | (1<<PD5) | (1<<PD6));
     DDRB |= ((1<<PB1) | (1<<PB2) | (1<<PB3) | (1<<PB5));
     PRR |= ((1<<PRTWI)|(1<<PRADC)); // Power down unused modules
+    ACSR |= (1<<ACD); // Analog comparator unused
 }
 
 void mainPwmInit(void) {
     // 57khz 0c0a, PD6
     TCCR0A |= ((1<<COM0A0)|(1<<WGM01)); // Toggle 0c0a on cmp match, ctc mode
-    OCR0A = 139;
+    OCR0A = ((uint8_t) (CARRIERPERIOD-1));
     
     // 19khz 0c1b, PB2
     TCCR1A |= (1<<COM1B0); // Toggle 0c1b on cmp match, ctc mode
     TCCR1B |= (1<<WGM12); // ctc mode, prescaler 1
-    OCR1AH = ((uint8_t) (420>>8));
-    OCR1AL = ((uint8_t) 420);
+    OCR1AH = ((uint8_t) ((SAMPLEPERIOD-1)>>8));
+    OCR1AL = ((uint8_t) (SAMPLEPERIOD-1));
     
     // ~26khz 0c2b, PD3
     TCCR2A |= ((1<<COM2B0)|(1<<WGM21)); // Toggle 0c2b on cmp match, ctc mode
-    OCR2A = 37;
+    OCR2A = ((uint8_t) (TONEPERIOD-1));
+
+    // Timers keep their setup while powered down, off until on air. SPI must be
+    // set up again once powered up, mainPwmControl does that going on air
+    PRR |= ((1<<PRTIM0)|(1<<PRTIM1)|(1<<PRTIM2)|(1<<PRSPI));
 }
 
 void mainLcdInit(void) {
     LcdInit();
     LcdCursor(FALSE, FALSE);
+    mainLcdReady = TRUE;
+}
+
+/*******************************************************************************
+* Runs from .init3 before RAM is set up. A watchdog reset leaves the watchdog  *
+* running on its shortest timeout, it must be off before the slow boot path.  *
+*******************************************************************************/
+void mainResetInit(void) {
+    mainResetFlags = MCUSR;
+    MCUSR = 0x00;
+    wdt_disable();
 }
 
 /*******************************************************************************
@@ -124,14 +324,7 @@ void mainFrequencyInputTask(void) {
     mainFrequencyInputLcdDisp();
 
     for (msgIndex = 0; msgIndex <= 5; msgIndex++) {
-        // Enable interrupts, put cpu to sleep, will wake on uart char rx
-        //sei();
-        //set_sleep_mode(SLEEP_MODE_IDLE);
-        //sleep_mode();
-        // Cpu wakes up here on keypress
-        while ((UCSR0A & (1<<RXC0)) == 0) {}
-
-        msgIncomingChar = uartRx(); // Grab incoming char
+        msgIncomingChar = mainWaitForChar(); // Sleep until a char arrives
 
         // If incoming char was RETURN assume end of entry
         if (msgIncomingChar == RETURN) {
@@ -203,11 +396,13 @@ void mainFrequencyInputTask(void) {
     } else {}
     mainTransitFrequency = ((uint16_t) msgTransitFrequency);
 
+    mainConfig.rtCount = 0; // Carousel is entered from scratch
     mainSystemState = DATA_INPUT_MODE; // Move on to next entry state
 }
 
 void mainFrequencyInputLcdDisp(void) {
     // Show current buffer on lcd
+    TRACE(TRACELCD, TRACELCDFREQUENCY);
     LcdMoveCursor(2, 6);
     LcdDispChar('[');
     LcdDispChar(mainFrequencyBuffer[0]);
@@ -220,6 +415,7 @@ void mainFrequencyInputLcdDisp(void) {
     LcdDispChar('M');
     LcdDispChar('H');
     LcdDispChar('z');
+    TRACE(TRACELCD, TRACELCDFREQUENCY|TRACELCDEND);
 }
 
 void mainDelayOneSec(void) {
@@ -234,37 +430,36 @@ void mainDelayOneSec(void) {
 * Data input task, sleeps CPU until UART Rx, places char into buffer.          *
 * When buffer fills all keys but RETURN & BACKSPACE are ignored. If at any     *
 * time RETURN is received the entry is assumed to be finished and the system   *
-* moves to the next state.                                                     *
+* moves to the next state. Called once per carousel message, an empty entry    *
+* after the first message ends the carousel.                                   *
 *                                                                              *
 * Modifies global variable mainSystemState & mainDataBuffer &                  *
-* mainRbdsPacketLength                                                         *
+* mainRbdsPacketLength & mainConfig                                            *
 *******************************************************************************/
 void mainDataInputTask(void) {
     uint8_t msgIndex;
     uint8_t msgIncomingChar;
     uint8_t msgRevertToPrevState = FALSE;
-    uint8_t msgPadBuffer;
 
     // Clear mainDataBuffer
     for (msgIndex = 0; msgIndex <= 64; msgIndex++) {
         mainDataBuffer[msgIndex] = 0x00;
     }
     
-    // Display frequency mode message
+    // Display message mode message, numbered after the first
     LcdClrDisp();
-    LcdDispStrgP(mainEnterMsgStrg);
+    if (mainConfig.rtCount == 0) {
+        LcdDispStrgP(mainEnterMsgStrg);
+    } else {
+        LcdDispStrgP(mainNextMsgStrg);
+        LcdDispChar(mainConfig.rtCount+'1');
+        LcdDispChar(':');
+    }
     // Show current buffer on lcd
     mainDataInputLcdDisp();
 
     for (msgIndex = 0; msgIndex <= 64; msgIndex++) {
-        // Enable interrupts, put cpu to sleep, will wake on uart char rx
-        //sei();
-        //set_sleep_mode(SLEEP_MODE_IDLE);
-        //sleep_mode();
-        // Cpu wakes up here on keypress
-        while ((UCSR0A & (1<<RXC0)) == 0) {}
-
-        msgIncomingChar = uartRx(); // Grab incoming char
+        msgIncomingChar = mainWaitForChar(); // Sleep until a char arrives
 
         // If incoming char was RETURN assume end of entry
         if (msgIncomingChar == RETURN) {
@@ -296,42 +491,69 @@ void mainDataInputTask(void) {
     // Figure out how to exit state
     if (msgRevertToPrevState) {
         mainSystemState = FREQUENCY_INPUT_MODE;
+    } else if ((mainDataBuffer[0] == 0x00) && (mainConfig.rtCount != 0)) {
+        // Carousel finished, nothing new to encode
+        mainRbdsPacketLength = 0;
+        mainSystemState = ENCODING_MODE;
     } else {
-        // Check length of buffer
-        for (msgIndex = 0; mainDataBuffer[msgIndex] != 0x00; msgIndex++) {}
-        msgIndex--;
-        // msgIndex now contains length of buffer
-        // If message length not divisible by 4, add extra spaces at end of buffer until it is, end with \r
-        msgPadBuffer = (msgIndex % 4);
-        if (msgPadBuffer != 0) {
-            for (; msgPadBuffer <= 2; msgPadBuffer++) {
-                mainDataBuffer[msgIndex] = ' ';
-                msgIndex++;
-            }
-            mainDataBuffer[msgIndex] = RETURN;
-            msgPadBuffer++;
-            mainRbdsPacketLength = ((msgIndex+msgPadBuffer)/4);
-        // If zero length buffer or buffer divisible by 4 but less than 64 chars, make 3 space chars, end with \r
-        } else if (msgIndex != 64) {
-            mainDataBuffer[0] = ' ';
-            mainDataBuffer[1] = ' ';
-            mainDataBuffer[3] = ' ';
-            mainDataBuffer[4] = RETURN;
-            mainRbdsPacketLength = ((msgIndex+4)/4);
-        // If buffer already full, clobber last char with \r
-        } else {
-            mainRbdsPacketBuffer[msgIndex-1] = RETURN;
-            mainRbdsPacketLength = (msgIndex/4);
-        }
+        mainRbdsPacketLength = rbdsPadRadiotext(mainDataBuffer);
+        mainConfig.rtDwell[mainConfig.rtCount] = mainDwellInput();
         mainSystemState = ENCODING_MODE;
     }
 }
 
+/*******************************************************************************
+* Reads up to 3 digits of dwell time in seconds. RETURN on an empty entry      *
+* takes the default, values are clamped to 1-255.                              *
+*******************************************************************************/
+uint8_t mainDwellInput(void) {
+    uint8_t dwellDigits[4] = {0x00, 0x00, 0x00, 0x00};
+    uint8_t dwellIndex = 0;
+    uint8_t dwellIncomingChar = 0x00;
+    uint16_t dwellSeconds = 0;
+
+    LcdClrDisp();
+    LcdDispStrgP(mainDwellStrg);
+    LcdMoveCursor(2, 1);
+
+    while (dwellIncomingChar != RETURN) {
+        dwellIncomingChar = mainWaitForChar();
+
+        if ((dwellIndex <= 2) && (dwellIncomingChar >= '0') && (dwellIncomingChar <= '9')) {
+            dwellDigits[dwellIndex] = dwellIncomingChar;
+            dwellIndex++;
+        } else if ((dwellIndex > 0) && (dwellIncomingChar == BACKSPACE)) {
+            dwellIndex--;
+            dwellDigits[dwellIndex] = 0x00;
+        } else {}
+
+        TRACE(TRACELCD, TRACELCDDWELL);
+        LcdClrLine(2);
+        LcdDispStrg(dwellDigits);
+        TRACE(TRACELCD, TRACELCDDWELL|TRACELCDEND);
+    }
+
+    if (dwellIndex == 0) {
+        return (DEFAULTDWELL);
+    } else {}
+    for (dwellIndex = 0; dwellDigits[dwellIndex] != 0x00; dwellIndex++) {
+        dwellSeconds *= 10;
+        dwellSeconds += (dwellDigits[dwellIndex]-'0');
+    }
+    if (dwellSeconds == 0) {
+        dwellSeconds = 1;
+    } else if (dwellSeconds > 255) {
+        dwellSeconds = 255;
+    } else {}
+    return ((uint8_t) dwellSeconds);
+}
+
 void mainDataInputLcdDisp(void) {
     // Show latest 15 chars of buffer on display
     uint8_t bufferLength;
     uint8_t i;
     
+    TRACE(TRACELCD, TRACELCDMESSAGE);
     LcdClrLine(2);
     LcdMoveCursor(2, 1); // Move cursor to beginning of second line
     // Check if msg exceeds 16 chars
@@ -345,99 +567,20 @@ void mainDataInputLcdDisp(void) {
         LcdDispChar(1); // Print left arrow char
         LcdDispStrg(&mainDataBuffer[bufferLength-15]); // Print to end of string from bufferLength
     }
+    TRACE(TRACELCD, TRACELCDMESSAGE|TRACELCDEND);
 }
 
 /*******************************************************************************
 * Encoding task, takes text data and formats rbds packets for transmission.    *
+* Each message is encoded once into its own EEPROM slot, once the carousel is  *
+* complete the settings are saved so the next boot can skip entry.             *
 *                                                                              *
-* Modifies global variable mainSystemState & mainRbdsPacketBuffer              *
+* Modifies global variable mainSystemState & mainConfig                        *
 *******************************************************************************/
 void mainEncodingTask(void) {
-    rbds_t encRbdsBuffer[64];
-    uint8_t encLoopLength;
-    uint8_t encBufferCount;
-    uint8_t encBitCount;
-    uint8_t encBitLength;
-    uint8_t encCurrentPacket;
-    uint8_t encCurrentSegment = 0;
-    uint8_t encCurrentBitOffset;
-    uint8_t encLastBit = 0;
-    uint8_t encCurrentBit;
-    uint8_t encWorkingBit;
+    rbds_t encRtBlocks[MAXRTGROUPS*2];
     uint8_t i;
-    
-    encLoopLength = ((mainRbdsPacketLength*4)-1);
-    
-    // Stuff fields
-    for (encBufferCount = 0; encBufferCount <= encLoopLength; encBufferCount++) {
-        switch (encBufferCount % 4) {
-            case 0:
-                // Fill each group A field with premade data
-                encRbdsBuffer[encBufferCount].groupa.picode = PICODE;
-                encRbdsBuffer[encBufferCount].groupa.checkword = PICODECHECKWORD;
-                break;
-            case 1:
-                // Fill each group B field with appropriate data
-                encRbdsBuffer[encBufferCount].type2groupb.grouptype = GROUP2A; // group type 2A, radiotext
-                encRbdsBuffer[encBufferCount].type2groupb.tp = FALSE; // No traffic announcements
-                encRbdsBuffer[encBufferCount].type2groupb.pty = NOPROGRAMTYPE; // No PTY sent to receiver
-                encRbdsBuffer[encBufferCount].type2groupb.textab = A; // Group type A
-                encRbdsBuffer[encBufferCount].type2groupb.segmentaddress = encCurrentSegment;
-                // Compute group checksum
-                encRbdsBuffer[encBufferCount].type2groupb.checkword = crcChecksum(&encRbdsBuffer[encBufferCount], OFFSETB);
-                break;
-            case 2:
-                // Fill group c with two chars
-                encRbdsBuffer[encBufferCount].type2groupcd.hichar = mainDataBuffer[encCurrentSegment];
-                encCurrentSegment++;
-                encRbdsBuffer[encBufferCount].type2groupcd.lowchar = mainDataBuffer[encCurrentSegment];
-                encCurrentSegment++;
-                // Compute group checksum
-                encRbdsBuffer[encBufferCount].type2groupcd.checkword = crcChecksum(&encRbdsBuffer[encBufferCount], OFFSETC);
-                break;
-            case 3:
-                // Fill group d with two chars
-                encRbdsBuffer[encBufferCount].type2groupcd.hichar = mainDataBuffer[encCurrentSegment];
-                encCurrentSegment++;
-                encRbdsBuffer[encBufferCount].type2groupcd.lowchar = mainDataBuffer[encCurrentSegment];
-                encCurrentSegment++;
-                // Compute group checksum
-                encRbdsBuffer[encBufferCount].type2groupcd.checkword = crcChecksum(&encRbdsBuffer[encBufferCount], OFFSETD);
-                break;
-            default :
-                break;
-        }
-    }
-    
-    // Differentially encode encRbdsBuffer and place into mainRbdsPacketBuffer
-    encBitLength = (mainRbdsPacketLength-1);
-    encBufferCount = 0;
-    encBitCount = 0;
-    // Go through each packet
-    for (encCurrentPacket = 0; encCurrentPacket <= mainRbdsPacketLength; encCurrentPacket++) {
-        // Go through each bit in each packet, MSB to LSB
-        for (encCurrentBitOffset = 31; encCurrentBitOffset <= 6; encCurrentBitOffset--) {
-            encCurrentBit = ((uint8_t) ((encRbdsBuffer[encCurrentPacket].hex >> encCurrentBitOffset) & ((uint32_t) 0x01))); // get current bit, 0 or 1
-            encWorkingBit = (encCurrentBit ^ encLastBit);
-            encLastBit = encCurrentBit; // Set new last bit
-
-            // Clear or set appropriate bit in correct element of mainRbdsPacketBuffer
-            if (encWorkingBit == 0) {
-                mainRbdsPacketBuffer[encBufferCount] = (mainRbdsPacketBuffer[encBufferCount] & ~(1<<encBitCount));
-            } else {
-                mainRbdsPacketBuffer[encBufferCount] = (mainRbdsPacketBuffer[encBufferCount] | (1<<encBitCount));
-            }
 
-            // Advance to next bit position in element encBufferCount of mainRbdsPacketBuffer
-            if (encBitCount == 7) {
-                encBitCount = 0;
-                encBufferCount++; // After 8 bits, move to next element in mainRbdsPacketBuffer array
-            } else {
-                encBitCount++;
-            }
-        }
-    }
-    
     LcdClrDisp();
     LcdDispStrgP(mainEncodingStrg);
     LcdMoveCursor(2, 1);
@@ -445,87 +588,451 @@ void mainEncodingTask(void) {
     LcdMoveCursor(2, 16);
     LcdDispChar(']');
     LcdMoveCursor(2,2);
+
+    if (mainRbdsPacketLength != 0) {
+        rbdsEncodeRadiotext(mainDataBuffer, encRtBlocks, mainRbdsPacketLength);
+        mainConfig.rtLength[mainConfig.rtCount] = mainRbdsPacketLength;
+        mainConfig.rtChecksum[mainConfig.rtCount] = eepromSaveMessage(mainConfig.rtCount, encRtBlocks, mainRbdsPacketLength);
+        mainConfig.rtCount++;
+    } else {}
+
     for (i = 0; i <= 13; i++) {
         LcdDispChar(2);
         _delay_ms(70);
     }
 
-    mainSystemState = TRANSMISSION_MODE;
+    // Keep taking messages until an empty entry or the carousel is full
+    if ((mainRbdsPacketLength != 0) && (mainConfig.rtCount < MAXRTMESSAGES)) {
+        mainSystemState = DATA_INPUT_MODE;
+    } else {
+        mainConfigSave();
+        mainRtValid = ((1<<mainConfig.rtCount)-1);
+        mainSystemState = TRANSMISSION_MODE;
+    }
+}
+
+/*******************************************************************************
+* Rewinds the carousel to its first valid message. Blocks A and B are fixed by *
+* the build and read from flash as each group is filled.                       *
+*                                                                              *
+* Modifies global variable carousel position                                   *
+*******************************************************************************/
+void mainCarouselStart(void) {
+    // New text on air, receivers must drop what they hold
+    mainRtTextAb ^= 0x01;
+    for (mainRtCurrent = 0; (mainRtValid & (1<<mainRtCurrent)) == 0; mainRtCurrent++) {}
+    mainRtSegment = 0;
+    mainRtChanged = 0;
+    mainRtSentEarly = 0;
+    mainRtDwellLeft = mainDwellGroups(mainConfig.rtDwell[mainRtCurrent]);
+    mainPsStart();
+}
+
+/*******************************************************************************
+* Fills group with the next 2A group of the carousel. Messages only change    *
+* after a complete pass once their dwell time has run out, on the next group  *
+* boundary. Segments that differ from the message receivers hold are sent     *
+* first and the rest follow in order, so small edits land within a few groups. *
+* Text A/B only flips when the new message is shorter, otherwise every old     *
+* segment gets overwritten and receivers can keep showing text meanwhile.      *
+* Cost is a table copy and an 8 byte EEPROM read, short enough to fit between  *
+* two samples, plus the diff on a message change which has a whole group.      *
+*                                                                              *
+* Modifies carousel position                                                   *
+*******************************************************************************/
+void mainCarouselNextGroup(rbds_t *group) {
+    uint8_t next;
+    uint8_t segment;
+
+    // In order pass skips what went out ahead of it
+    while (mainRtSentEarly & ((uint16_t) 1<<mainRtSegment)) {
+        mainRtSentEarly &= ~((uint16_t) 1<<mainRtSegment);
+        mainRtSegment++;
+        if (mainRtSegment >= mainConfig.rtLength[mainRtCurrent]) {
+            mainRtSegment = 0;
+        } else {}
+    }
+
+    if ((mainRtChanged == 0) && (mainRtSentEarly == 0) && (mainRtSegment == 0) && (mainRtDwellLeft == 0)) {
+        // Find next valid message, wrapping back to the current one
+        next = mainRtCurrent;
+        do {
+            next++;
+            if (next >= mainConfig.rtCount) {
+                next = 0;
+            } else {}
+        } while ((mainRtValid & (1<<next)) == 0);
+
+        if (next != mainRtCurrent) {
+            mainRtChanged = mainCarouselChanges(mainRtCurrent, next);
+            if (mainConfig.rtLength[next] < mainConfig.rtLength[mainRtCurrent]) {
+                mainRtTextAb ^= 0x01;
+            } else {}
+            mainRtCurrent = next;
+        } else {}
+        mainRtDwellLeft = mainDwellGroups(mainConfig.rtDwell[mainRtCurrent]);
+    } else {}
+
+    if (mainRtChanged != 0) {
+        for (segment = 0; (mainRtChanged & ((uint16_t) 1<<segment)) == 0; segment++) {}
+        mainRtChanged &= ~((uint16_t) 1<<segment);
+        mainRtSentEarly |= ((uint16_t) 1<<segment);
+    } else {
+        segment = mainRtSegment;
+        mainRtSegment++;
+        if (mainRtSegment >= mainConfig.rtLength[mainRtCurrent]) {
+            mainRtSegment = 0;
+        } else {}
+    }
+
+    rbdsStaticGroupA(&group[0]);
+    rbdsStaticGroup2AB(&group[1], mainRtTextAb, segment);
+    eepromReadBlocks(mainRtCurrent, (segment*2), &group[2], 2);
+
+    if (mainRtDwellLeft != 0) {
+        mainRtDwellLeft--;
+    } else {}
+}
+
+/*******************************************************************************
+* Returns a mask of the segments of message to that differ from message from,  *
+* including any past the end of from.                                          *
+*******************************************************************************/
+uint16_t mainCarouselChanges(uint8_t from, uint8_t to) {
+    rbds_t fromBlocks[2];
+    rbds_t toBlocks[2];
+    uint16_t changed = 0;
+    uint8_t segment;
+
+    for (segment = 0; segment < mainConfig.rtLength[to]; segment++) {
+        if (segment >= mainConfig.rtLength[from]) {
+            changed |= ((uint16_t) 1<<segment);
+        } else {
+            eepromReadBlocks(from, (segment*2), fromBlocks, 2);
+            eepromReadBlocks(to, (segment*2), toBlocks, 2);
+            if ((fromBlocks[0].hex != toBlocks[0].hex) || (fromBlocks[1].hex != toBlocks[1].hex)) {
+                changed |= ((uint16_t) 1<<segment);
+            } else {}
+        }
+    }
+    return (changed);
+}
+
+uint16_t mainDwellGroups(uint8_t seconds) {
+    // 104 bits per group at 1187.5 bits per second
+    return ((uint16_t) ((((uint32_t) seconds) * 2375) / 208));
+}
+
+/*******************************************************************************
+* Encodes the PS text into the pair cache, once per text. Short names are      *
+* padded to 8 chars and never step.                                            *
+*                                                                              *
+* Modifies PS position                                                         *
+*******************************************************************************/
+void mainPsStart(void) {
+    uint8_t text[PSTEXTSIZE];
+    uint8_t length;
+
+    for (length = 0; (length < mainConfig.psLength) && (length < PSTEXTSIZE); length++) {
+        text[length] = mainConfig.psName[length];
+    }
+    for (; length < 8; length++) {
+        text[length] = ' ';
+    }
+    rbdsEncodePs(text, mainPsPairs, length);
+    mainPsLength = length;
+    mainPsFrame = 0;
+    mainPsSegment = 0;
+    mainPsRepeatsLeft = mainConfig.psRepeats;
+    mainPsCredit = PSSHAREHALF;
 }
 
 /*******************************************************************************
-* Transmission task, turns on transmission hardware and loops through packet   *
-* buffer, checking each bit in turn. Positive or negative sin waves are        *
-* generated and sent to the transmission hardware.                             *
+* Fills group with the next 0A group of the PS name from the pair cache. A     *
+* scroll only steps once the name has gone out whole its repeats, so receivers *
+* never put together a name from two steps. The dwell is time on air, so it    *
+* runs down here as well.                                                      *
+*                                                                              *
+* Modifies PS position & mainRtDwellLeft                                       *
+*******************************************************************************/
+void mainPsNextGroup(rbds_t *group) {
+    uint8_t pair;
+
+    pair = (mainPsFrame + (mainPsSegment*2));
+    if (pair >= mainPsLength) {
+        pair -= mainPsLength;
+    } else {}
+    rbdsStaticGroupA(&group[0]);
+    rbdsStaticGroup0A(&group[1], mainPsSegment);
+    group[3] = mainPsPairs[pair];
+
+    mainPsSegment++;
+    if (mainPsSegment > 3) {
+        mainPsSegment = 0;
+        mainPsRepeatsLeft--;
+        if ((mainPsRepeatsLeft == 0) && (mainPsLength > 8)) {
+            mainPsFrame++;
+            if (mainPsFrame >= mainPsLength) {
+                mainPsFrame = 0;
+            } else {}
+        } else {}
+        if (mainPsRepeatsLeft == 0) {
+            mainPsRepeatsLeft = mainConfig.psRepeats;
+        } else {}
+    } else {}
+
+    if (mainRtDwellLeft != 0) {
+        mainRtDwellLeft--;
+    } else {}
+}
+
+/*******************************************************************************
+* Takes a new PS text from the controller, saved and put on air from its first *
+* name. Refused if longer than fits, or scrolling faster than PSREPEATSMIN.    *
+* Saving a whole new text can take longer than a group, which then goes out    *
+* twice.                                                                       *
+*                                                                              *
+* Modifies global variable mainConfig & mainWarm & PS position                 *
+*******************************************************************************/
+uint8_t mainPsSet(pstext_t *ps) {
+    uint8_t i;
+
+    if ((ps->length > PSTEXTSIZE) || ((ps->length > 8) && (ps->repeats < PSREPEATSMIN))) {
+        return (FALSE);
+    } else {}
+    for (i = 0; i < ps->length; i++) {
+        mainConfig.psName[i] = ps->text[i];
+    }
+    mainConfig.psLength = ps->length;
+    mainConfig.psRepeats = ((ps->repeats < PSREPEATSMIN) ? PSREPEATSMIN : ps->repeats);
+    if (ps->length == 0) {
+        mainConfig.groupMix &= ~GROUPMIX0A;
+    } else {
+        mainConfig.groupMix |= GROUPMIX0A;
+    }
+    mainConfigQueue();
+    mainWarm.config = mainConfig;
+    mainPsStart();
+    return (TRUE);
+}
+
+/*******************************************************************************
+* Counts a carousel group against the PS share and returns TRUE if it goes to  *
+* PS. Every other group, or for fastest tune in a share set by the length of   *
+* the message on air. Shares add up so PS groups are spread evenly, a receiver *
+* joining at any point waits about as long as at any other.                    *
+*                                                                              *
+* Modifies PS position                                                         *
+*******************************************************************************/
+uint8_t mainPsDue(void) {
+    uint8_t length;
+
+    if (mainConfig.groupMix & GROUPMIXACQUIRE) {
+        length = mainConfig.rtLength[mainRtCurrent];
+        if (length == 0) {
+            length = 1;
+        } else if (length > MAXRTGROUPS) {
+            length = MAXRTGROUPS;
+        } else {}
+        mainPsCredit += pgm_read_byte(&mainPsShare[length-1]);
+    } else {
+        mainPsCredit += PSSHAREHALF;
+    }
+    if (mainPsCredit < 256) {
+        return (FALSE);
+    } else {}
+    mainPsCredit -= 256;
+    return (TRUE);
+}
+
+/*******************************************************************************
+* Takes the group types to send alongside 2A from the controller. Refused for  *
+* unknown types, or PS with no text to send.                                   *
+*                                                                              *
+* Modifies global variable mainConfig & mainWarm                               *
+*******************************************************************************/
+uint8_t mainGroupMixSet(uint8_t mix) {
+    if ((mix & ~(GROUPMIX0A|GROUPMIXACQUIRE)) || ((mix & GROUPMIX0A) && (mainConfig.psLength == 0))) {
+        return (FALSE);
+    } else {}
+    mainConfig.groupMix = mix;
+    mainConfigQueue();
+    mainWarm.config = mainConfig;
+    return (TRUE);
+}
+
+/*******************************************************************************
+* Loads newest stored config and checks each stored message. Returns FALSE if  *
+* the config or every message fails its checksum, leaving the unit to          *
+* interactive entry. Messages failing alone are skipped by the carousel.      *
+*                                                                              *
+* Modifies global variable mainConfig & mainRtValid & mainTransitFrequency &   *
+* mainFrequencyBuffer                                                          *
+*******************************************************************************/
+uint8_t mainConfigLoad(void) {
+    uint8_t i;
+
+    if (!eepromLoadConfig(&mainConfig)) {
+        return (FALSE);
+    } else {}
+
+    mainRtValid = 0;
+    for (i = 0; (i < mainConfig.rtCount) && (i < MAXRTMESSAGES); i++) {
+        if (eepromCheckMessage(i, mainConfig.rtLength[i], mainConfig.rtChecksum[i])) {
+            mainRtValid |= (1<<i);
+        } else {}
+    }
+    if (mainRtValid == 0) {
+        return (FALSE);
+    } else {}
+
+    mainTransitFrequency = mainConfig.frequency;
+    mainFrequencyBufferFill(mainTransitFrequency);
+    return (TRUE);
+}
+
+/*******************************************************************************
+* Saves the entered frequency and carousel, messages are already in their      *
+* slots so only the config needs committing.                                   *
+*                                                                              *
+* Modifies global variable mainConfig                                          *
+*******************************************************************************/
+void mainConfigSave(void) {
+    mainConfigPrepare();
+    eepromSaveConfig(&mainConfig);
+}
+
+/*******************************************************************************
+* Saves the config from on air without holding up the main loop, the main loop *
+* writes it a byte a pass and any left is finished on leaving air.             *
+*                                                                              *
+* Modifies global variable mainConfig                                          *
+*******************************************************************************/
+void mainConfigQueue(void) {
+    mainConfigPrepare();
+    eepromSaveConfigStart(&mainConfig);
+}
+
+/*******************************************************************************
+* Fills the config for a save, defaults on a blank part then the frequency.    *
+*                                                                              *
+* Modifies global variable mainConfig                                          *
+*******************************************************************************/
+void mainConfigPrepare(void) {
+    uint8_t i;
+
+    // First save on a blank part, start from defaults
+    if (mainConfig.initialized != CONFIGINITIALIZED) {
+        mainConfig.initialized = CONFIGINITIALIZED;
+        for (i = 0; i <= 7; i++) {
+            mainConfig.psName[i] = PSNAME[i];
+        }
+        mainConfig.psLength = 8;
+        mainConfig.psRepeats = PSREPEATSDEFAULT;
+        mainConfig.groupMix = 0;
+        mainConfig.injection = INJECTIONFULL;
+    } else {}
+
+    mainConfig.frequency = mainTransitFrequency;
+    mainConfig.tuningCode = mainTuningCode(mainTransitFrequency);
+}
+
+void mainFrequencyBufferFill(uint16_t frequency) {
+    int8_t i;
+
+    // Right justify digits, blank leading zero below 100MHz
+    for (i = 4; i >= 0; i--) {
+        mainFrequencyBuffer[i] = ((frequency % 10) + '0');
+        frequency /= 10;
+    }
+    if (mainFrequencyBuffer[0] == '0') {
+        mainFrequencyBuffer[0] = ' ';
+    } else {}
+}
+
+/*******************************************************************************
+* Transmission task, turns on transmission hardware and hands samples to the   *
+* timer 1 compare interrupt, which is locked to the 19khz pilot. Between      *
+* interrupts the CPU idles asleep, waking to fill the next carousel group,     *
+* check for commands and send telemetry.                                       *
 *                                                                              *
 * Modifies global variable mainSystemState                                     *
 *******************************************************************************/
 void mainTransmissionTask(void) {
     dac_t trxDac;
     uint8_t trxIncomingChar = 0x00;
-    uint16_t trxCurrentBufferBit;
-    uint8_t trxCurrentBufferByte;
-    uint16_t trxBufferBitLength;
-    uint8_t trxCurrentBitInByte;
-    uint8_t trxSinType;
-    uint8_t i;
     
     mainPwmControl(STARTTHEMUSIC); // Start the music
 
-    // Display frequency mode message
-    LcdClrDisp();
-    LcdDispStrgP(mainTransmittingStrg);
-    LcdMoveCursor(2,1);
-    LcdDispStrgP(mainFreqStrg);
-    mainFrequencyInputLcdDisp();
+    // Display frequency mode message, still showing after a warm restart
+    if (!mainWarmStart) {
+        TRACE(TRACELCD, TRACELCDTRANSMIT);
+        LcdClrDisp();
+        LcdDispStrgP(mainTransmittingStrg);
+        LcdMoveCursor(2,1);
+        LcdDispStrgP(mainFreqStrg);
+        mainFrequencyInputLcdDisp();
+        TRACE(TRACELCD, TRACELCDTRANSMIT|TRACELCDEND);
+    } else {}
 
     // Set transmission frequency
     trxDac.bit.channel = CHA;
     trxDac.bit.gainstage = TWOVREF;
     trxDac.bit.shutdown = STARTUP;
-    trxDac.bit.data = mainFrequencyConverter(mainTransitFrequency);
+    trxDac.bit.data = mainConfig.tuningCode;
     spiUpdateDac(trxDac);
-    
-    trxDac.bit.channel = CHB; // Get ready for transmitting data
-    
-    trxBufferBitLength = (((uint16_t) mainRbdsPacketLength) * 104); // Calculate how many bits we must transmit
-    trxCurrentBitInByte = 0;
-    trxCurrentBufferByte = 0;
+
+    mainCarouselStart();
+    if (mainWarmStart) {
+        mainWarmResume();
+    } else {}
+    mainWarm.config = mainConfig;
+    mainTxStart();
+    mainWarmSave();
+    mainAirReport();
+
+    // A group takes 88ms, both the interrupt and this loop must keep them moving
+    WATCHDOGSTART();
     
     while (trxIncomingChar != BACKSPACE) {
+        mainSleep();
+        // Interrupt has moved on to the group just filled, fill the next one
+        if (!mainTxNextReady) {
+            mainTxFill();
+            mainWarmSave();
+            WATCHDOGKICK();
+            mainClockPrepare();
+        } else {}
+        mainInjectionUpdate();
+        (void) eepromSaveConfigStep();
         trxIncomingChar = uartRx(); // Check if we need to exit
-        // Loop through for each bit we must transmit
-        for (trxCurrentBufferBit = 0; trxCurrentBufferBit <= trxBufferBitLength; trxCurrentBufferBit++) {
-            // Determine if we must transmit a 1 or 0
-            trxSinType = (mainRbdsPacketBuffer[trxCurrentBufferByte] & (0x80>>trxCurrentBitInByte));
-            
-            // Transmit all 31 bits of the sin wave, either positive or negative
-            // Positive wave
-            if (trxSinType) {
-                for (i = 0; i <= 30; i++) {
-                    trxDac.bit.data = pgm_read_word(&mainSinTable[i]);
-                    spiUpdateDac(trxDac); // Send new data to DAC
-                    _delay_us(PERIODDELAY-COMPUTATIONTIME); // Delay until next sin wave segment is needed, adjust COMPUTATIONTIME as needed
-                }
-            // Negative wave
-            } else {
-                for (i = 32; i >= 1; i--) {
-                    trxDac.bit.data = pgm_read_word(&mainSinTable[i]);
-                    spiUpdateDac(trxDac); // Send new data to DAC
-                    _delay_us(PERIODDELAY-COMPUTATIONTIME); // Delay until next sin wave segment is needed, adjust COMPUTATIONTIME as needed
-                }
-            }
-                        
-            // Keep track of which byte and bit position each bit is stored in
-            if (trxCurrentBitInByte == 7) {
-                trxCurrentBitInByte = 0;
-                trxCurrentBufferByte++;
-            } else {
-                trxCurrentBitInByte++;
-            }
-        }
+        if (mainCommandType != 0) {
+            trxIncomingChar = mainCommandChar(trxIncomingChar);
+        } else {}
+        if (trxIncomingChar == TELEMETRYREQUEST) {
+            mainTelemetryStart();
+        } else if (trxIncomingChar == TRACEDUMP) {
+            mainTraceDumpStart();
+        } else if (trxIncomingChar == TRACESAMPLES) {
+            traceMask ^= ((1<<TRACESAMPLE));
+        } else if ((trxIncomingChar == CLOCKSET) || (trxIncomingChar == URGENTGROUP) || (trxIncomingChar == CHANNELSET)
+            || (trxIncomingChar == PSSET) || (trxIncomingChar == INJECTIONSET) || (trxIncomingChar == GROUPMIXSET)
+            || (trxIncomingChar == BOOTREQUEST)) {
+            mainCommandType = trxIncomingChar;
+            mainCommandIndex = 0;
+#ifdef PROFILE
+        } else if (trxIncomingChar == PROFILEDUMP) {
+            mainProfileDumpStart();
+#endif
+        } else {}
+        mainReportSend();
     }
 
+    WATCHDOGSTOP();
+    eepromSaveConfigFinish();
+    TIMSK1 &= ~(1<<OCIE1A); // Stop sample engine
+    mainWarm.checksum = ~mainWarm.checksum; // Left air on purpose, don't come back to it
+
     // Turn off DAC outputs
     trxDac.bit.channel = CHA;
     trxDac.bit.shutdown = SHUTDOWN;
@@ -535,9 +1042,680 @@ void mainTransmissionTask(void) {
     spiUpdateDac(trxDac);
 
     mainPwmControl(STOPTHEMUSIC);
+    if (!mainLcdReady) {
+        mainLcdInit();
+    } else {}
     mainSystemState = FREQUENCY_INPUT_MODE;
 }
 
+/*******************************************************************************
+* Hands over to the serial bootloader for a firmware update. The request is   *
+* left in the top word of RAM, which the bootloader checks after the watchdog *
+* reset. Nothing runs on the stack after the write. Does not return.          *
+*******************************************************************************/
+void mainBootRequest(void) {
+    cli();
+    *((volatile uint16_t *) BOOTREQUESTADDRESS) = BOOTREQUESTMAGIC;
+    wdt_enable(WDTO_15MS);
+    for (;;) {}
+}
+
+/*******************************************************************************
+* Takes the config and carousel state kept in .noinit if the last reset was a  *
+* watchdog or brownout reset and the state checks out. Returns FALSE after any *
+* other reset, which also starts the restart count over.                       *
+*                                                                              *
+* Modifies global variable mainConfig & mainRtValid & mainTransitFrequency &   *
+* mainFrequencyBuffer & mainWarmStart & mainWarm                               *
+*******************************************************************************/
+uint8_t mainWarmRestore(void) {
+    if (((mainResetFlags & ((1<<WDRF)|(1<<BORF))) == 0) || (mainResetFlags & (1<<PORF))
+            || (crcCcitt((uint8_t *) &mainWarm, sizeof(warm_t)-2) != mainWarm.checksum)) {
+        mainWarm.restarts = 0;
+        return (FALSE);
+    } else {}
+
+    mainConfig = mainWarm.config;
+    mainRtValid = mainWarm.rtValid;
+    mainTransitFrequency = mainConfig.frequency;
+    mainFrequencyBufferFill(mainTransitFrequency);
+    mainWarm.restarts++;
+    mainWarmStart = TRUE;
+    return (TRUE);
+}
+
+/*******************************************************************************
+* Puts the carousel back where it was, text A/B included, so receivers carry   *
+* on without dropping the text they hold.                                      *
+*                                                                              *
+* Modifies carousel position & mainWarmStart                                   *
+*******************************************************************************/
+void mainWarmResume(void) {
+    mainRtCurrent = mainWarm.rtCurrent;
+    mainRtSegment = mainWarm.rtSegment;
+    mainRtTextAb = mainWarm.rtTextAb;
+    mainRtChanged = mainWarm.rtChanged;
+    mainRtSentEarly = mainWarm.rtSentEarly;
+    mainRtDwellLeft = mainWarm.rtDwellLeft;
+    mainWarmStart = FALSE;
+}
+
+/*******************************************************************************
+* Records carousel position after each group fill, around 1500 cycles for the  *
+* checksum once a group.                                                       *
+*                                                                              *
+* Modifies global variable mainWarm                                            *
+*******************************************************************************/
+void mainWarmSave(void) {
+    mainWarm.rtValid = mainRtValid;
+    mainWarm.rtCurrent = mainRtCurrent;
+    mainWarm.rtSegment = mainRtSegment;
+    mainWarm.rtTextAb = mainRtTextAb;
+    mainWarm.rtChanged = mainRtChanged;
+    mainWarm.rtSentEarly = mainRtSentEarly;
+    mainWarm.rtDwellLeft = mainRtDwellLeft;
+    mainWarm.checksum = crcCcitt((uint8_t *) &mainWarm, sizeof(warm_t)-2);
+}
+
+/*******************************************************************************
+* Primes the sample engine with the first group and enables its interrupt.    *
+* State is set as if a group just finished, so the first interrupt swaps the   *
+* group in and starts on its first bit.                                        *
+*                                                                              *
+* Modifies sample engine state                                                 *
+*******************************************************************************/
+void mainTxStart(void) {
+    mainTxDac.bit.channel = CHB;
+    mainTxDac.bit.gainstage = TWOVREF;
+    mainTxDac.bit.shutdown = STARTUP;
+    mainInjectionFill(mainTxWaves[0], mainConfig.injection);
+    mainTxWave = mainTxWaves[0];
+    mainTxWaveNext = NULL;
+    mainInjectionDue = FALSE;
+    mainTxDac.bit.data = mainTxWave[0];
+    SAMPLELOAD(mainTxDac);
+
+    mainTxActive = 2;
+    mainTxHeld = NOGROUP;
+    mainCarouselNextGroup(mainTxGroup[0]);
+    mainTxNext = 0;
+    mainTxNextClock = FALSE;
+    mainTxNextReady = TRUE;
+    mainTxBlockIndex = 3;
+    mainTxBitsLeft = 0;
+    mainTxSample = (SAMPLESPERSYMBOL-1);
+    mainTxLastBit = 0;
+    mainTxQuiet = FALSE;
+    mainTuneReady = FALSE;
+    mainTuneLeft = 0;
+    mainTxIdle = 0xffff; // First boundary is not a whole symbol, keep it out of the minimum
+
+    TIFR1 = (1<<OCF1A); // Pilot has been running, don't count the first sample as late
+    TIMSK1 |= (1<<OCIE1A);
+}
+
+/*******************************************************************************
+* Quiet symbol of a retune, from the sample interrupt at a group boundary. The *
+* first writes the overshoot to channel A and the second the new code, the     *
+* rest hold while the VCO settles. The stub has sent this period's sample, so  *
+* the SPI is free until the next compare match.                                *
+*******************************************************************************/
+void mainTuneSymbol(void) {
+    uint8_t step;
+
+    if (mainTuneLeft == 0) {
+        mainTuneLeft = mainTuneSymbols;
+        mainTuneReady = FALSE;
+    } else {}
+    step = (mainTuneSymbols - mainTuneLeft);
+    if (step < 2) {
+        mainTuneDac.bit.data = mainTuneProfile[step];
+        spiUpdateDac(mainTuneDac);
+    } else {}
+    mainTuneLeft--;
+    mainTxQuiet = TRUE;
+}
+
+/*******************************************************************************
+* Sample handler, the stub in sample.c has already sent the sample worked out  *
+* last time at a fixed cycle from the compare match, so output timing does not *
+* depend on which path is taken below. Loads the next sample for the stub.     *
+*                                                                              *
+* Modifies sample engine state & mainTelemetry                                 *
+*******************************************************************************/
+ISR(__vector_sample) {
+    uint16_t isrLatency;
+    uint16_t isrSlept;
+
+    isrLatency = sampleEntry;
+    TRACETICK();
+    RTCTICK();
+    TRACE(TRACESAMPLE, (uint8_t) (isrLatency>>1));
+
+    // CPU was asleep from mainSleepStart until this compare match woke it
+    if (mainSleeping) {
+        isrSlept = ((OCR1A+1)-mainSleepStart);
+        mainTxIdle += isrSlept;
+        mainTelemetry.sleepCycles += isrSlept;
+        mainSleeping = FALSE;
+    } else {}
+    if (isrLatency > mainTelemetry.maxLatency) {
+        mainTelemetry.maxLatency = isrLatency;
+    } else {}
+
+    mainTxSample++;
+    if (mainTxSample >= SAMPLESPERSYMBOL) {
+        mainTxSample = 0;
+
+        mainTelemetry.symbols++;
+        mainTelemetry.lastIdle = mainTxIdle;
+        if (mainTxIdle < mainTelemetry.minIdle) {
+            mainTelemetry.minIdle = mainTxIdle;
+        } else {}
+        mainTxIdle = 0;
+
+        // Symbols start and end on the mid level at any injection, no step
+        if (mainTxWaveNext != NULL) {
+            mainTxWave = mainTxWaveNext;
+            mainTxWaveNext = NULL;
+        } else {}
+
+        if ((mainTxBitsLeft == 0) && (mainTxBlockIndex == 3) && (mainTuneReady || (mainTuneLeft != 0))) {
+            mainTuneSymbol();
+        } else {
+            mainTxQuiet = FALSE;
+            if (mainTxBitsLeft == 0) {
+                mainTxBlockIndex++;
+                if (mainTxBlockIndex > 3) {
+                    mainTxBlockIndex = 0;
+                    // Move to the group the main loop filled, resend this one if it is late
+                    if (mainTxNextReady) {
+                        mainTxActive = mainTxNext;
+                        mainTxNextReady = FALSE;
+                        TRACE(TRACEGROUP, 0);
+                    } else {
+                        mainTelemetry.underruns++;
+                        TRACE(TRACEGROUP, 1);
+                    }
+                    mainTelemetry.groups++;
+                } else {}
+                mainTxBlock = mainTxGroup[mainTxActive][mainTxBlockIndex];
+                mainTxBitsLeft = 26;
+                mainTelemetry.blocks++;
+            } else {}
+
+            mainTxLastBit = rbdsDiffEncode(&mainTxBlock, mainTxLastBit);
+            mainTxBitsLeft--;
+        }
+    } else {}
+
+    // Positive or negative wave for the current bit, flat while the VCO settles
+    if (mainTxQuiet) {
+        mainTxDac.bit.data = mainTxWave[0];
+    } else if (mainTxLastBit) {
+        mainTxDac.bit.data = mainTxWave[mainTxSample];
+    } else {
+        mainTxDac.bit.data = mainTxWave[(SAMPLESPERSYMBOL-1)-mainTxSample];
+    }
+    SAMPLELOAD(mainTxDac);
+
+    // Next compare match already passed, a sample will be late
+    if (TIFR1 & (1<<OCF1A)) {
+        mainTelemetry.underruns++;
+        TRACE(TRACELATE, 0);
+    } else {}
+}
+
+/*******************************************************************************
+* Trace clock & RTC off air, compare B matches once per IDLEPERIODS sample     *
+* periods.                                                                     *
+*******************************************************************************/
+ISR(TIMER1_COMPB_vect) {
+    TRACETICKS(IDLEPERIODS);
+    RTCTICKS(IDLEPERIODS);
+}
+
+/*******************************************************************************
+* Idles the CPU until the next interrupt. Off air the Rx ring is checked with  *
+* interrupts off and they are only enabled by the instruction before sleep,    *
+* so a byte landing after the caller's check can't leave the CPU asleep with   *
+* it unread. On air the sample interrupt wakes it within a period anyway, so   *
+* interrupts stay on and only the TCNT1 read, which shares the TEMP register   *
+* with the stub's, holds them off. A byte already waiting skips the sleep, and *
+* on air the sample interrupt counts the time slept.                           *
+*******************************************************************************/
+void mainSleep(void) {
+    set_sleep_mode(SLEEP_MODE_IDLE);
+    if (!(TIMSK1 & (1<<OCIE1A))) {
+        cli();
+    } else {}
+    if (uartRxReady()) {
+        sei();
+        return;
+    } else {}
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+        mainSleepStart = TCNT1;
+    }
+    mainSleeping = TRUE;
+    sleep_enable();
+    sei();
+    sleep_cpu();
+    sleep_disable();
+    mainSleeping = FALSE; // Woken by something other than the sample interrupt
+}
+
+uint8_t mainWaitForChar(void) {
+    while (!uartRxReady()) {
+        mainSleep();
+    }
+    return (uartRx());
+}
+
+/*******************************************************************************
+* Telemetry is snapshotted on request and then sent one char at a time as the  *
+* main loop wakes, so the report never holds up the carrier.                   *
+*                                                                              *
+* Modifies global variable mainTelemetryReport & report state                  *
+*******************************************************************************/
+void mainTelemetryStart(void) {
+    // Let a report in progress finish rather than tear it
+    if (mainReportType == 0) {
+        // Copied whole, then each count an interrupt keeps copied again on its
+        // own, so the sample interrupt is held off for one field at a time
+        mainTelemetry.urgentDropped = urgentDropped;
+        mainTelemetry.uartTxDropped = uartTxDropped;
+        mainTelemetryReport = mainTelemetry;
+        ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+            mainTelemetryReport.groups = mainTelemetry.groups;
+        }
+        ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+            mainTelemetryReport.blocks = mainTelemetry.blocks;
+        }
+        ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+            mainTelemetryReport.symbols = mainTelemetry.symbols;
+        }
+        ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+            mainTelemetryReport.underruns = mainTelemetry.underruns;
+        }
+        ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+            mainTelemetryReport.maxLatency = mainTelemetry.maxLatency;
+        }
+        ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+            mainTelemetryReport.minIdle = mainTelemetry.minIdle;
+        }
+        ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+            mainTelemetryReport.lastIdle = mainTelemetry.lastIdle;
+        }
+        ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+            mainTelemetryReport.sleepCycles = mainTelemetry.sleepCycles;
+        }
+        ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+            mainTelemetryReport.uartOverruns = uartOverruns;
+        }
+        // Active time as permille of the symbols since the last report
+        if (mainTelemetryReport.symbols != mainTelemetrySymbolMark) {
+            mainTelemetryReport.dutyCycle = (1000-((((mainTelemetryReport.sleepCycles-mainTelemetrySleepMark)/(mainTelemetryReport.symbols-mainTelemetrySymbolMark))*1000)/CYCLESPERSYMBOL));
+        } else {}
+        mainTelemetrySleepMark = mainTelemetryReport.sleepCycles;
+        mainTelemetrySymbolMark = mainTelemetryReport.symbols;
+        mainReportType = TELEMETRYREPORT;
+        mainReportLength = sizeof(telemetry_t);
+        mainReportIndex = 0;
+    } else {}
+}
+
+/*******************************************************************************
+* Trace ring is frozen for the dump and recording picks up again once the      *
+* last char is out, about half a second for a full ring.                       *
+*                                                                              *
+* Modifies report state                                                        *
+*******************************************************************************/
+void mainTraceDumpStart(void) {
+    if (mainReportType == 0) {
+        mainReportType = TRACEREPORT;
+        mainReportLength = traceDumpStart();
+        mainReportIndex = 0;
+    } else {}
+}
+
+#ifdef PROFILE
+/*******************************************************************************
+* PC histogram is frozen for the dump and cleared once the last char is out,   *
+* the host adds up successive dumps.                                           *
+*                                                                              *
+* Modifies report state                                                        *
+*******************************************************************************/
+void mainProfileDumpStart(void) {
+    if (mainReportType == 0) {
+        mainReportType = PROFILEREPORT;
+        mainReportLength = profileDumpStart();
+        mainReportIndex = 0;
+    } else {}
+}
+#endif
+
+/*******************************************************************************
+* Streams the report in progress into the UART Tx ring as room allows: report  *
+* type letter, two hex digits per report byte, then CR LF. Never waits, the    *
+* Tx interrupt drains the ring while the main loop sleeps.                     *
+*                                                                              *
+* Modifies report state                                                        *
+*******************************************************************************/
+void mainReportSend(void) {
+    uint8_t sendByte;
+
+    if (mainReportType == 0) {
+        return;
+    } else {}
+
+    while (uartTxFree() >= 2) {
+        if (mainReportIndex == 0) {
+            uartStreamStart();
+            (void) uartTx(mainReportType);
+        } else if (mainReportIndex <= mainReportLength) {
+            if (mainReportType == TRACEREPORT) {
+                sendByte = traceDumpByte(mainReportIndex-1);
+#ifdef PROFILE
+            } else if (mainReportType == PROFILEREPORT) {
+                sendByte = profileDumpByte(mainReportIndex-1);
+#endif
+            } else {
+                sendByte = ((uint8_t *) &mainTelemetryReport)[mainReportIndex-1];
+            }
+            (void) uartTxHex(sendByte);
+        } else {
+            (void) uartTx('\r');
+            (void) uartTx('\n');
+            uartStreamEnd();
+            if (mainReportType == TRACEREPORT) {
+                traceDumpEnd();
+#ifdef PROFILE
+            } else if (mainReportType == PROFILEREPORT) {
+                profileDumpEnd();
+#endif
+            } else {}
+            mainReportType = 0;
+            return;
+        }
+        mainReportIndex++;
+    }
+}
+
+/*******************************************************************************
+* Answers a command with a line of its own: ACKREPORT, the command letter,     *
+* then 01 if it was taken or 00 if refused. Settings follow with the value now *
+* in effect in decimal. Dropped rather than waited for if a report has the     *
+* UART.                                                                        *
+*******************************************************************************/
+void mainCommandAck(uint8_t command, uint8_t done) {
+    uartline_t line;
+
+    uartLineStart(&line, ACKREPORT);
+    uartLineChar(&line, command);
+    uartLineHex(&line, done);
+    if (command == CHANNELSET) {
+        uartLineChar(&line, ' ');
+        uartLineUnsigned(&line, mainTransitFrequency);
+    } else if (command == PSSET) {
+        uartLineChar(&line, ' ');
+        uartLineUnsigned(&line, mainConfig.psLength);
+    } else if (command == INJECTIONSET) {
+        uartLineChar(&line, ' ');
+        uartLineUnsigned(&line, mainConfig.injection);
+    } else if (command == GROUPMIXSET) {
+        uartLineChar(&line, ' ');
+        uartLineUnsigned(&line, mainConfig.groupMix);
+    } else {}
+    (void) uartLineSend(&line);
+}
+
+/*******************************************************************************
+* Tells the host the unit is on air with the same text as the LCD, so a host   *
+* needn't probe with telemetry to find out.                                    *
+*******************************************************************************/
+void mainAirReport(void) {
+    uartline_t line;
+
+    uartLineStart(&line, AIRREPORT);
+    uartLineStringP(&line, mainTransmittingStrg);
+    uartLineChar(&line, ' ');
+    uartLineString(&line, &mainFrequencyBuffer[(mainFrequencyBuffer[0] == ' ') ? 1 : 0]); // No LCD justifying blank
+    (void) uartLineSend(&line);
+}
+
+/*******************************************************************************
+* Takes the next hex digit of a clock set, urgent group, channel, PS text,     *
+* injection level or group mix, high digit of each byte first, and acts on the *
+* last. A clock set is timed by the controller so the last digit lands on a    *
+* second edge. A boot request instead takes BOOTREQUESTCONFIRM char by char    *
+* and only then hands over, so a stray 'B' can't take the unit off air. Any    *
+* other char abandons the command and is returned to be handled as one, 0 is   *
+* returned for a char used here.                                               *
+*                                                                              *
+* Modifies global variable mainCommandType & mainCommandIndex & mainCommand &  *
+* mainClockMinute & mainClockReady                                             *
+*******************************************************************************/
+uint8_t mainCommandChar(uint8_t c) {
+    uint8_t digit;
+    uint8_t *byte;
+    uint8_t length;
+
+    if (c == 0) {
+        return (0);
+    } else if (mainCommandType == BOOTREQUEST) {
+        if (c != pgm_read_byte(&mainBootConfirmStrg[mainCommandIndex])) {
+            mainCommandType = 0;
+            return (c);
+        } else {}
+        mainCommandIndex++;
+        if (pgm_read_byte(&mainBootConfirmStrg[mainCommandIndex]) == 0x00) {
+            mainBootRequest();
+        } else {}
+        return (0);
+    } else if ((c >= '0') && (c <= '9')) {
+        digit = (c-'0');
+    } else if ((c >= 'a') && (c <= 'f')) {
+        digit = (c-('a'-10));
+    } else if ((c >= 'A') && (c <= 'F')) {
+        digit = (c-('A'-10));
+    } else {
+        mainCommandType = 0;
+        return (c);
+    }
+
+    byte = &((uint8_t *) &mainCommand)[mainCommandIndex>>1];
+    if (mainCommandIndex & 0x01) {
+        *byte |= digit;
+    } else {
+        *byte = (digit<<4);
+    }
+    mainCommandIndex++;
+    if (mainCommandType == CLOCKSET) {
+        length = sizeof(rtc_t);
+    } else if (mainCommandType == CHANNELSET) {
+        length = sizeof(uint16_t);
+    } else if (mainCommandType == PSSET) {
+        length = sizeof(pstext_t);
+    } else if ((mainCommandType == INJECTIONSET) || (mainCommandType == GROUPMIXSET)) {
+        length = sizeof(uint8_t);
+    } else {
+        length = sizeof(urgent_t);
+    }
+    if (mainCommandIndex < (length*2)) {
+        return (0);
+    } else {}
+
+    if (mainCommandType == CLOCKSET) {
+        if (rtcSet(&mainCommand.clock)) {
+            mainClockMinute = 0xff; // Any group built is for the old time
+            mainClockReady = FALSE;
+            mainCommandAck(CLOCKSET, TRUE);
+        } else {
+            mainCommandAck(CLOCKSET, FALSE);
+        }
+    } else if (mainCommandType == CHANNELSET) {
+        mainCommandAck(CHANNELSET, mainChannelSet(mainCommand.channel));
+    } else if (mainCommandType == PSSET) {
+        mainCommandAck(PSSET, mainPsSet(&mainCommand.ps));
+    } else if (mainCommandType == INJECTIONSET) {
+        mainCommandAck(INJECTIONSET, mainInjectionSet(mainCommand.injection));
+    } else if (mainCommandType == GROUPMIXSET) {
+        mainCommandAck(GROUPMIXSET, mainGroupMixSet(mainCommand.groupMix));
+    } else if (urgentAdd(&mainCommand.urgent)) {
+        mainUrgentPreempt();
+        mainCommandAck(URGENTGROUP, TRUE);
+    } else {
+        mainCommandAck(URGENTGROUP, FALSE);
+    }
+    mainCommandType = 0;
+    return (0);
+}
+
+/*******************************************************************************
+* Fills the next group: the 4A group when the minute edge is due, else an      *
+* urgent group, else a group put back by an urgent one, else the carousel with *
+* PS in its share of groups when it is on.                                     *
+*                                                                              *
+* Modifies sample engine buffers & carousel & PS position                      *
+*******************************************************************************/
+void mainTxFill(void) {
+    uint8_t buffer;
+
+    buffer = mainTxFreeBuffer();
+    urgentAge();
+    mainTxNextClock = FALSE;
+    if (mainClockSplice(mainTxGroup[buffer])) {
+        mainTxNextClock = TRUE;
+    } else if (!mainUrgentFill(mainTxGroup[buffer])) {
+        if (mainTxHeld != NOGROUP) {
+            buffer = mainTxHeld;
+            mainTxHeld = NOGROUP;
+        } else if ((mainConfig.groupMix & GROUPMIX0A) && mainPsDue()) {
+            mainPsNextGroup(mainTxGroup[buffer]);
+        } else {
+            mainCarouselNextGroup(mainTxGroup[buffer]);
+        }
+    } else {}
+    mainTxNext = buffer;
+    mainTxNextReady = TRUE;
+}
+
+// Buffer not on air, not held and not filled as next
+uint8_t mainTxFreeBuffer(void) {
+    uint8_t buffer;
+
+    for (buffer = 0; (buffer == mainTxActive) || (buffer == mainTxHeld) || (mainTxNextReady && (buffer == mainTxNext)); buffer++) {}
+    return (buffer);
+}
+
+uint8_t mainUrgentFill(rbds_t *group) {
+    if (!urgentNext(&group[1])) {
+        return (FALSE);
+    } else {}
+    rbdsStaticGroupA(&group[0]);
+    return (TRUE);
+}
+
+/*******************************************************************************
+* Puts an urgent group in place of the next group if that has not started, so  *
+* it goes out on the next boundary. The group it replaces is held and goes     *
+* next. A 4A group stays put and the urgent group is held behind it instead.   *
+* From the command's last char to the group's first bit on air is then at most *
+* one group plus a main loop pass, two groups once a minute behind a 4A group  *
+* or behind another urgent group that came in during the same group.           *
+*                                                                              *
+* Modifies sample engine buffers                                               *
+*******************************************************************************/
+void mainUrgentPreempt(void) {
+    uint8_t buffer;
+
+    // Not filled yet, the fill takes it from the queue
+    if (!mainTxNextReady || (mainTxHeld != NOGROUP)) {
+        return;
+    } else {}
+    buffer = mainTxFreeBuffer();
+    if (!mainUrgentFill(mainTxGroup[buffer])) {
+        return;
+    } else {}
+
+    // The interrupt may have moved on to next since the test above
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+        if (!mainTxNextReady) {
+            mainTxNext = buffer;
+            mainTxNextClock = FALSE;
+            mainTxNextReady = TRUE;
+        } else if (mainTxNextClock) {
+            mainTxHeld = buffer;
+        } else {
+            mainTxHeld = mainTxNext;
+            mainTxNext = buffer;
+        }
+    }
+}
+
+/*******************************************************************************
+* Builds the 4A group for the next minute edge ahead of time, so the splice is *
+* only a copy. Runs after each group fill, the build itself once a minute.     *
+*                                                                              *
+* Modifies global variable mainClockGroup & mainClockMinute & mainClockReady   *
+*******************************************************************************/
+void mainClockPrepare(void) {
+    rtc_t edge;
+
+    if (!rtcValid) {
+        return;
+    } else {}
+    (void) rtcNextMinute(&edge);
+    if (edge.minute != mainClockMinute) {
+        rbdsGroup4A(mainClockGroup, TPFLAG, PTYCODE, &edge);
+        mainClockMinute = edge.minute;
+        mainClockReady = TRUE;
+    } else {}
+}
+
+/*******************************************************************************
+* Fills group with the 4A group if the minute edge falls within half a group   *
+* of the boundary it will start on, so it goes out within 44ms of the edge.    *
+* Group is filled as soon as the one before it starts, a fill more than half a *
+* group late misses the minute. Returns FALSE to leave group to the carousel.  *
+*                                                                              *
+* Modifies global variable mainClockReady                                      *
+*******************************************************************************/
+uint8_t mainClockSplice(rbds_t *group) {
+    rtc_t edge;
+    uint32_t toEdge;
+    uint16_t toGroup;
+    uint8_t blockIndex;
+    uint8_t bitsLeft;
+    uint8_t sample;
+
+    if (!mainClockReady) {
+        return (FALSE);
+    } else {}
+    toEdge = rtcNextMinute(&edge);
+    if (edge.minute != mainClockMinute) {
+        return (FALSE);
+    } else {}
+
+    // Symbols sent of the group on air, its first sample goes out a period after the swap
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+        blockIndex = mainTxBlockIndex;
+        bitsLeft = mainTxBitsLeft;
+        sample = mainTxSample;
+    }
+    toGroup = (GROUPSAMPLES-((((blockIndex*26)+(25-bitsLeft))*SAMPLESPERSYMBOL)+sample));
+    if (((toGroup+(GROUPSAMPLES/2)) <= toEdge) || (toGroup > (toEdge+(GROUPSAMPLES/2)))) {
+        return (FALSE);
+    } else {}
+
+    rbdsStaticGroupA(&group[0]);
+    group[1] = mainClockGroup[0];
+    group[2] = mainClockGroup[1];
+    group[3] = mainClockGroup[2];
+    mainClockReady = FALSE;
+    return (TRUE);
+}
+
 uint16_t mainFrequencyConverter(uint16_t frequency) {
     uint32_t frequencyHertz;
 
@@ -549,16 +1727,193 @@ uint16_t mainFrequencyConverter(uint16_t frequency) {
     return ((uint16_t) frequencyHertz);
 }
 
+// Flash table on the FM band raster, the division off it
+uint16_t mainTuningCode(uint16_t frequency) {
+    if ((frequency >= TUNINGTABLEFIRST) && (frequency <= TUNINGTABLELAST) && ((frequency % TUNINGTABLESTEP) == 0)) {
+        return (pgm_read_word(&mainTuningTable[(frequency-TUNINGTABLEFIRST)/TUNINGTABLESTEP]));
+    } else {
+        return (mainFrequencyConverter(frequency));
+    }
+}
+
+/*******************************************************************************
+* Retunes on air to a channel in 10khz steps. The settle profile is worked out *
+* here so the sample interrupt only copies codes to channel A from the next    *
+* group boundary. Overshoot is worked on the 12 bits the DAC sees and kept in  *
+* its range, the symbols held grow to settle what clamping left. Refused out   *
+* of range or while the last retune is still settling.                         *
+*                                                                              *
+* Modifies global variable mainTransitFrequency & mainConfig & mainWarm &      *
+* mainFrequencyBuffer                                                          *
+*******************************************************************************/
+uint8_t mainChannelSet(uint16_t frequency) {
+    uint16_t code;
+    int16_t from;
+    int16_t to;
+    int32_t boost;
+    int16_t gap;
+    uint8_t symbols;
+
+    if ((frequency < 7000) || (frequency > 15000) || mainTuneReady || (mainTuneLeft != 0)) {
+        return (FALSE);
+    } else {}
+
+    code = mainTuningCode(frequency);
+    from = (int16_t) (mainConfig.tuningCode & DACMAX);
+    to = (int16_t) (code & DACMAX);
+    boost = (to + ((((int32_t) (to-from))*TUNEOVERSHOOT)/16));
+    if (boost < 0) {
+        boost = 0;
+    } else if (boost > DACMAX) {
+        boost = DACMAX;
+    } else {}
+
+    // Loop lands halfway to the overshoot, then halves what is left a symbol
+    gap = (to - (from + ((((int16_t) boost)-from)/2)));
+    if (gap < 0) {
+        gap = -gap;
+    } else {}
+    symbols = 1;
+    while ((gap > TUNESETTLECODES) && (symbols < TUNESETTLEMAX)) {
+        gap >>= 1;
+        symbols++;
+    }
+    if (symbols < TUNESETTLESYMBOLS) {
+        symbols = TUNESETTLESYMBOLS;
+    } else {}
+
+    mainTuneDac.bit.channel = CHA;
+    mainTuneDac.bit.gainstage = TWOVREF;
+    mainTuneDac.bit.shutdown = STARTUP;
+    mainTuneProfile[0] = (uint16_t) boost;
+    mainTuneProfile[1] = code;
+    mainTuneSymbols = symbols;
+    mainTuneReady = TRUE;
+
+    mainTransitFrequency = frequency;
+    mainConfigQueue();
+    mainWarm.config = mainConfig;
+    mainFrequencyBufferFill(frequency);
+    if (mainLcdReady) {
+        mainFrequencyInputLcdDisp();
+    } else {}
+    return (TRUE);
+}
+
+/*******************************************************************************
+* Sine table brought from its 13 bits to a DACSWING swing about DACMID, scaled *
+* by level. Worked out once per level.                                         *
+*******************************************************************************/
+void mainInjectionFill(uint16_t *wave, uint8_t level) {
+    int32_t sample;
+    uint8_t i;
+
+    for (i = 0; i < SAMPLESPERSYMBOL; i++) {
+        sample = (((int32_t) pgm_read_word(&mainSinTable[i])) - SINTABLEMID);
+        sample = (DACMID + ((((sample*DACSWING)/SINTABLESWING)*level)/INJECTIONFULL));
+        if (sample < 0) {
+            sample = 0;
+        } else if (sample > DACMAX) {
+            sample = DACMAX;
+        } else {}
+        wave[i] = (uint16_t) sample;
+    }
+}
+
+/*******************************************************************************
+* Sets the injection level on air and queues its save. The table goes in from *
+* the main loop by mainInjectionUpdate, the latest level wins.                 *
+*                                                                              *
+* Modifies global variable mainConfig & mainWarm & injection state             *
+*******************************************************************************/
+uint8_t mainInjectionSet(uint8_t level) {
+    mainInjectionLevel = level;
+    mainInjectionDue = TRUE;
+    mainInjectionUpdate();
+
+    mainConfig.injection = level;
+    mainConfigQueue();
+    mainWarm.config = mainConfig;
+    return (TRUE);
+}
+
+/*******************************************************************************
+* Fills the table not on air with the level due and hands it to the sample     *
+* interrupt, which swaps it in at the next symbol so samples stay a table      *
+* read. Waits for a later pass while the last one has yet to go in.            *
+*                                                                              *
+* Modifies global variable mainTxWaves & injection state                       *
+*******************************************************************************/
+void mainInjectionUpdate(void) {
+    uint16_t *wave;
+
+    if (!mainInjectionDue || (mainTxWaveNext != NULL)) {
+        return;
+    } else {}
+    wave = ((mainTxWave == mainTxWaves[0]) ? mainTxWaves[1] : mainTxWaves[0]);
+    mainInjectionFill(wave, mainInjectionLevel);
+    mainTxWaveNext = wave;
+    mainInjectionDue = FALSE;
+}
+
 void mainPwmControl(uint8_t command) {
     if (command == STARTTHEMUSIC) {
+        PRR &= ~((1<<PRTIM0)|(1<<PRTIM1)|(1<<PRTIM2)|(1<<PRSPI)); // Power up modules used on air
+        spiInit(); // SPI needs setting up again after power reduction
+        if (TIMSK1 & (1<<OCIE1B)) {
+            // Counts since the last compare B haven't been ticked, stopped while they are taken
+            TIMSK1 &= ~(1<<OCIE1B); // Sample interrupt takes over the trace clock & RTC
+            TCCR1B &= ~((1<<CS12)|(1<<CS10));
+            mainIdleCredit(((uint32_t) TCNT1)*1024);
+        } else {}
+        TCNT1 = 0x0000;
+        TCCR1A |= (1<<COM1B0);
         DDRD |= (1<<PD1); // Turn on transmission circuits
         TCCR0B |= (1<<CS00); // prescaler 1
+        TCCR1B &= ~(1<<CS12);
         TCCR1B |= (1<<CS10); // ctc mode, prescaler 1
         TCCR2B |= (1<<CS21); // prescaler 8
     } else {
         DDRD &= ~(1<<PD1); // Turn off transmission circuits
         TCCR0B &= ~(1<<CS00); // prescaler 1
-        TCCR1B &= ~(1<<CS10); // ctc mode, prescaler 1
         TCCR2B &= ~(1<<CS21); // prescaler 8
+        PRR |= ((1<<PRTIM0)|(1<<PRTIM2)|(1<<PRSPI));
+        if ((TCCR1B & ((1<<CS12)|(1<<CS10))) == (1<<CS10)) {
+            // Left air part way through a sample period, a match since the sample
+            // engine stopped went unticked too
+            TCCR1B &= ~(1<<CS10);
+            mainIdleCredit(TCNT1 + ((TIFR1 & (1<<OCF1A)) ? SAMPLEPERIOD : 0));
+            TCNT1 = 0x0000;
+        } else {}
+        if ((traceMask != 0) || rtcValid) {
+            // Timer 1 keeps counting for the trace clock & RTC, prescaled so idle sleep is
+            // only woken IDLEPERIODS sample periods at a time, pilot output off
+            PRR &= ~(1<<PRTIM1);
+            TCCR1A &= ~(1<<COM1B0);
+            TCCR1B |= ((1<<CS12)|(1<<CS10)); // ctc mode, prescaler 1024
+            TIMSK1 |= (1<<OCIE1B);
+        } else {
+            TCCR1B &= ~((1<<CS12)|(1<<CS10));
+            PRR |= (1<<PRTIM1);
+        }
+    }
+}
+
+/*******************************************************************************
+* Ticks the trace clock & RTC for timer 1 cycles counted across a prescaler    *
+* switch, which neither interrupt saw. The part short of a sample period is    *
+* carried to the next switch.                                                  *
+*                                                                              *
+* Modifies global variable mainIdleCarry                                       *
+*******************************************************************************/
+void mainIdleCredit(uint32_t cycles) {
+    uint16_t periods;
+
+    cycles += mainIdleCarry;
+    periods = (uint16_t) (cycles/SAMPLEPERIOD);
+    mainIdleCarry = (uint16_t) (cycles%SAMPLEPERIOD);
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+        TRACETICKS(periods);
+        RTCTICKS(periods);
     }
 }
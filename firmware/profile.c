@@ -0,0 +1,145 @@
+#include "includes.h"
+
+#ifdef PROFILE
+
+#define PROFILE_HEADER_SIZE ((uint8_t) 9)
+
+void profileStart(void);
+void profileWatchdogStart(void);
+void profileWatchdogStop(void);
+void profileKick(void);
+uint16_t profileDumpStart(void);
+uint8_t profileDumpByte(uint16_t index);
+void profileDumpEnd(void);
+void __vector_profile(void) __attribute__ ((signal, used));
+static void profileWatchdogMode(uint8_t mode);
+
+extern uint8_t _etext; // End of program in flash, from the linker script
+
+volatile uint16_t profilePc; // Word address, set by the interrupt stub
+static uint16_t profileCounts[PROFILEBUCKETS];
+static uint32_t profileSamples = 0;
+static uint16_t profileOutside = 0;
+static uint8_t profileShift;
+static volatile uint8_t profilePaused = FALSE;
+static volatile uint8_t profileArmed = FALSE;
+static volatile uint8_t profileKicked = FALSE;
+static uint8_t profileMissed = 0;
+
+// Timed sequence, the second write must follow within 4 cycles
+static void profileWatchdogMode(uint8_t mode) {
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+        wdt_reset();
+        WDTCSR = ((1<<WDCE)|(1<<WDE));
+        WDTCSR = mode;
+    }
+}
+
+void profileStart(void) {
+    // Smallest power of 2 bucket that spreads the program over the histogram
+    for (profileShift = 1; ((uint16_t) &_etext >> profileShift) >= PROFILEBUCKETS; profileShift++) {}
+    profileWatchdogMode((1<<WDIE)); // Interrupt only, 16ms
+}
+
+void profileWatchdogStart(void) {
+    profileMissed = 0;
+    profileKicked = FALSE;
+    profileArmed = TRUE;
+    profileWatchdogMode(((1<<WDIE)|(1<<WDE))); // Interrupt then reset, 16ms
+}
+
+void profileWatchdogStop(void) {
+    profileArmed = FALSE;
+    profileWatchdogMode((1<<WDIE));
+}
+
+void profileKick(void) {
+    profileKicked = TRUE;
+}
+
+uint16_t profileDumpStart(void) {
+    profilePaused = TRUE;
+    return (PROFILE_HEADER_SIZE + (PROFILEBUCKETS*sizeof(uint16_t)));
+}
+
+uint8_t profileDumpByte(uint16_t index) {
+    if (index == 0) {
+        return (profileShift);
+    } else if (index < 5) {
+        return ((uint8_t) (profileSamples >> ((index-1)*8)));
+    } else if (index < 7) {
+        return ((uint8_t) (profileOutside >> ((index-5)*8)));
+    } else if (index < PROFILE_HEADER_SIZE) {
+        return ((uint8_t) (PROFILEBUCKETS >> ((index-7)*8)));
+    } else {}
+    index -= PROFILE_HEADER_SIZE;
+    return (((uint8_t *) profileCounts)[index]);
+}
+
+void profileDumpEnd(void) {
+    uint16_t i;
+
+    for (i = 0; i < PROFILEBUCKETS; i++) {
+        profileCounts[i] = 0;
+    }
+    profileSamples = 0;
+    profileOutside = 0;
+    profilePaused = FALSE;
+}
+
+/*******************************************************************************
+* Watchdog interrupt stub, saves the return address from under the registers  *
+* it pushes, high byte first, then carries on in the handler below. Nothing    *
+* here touches SREG.                                                           *
+*******************************************************************************/
+ISR(WDT_vect, ISR_NAKED) {
+    __asm__ __volatile__ (
+        "push r0" "\n\t"
+        "push r30" "\n\t"
+        "push r31" "\n\t"
+        "in r30, __SP_L__" "\n\t"
+        "in r31, __SP_H__" "\n\t"
+        "ldd r0, Z+4" "\n\t"
+        "sts profilePc+1, r0" "\n\t"
+        "ldd r0, Z+5" "\n\t"
+        "sts profilePc, r0" "\n\t"
+        "pop r31" "\n\t"
+        "pop r30" "\n\t"
+        "pop r0" "\n\t"
+        "jmp __vector_profile" "\n\t"
+    );
+}
+
+/*******************************************************************************
+* Counts the sample, then rearms the interrupt in reset mode if the main loop *
+* kicked since the last one. Left unarmed the next timeout resets the part.   *
+*******************************************************************************/
+void __vector_profile(void) {
+    uint16_t bucket;
+
+    if (!profilePaused) {
+        bucket = (profilePc >> (profileShift-1)); // Word address to byte bucket
+        if (bucket < PROFILEBUCKETS) {
+            if (profileCounts[bucket] != 0xffff) {
+                profileCounts[bucket]++;
+            } else {}
+        } else if (profileOutside != 0xffff) {
+            profileOutside++;
+        } else {}
+        profileSamples++;
+    } else {}
+
+    if (profileArmed) {
+        if (profileKicked) {
+            profileKicked = FALSE;
+            profileMissed = 0;
+        } else {
+            profileMissed++;
+        }
+        if (profileMissed < PROFILEWATCHDOGTICKS) {
+            WDTCSR |= (1<<WDIE);
+        } else {}
+    } else {}
+}
+
+#endif
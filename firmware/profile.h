@@ -0,0 +1,46 @@
+/******************************************************************************
+* PC Sampling Profiler Module                                                 *
+*                                                                             *
+* Built with make PROFILE=1. The watchdog interrupt samples the interrupted   *
+* program counter every 16ms into a histogram of flash buckets, 256 buckets   *
+* sized to cover the program. The watchdog runs off its own 128khz oscillator *
+* so samples don't lock to the sample engine or the group timing. Time in     *
+* other interrupts lands on the instruction they returned to.                 *
+*                                                                             *
+* On air the watchdog also does its usual job: without a kick for             *
+* PROFILEWATCHDOGTICKS interrupts it is left to reset the part.               *
+*                                                                             *
+* (void) profileStart(void)            Function starts sampling.              *
+* (void) profileWatchdogStart(void)    Function arms the watchdog reset.      *
+* (void) profileWatchdogStop(void)     Function disarms it, sampling goes on. *
+* (void) profileKick(void)             Function holds off the watchdog reset. *
+* (uint16_t) profileDumpStart(void)    Function freezes the histogram for a   *
+*                                      dump, returns dump length in bytes.    *
+* (uint8_t) profileDumpByte(uint16_t)  Function returns a byte of the dump:   *
+*                                      bucket shift, samples, samples past    *
+*                                      the buckets, bucket count, then counts,*
+*                                      LSB first.                             *
+* (void) profileDumpEnd(void)          Function clears the histogram and      *
+*                                      resumes sampling.                      *
+*                                                                             *
+******************************************************************************/
+
+extern void profileStart(void);
+extern void profileWatchdogStart(void);
+extern void profileWatchdogStop(void);
+extern void profileKick(void);
+extern uint16_t profileDumpStart(void);
+extern uint8_t profileDumpByte(uint16_t index);
+extern void profileDumpEnd(void);
+
+// Profiling builds share the watchdog with the sampler, wdt_reset() would lock
+// the samples to the main loop
+#ifdef PROFILE
+#define WATCHDOGSTART() profileWatchdogStart()
+#define WATCHDOGKICK() profileKick()
+#define WATCHDOGSTOP() profileWatchdogStop()
+#else
+#define WATCHDOGSTART() wdt_enable(WDTO_250MS)
+#define WATCHDOGKICK() wdt_reset()
+#define WATCHDOGSTOP() wdt_disable()
+#endif
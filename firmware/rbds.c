@@ -0,0 +1,141 @@
+#include "includes.h"
+
+#define RBDS0ABINFO(segment) ((((uint16_t) GROUP0A)<<11) | (((uint16_t) TPFLAG)<<10) | (((uint16_t) PTYCODE)<<5) | \
+    (((uint16_t) MSFLAG)<<3) | ((((uint16_t) DIFLAGS>>(3-(segment))) & 0x01)<<2) | (segment))
+#define RBDS2ABINFO(segment) ((((uint16_t) GROUP2A)<<11) | (((uint16_t) TPFLAG)<<10) | (((uint16_t) PTYCODE)<<5) | (((uint16_t) A)<<4) | (segment))
+
+// Checkword is linear in the data and offset E is zero, so the mask is the
+// text A/B flag's own contribution and xor flips it in any valid block B
+static const uint32_t rbdsStaticA PROGMEM = CRCBLOCK(PICODE, OFFSETA);
+static const uint32_t rbdsStaticTextAbMask PROGMEM = CRCBLOCK(((uint16_t) 1<<4), OFFSETE);
+static const uint32_t rbdsStatic2AB[MAXRTGROUPS] PROGMEM = {
+    CRCBLOCK(RBDS2ABINFO(0), OFFSETB), CRCBLOCK(RBDS2ABINFO(1), OFFSETB),
+    CRCBLOCK(RBDS2ABINFO(2), OFFSETB), CRCBLOCK(RBDS2ABINFO(3), OFFSETB),
+    CRCBLOCK(RBDS2ABINFO(4), OFFSETB), CRCBLOCK(RBDS2ABINFO(5), OFFSETB),
+    CRCBLOCK(RBDS2ABINFO(6), OFFSETB), CRCBLOCK(RBDS2ABINFO(7), OFFSETB),
+    CRCBLOCK(RBDS2ABINFO(8), OFFSETB), CRCBLOCK(RBDS2ABINFO(9), OFFSETB),
+    CRCBLOCK(RBDS2ABINFO(10), OFFSETB), CRCBLOCK(RBDS2ABINFO(11), OFFSETB),
+    CRCBLOCK(RBDS2ABINFO(12), OFFSETB), CRCBLOCK(RBDS2ABINFO(13), OFFSETB),
+    CRCBLOCK(RBDS2ABINFO(14), OFFSETB), CRCBLOCK(RBDS2ABINFO(15), OFFSETB)
+};
+static const uint32_t rbdsStatic0AB[4] PROGMEM = {
+    CRCBLOCK(RBDS0ABINFO(0), OFFSETB), CRCBLOCK(RBDS0ABINFO(1), OFFSETB),
+    CRCBLOCK(RBDS0ABINFO(2), OFFSETB), CRCBLOCK(RBDS0ABINFO(3), OFFSETB)
+};
+static const uint32_t rbdsStatic0AC PROGMEM = CRCBLOCK(PSNOAF, OFFSETC);
+
+void rbdsStaticGroupA(rbds_t *block) {
+    block->hex = pgm_read_dword(&rbdsStaticA);
+}
+
+void rbdsStaticGroup0A(rbds_t *blocks, uint8_t segment) {
+    blocks[0].hex = pgm_read_dword(&rbdsStatic0AB[segment]);
+    blocks[1].hex = pgm_read_dword(&rbdsStatic0AC);
+}
+
+void rbdsStaticGroup2AB(rbds_t *block, uint8_t textab, uint8_t segment) {
+    block->hex = pgm_read_dword(&rbdsStatic2AB[segment]);
+    if (textab) {
+        block->hex ^= pgm_read_dword(&rbdsStaticTextAbMask);
+    } else {}
+}
+
+void rbdsGroupA(rbds_t *block, uint16_t picode) {
+    block->hex = 0;
+    block->groupa.picode = picode;
+    block->groupa.checkword = crcChecksum(block, OFFSETA);
+}
+
+void rbdsGroup2AB(rbds_t *block, uint8_t tp, uint8_t pty, uint8_t textab, uint8_t segment) {
+    block->hex = 0;
+    block->type2groupb.grouptype = GROUP2A; // group type 2A, radiotext
+    block->type2groupb.tp = tp;
+    block->type2groupb.pty = pty;
+    block->type2groupb.textab = textab;
+    block->type2groupb.segmentaddress = segment;
+    block->type2groupb.checkword = crcChecksum(block, OFFSETB);
+}
+
+void rbdsGroup4A(rbds_t *blocks, uint8_t tp, uint8_t pty, rtc_t *time) {
+    uint8_t offset;
+
+    blocks[0].hex = 0;
+    blocks[0].type4agroupb.grouptype = GROUP4A; // group type 4A, clock time
+    blocks[0].type4agroupb.tp = tp;
+    blocks[0].type4agroupb.pty = pty;
+    blocks[0].type4agroupb.mjdhigh = (uint8_t) (time->mjd>>15);
+    blocks[0].type4agroupb.checkword = crcChecksum(&blocks[0], OFFSETB);
+
+    blocks[1].hex = 0;
+    blocks[1].type4agroupc.mjdlow = (uint16_t) (time->mjd & 0x7fff);
+    blocks[1].type4agroupc.hourhigh = (time->hour>>4);
+    blocks[1].type4agroupc.checkword = crcChecksum(&blocks[1], OFFSETC);
+
+    // Offset is sign and magnitude
+    blocks[2].hex = 0;
+    blocks[2].type4agroupd.hourlow = (time->hour & 0x0f);
+    blocks[2].type4agroupd.minute = time->minute;
+    if (time->offset < 0) {
+        offset = (uint8_t) -time->offset;
+        blocks[2].type4agroupd.offsetsign = 1;
+    } else {
+        offset = (uint8_t) time->offset;
+    }
+    blocks[2].type4agroupd.offset = offset;
+    blocks[2].type4agroupd.checkword = crcChecksum(&blocks[2], OFFSETD);
+}
+
+uint8_t rbdsPadRadiotext(uint8_t *text) {
+    uint8_t length;
+
+    // Find length of message
+    for (length = 0; text[length] != 0x00; length++) {}
+    // Short messages end with \r, then pad with spaces to a whole 4 char segment
+    if (length < 64) {
+        text[length] = RETURN;
+        length++;
+    } else {}
+    for (; (length % 4) != 0; length++) {
+        text[length] = ' ';
+    }
+    return (length/4);
+}
+
+void rbdsEncodeRadiotext(uint8_t *text, rbds_t *blocks, uint8_t length) {
+    uint8_t block;
+
+    // Two chars per block, group c then group d for each segment
+    for (block = 0; block < (length*2); block++) {
+        blocks[block].hex = 0;
+        blocks[block].type2groupcd.hichar = *text;
+        text++;
+        blocks[block].type2groupcd.lowchar = *text;
+        text++;
+        if ((block % 2) == 0) {
+            blocks[block].type2groupcd.checkword = crcChecksum(&blocks[block], OFFSETC);
+        } else {
+            blocks[block].type2groupcd.checkword = crcChecksum(&blocks[block], OFFSETD);
+        }
+    }
+}
+
+void rbdsEncodePs(uint8_t *text, rbds_t *pairs, uint8_t length) {
+    uint8_t pair;
+
+    // Block D for the two chars from each position, wrapping round the text
+    for (pair = 0; pair < length; pair++) {
+        pairs[pair].hex = 0;
+        pairs[pair].type2groupcd.hichar = text[pair];
+        pairs[pair].type2groupcd.lowchar = text[((pair+1) < length) ? (pair+1) : 0];
+        pairs[pair].type2groupcd.checkword = crcChecksum(&pairs[pair], OFFSETD);
+    }
+}
+
+uint8_t rbdsDiffEncode(rbds_t *block, uint8_t lastBit) {
+    // Output toggles on each 1 bit
+    if (block->hex & 0x80000000) {
+        lastBit ^= 0x01;
+    } else {}
+    block->hex <<= 1;
+    return (lastBit);
+}
@@ -0,0 +1,56 @@
+/******************************************************************************
+* RBDS Group Module                                                           *
+*                                                                             *
+* Contains functions required to build and encode RBDS blocks. Nothing here   *
+* touches hardware so the same code can be built for host tools. Blocks fixed *
+* by the build (PICODE, PTYCODE & TPFLAG) are worked out by the compiler and  *
+* kept in flash, the firmware only reads them. Host tools build their own.    *
+*                                                                             *
+* (void) rbdsStaticGroupA(rbds_t*)      Function fills block A of this build  *
+*                                       from flash.                           *
+* (void) rbdsStaticGroup0A(rbds_t*, uint8_t)                                  *
+*                                       Function fills 0A blocks B & C of     *
+*                                       this build from flash for segment,    *
+*                                       block C carrying no AF.               *
+* (void) rbdsStaticGroup2AB(rbds_t*, uint8_t, uint8_t)                        *
+*                                       Function fills 2A block B of this     *
+*                                       build from flash for text A/B and     *
+*                                       segment.                              *
+* (void) rbdsGroupA(rbds_t*, uint16_t)  Function fills block A with PI code   *
+*                                       and checkword.                        *
+* (void) rbdsGroup2AB(rbds_t*, uint8_t, uint8_t, uint8_t, uint8_t)            *
+*                                       Function fills block B of a 2A group  *
+*                                       from TP, PTY, text A/B & segment.     *
+* (void) rbdsGroup4A(rbds_t*, uint8_t, uint8_t, rtc_t*)                       *
+*                                       Function fills blocks B, C & D of a   *
+*                                       4A clock time group from TP, PTY &    *
+*                                       time, seconds are not sent.           *
+* (uint8_t) rbdsPadRadiotext(uint8_t*)  Function terminates & pads a null     *
+*                                       terminated message of up to 64 chars  *
+*                                       to whole segments, returns segment    *
+*                                       count.                                *
+* (void) rbdsEncodeRadiotext(uint8_t*, rbds_t*, uint8_t)                      *
+*                                       Function fills C & D blocks for each  *
+*                                       segment of a padded message.          *
+* (void) rbdsEncodePs(uint8_t*, rbds_t*, uint8_t)                             *
+*                                       Function fills a 0A block D for the   *
+*                                       two chars from each position of PS    *
+*                                       text, wrapping round, so any name in  *
+*                                       a scroll is four of them.             *
+* (uint8_t) rbdsDiffEncode(rbds_t*, uint8_t)                                  *
+*                                       Function shifts next bit out of block *
+*                                       MSB first, returns differentially     *
+*                                       encoded output given previous output. *
+*                                                                             *
+******************************************************************************/
+
+extern void rbdsStaticGroupA(rbds_t *block);
+extern void rbdsStaticGroup0A(rbds_t *blocks, uint8_t segment);
+extern void rbdsStaticGroup2AB(rbds_t *block, uint8_t textab, uint8_t segment);
+extern void rbdsGroupA(rbds_t *block, uint16_t picode);
+extern void rbdsGroup2AB(rbds_t *block, uint8_t tp, uint8_t pty, uint8_t textab, uint8_t segment);
+extern void rbdsGroup4A(rbds_t *blocks, uint8_t tp, uint8_t pty, rtc_t *time);
+extern uint8_t rbdsPadRadiotext(uint8_t *text);
+extern void rbdsEncodeRadiotext(uint8_t *text, rbds_t *blocks, uint8_t length);
+extern void rbdsEncodePs(uint8_t *text, rbds_t *pairs, uint8_t length);
+extern uint8_t rbdsDiffEncode(rbds_t *block, uint8_t lastBit);
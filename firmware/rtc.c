@@ -0,0 +1,53 @@
+#include "includes.h"
+
+uint8_t rtcSet(rtc_t *time);
+uint32_t rtcNextMinute(rtc_t *time);
+
+volatile uint8_t rtcValid = FALSE;
+volatile uint16_t rtcCountdown; // Sample periods left in this second
+volatile uint16_t rtcRemainder; // Fraction of a sample period carried, in cycles
+volatile uint32_t rtcSeconds;   // Seconds since set
+static rtc_t rtcBase;           // Time when set
+static uint32_t rtcBaseSecond;  // Second of the day when set
+
+uint8_t rtcSet(rtc_t *time) {
+    if ((time->hour > 23) || (time->minute > 59) || (time->second > 59) || (time->offset > 31) || (time->offset < -31)) {
+        return (FALSE);
+    } else {}
+    // Stopped while it is set, the interrupts leave an invalid clock alone so
+    // they needn't be held off
+    rtcValid = FALSE;
+    rtcBase = *time;
+    rtcBaseSecond = ((((uint32_t) time->hour)*3600)+(((uint16_t) time->minute)*60)+time->second);
+    rtcSeconds = 0;
+    rtcRemainder = 0;
+    rtcCountdown = RTCSAMPLESPERSECOND;
+    rtcValid = TRUE;
+    return (TRUE);
+}
+
+/*******************************************************************************
+* Seconds are taken as RTCSAMPLESPERSECOND long to the minute edge, leaving    *
+* out the odd longer second. Divides a few times, keep it out of interrupts.   *
+*******************************************************************************/
+uint32_t rtcNextMinute(rtc_t *time) {
+    uint32_t seconds;
+    uint16_t countdown;
+    uint8_t second;
+
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+        seconds = rtcSeconds;
+        countdown = rtcCountdown;
+    }
+    seconds += rtcBaseSecond;
+    second = (uint8_t) (seconds % 60);
+    seconds += (60-second);
+
+    *time = rtcBase;
+    time->mjd += (seconds / 86400);
+    seconds %= 86400;
+    time->hour = (uint8_t) (seconds / 3600);
+    time->minute = (uint8_t) ((seconds / 60) % 60);
+    time->second = 0;
+    return ((((uint32_t) (59-second))*RTCSAMPLESPERSECOND)+countdown);
+}
@@ -0,0 +1,64 @@
+/******************************************************************************
+* Real Time Clock Module                                                      *
+*                                                                             *
+* Keeps UTC from the crystal by counting timer 1 sample periods: the sample   *
+* interrupt ticks it on air, compare B ticks it IDLEPERIODS at a time off     *
+* air. A second is RTCSAMPLESPERSECOND periods, one longer as the remainder   *
+* adds up, so the clock is as good as the crystal. Going on or off air the    *
+* timer 1 count part way through a period is carried over the prescaler       *
+* switch, losing only the prescaler's own part count & the few cycles timer 1 *
+* is stopped for, under 64us a switch. Not kept over a reset, the controller  *
+* sets it again.                                                              *
+*                                                                             *
+* (uint8_t) rtcSet(rtc_t*)             Function sets the clock, the second    *
+*                                      starts now. Returns FALSE and leaves   *
+*                                      the clock alone if time is not valid.  *
+* (uint32_t) rtcNextMinute(rtc_t*)     Function fills time with the time at   *
+*                                      the next minute edge, returns sample   *
+*                                      periods until it, within a minute's    *
+*                                      remainder (about 1.5ms) early.         *
+*                                                                             *
+* (uint8_t) rtcValid                   TRUE once the clock has been set.      *
+*                                                                             *
+******************************************************************************/
+
+// Inline so the sample & off air compare B interrupts stay free of calls
+#define RTCNEXTSECOND() do { \
+    rtcSeconds++; \
+    rtcRemainder += RTCSAMPLEREMAINDER; \
+    if (rtcRemainder >= RTCSAMPLEPERIOD) { \
+        rtcRemainder -= RTCSAMPLEPERIOD; \
+        rtcCountdown = (RTCSAMPLESPERSECOND+1); \
+    } else { \
+        rtcCountdown = RTCSAMPLESPERSECOND; \
+    } \
+} while (0)
+
+#define RTCTICK() do { \
+    if (rtcValid) { \
+        rtcCountdown--; \
+        if (rtcCountdown == 0) { \
+            RTCNEXTSECOND(); \
+        } else {} \
+    } else {} \
+} while (0)
+
+// Fewer than a second's periods at once, those past the second come off the next
+#define RTCTICKS(count) do { \
+    if (rtcValid) { \
+        if (rtcCountdown <= (count)) { \
+            uint16_t rtcCarried = ((count) - rtcCountdown); \
+            RTCNEXTSECOND(); \
+            rtcCountdown -= rtcCarried; \
+        } else { \
+            rtcCountdown -= (count); \
+        } \
+    } else {} \
+} while (0)
+
+extern uint8_t rtcSet(rtc_t *time);
+extern uint32_t rtcNextMinute(rtc_t *time);
+extern volatile uint8_t rtcValid;
+extern volatile uint16_t rtcCountdown;
+extern volatile uint16_t rtcRemainder;
+extern volatile uint32_t rtcSeconds;
@@ -0,0 +1,107 @@
+#include "includes.h"
+
+#define SAMPLEASM(x) SAMPLEASMSTRING(x)
+#define SAMPLEASMSTRING(x) #x
+
+volatile uint16_t sampleEntry;
+
+/*******************************************************************************
+* Sample interrupt stub. Every path from the TCNT1 read to the DAC latch takes *
+* the same cycles: each skip or clamp costs 2 either way, the sled is entered  *
+* entry-SAMPLEENTRYMIN nops in and the SPI waits start from an aligned write.  *
+* SREG is saved before the arithmetic, the handler saves the rest itself.      *
+*******************************************************************************/
+ISR(TIMER1_COMPA_vect, ISR_NAKED) {
+    __asm__ __volatile__ (
+        "push r30" "\n\t"
+        "in r30, __SREG__" "\n\t"
+        "push r30" "\n\t"
+        "push r31" "\n\t"
+        "lds r30, %[tcntl]" "\n\t"
+        "lds r31, %[tcnth]" "\n\t"
+        "sts sampleEntry, r30" "\n\t"
+        "sts sampleEntry+1, r31" "\n\t"
+        // Late by a whole byte, clamp so no time is added
+        "tst r31" "\n\t"
+        "breq 1f" "\n\t"
+        "ldi r30, 0xff" "\n\t"
+        "1: subi r30, " SAMPLEASM(SAMPLEENTRYMIN) "\n\t"
+        "cpi r30, " SAMPLEASM(SAMPLEJITTERWINDOW) "+1" "\n\t"
+        "brlo 2f" "\n\t"
+        "ldi r30, " SAMPLEASM(SAMPLEJITTERWINDOW) "\n\t"
+        "2: clr r31" "\n\t"
+        "subi r30, lo8(-(pm(3f)))" "\n\t"
+        "sbci r31, hi8(-(pm(3f)))" "\n\t"
+        "ijmp" "\n\t"
+        "3: .rept " SAMPLEASM(SAMPLEJITTERWINDOW) "\n\t"
+        "nop" "\n\t"
+        ".endr" "\n\t"
+        // Same sequence as spiUpdateDac, low byte first
+        "in r30, %[low]" "\n\t"
+        "cbi %[portd], 5" "\n\t"
+        "out %[spdr], r30" "\n\t"
+        "in r30, %[high]" "\n\t"
+        "4: in r31, %[spsr]" "\n\t"
+        "sbrs r31, 7" "\n\t"
+        "rjmp 4b" "\n\t"
+        "out %[spdr], r30" "\n\t"
+        "5: in r31, %[spsr]" "\n\t"
+        "sbrs r31, 7" "\n\t"
+        "rjmp 5b" "\n\t"
+        "sbi %[portd], 5" "\n\t"
+        "nop" "\n\t"
+        "cbi %[portb], 1" "\n\t"
+        "nop" "\n\t"
+        "nop" "\n\t"
+        "sbi %[portb], 1" "\n\t"
+        "pop r31" "\n\t"
+        "pop r30" "\n\t"
+        "out __SREG__, r30" "\n\t"
+        "pop r30" "\n\t"
+        "jmp __vector_sample" "\n\t"
+        :
+        : [tcntl] "n" (_SFR_MEM_ADDR(TCNT1L)), [tcnth] "n" (_SFR_MEM_ADDR(TCNT1H)),
+          [low] "n" (_SFR_IO_ADDR(GPIOR1)), [high] "n" (_SFR_IO_ADDR(GPIOR2)),
+          [spdr] "n" (_SFR_IO_ADDR(SPDR)), [spsr] "n" (_SFR_IO_ADDR(SPSR)),
+          [portd] "n" (_SFR_IO_ADDR(PORTD)), [portb] "n" (_SFR_IO_ADDR(PORTB))
+    );
+}
+
+/*******************************************************************************
+* UART interrupt stubs. Each does only what has to happen with interrupts off  *
+* and turns them back on before jumping to its handler in uart.c, so a compare *
+* match waits a few cycles rather than a whole C handler. Rx reads the status  *
+* while it is valid and the byte, then leaves interrupts off only if another   *
+* byte is already waiting behind it. Tx turns its own interrupt off, writing   *
+* UCSR0B whole so no read-modify-write can race the main loop. Neither touches *
+* SREG's flags.                                                                *
+*******************************************************************************/
+ISR(USART_RX_vect, ISR_NAKED) {
+    __asm__ __volatile__ (
+        "push r30" "\n\t"
+        "lds r30, %[ucsr0a]" "\n\t"
+        "sts uartRxStatus, r30" "\n\t"
+        "lds r30, %[udr0]" "\n\t"
+        "sts uartRxByte, r30" "\n\t"
+        "lds r30, %[ucsr0a]" "\n\t"
+        "sbrs r30, %[rxc]" "\n\t"
+        "sei" "\n\t"
+        "pop r30" "\n\t"
+        "jmp __vector_uartrx" "\n\t"
+        :
+        : [ucsr0a] "n" (_SFR_MEM_ADDR(UCSR0A)), [udr0] "n" (_SFR_MEM_ADDR(UDR0)), [rxc] "n" (RXC0)
+    );
+}
+
+ISR(USART_UDRE_vect, ISR_NAKED) {
+    __asm__ __volatile__ (
+        "push r30" "\n\t"
+        "ldi r30, %[control]" "\n\t"
+        "sts %[ucsr0b], r30" "\n\t"
+        "sei" "\n\t"
+        "pop r30" "\n\t"
+        "jmp __vector_uarttx" "\n\t"
+        :
+        : [ucsr0b] "n" (_SFR_MEM_ADDR(UCSR0B)), [control] "n" (UARTCONTROL)
+    );
+}
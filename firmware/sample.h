@@ -0,0 +1,26 @@
+/******************************************************************************
+* Sample Output Module                                                        *
+*                                                                             *
+* Sends each DAC sample a fixed number of cycles after its timer 1 compare    *
+* match. The naked interrupt stub reads TCNT1 to see how late it got in,      *
+* finishing an instruction or waking from idle, and pads out the difference   *
+* in a nop sled before the DAC write, then carries on in the sample handler   *
+* in main.c. The next sample waits in GPIOR1 & GPIOR2, kept for it alone, so  *
+* the stub needs only r30, r31 & SREG. Entry later than the window (another   *
+* interrupt or an atomic block in the way) goes out late by the excess.       *
+*                                                                             *
+* The UART interrupts have stubs here too, the AVR only asm kept in one file: *
+* each turns interrupts back on within a few cycles and jumps to its handler  *
+* in uart.c, so they stay inside the window.                                  *
+*                                                                             *
+* SAMPLELOAD(dac_t)                    Macro loads the sample the next        *
+*                                      compare match sends.                   *
+*                                                                             *
+* (uint16_t) sampleEntry               Cycles from compare match to the stub  *
+*                                      reading TCNT1, for the last sample.    *
+*                                                                             *
+******************************************************************************/
+
+#define SAMPLELOAD(dac) do { GPIOR1 = (uint8_t) (dac).spi; GPIOR2 = (uint8_t) ((dac).spi>>8); } while (0)
+
+extern volatile uint16_t sampleEntry;
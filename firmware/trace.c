@@ -0,0 +1,97 @@
+#include "includes.h"
+
+#define TRACE_RING_SIZE ((uint8_t) 64) // Must be a power of 2
+#define TRACE_HEADER_SIZE ((uint8_t) 5)
+
+void traceRecord(uint8_t event, uint8_t data);
+uint16_t traceDumpStart(void);
+uint8_t traceDumpByte(uint16_t index);
+void traceDumpEnd(void);
+static void traceStore(uint8_t slot, uint8_t event, uint8_t data, uint16_t time);
+
+uint8_t traceMask = TRACEDEFAULTMASK;
+volatile uint16_t traceTicks = 0;
+volatile uint16_t traceEpoch = 0;
+volatile uint8_t traceEpochMark = FALSE;
+
+static trace_t traceRing[TRACE_RING_SIZE];
+static uint8_t traceHead = 0; // Runs free, 256 being a whole number of rings
+static uint8_t traceFull = FALSE;
+static uint8_t traceCount;
+static uint8_t traceSavedMask;
+static uint16_t traceDumpEpoch;
+static uint16_t traceDumpTicks;
+
+static void traceStore(uint8_t slot, uint8_t event, uint8_t data, uint16_t time) {
+    slot &= (TRACE_RING_SIZE-1);
+    traceRing[slot].event = event;
+    traceRing[slot].data = data;
+    traceRing[slot].time = time;
+}
+
+/*******************************************************************************
+* Only taking the slots is atomic, so the sample interrupt is held off for a   *
+* few loads and stores. A record from an interrupt meanwhile takes the slots   *
+* after these, and each is filled in with interrupts on.                       *
+*******************************************************************************/
+void traceRecord(uint8_t event, uint8_t data) {
+    uint16_t time;
+    uint16_t epoch;
+    uint8_t marked;
+    uint8_t slot;
+
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+        time = traceTicks;
+        epoch = traceEpoch;
+        marked = traceEpochMark;
+        traceEpochMark = FALSE;
+        slot = traceHead;
+        traceHead = (slot+1+marked);
+    }
+    if ((slot+1+marked) >= TRACE_RING_SIZE) {
+        traceFull = TRUE;
+    } else {}
+    if (marked) {
+        traceStore(slot, TRACEEPOCH, 0, epoch);
+        slot++;
+    } else {}
+    traceStore(slot, event, data, time);
+}
+
+// Interrupts are only held off to read the clock, records stop with the mask
+uint16_t traceDumpStart(void) {
+    traceSavedMask = traceMask;
+    traceMask = 0x00;
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+        traceDumpEpoch = traceEpoch;
+        traceDumpTicks = traceTicks;
+    }
+    traceCount = (traceFull ? TRACE_RING_SIZE : traceHead);
+    return (TRACE_HEADER_SIZE + (((uint16_t) traceCount)*sizeof(trace_t)));
+}
+
+uint8_t traceDumpByte(uint16_t index) {
+    uint8_t entry;
+
+    if (index < TRACE_HEADER_SIZE) {
+        if (index == 0) {
+            return ((uint8_t) traceDumpEpoch);
+        } else if (index == 1) {
+            return ((uint8_t) (traceDumpEpoch>>8));
+        } else if (index == 2) {
+            return ((uint8_t) traceDumpTicks);
+        } else if (index == 3) {
+            return ((uint8_t) (traceDumpTicks>>8));
+        } else {
+            return (traceCount);
+        }
+    } else {}
+    index -= TRACE_HEADER_SIZE;
+    // Oldest entry is at the head once the ring has filled
+    entry = ((traceHead - traceCount + (index/sizeof(trace_t))) & (TRACE_RING_SIZE-1));
+    return (((uint8_t *) &traceRing[entry])[index % sizeof(trace_t)]);
+}
+
+void traceDumpEnd(void) {
+    traceMask = traceSavedMask;
+}
@@ -0,0 +1,37 @@
+/******************************************************************************
+* Event Trace Module                                                          *
+*                                                                             *
+* Records timestamped events into a fixed RAM ring for finding glitches on    *
+* air. Time is counted in sample periods (SAMPLEPERIOD cycles, 26.3us at      *
+* 16MHz) by timer 1: the sample interrupt ticks it on air, compare B ticks it *
+* IDLEPERIODS at a time off air. Each entry holds the low 16 bits, a          *
+* TRACEEPOCH entry carrying the high 16 bits goes in ahead of the first event *
+* after they change.                                                          *
+*                                                                             *
+* (void) traceRecord(uint8_t, uint8_t) Function stores an event & data byte,  *
+*                                      safe from interrupts, holding them off *
+*                                      only to take its slots. Use TRACE() so *
+*                                      masked events cost only the test.      *
+* (uint16_t) traceDumpStart(void)      Function freezes the ring for a dump,  *
+*                                      returns dump length in bytes.          *
+* (uint8_t) traceDumpByte(uint16_t)    Function returns a byte of the dump:   *
+*                                      epoch, ticks & entry count, then       *
+*                                      entries oldest first, LSB first.       *
+* (void) traceDumpEnd(void)            Function resumes recording.            *
+*                                                                             *
+* (uint8_t) traceMask                  Bit per event type to record.          *
+*                                                                             *
+******************************************************************************/
+
+#define TRACE(event, data) do { if (traceMask & (1<<(event))) { traceRecord((event), (data)); } else {} } while (0)
+#define TRACETICK() do { traceTicks++; if (traceTicks == 0) { traceEpoch++; traceEpochMark = TRUE; } else {} } while (0)
+#define TRACETICKS(count) do { traceTicks += (count); if (traceTicks < (count)) { traceEpoch++; traceEpochMark = TRUE; } else {} } while (0)
+
+extern void traceRecord(uint8_t event, uint8_t data);
+extern uint16_t traceDumpStart(void);
+extern uint8_t traceDumpByte(uint16_t index);
+extern void traceDumpEnd(void);
+extern uint8_t traceMask;
+extern volatile uint16_t traceTicks;
+extern volatile uint16_t traceEpoch;
+extern volatile uint8_t traceEpochMark;
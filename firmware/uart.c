@@ -1,29 +1,225 @@
 #include "includes.h"
 
-#define UART_BAUD 9600
-#define UART_BAUD_CODE ((uint16_t) ((F_CPU/16/UART_BAUD)-1))
+#if CLOCKERRORPPM(16*(UARTBAUDCODE+1), UARTBAUD) > UARTTOLERANCEPPM
+#error "UARTBAUD too far off at this F_CPU"
+#endif
+
+#define UART_RX_BUFFER_SIZE ((uint8_t) 32) // Must be a power of 2
+#define UART_TX_BUFFER_SIZE ((uint8_t) 128) // Must be a power of 2
+
+void uartInit(void);
+uint8_t uartRxReady(void);
+uint8_t uartRx(void);
+uint8_t uartTxFree(void);
+uint8_t uartTx(uint8_t byte);
+uint8_t uartTxHex(uint8_t byte);
+void uartStreamStart(void);
+void uartStreamEnd(void);
+void uartLineStart(uartline_t *line, uint8_t type);
+void uartLineChar(uartline_t *line, uint8_t c);
+void uartLineHex(uartline_t *line, uint8_t byte);
+void uartLineUnsigned(uartline_t *line, uint16_t value);
+void uartLineString(uartline_t *line, const uint8_t *s);
+void uartLineStringP(uartline_t *line, const uint8_t *s);
+uint8_t uartLineSend(uartline_t *line);
+static uint8_t uartHexDigit(uint8_t nibble);
+static void uartTxPut(uint8_t byte);
+
+uint16_t uartOverruns = 0;
+uint16_t uartTxDropped = 0;
+volatile uint8_t uartRxStatus; // UCSR0A & UDR0 as the Rx stub read them
+volatile uint8_t uartRxByte;
+
+static volatile uint8_t uartRxBuffer[UART_RX_BUFFER_SIZE];
+static volatile uint8_t uartRxHead = 0;
+static volatile uint8_t uartRxTail = 0;
+static volatile uint8_t uartTxBuffer[UART_TX_BUFFER_SIZE];
+static volatile uint8_t uartTxHead = 0;
+static volatile uint8_t uartTxTail = 0;
+static uint8_t uartStreaming = FALSE;
 
 void uartInit(void) {
     // Flush buffer
     UDR0 = 0x00;
 
     // Set baudrate
-    UBRR0H = (uint8_t) (UART_BAUD_CODE>>8);
-    UBRR0L = (uint8_t) (UART_BAUD_CODE);
+    UBRR0H = (uint8_t) (UARTBAUDCODE>>8);
+    UBRR0L = (uint8_t) (UARTBAUDCODE);
 
-    UCSR0B = ((1<<RXEN0) | (1<<TXEN0)); // Enable tx/rx
+    UCSR0B = UARTCONTROL; // Enable tx/rx, interrupt on rx
 
     UCSR0C = ((1<<UCSZ01) | (1<<UCSZ00)); // 8-bit mode
 }
 
+/*******************************************************************************
+* Rx handler, moves each byte into the Rx ring so nothing is lost while the    *
+* main loop is busy or asleep. Bytes lost in hardware or to a full ring are    *
+* both counted as overruns. The stub in sample.c has read the status & byte    *
+* and turned interrupts back on, so the sample interrupt can cut in here.      *
+*******************************************************************************/
+ISR(__vector_uartrx) {
+    uint8_t head;
+
+    TRACE(TRACEUARTRX, uartRxByte);
+    if (uartRxStatus & (1<<DOR0)) {
+        uartOverruns++;
+    } else {}
+
+    head = ((uartRxHead+1) & (UART_RX_BUFFER_SIZE-1));
+    if (head == uartRxTail) {
+        uartOverruns++;
+    } else {
+        uartRxBuffer[uartRxHead] = uartRxByte;
+        uartRxHead = head;
+    }
+}
+
+uint8_t uartRxReady(void) {
+    return (uartRxHead != uartRxTail);
+}
+
 uint8_t uartRx(void) {
     uint8_t byte;
 
-    if (UCSR0A & (1<<RXC0)) { // Check for data waiting
-        byte = UDR0;
+    if (uartRxHead != uartRxTail) { // Check for data waiting
+        byte = uartRxBuffer[uartRxTail];
+        uartRxTail = ((uartRxTail+1) & (UART_RX_BUFFER_SIZE-1));
     } else {
         byte = 0x00;
     }
 
     return (byte);
 }
+
+/*******************************************************************************
+* Tx handler, sends the next byte of the Tx ring. The stub in sample.c has     *
+* turned this interrupt off and interrupts back on, it is only turned on again *
+* with a byte sent so it stays off once the ring is empty.                     *
+*******************************************************************************/
+ISR(__vector_uarttx) {
+    if (uartTxHead != uartTxTail) {
+        UDR0 = uartTxBuffer[uartTxTail];
+        uartTxTail = ((uartTxTail+1) & (UART_TX_BUFFER_SIZE-1));
+        UCSR0B = (UARTCONTROL | (1<<UDRIE0));
+    } else {}
+}
+
+// Room checked by the caller. The main loop is the only producer and the byte
+// is in before the head moves past it, so the Tx handler needs no atomic block
+static void uartTxPut(uint8_t byte) {
+    uartTxBuffer[uartTxHead] = byte;
+    uartTxHead = ((uartTxHead+1) & (UART_TX_BUFFER_SIZE-1));
+    UCSR0B = (UARTCONTROL | (1<<UDRIE0));
+}
+
+static uint8_t uartHexDigit(uint8_t nibble) {
+    nibble &= 0x0f;
+    if (nibble > 9) {
+        return (nibble+('a'-10));
+    } else {
+        return (nibble+'0');
+    }
+}
+
+uint8_t uartTxFree(void) {
+    return ((uartTxTail-uartTxHead-1) & (UART_TX_BUFFER_SIZE-1));
+}
+
+uint8_t uartTx(uint8_t byte) {
+    uint8_t sent = FALSE;
+
+    if (uartTxFree() != 0) {
+        uartTxPut(byte);
+        sent = TRUE;
+    } else {
+        uartTxDropped++;
+    }
+    return (sent);
+}
+
+uint8_t uartTxHex(uint8_t byte) {
+    uint8_t sent = FALSE;
+
+    if (uartTxFree() >= 2) {
+        uartTxPut(uartHexDigit(byte>>4));
+        uartTxPut(uartHexDigit(byte));
+        sent = TRUE;
+    } else {
+        uartTxDropped += 2;
+    }
+    return (sent);
+}
+
+void uartStreamStart(void) {
+    uartStreaming = TRUE;
+}
+
+void uartStreamEnd(void) {
+    uartStreaming = FALSE;
+}
+
+void uartLineStart(uartline_t *line, uint8_t type) {
+    line->length = 0;
+    uartLineChar(line, type);
+}
+
+// Two places are kept for CR LF, chars past the end are left off
+void uartLineChar(uartline_t *line, uint8_t c) {
+    if (line->length < (UARTLINESIZE-2)) {
+        line->text[line->length] = c;
+        line->length++;
+    } else {}
+}
+
+void uartLineHex(uartline_t *line, uint8_t byte) {
+    uartLineChar(line, uartHexDigit(byte>>4));
+    uartLineChar(line, uartHexDigit(byte));
+}
+
+void uartLineUnsigned(uartline_t *line, uint16_t value) {
+    uint8_t digits[5];
+    uint8_t count = 0;
+
+    do {
+        digits[count] = ((value % 10)+'0');
+        value /= 10;
+        count++;
+    } while (value != 0);
+    while (count != 0) {
+        count--;
+        uartLineChar(line, digits[count]);
+    }
+}
+
+void uartLineString(uartline_t *line, const uint8_t *s) {
+    while (*s != 0x00) {
+        uartLineChar(line, *s++);
+    }
+}
+
+void uartLineStringP(uartline_t *line, const uint8_t *s) {
+    while (pgm_read_byte(s) != 0x00) {
+        uartLineChar(line, pgm_read_byte(s++));
+    }
+}
+
+/*******************************************************************************
+* Queues the whole line with CR LF or none of it, so lines never mix with      *
+* each other. Dropped while a stream has the UART.                             *
+*******************************************************************************/
+uint8_t uartLineSend(uartline_t *line) {
+    uint8_t sent = FALSE;
+    uint8_t i;
+
+    line->text[line->length] = '\r';
+    line->text[line->length+1] = '\n';
+    if (!uartStreaming && (uartTxFree() >= (line->length+2))) {
+        for (i = 0; i < (line->length+2); i++) {
+            uartTxPut(line->text[i]);
+        }
+        sent = TRUE;
+    } else {
+        uartTxDropped += (line->length+2);
+    }
+    return (sent);
+}
@@ -3,13 +3,65 @@
 *                                                                             *
 * Contains functions and definitions required for 2014 ROV motherboard        *
 *                                                                             *
+* Both directions are buffered by interrupt: nothing here waits on the UART,  *
+* so it is safe to use on air. The interrupts enter through stubs in sample.c *
+* that turn interrupts back on within a few cycles, the handlers here run     *
+* with them on. Only the main loop queues Tx bytes, which is what lets the    *
+* Tx ring go without atomic blocks.                                           *
 *                                                                             *
 * (void) uartInit(void)         Function initializes the UART system into     *
-*                               8-bit, 1 stop bit, no parity mode.            *
+*                               8-bit, 1 stop bit, no parity mode, Rx bytes   *
+*                               are buffered by interrupt.                    *
+* (uint8_t) uartRxReady(void)   Function returns TRUE if a byte is waiting.   *
 * (uint8_t) uartRx(void)        Function returns byte waiting in the UART Rx  *
-*                               register, returns null (0x00) if empty.       *
+*                               buffer, returns null (0x00) if empty.         *
+* (uint8_t) uartTxFree(void)    Function returns room left in the Tx ring.    *
+* (uint8_t) uartTx(uint8_t)     Function queues a byte for the Tx interrupt,  *
+*                               returns FALSE and counts it dropped if the    *
+*                               ring is full. Never waits.                    *
+* (uint8_t) uartTxHex(uint8_t)  Function queues a byte as two hex digits,     *
+*                               high first, both or neither.                  *
+* (void) uartStreamStart(void)  Function holds the UART for output longer     *
+*                               than the ring, fed with uartTx as room        *
+*                               allows. Lines are dropped until it ends.      *
+* (void) uartStreamEnd(void)    Function lets lines out again.                *
+*                                                                             *
+* Lines are formatted into a uartline_t the caller owns and go into the ring  *
+* whole or not at all:                                                        *
+*                                                                             *
+* (void) uartLineStart(uartline_t*, uint8_t)   Starts a line with its type    *
+*                                              letter.                        *
+* (void) uartLineChar(uartline_t*, uint8_t)    Adds a char.                   *
+* (void) uartLineHex(uartline_t*, uint8_t)     Adds two hex digits.           *
+* (void) uartLineUnsigned(uartline_t*, uint16_t) Adds a decimal number.       *
+* (void) uartLineString(uartline_t*, uint8_t*) Adds a null terminated string. *
+* (void) uartLineStringP(uartline_t*, uint8_t*) Adds one from flash.          *
+* (uint8_t) uartLineSend(uartline_t*)          Queues the line and CR LF,     *
+*                                              returns FALSE if dropped.      *
+*                                                                             *
+* (uint16_t) uartOverruns       Count of Rx bytes lost to overrun.            *
+* (uint16_t) uartTxDropped      Count of Tx bytes dropped, never waited for.  *
+* (uint8_t) uartRxStatus        UCSR0A as the Rx stub read it.                *
+* (uint8_t) uartRxByte          UDR0 as the Rx stub read it.                  *
 *                                                                             *
 ******************************************************************************/
 
 extern void uartInit(void);
+extern uint8_t uartRxReady(void);
 extern uint8_t uartRx(void);
+extern uint8_t uartTxFree(void);
+extern uint8_t uartTx(uint8_t byte);
+extern uint8_t uartTxHex(uint8_t byte);
+extern void uartStreamStart(void);
+extern void uartStreamEnd(void);
+extern void uartLineStart(uartline_t *line, uint8_t type);
+extern void uartLineChar(uartline_t *line, uint8_t c);
+extern void uartLineHex(uartline_t *line, uint8_t byte);
+extern void uartLineUnsigned(uartline_t *line, uint16_t value);
+extern void uartLineString(uartline_t *line, const uint8_t *s);
+extern void uartLineStringP(uartline_t *line, const uint8_t *s);
+extern uint8_t uartLineSend(uartline_t *line);
+extern uint16_t uartOverruns;
+extern uint16_t uartTxDropped;
+extern volatile uint8_t uartRxStatus;
+extern volatile uint8_t uartRxByte;
@@ -0,0 +1,109 @@
+#include "includes.h"
+
+uint8_t urgentAdd(urgent_t *request);
+uint8_t urgentNext(rbds_t *blocks);
+void urgentAge(void);
+static void urgentRemove(uint8_t slot);
+
+uint16_t urgentDropped = 0;
+static urgentslot_t urgentQueue[URGENTQUEUESIZE]; // Oldest first
+static uint8_t urgentCount = 0;
+
+static void urgentRemove(uint8_t slot) {
+    urgentCount--;
+    for (; slot < urgentCount; slot++) {
+        urgentQueue[slot] = urgentQueue[slot+1];
+    }
+}
+
+uint8_t urgentAdd(urgent_t *request) {
+    urgentslot_t *entry;
+    uint8_t lowest;
+    uint8_t slot;
+    uint32_t groups;
+
+    if (urgentCount >= URGENTQUEUESIZE) {
+        lowest = 0;
+        for (slot = 1; slot < urgentCount; slot++) {
+            if (urgentQueue[slot].priority <= urgentQueue[lowest].priority) {
+                lowest = slot;
+            } else {}
+        }
+        urgentDropped++;
+        if (request->priority <= urgentQueue[lowest].priority) {
+            return (FALSE);
+        } else {}
+        urgentRemove(lowest);
+    } else {}
+
+    entry = &urgentQueue[urgentCount];
+    entry->blocks[0].hex = (((uint32_t) request->blockB)<<16);
+    entry->blocks[0].hex |= (((uint32_t) crcChecksum(&entry->blocks[0], OFFSETB))<<6);
+    entry->blocks[1].hex = (((uint32_t) request->blockC)<<16);
+    if (entry->blocks[0].type2groupb.grouptype & 0x01) {
+        entry->blocks[1].hex |= (((uint32_t) crcChecksum(&entry->blocks[1], OFFSETC2))<<6); // Version B, block C is PI again
+    } else {
+        entry->blocks[1].hex |= (((uint32_t) crcChecksum(&entry->blocks[1], OFFSETC))<<6);
+    }
+    entry->blocks[2].hex = (((uint32_t) request->blockD)<<16);
+    entry->blocks[2].hex |= (((uint32_t) crcChecksum(&entry->blocks[2], OFFSETD))<<6);
+
+    entry->priority = request->priority;
+    entry->repeats = request->repeats;
+    if (entry->repeats == 0) {
+        entry->repeats = 1;
+    } else {}
+    // Expiry in seconds to groups, at least one, 0 for no limit
+    groups = ((((uint32_t) request->expiry)*2375)/208);
+    if (request->expiry == 0) {
+        entry->groupsLeft = 0;
+    } else if (groups == 0) {
+        entry->groupsLeft = 1;
+    } else if (groups > 0xffff) {
+        entry->groupsLeft = 0xffff;
+    } else {
+        entry->groupsLeft = (uint16_t) groups;
+    }
+    urgentCount++;
+    return (TRUE);
+}
+
+uint8_t urgentNext(rbds_t *blocks) {
+    uint8_t best;
+    uint8_t slot;
+
+    if (urgentCount == 0) {
+        return (FALSE);
+    } else {}
+    best = 0;
+    for (slot = 1; slot < urgentCount; slot++) {
+        if (urgentQueue[slot].priority > urgentQueue[best].priority) {
+            best = slot;
+        } else {}
+    }
+    blocks[0] = urgentQueue[best].blocks[0];
+    blocks[1] = urgentQueue[best].blocks[1];
+    blocks[2] = urgentQueue[best].blocks[2];
+    urgentQueue[best].repeats--;
+    if (urgentQueue[best].repeats == 0) {
+        urgentRemove(best);
+    } else {}
+    return (TRUE);
+}
+
+void urgentAge(void) {
+    uint8_t slot;
+
+    slot = 0;
+    while (slot < urgentCount) {
+        if (urgentQueue[slot].groupsLeft != 0) {
+            urgentQueue[slot].groupsLeft--;
+            if (urgentQueue[slot].groupsLeft == 0) {
+                urgentRemove(slot);
+                urgentDropped++;
+                continue;
+            } else {}
+        } else {}
+        slot++;
+    }
+}
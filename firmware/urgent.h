@@ -0,0 +1,26 @@
+/******************************************************************************
+* Urgent Group Queue Module                                                   *
+*                                                                             *
+* Holds groups sent over UART to go out ahead of the carousel, such as TMC    *
+* 8A groups or an alarm. Highest priority goes first, oldest first within a   *
+* priority. Checkwords are worked out as groups are added, so taking one is   *
+* only a copy. A full queue makes room by dropping its newest lowest priority *
+* group if the new one is more urgent, otherwise the new one is dropped.      *
+*                                                                             *
+* (uint8_t) urgentAdd(urgent_t*)       Function queues a group, returns FALSE *
+*                                      if it was dropped.                     *
+* (uint8_t) urgentNext(rbds_t*)        Function fills blocks B, C & D with    *
+*                                      the next group and counts off one of   *
+*                                      its repeats. Returns FALSE if empty.   *
+* (void) urgentAge(void)               Function counts a group boundary off   *
+*                                      the expiry of each queued group,       *
+*                                      dropping groups whose time is up.      *
+*                                                                             *
+* (uint16_t) urgentDropped             Groups dropped unsent or part sent.    *
+*                                                                             *
+******************************************************************************/
+
+extern uint8_t urgentAdd(urgent_t *request);
+extern uint8_t urgentNext(rbds_t *blocks);
+extern void urgentAge(void);
+extern uint16_t urgentDropped;
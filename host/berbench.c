@@ -0,0 +1,452 @@
+/*******************************************************************************
+* RBDS Block Error Rate Bench                                                  *
+*                                                                              *
+* Measures how the transmitted signal holds up on a noisy channel. Blocks of   *
+* random data get their checkwords from the firmware's crc.c and are           *
+* differentially encoded by its rbds.c, then sent as the firmware sends the    *
+* sine table from sintables.txt at full injection, held between DAC samples as *
+* the DAC does. The channel adds AWGN, a subcarrier frequency offset and       *
+* jitter on each DAC sample edge.                                              *
+*                                                                              *
+* The receiver matches each symbol against one ideal sine cycle, decides bits  *
+* differentially from adjacent symbols so carrier phase doesn't matter, and    *
+* decodes each block by syndrome with its offset known: zero is taken as is,   *
+* otherwise a burst of up to -b bits is corrected by table lookup. Noise is    *
+* added to the matched filter output, the same statistics as white noise       *
+* ahead of it. Eb/N0 is for complex noise against the held DAC waveform.       *
+*                                                                              *
+* Each point is split into jobs of BERBATCH blocks on BERLANES streams at      *
+* once, one stream per vector lane, shared out over worker threads. Jobs are   *
+* seeded by number so results don't depend on the thread count.                *
+*                                                                              *
+* berbench [-s start:stop:step] [-N blocks] [-f hz] [-J cycles] [-b bits]      *
+*          [-w dac|table] [-n threads] [-S seed]                               *
+*                                                                              *
+* Prints one line per Eb/N0 point: bit error rate before decoding, block error *
+* rate with detection only, then with burst correction, and the rate of wrong  *
+* blocks let through with correction.                                          *
+*                                                                              *
+*******************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <math.h>
+#include <unistd.h>
+#include <pthread.h>
+
+#pragma pack(push, 1)
+#include "includes.h"
+#include "sintables.txt"
+#pragma pack(pop)
+
+#define BERBATCH 256 // Blocks per stream in a job
+#define BERSAMPLECYCLES 421.0 // CPU cycles per DAC sample
+#define BERSYMBOLSECONDS ((SAMPLESPERSYMBOL*BERSAMPLECYCLES)/16000000.0)
+#define BERBLOCKBITS 26
+#define BERMAXBURST 5 // Longest burst the code corrects
+#define BERMAXPOINTS 256
+
+typedef float berVec_t __attribute__ ((vector_size (32)));
+typedef int32_t berVecI_t __attribute__ ((vector_size (32)));
+#define BERLANES (sizeof(berVec_t)/sizeof(float))
+
+typedef struct {
+    double start;
+    double stop;
+    double step;
+    uint64_t blocks;
+    double offsetHz;
+    double jitterCycles;
+    uint8_t burst;
+    int table;
+    uint64_t seed;
+} berOptions_t;
+
+// Counts for one Eb/N0 point, added to atomically by the workers
+typedef struct {
+    double ebn0;
+    uint64_t blocks;
+    uint64_t bitErrors;
+    uint64_t detectErrors;
+    uint64_t correctErrors;
+    uint64_t undetected;
+} berPoint_t;
+
+// Matched filter output for each symbol shape, and each sample edge's weight
+// on it per sample period the edge moves later
+typedef struct {
+    float forward;
+    float backward;
+    float forwardEdge[SAMPLESPERSYMBOL];
+    float backwardEdge[SAMPLESPERSYMBOL];
+    double energy; // Per symbol, sample periods x full scale^2
+} berShape_t;
+
+static berOptions_t berOptions = {0.0, 12.0, 1.0, 200000, 0.0, 0.0, BERMAXBURST, FALSE, 1};
+static berShape_t berShape;
+static uint32_t berCorrection[1024]; // Error pattern for each syndrome, 0 if none
+static berPoint_t berPoints[BERMAXPOINTS];
+static int berPointCount;
+static uint64_t berJobsPerPoint;
+static uint64_t berJobCount;
+static uint64_t berNextJob;
+static const uint8_t berOffsets[4] = {OFFSETA, OFFSETB, OFFSETC, OFFSETD};
+
+static void berUsage(void) {
+    fprintf(stderr,
+        "usage: berbench [options]\n"
+        "  -s start:stop:step  Eb/N0 points in dB (default 0:12:1)\n"
+        "  -N blocks           blocks per point (default 200000)\n"
+        "  -f hz               subcarrier frequency offset (default 0)\n"
+        "  -J cycles           rms jitter of each DAC sample edge in CPU cycles (default 0)\n"
+        "  -b bits             longest burst corrected, 0 to %u (default %u)\n"
+        "  -w dac|table        send the 12 bit wave the firmware builds, or the table as written (default dac)\n"
+        "  -n threads          worker threads (default one per cpu)\n"
+        "  -S seed             random seed (default 1)\n",
+        BERMAXBURST, BERMAXBURST);
+    exit(1);
+}
+
+/******************************************************************************
+* Random numbers, splitmix64 so a job's stream follows from its number        *
+******************************************************************************/
+
+static uint64_t berRandom(uint64_t *state) {
+    uint64_t z;
+
+    *state += 0x9e3779b97f4a7c15ULL;
+    z = *state;
+    z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+    return (z ^ (z >> 31));
+}
+
+// Fills count unit normal deviates, count even
+static void berGaussian(uint64_t *state, float *out, uint32_t count) {
+    double u;
+    double v;
+    double r;
+    uint32_t i;
+
+    for (i = 0; i < count; i += 2) {
+        u = ((berRandom(state) >> 11) + 1.0) * (1.0/9007199254740993.0);
+        v = (berRandom(state) >> 11) * (1.0/9007199254740992.0);
+        r = sqrt(-2.0 * log(u));
+        out[i] = (float) (r * cos(2.0 * M_PI * v));
+        out[i+1] = (float) (r * sin(2.0 * M_PI * v));
+    }
+}
+
+/******************************************************************************
+* Transmit shape & receiver                                                   *
+******************************************************************************/
+
+/*******************************************************************************
+* Template is h(t) = sin(2 pi t/32) over the symbol in sample periods. A held  *
+* sample v over [i, i+1] gives v(H(i+1)-H(i)), H the integral of h. An edge    *
+* moving d later swaps d of the next sample for the last, adding               *
+* d h(i) (v[i-1]-v[i]) to first order. h is zero at the symbol edges, so only  *
+* edges inside the symbol count.                                               *
+*******************************************************************************/
+// Table entry as mainInjectionFill() puts it on channel B at full injection
+static double berDacSample(uint16_t entry) {
+    int32_t sample;
+
+    sample = (DACMID + (((((int32_t) entry) - SINTABLEMID)*DACSWING)/SINTABLESWING));
+    return ((sample < 0) ? 0 : ((sample > DACMAX) ? DACMAX : sample));
+}
+
+static void berShapeInit(void) {
+    double forward[SAMPLESPERSYMBOL];
+    double backward[SAMPLESPERSYMBOL];
+    double mean = 0.0;
+    double weight;
+    double h;
+    uint8_t i;
+
+    for (i = 0; i < SAMPLESPERSYMBOL; i++) {
+        forward[i] = (berOptions.table ? mainSinTable[i] : berDacSample(mainSinTable[i]));
+        mean += forward[i];
+    }
+    // AC coupled, full scale is the 12 bit DAC's
+    mean /= SAMPLESPERSYMBOL;
+    for (i = 0; i < SAMPLESPERSYMBOL; i++) {
+        forward[i] = (forward[i] - mean) / 4096.0;
+    }
+    for (i = 0; i < SAMPLESPERSYMBOL; i++) {
+        backward[i] = forward[(SAMPLESPERSYMBOL-1)-i];
+    }
+
+    memset(&berShape, 0, sizeof(berShape));
+    for (i = 0; i < SAMPLESPERSYMBOL; i++) {
+        weight = (cos(2.0 * M_PI * i / SAMPLESPERSYMBOL) - cos(2.0 * M_PI * (i+1) / SAMPLESPERSYMBOL))
+            * (SAMPLESPERSYMBOL / (2.0 * M_PI));
+        berShape.forward += (float) (forward[i] * weight);
+        berShape.backward += (float) (backward[i] * weight);
+        berShape.energy += ((forward[i] * forward[i]) + (backward[i] * backward[i])) / 2.0;
+        if (i != 0) {
+            h = sin(2.0 * M_PI * i / SAMPLESPERSYMBOL);
+            berShape.forwardEdge[i] = (float) (h * (forward[i-1] - forward[i]));
+            berShape.backwardEdge[i] = (float) (h * (backward[i-1] - backward[i]));
+        } else {}
+    }
+}
+
+static uint16_t berSyndrome(uint32_t word, uint8_t offset) {
+    rbds_t block;
+
+    block.hex = ((word >> 10) << 16);
+    return (crcChecksum(&block, offset) ^ (word & 0x3ff));
+}
+
+// Every burst up to the longest asked for must have a syndrome of its own
+static int berCorrectionInit(void) {
+    uint32_t pattern;
+    uint32_t inner;
+    uint16_t syndrome;
+    uint8_t length;
+    uint8_t shift;
+
+    memset(berCorrection, 0, sizeof(berCorrection));
+    for (length = 1; length <= berOptions.burst; length++) {
+        for (inner = 0; inner < (length > 2 ? (1u << (length-2)) : 1); inner++) {
+            pattern = (length == 1) ? 1 : (1 | (inner << 1) | (1u << (length-1)));
+            for (shift = 0; shift <= (BERBLOCKBITS-length); shift++) {
+                syndrome = berSyndrome(pattern << shift, OFFSETE);
+                if ((berCorrection[syndrome] != 0) && (berCorrection[syndrome] != (pattern << shift))) {
+                    return (FALSE);
+                } else {}
+                berCorrection[syndrome] = (pattern << shift);
+            }
+        }
+    }
+    return (TRUE);
+}
+
+/*******************************************************************************
+* Runs one job: BERBATCH blocks on each lane's stream, each stream with its    *
+* own bits, carrier phase and noise.                                           *
+*******************************************************************************/
+static void berRunJob(uint64_t job) {
+    berPoint_t *point = &berPoints[job / berJobsPerPoint];
+    rbds_t shift[BERLANES];
+    uint32_t sent[BERLANES];
+    uint32_t received[BERLANES];
+    uint8_t lastBit[BERLANES];
+    float noise[2*BERLANES] __attribute__ ((aligned (sizeof(berVec_t))));
+    float edges[SAMPLESPERSYMBOL*BERLANES] __attribute__ ((aligned (sizeof(berVec_t))));
+    const berVec_t zero = {0};
+    berVec_t y;
+    berVec_t weight;
+    berVec_t yRe;
+    berVec_t yIm;
+    berVec_t lastRe;
+    berVec_t lastIm;
+    berVec_t rotRe;
+    berVec_t rotIm;
+    berVec_t turn;
+    berVec_t scale;
+    berVecI_t isForward;
+    berVecI_t flipped;
+    uint64_t state;
+    uint64_t bitErrors = 0;
+    uint64_t detectErrors = 0;
+    uint64_t correctErrors = 0;
+    uint64_t undetected = 0;
+    float sigma;
+    float jitter;
+    float stepRe;
+    float stepIm;
+    uint32_t block;
+    uint32_t corrected;
+    uint16_t syndrome;
+    uint8_t offset;
+    uint8_t bit;
+    uint8_t lane;
+    uint8_t i;
+
+    state = berOptions.seed ^ (job * 0xd1b54a32d192ed03ULL);
+    (void) berRandom(&state);
+    // Complex noise, N0/2 per dimension through a template of energy 16
+    sigma = (float) sqrt((berShape.energy / pow(10.0, point->ebn0 / 10.0)) * 0.5 * (SAMPLESPERSYMBOL / 2));
+    jitter = (float) (berOptions.jitterCycles / BERSAMPLECYCLES);
+    stepRe = (float) cos(2.0 * M_PI * berOptions.offsetHz * BERSYMBOLSECONDS);
+    stepIm = (float) sin(2.0 * M_PI * berOptions.offsetHz * BERSYMBOLSECONDS);
+
+    for (lane = 0; lane < BERLANES; lane++) {
+        turn[lane] = (float) (2.0 * M_PI * (berRandom(&state) >> 11) * (1.0/9007199254740992.0));
+        rotRe[lane] = cosf(turn[lane]);
+        rotIm[lane] = sinf(turn[lane]);
+        lastBit[lane] = 0;
+        lastRe[lane] = berShape.backward * rotRe[lane];
+        lastIm[lane] = berShape.backward * rotIm[lane];
+    }
+
+    for (block = 0; block < BERBATCH; block++) {
+        offset = berOffsets[block & 3];
+        for (lane = 0; lane < BERLANES; lane++) {
+            shift[lane].hex = (berRandom(&state) & 0xffff0000);
+            shift[lane].hex |= (((uint32_t) crcChecksum(&shift[lane], offset)) << 6);
+            sent[lane] = (shift[lane].hex >> 6);
+            received[lane] = 0;
+        }
+
+        for (bit = 0; bit < BERBLOCKBITS; bit++) {
+            for (lane = 0; lane < BERLANES; lane++) {
+                lastBit[lane] = rbdsDiffEncode(&shift[lane], lastBit[lane]);
+                isForward[lane] = (lastBit[lane] ? -1 : 0);
+            }
+            y = (berVec_t) ((isForward & (berVecI_t) (zero + berShape.forward))
+                | (~isForward & (berVecI_t) (zero + berShape.backward)));
+            if (jitter != 0.0f) {
+                berGaussian(&state, edges, SAMPLESPERSYMBOL*BERLANES);
+                for (i = 1; i < SAMPLESPERSYMBOL; i++) {
+                    weight = (berVec_t) ((isForward & (berVecI_t) (zero + berShape.forwardEdge[i]))
+                        | (~isForward & (berVecI_t) (zero + berShape.backwardEdge[i])));
+                    y += (*(berVec_t *) &edges[i*BERLANES]) * jitter * weight;
+                }
+            } else {}
+
+            berGaussian(&state, noise, 2*BERLANES);
+            yRe = (y * rotRe) + (sigma * *(berVec_t *) &noise[0]);
+            yIm = (y * rotIm) + (sigma * *(berVec_t *) &noise[BERLANES]);
+
+            // Symbol flipped from the last is a 1
+            flipped = (((yRe * lastRe) + (yIm * lastIm)) < 0.0f);
+            for (lane = 0; lane < BERLANES; lane++) {
+                received[lane] = ((received[lane] << 1) | (flipped[lane] & 1));
+            }
+            lastRe = yRe;
+            lastIm = yIm;
+            turn = (rotRe * stepRe) - (rotIm * stepIm);
+            rotIm = (rotRe * stepIm) + (rotIm * stepRe);
+            rotRe = turn;
+        }
+
+        // Keep the carrier rotation on the unit circle
+        scale = 1.0f / ((rotRe * rotRe) + (rotIm * rotIm));
+        rotRe *= (0.5f + (0.5f * scale));
+        rotIm *= (0.5f + (0.5f * scale));
+
+        for (lane = 0; lane < BERLANES; lane++) {
+            bitErrors += __builtin_popcount(received[lane] ^ sent[lane]);
+            syndrome = berSyndrome(received[lane], offset);
+            if ((syndrome != 0) || (received[lane] != sent[lane])) {
+                detectErrors++;
+            } else {}
+            if (syndrome == 0) {
+                corrected = received[lane];
+            } else if (berCorrection[syndrome] != 0) {
+                corrected = (received[lane] ^ berCorrection[syndrome]);
+            } else {
+                correctErrors++;
+                continue;
+            }
+            if (corrected != sent[lane]) {
+                correctErrors++;
+                undetected++;
+            } else {}
+        }
+    }
+
+    __atomic_fetch_add(&point->blocks, (uint64_t) BERBATCH*BERLANES, __ATOMIC_RELAXED);
+    __atomic_fetch_add(&point->bitErrors, bitErrors, __ATOMIC_RELAXED);
+    __atomic_fetch_add(&point->detectErrors, detectErrors, __ATOMIC_RELAXED);
+    __atomic_fetch_add(&point->correctErrors, correctErrors, __ATOMIC_RELAXED);
+    __atomic_fetch_add(&point->undetected, undetected, __ATOMIC_RELAXED);
+}
+
+static void *berWorker(void *argument) {
+    uint64_t job;
+
+    for (job = __atomic_fetch_add(&berNextJob, 1, __ATOMIC_RELAXED); job < berJobCount;
+            job = __atomic_fetch_add(&berNextJob, 1, __ATOMIC_RELAXED)) {
+        berRunJob(job);
+    }
+    return (argument);
+}
+
+int main(int argc, char **argv) {
+    pthread_t *threads;
+    const char *waveform = "dac";
+    berPoint_t *point;
+    double ebn0;
+    long threadCount;
+    int option;
+    int i;
+
+    threadCount = sysconf(_SC_NPROCESSORS_ONLN);
+    while ((option = getopt(argc, argv, "s:N:f:J:b:w:n:S:")) != -1) {
+        switch (option) {
+            case 's':
+                if (sscanf(optarg, "%lf:%lf:%lf", &berOptions.start, &berOptions.stop, &berOptions.step) != 3) {
+                    berUsage();
+                } else {}
+                break;
+            case 'N': berOptions.blocks = strtoull(optarg, NULL, 0); break;
+            case 'f': berOptions.offsetHz = strtod(optarg, NULL); break;
+            case 'J': berOptions.jitterCycles = strtod(optarg, NULL); break;
+            case 'b': berOptions.burst = (uint8_t) strtoul(optarg, NULL, 0); break;
+            case 'w': waveform = optarg; break;
+            case 'n': threadCount = strtol(optarg, NULL, 0); break;
+            case 'S': berOptions.seed = strtoull(optarg, NULL, 0); break;
+            default: berUsage();
+        }
+    }
+
+    if (strcmp(waveform, "dac") == 0) {
+        berOptions.table = FALSE;
+    } else if (strcmp(waveform, "table") == 0) {
+        berOptions.table = TRUE;
+    } else {
+        berUsage();
+    }
+    if ((berOptions.step <= 0) || (berOptions.stop < berOptions.start) || (berOptions.blocks == 0)
+            || (berOptions.jitterCycles < 0) || (berOptions.burst > BERMAXBURST) || (threadCount < 1)) {
+        berUsage();
+    } else {}
+
+    for (ebn0 = berOptions.start; (ebn0 <= (berOptions.stop + (berOptions.step/2))) && (berPointCount < BERMAXPOINTS);
+            ebn0 += berOptions.step) {
+        berPoints[berPointCount].ebn0 = ebn0;
+        berPointCount++;
+    }
+    berShapeInit();
+    if (!berCorrectionInit()) {
+        fprintf(stderr, "bursts of %u bits don't all have their own syndrome\n", berOptions.burst);
+        return (1);
+    } else {}
+    berJobsPerPoint = ((berOptions.blocks + ((BERBATCH*BERLANES)-1)) / (BERBATCH*BERLANES));
+    berJobCount = (berJobsPerPoint * berPointCount);
+
+    printf("# %s waveform, %.1f hz offset, %.2f cycles rms edge jitter, bursts to %u bits corrected\n",
+        berOptions.table ? "table" : "dac", berOptions.offsetHz, berOptions.jitterCycles, berOptions.burst);
+    printf("# ebn0_db blocks ber bler_detect bler_correct undetected\n");
+    fflush(stdout);
+
+    if ((uint64_t) threadCount > berJobCount) {
+        threadCount = (long) berJobCount;
+    } else {}
+    threads = malloc(threadCount*sizeof(pthread_t));
+    for (i = 0; i < threadCount; i++) {
+        if ((threads == NULL) || (pthread_create(&threads[i], NULL, berWorker, NULL) != 0)) {
+            fprintf(stderr, "can't start worker thread\n");
+            exit(1);
+        } else {}
+    }
+    for (i = 0; i < threadCount; i++) {
+        pthread_join(threads[i], NULL);
+    }
+    free(threads);
+
+    for (i = 0; i < berPointCount; i++) {
+        point = &berPoints[i];
+        printf("%6.2f %10llu %.3e %.3e %.3e %.3e\n", point->ebn0, (unsigned long long) point->blocks,
+            (double) point->bitErrors / ((double) point->blocks * BERBLOCKBITS),
+            (double) point->detectErrors / point->blocks, (double) point->correctErrors / point->blocks,
+            (double) point->undetected / point->blocks);
+    }
+    return (0);
+}
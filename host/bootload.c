@@ -0,0 +1,189 @@
+/*******************************************************************************
+* Bootloader Uploader                                                          *
+*                                                                              *
+* Updates a unit's application over serial through the bootloader in          *
+* bootloader/. Asks the running application to hand over, reads the CRC of    *
+* every page on the unit and only writes the pages of the new image that      *
+* differ, so a small change takes the unit off air for a second or two.        *
+*                                                                              *
+* bootload [-p port] [-b baud] [-B baud] [-n] image.hex                        *
+*                                                                              *
+* Works the same against bootsim, give it the pty that prints.                 *
+*                                                                              *
+*******************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <time.h>
+#include <termios.h>
+#include <unistd.h>
+#include "boot.h"
+#include "ihex.h"
+#include "serial.h"
+
+#define BOOTLOADREQUEST "B#boot" // Application command & confirm, firmware includes.h BOOTREQUEST
+#define BOOTLOADSYNCTRIES 40
+#define BOOTLOADRETRIES 3
+
+static uint32_t bootloadPageCrc(uint8_t *page) {
+    uint32_t crc = 0xffffffff;
+    uint16_t i;
+
+    for (i = 0; i < BOOTPAGESIZE; i++) {
+        crc = bootCrc32Update(crc, page[i]);
+    }
+    return (~crc);
+}
+
+static double bootloadNow(void) {
+    struct timespec now;
+
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (now.tv_sec + (now.tv_nsec / 1e9));
+}
+
+static void bootloadUsage(void) {
+    fprintf(stderr,
+        "usage: bootload [-p port] [-b baud] [-B baud] [-n] image.hex\n"
+        "  -p port  serial port (default /dev/ttyUSB0)\n"
+        "  -b baud  application baud rate (default 9600)\n"
+        "  -B baud  bootloader baud rate (default 500000)\n"
+        "  -n       unit is already in the bootloader, don't ask the application\n");
+    exit(1);
+}
+
+// Sends sync until the loader answers, returns FALSE if it never does
+static int bootloadSync(int fd) {
+    uint8_t command = BOOTSYNC;
+    uint8_t reply[4];
+    int tries;
+
+    for (tries = 0; tries < BOOTLOADSYNCTRIES; tries++) {
+        tcflush(fd, TCIFLUSH);
+        if (serialWrite(fd, &command, 1) < 0) {
+            return (FALSE);
+        } else {}
+        if ((serialRead(fd, reply, 4, 50) == 4) && (reply[0] == BOOTSYNC)) {
+            if ((reply[1] != BOOTVERSION) || ((reply[2]*2) != BOOTPAGESIZE) || (reply[3] != BOOTAPPPAGES)) {
+                fprintf(stderr, "bootloader version %u with %u pages of %u bytes, expected version %u\n",
+                    reply[1], reply[3], reply[2]*2, BOOTVERSION);
+                return (FALSE);
+            } else {}
+            return (TRUE);
+        } else {}
+    }
+    fprintf(stderr, "no answer from bootloader\n");
+    return (FALSE);
+}
+
+static int bootloadWritePage(int fd, uint8_t page, uint8_t *data) {
+    uint8_t command[1+1+BOOTPAGESIZE+4];
+    uint32_t crc = bootloadPageCrc(data);
+    uint8_t reply;
+    int tries;
+
+    command[0] = BOOTWRITE;
+    command[1] = page;
+    memcpy(&command[2], data, BOOTPAGESIZE);
+    command[2+BOOTPAGESIZE] = (uint8_t) crc;
+    command[3+BOOTPAGESIZE] = (uint8_t) (crc>>8);
+    command[4+BOOTPAGESIZE] = (uint8_t) (crc>>16);
+    command[5+BOOTPAGESIZE] = (uint8_t) (crc>>24);
+    for (tries = 0; tries < BOOTLOADRETRIES; tries++) {
+        if (serialWrite(fd, command, sizeof(command)) < 0) {
+            return (FALSE);
+        } else {}
+        // Erase & write take under 10ms, a garbled command times out in the loader after 1s
+        if ((serialRead(fd, &reply, 1, 1500) == 1) && (reply == BOOTOK)) {
+            return (TRUE);
+        } else {}
+        fprintf(stderr, "page %u failed, retrying\n", page);
+        tcflush(fd, TCIFLUSH);
+    }
+    return (FALSE);
+}
+
+int main(int argc, char **argv) {
+    static uint8_t image[BOOTAPPPAGES*BOOTPAGESIZE];
+    uint8_t remote[BOOTAPPPAGES*4];
+    uint8_t command;
+    uint32_t remoteCrc;
+    const char *port = "/dev/ttyUSB0";
+    uint32_t appBaud = 9600;
+    uint32_t bootBaud = 500000;
+    int request = TRUE;
+    int option;
+    int fd;
+    int pages;
+    int changed = 0;
+    int page;
+    long top;
+    double start;
+    double diffed;
+
+    while ((option = getopt(argc, argv, "p:b:B:n")) != -1) {
+        switch (option) {
+            case 'p': port = optarg; break;
+            case 'b': appBaud = (uint32_t) strtoul(optarg, NULL, 0); break;
+            case 'B': bootBaud = (uint32_t) strtoul(optarg, NULL, 0); break;
+            case 'n': request = FALSE; break;
+            default: bootloadUsage();
+        }
+    }
+    if (optind != (argc-1)) {
+        bootloadUsage();
+    } else {}
+
+    // Unused flash reads back erased
+    memset(image, 0xff, sizeof(image));
+    top = ihexRead(argv[optind], image, sizeof(image));
+    if (top <= 0) {
+        fprintf(stderr, "%s: no image that fits below the bootloader\n", argv[optind]);
+        return (1);
+    } else {}
+    pages = (int) ((top + BOOTPAGESIZE - 1) / BOOTPAGESIZE);
+
+    fd = serialOpen(port, request ? appBaud : bootBaud);
+    if (fd < 0) {
+        return (1);
+    } else {}
+    start = bootloadNow();
+    if (request) {
+        if ((serialWrite(fd, (const uint8_t *) BOOTLOADREQUEST, strlen(BOOTLOADREQUEST)) < 0) || (serialSetBaud(fd, bootBaud) < 0)) {
+            return (1);
+        } else {}
+    } else {}
+    if (!bootloadSync(fd)) {
+        return (1);
+    } else {}
+
+    // Diff against the image on the unit
+    command = BOOTPAGECRCS;
+    if ((serialWrite(fd, &command, 1) < 0) || (serialRead(fd, remote, sizeof(remote), 1000) != sizeof(remote))) {
+        fprintf(stderr, "no page CRCs from bootloader\n");
+        return (1);
+    } else {}
+    diffed = bootloadNow();
+    for (page = 0; page < pages; page++) {
+        remoteCrc = remote[page*4] | (remote[(page*4)+1]<<8) | (remote[(page*4)+2]<<16) | ((uint32_t) remote[(page*4)+3]<<24);
+        if (remoteCrc != bootloadPageCrc(&image[page*BOOTPAGESIZE])) {
+            if (!bootloadWritePage(fd, (uint8_t) page, &image[page*BOOTPAGESIZE])) {
+                fprintf(stderr, "page %d could not be written, unit stays in the bootloader\n", page);
+                return (1);
+            } else {}
+            changed++;
+        } else {}
+    }
+
+    command = BOOTEXIT;
+    if ((serialWrite(fd, &command, 1) < 0) || (serialRead(fd, &command, 1, 1000) != 1) || (command != BOOTEXIT)) {
+        fprintf(stderr, "bootloader did not confirm exit\n");
+        return (1);
+    } else {}
+    printf("%d of %d pages changed, off air %.2f s (diff %.2f s, writes %.2f s)\n",
+        changed, pages, bootloadNow() - start, diffed - start, bootloadNow() - diffed);
+    close(fd);
+    return (0);
+}
@@ -0,0 +1,156 @@
+/*******************************************************************************
+* Bootloader Simulator                                                         *
+*                                                                              *
+* Runs bootloader/boot.c on the host against 32KB of simulated flash, with     *
+* the UART on a pty so bootload can be pointed at it. Until asked for the      *
+* loader it acts as the application, which only listens for the bootloader     *
+* request; each loader session reports the pages written and can save flash.   *
+*                                                                              *
+* bootsim [-i image.hex] [-o flash.hex] [-1]                                   *
+*                                                                              *
+* -1 exits after one loader session, for scripted tests.                       *
+*                                                                              *
+*******************************************************************************/
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <termios.h>
+#include <unistd.h>
+#include "boot.h"
+#include "ihex.h"
+
+#define BOOTSIMFLASH ((uint32_t) 32768)
+#define BOOTSIMREQUEST ((uint8_t) 'B') // Application command, firmware includes.h BOOTREQUEST
+
+static uint8_t bootsimFlash[BOOTSIMFLASH];
+static uint16_t bootsimPageWrites[BOOTSIMFLASH/BOOTPAGESIZE];
+static int bootsimPty;
+
+uint8_t bootUartRx(uint8_t *byte) {
+    struct pollfd wait = {bootsimPty, POLLIN, 0};
+
+    // Loader timeout is one second
+    if ((poll(&wait, 1, 1000) == 1) && (read(bootsimPty, byte, 1) == 1)) {
+        return (TRUE);
+    } else {}
+    return (FALSE);
+}
+
+void bootUartTx(uint8_t byte) {
+    if (write(bootsimPty, &byte, 1) != 1) {
+        perror("bootsim pty");
+    } else {}
+}
+
+uint8_t bootFlashRead(uint16_t address) {
+    return (bootsimFlash[address % BOOTSIMFLASH]);
+}
+
+void bootFlashWritePage(uint16_t address, uint8_t *data) {
+    // Page write on the part ignores the low address bits
+    address &= ~(BOOTPAGESIZE-1);
+    memcpy(&bootsimFlash[address], data, BOOTPAGESIZE);
+    bootsimPageWrites[address/BOOTPAGESIZE]++;
+}
+
+static void bootsimSave(const char *path) {
+    FILE *file;
+    uint32_t address;
+    uint8_t sum;
+    int i;
+
+    file = fopen(path, "w");
+    if (file == NULL) {
+        perror(path);
+        return;
+    } else {}
+    // Application section as 16 byte records, same as avr-objcopy writes
+    for (address = 0; address < (BOOTAPPPAGES*BOOTPAGESIZE); address += 16) {
+        sum = 16 + (address>>8) + address;
+        fprintf(file, ":10%04X00", address);
+        for (i = 0; i < 16; i++) {
+            fprintf(file, "%02X", bootsimFlash[address+i]);
+            sum += bootsimFlash[address+i];
+        }
+        fprintf(file, "%02X\n", (uint8_t) -sum);
+    }
+    fprintf(file, ":00000001FF\n");
+    fclose(file);
+}
+
+static void bootsimUsage(void) {
+    fprintf(stderr, "usage: bootsim [-i image.hex] [-o flash.hex] [-1]\n");
+    exit(1);
+}
+
+int main(int argc, char **argv) {
+    struct termios settings;
+    const char *saveFile = NULL;
+    uint16_t before[BOOTSIMFLASH/BOOTPAGESIZE];
+    uint8_t byte;
+    int once = FALSE;
+    int slave;
+    int option;
+    int written;
+    int page;
+
+    memset(bootsimFlash, 0xff, sizeof(bootsimFlash));
+    while ((option = getopt(argc, argv, "i:o:1")) != -1) {
+        switch (option) {
+            case 'i':
+                if (ihexRead(optarg, bootsimFlash, BOOTAPPPAGES*BOOTPAGESIZE) < 0) {
+                    return (1);
+                } else {}
+                break;
+            case 'o': saveFile = optarg; break;
+            case '1': once = TRUE; break;
+            default: bootsimUsage();
+        }
+    }
+
+    // Hold the slave open so the pty doesn't hang up between clients, raw so
+    // nothing is echoed or translated
+    bootsimPty = posix_openpt(O_RDWR | O_NOCTTY);
+    if ((bootsimPty < 0) || (grantpt(bootsimPty) < 0) || (unlockpt(bootsimPty) < 0)) {
+        perror("pty");
+        return (1);
+    } else {}
+    slave = open(ptsname(bootsimPty), O_RDWR | O_NOCTTY);
+    if ((slave < 0) || (tcgetattr(slave, &settings) < 0)) {
+        perror(ptsname(bootsimPty));
+        return (1);
+    } else {}
+    cfmakeraw(&settings);
+    tcsetattr(slave, TCSANOW, &settings);
+    printf("%s\n", ptsname(bootsimPty));
+    fflush(stdout);
+
+    for (;;) {
+        // Application, waits for the bootloader request
+        if ((read(bootsimPty, &byte, 1) != 1) || (byte != BOOTSIMREQUEST)) {
+            continue;
+        } else {}
+        tcflush(slave, TCIOFLUSH); // Request came in at the application's baud rate
+
+        memcpy(before, bootsimPageWrites, sizeof(before));
+        bootLoader();
+
+        written = 0;
+        for (page = 0; page < (BOOTSIMFLASH/BOOTPAGESIZE); page++) {
+            written += (bootsimPageWrites[page] - before[page]);
+        }
+        printf("loader session: %d page writes\n", written);
+        fflush(stdout);
+        if (saveFile != NULL) {
+            bootsimSave(saveFile);
+        } else {}
+        if (once) {
+            return (0);
+        } else {}
+    }
+}
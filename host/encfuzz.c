@@ -0,0 +1,535 @@
+/*******************************************************************************
+* RBDS Encoder Differential Fuzzer                                             *
+*                                                                              *
+* Runs random inputs through the firmware's encoders and through a frozen      *
+* bit-serial reference written from the standard, and fails on any bit that    *
+* differs. Checkwords come from long division by g(x) with the offset words    *
+* written out, blocks are packed by shifting fields into place rather than     *
+* through the rbds_t bitfields, and differential encoding walks each bit.      *
+* Keep the reference slow and obvious: it is what table, word and flash        *
+* constant speedups in crc.c, rbds.c & urgent.c are measured against.          *
+*                                                                              *
+* Each input sets a PI code, TP, PTY, text A/B, a 2A segment, a 4A time, an    *
+* urgent group's B, C & D information words, the first differential output     *
+* bit and up to 64 chars of radiotext. Compared for each input:                *
+*   crcChecksum of the PI code for every offset                                *
+*   rbdsGroupA, rbdsStaticGroupA & rbdsStaticGroup2AB                          *
+*   rbdsStaticGroup0A for the segment's low 2 bits                             *
+*   rbdsGroup4A                                                                *
+*   urgentAdd then urgentNext, version B groups take offset C'                 *
+*   rbdsEncodePs over the first 8 to 24 chars of the text, picked by segment   *
+*   rbdsPadRadiotext, rbdsEncodeRadiotext & rbdsGroup2AB for every segment     *
+*   rbdsDiffEncode over every 2A group, 26 bits a block as the sample          *
+*   interrupt sends them                                                       *
+*                                                                              *
+* encfuzz [-n inputs] [-S seed] [input...]                                     *
+*                                                                              *
+* With no input files, runs batches of ENCFUZZBATCH random inputs, each batch  *
+* through the firmware then the reference so either can be timed alone, and    *
+* prints groups per second for both. A group is each 2A group plus the 4A and  *
+* urgent group of an input. Input files are run once each, as a reproducer.    *
+* The first mismatch prints the input in hex and the field that differs,       *
+* writes the input to encfuzz-fail.bin and exits failing.                      *
+*                                                                              *
+* Built with clang -fsanitize=fuzzer -DENCFUZZLIBFUZZER and the firmware       *
+* objects, LLVMFuzzerTestOneInput runs under libFuzzer instead, aborting on a  *
+* mismatch.                                                                    *
+*                                                                              *
+*******************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <time.h>
+#include <unistd.h>
+
+#pragma pack(push, 1)
+#include "includes.h"
+#pragma pack(pop)
+
+#define ENCFUZZBATCH 4096 // Inputs per timed batch
+#define ENCFUZZHEADER 17 // Input bytes ahead of the radiotext
+#define ENCFUZZTEXT 64
+#define ENCFUZZINPUT (ENCFUZZHEADER+ENCFUZZTEXT)
+#define ENCFUZZBLOCKBITS 26
+#define ENCFUZZGROUPBITS (4*ENCFUZZBLOCKBITS)
+
+// Where each block lands in the output
+#define ENCFUZZCRC 0 // crcChecksum of the PI code, one per offset, as blocks
+#define ENCFUZZA 6
+#define ENCFUZZSTATICA 7
+#define ENCFUZZSTATIC2AB 8
+#define ENCFUZZSTATIC0A 9 // B & C
+#define ENCFUZZ4A 11 // B, C & D
+#define ENCFUZZURGENT 14 // B, C & D
+#define ENCFUZZPS 17 // D for each pair
+#define ENCFUZZRT (ENCFUZZPS+PSTEXTSIZE) // B, C & D for each segment
+#define ENCFUZZBLOCKS (ENCFUZZRT+(3*MAXRTGROUPS))
+
+// Input as the fuzzer sees it, short inputs are zero filled
+typedef struct {
+    uint8_t pi[2];
+    uint8_t flags;         // Bit 0 TP, 1 text A/B, 2 first output bit, 3 offset sign
+    uint8_t pty;
+    uint8_t mjd[3];
+    uint8_t hour;
+    uint8_t minute;
+    uint8_t offset;
+    uint8_t urgent[6];     // B, C & D information words
+    uint8_t segment;
+    uint8_t text[ENCFUZZTEXT]; // Up to the first null
+} encfuzzinput_t;
+
+typedef struct {
+    uint32_t blocks[ENCFUZZBLOCKS];
+    uint8_t bits[(MAXRTGROUPS*ENCFUZZGROUPBITS)/8];
+    uint8_t segments;
+    uint8_t psLength;
+} encfuzzoutput_t;
+
+typedef struct {
+    uint16_t pi;
+    uint8_t tp;
+    uint8_t pty;
+    uint8_t textab;
+    uint8_t lastBit;
+    uint8_t segment;
+    rtc_t time;
+    uint16_t urgent[3];
+    uint8_t text[ENCFUZZTEXT+1];
+} encfuzzcase_t;
+
+static uint64_t encfuzzInputs = 1000000;
+static uint64_t encfuzzSeed = 1;
+
+static void encfuzzUsage(void) {
+    fprintf(stderr,
+        "usage: encfuzz [-n inputs] [-S seed] [input...]\n"
+        "  -n inputs  random inputs to run (default 1000000)\n"
+        "  -S seed    random seed (default 1)\n"
+        "  input      run each file once instead\n");
+    exit(1);
+}
+
+static uint64_t encfuzzRandom(uint64_t *state) {
+    uint64_t z;
+
+    *state += 0x9e3779b97f4a7c15ULL;
+    z = *state;
+    z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+    return (z ^ (z >> 31));
+}
+
+static double encfuzzSeconds(void) {
+    struct timespec now;
+
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (now.tv_sec + (now.tv_nsec / 1e9));
+}
+
+// Fields in range for the firmware, which only range checks time on a set
+static void encfuzzDecode(const uint8_t *data, size_t size, encfuzzcase_t *c) {
+    encfuzzinput_t input;
+    uint32_t mjd;
+
+    memset(&input, 0, sizeof(input));
+    memcpy(&input, data, (size < sizeof(input)) ? size : sizeof(input));
+    memset(c, 0, sizeof(*c));
+    c->pi = (uint16_t) (input.pi[0] | (input.pi[1] << 8));
+    c->tp = (input.flags & 0x01);
+    c->textab = ((input.flags >> 1) & 0x01);
+    c->lastBit = ((input.flags >> 2) & 0x01);
+    c->pty = (input.pty & 0x1f);
+    c->segment = (input.segment & (MAXRTGROUPS-1));
+    mjd = (input.mjd[0] | (input.mjd[1] << 8) | (((uint32_t) input.mjd[2]) << 16));
+    c->time.mjd = (mjd & 0x1ffff);
+    c->time.hour = (input.hour % 24);
+    c->time.minute = (input.minute % 60);
+    c->time.offset = (int8_t) (input.offset % 32);
+    if (input.flags & 0x08) {
+        c->time.offset = -c->time.offset;
+    } else {}
+    c->urgent[0] = (uint16_t) (input.urgent[0] | (input.urgent[1] << 8));
+    c->urgent[1] = (uint16_t) (input.urgent[2] | (input.urgent[3] << 8));
+    c->urgent[2] = (uint16_t) (input.urgent[4] | (input.urgent[5] << 8));
+    memcpy(c->text, input.text, ENCFUZZTEXT); // Null at the end from the memset
+}
+
+static void encfuzzPutBit(uint8_t *bits, uint16_t index, uint8_t bit) {
+    if (bit) {
+        bits[index >> 3] |= (uint8_t) (0x80 >> (index & 0x07));
+    } else {}
+}
+
+/******************************************************************************
+* Reference, frozen. Don't speed this up.                                     *
+******************************************************************************/
+
+// Offset words from the standard in OFFSETA to OFFSETE order
+static const uint16_t encfuzzRefOffsets[6] = {0x0fc, 0x198, 0x168, 0x350, 0x1b4, 0x000};
+
+// Remainder of info x^10 divided by g(x) = x^10+x^8+x^7+x^5+x^4+x^3+1
+static uint16_t encfuzzRefCheckword(uint16_t info, uint8_t offset) {
+    uint32_t remainder;
+    int bit;
+
+    remainder = (((uint32_t) info) << 10);
+    for (bit = 25; bit >= 10; bit--) {
+        if (remainder & (((uint32_t) 1) << bit)) {
+            remainder ^= (((uint32_t) 0x5b9) << (bit-10));
+        } else {}
+    }
+    return ((uint16_t) ((remainder ^ encfuzzRefOffsets[offset]) & 0x3ff));
+}
+
+// 26 bit block MSB first at the top of 32 bits, as rbds_t holds it
+static uint32_t encfuzzRefBlock(uint16_t info, uint8_t offset) {
+    return ((((uint32_t) info) << 16) | (((uint32_t) encfuzzRefCheckword(info, offset)) << 6));
+}
+
+static uint16_t encfuzzRef2AB(uint8_t tp, uint8_t pty, uint8_t textab, uint8_t segment) {
+    return ((uint16_t) ((2 << 12) | (0 << 11) | (tp << 10) | (pty << 5) | (textab << 4) | segment));
+}
+
+static uint16_t encfuzzRef0AB(uint8_t segment) {
+    return ((uint16_t) ((0 << 12) | (0 << 11) | (TPFLAG << 10) | (PTYCODE << 5) | (0 << 4) | (MSFLAG << 3)
+        | (((DIFLAGS >> (3-segment)) & 0x01) << 2) | segment));
+}
+
+static void encfuzzReference(const encfuzzcase_t *c, encfuzzoutput_t *out) {
+    uint8_t text[ENCFUZZTEXT];
+    uint16_t length;
+    uint16_t bit;
+    uint8_t segment;
+    uint8_t offset;
+    uint8_t block;
+    uint8_t level;
+    uint32_t group[4];
+    int i;
+
+    memset(out, 0, sizeof(*out));
+    for (offset = OFFSETA; offset <= OFFSETE; offset++) {
+        out->blocks[ENCFUZZCRC+offset] = encfuzzRefCheckword(c->pi, offset);
+    }
+    out->blocks[ENCFUZZA] = encfuzzRefBlock(c->pi, OFFSETA);
+    out->blocks[ENCFUZZSTATICA] = encfuzzRefBlock(PICODE, OFFSETA);
+    out->blocks[ENCFUZZSTATIC2AB] = encfuzzRefBlock(encfuzzRef2AB(TPFLAG, PTYCODE, c->textab, c->segment), OFFSETB);
+    out->blocks[ENCFUZZSTATIC0A] = encfuzzRefBlock(encfuzzRef0AB(c->segment & 0x03), OFFSETB);
+    out->blocks[ENCFUZZSTATIC0A+1] = encfuzzRefBlock(PSNOAF, OFFSETC);
+
+    out->blocks[ENCFUZZ4A] = encfuzzRefBlock((uint16_t) ((4 << 12) | (0 << 11) | (c->tp << 10) | (c->pty << 5)
+        | ((c->time.mjd >> 15) & 0x03)), OFFSETB);
+    out->blocks[ENCFUZZ4A+1] = encfuzzRefBlock((uint16_t) (((c->time.mjd & 0x7fff) << 1) | (c->time.hour >> 4)), OFFSETC);
+    out->blocks[ENCFUZZ4A+2] = encfuzzRefBlock((uint16_t) (((c->time.hour & 0x0f) << 12) | (c->time.minute << 6)
+        | ((c->time.offset < 0) << 5) | abs(c->time.offset)), OFFSETD);
+
+    out->blocks[ENCFUZZURGENT] = encfuzzRefBlock(c->urgent[0], OFFSETB);
+    out->blocks[ENCFUZZURGENT+1] = encfuzzRefBlock(c->urgent[1], ((c->urgent[0] >> 11) & 0x01) ? OFFSETC2 : OFFSETC);
+    out->blocks[ENCFUZZURGENT+2] = encfuzzRefBlock(c->urgent[2], OFFSETD);
+
+    // PS pairs wrap round from the last char to the first
+    out->psLength = (uint8_t) (8 + (c->segment % (PSTEXTSIZE-7)));
+    for (i = 0; i < out->psLength; i++) {
+        out->blocks[ENCFUZZPS+i] = encfuzzRefBlock((uint16_t) ((c->text[i] << 8) | c->text[(i+1) % out->psLength]), OFFSETD);
+    }
+
+    // Text ends with CR unless it fills all 64, then spaces to a whole segment
+    for (length = 0; (length < ENCFUZZTEXT) && (c->text[length] != 0x00); length++) {
+        text[length] = c->text[length];
+    }
+    if (length < ENCFUZZTEXT) {
+        text[length] = '\r';
+        length++;
+    } else {}
+    while ((length % 4) != 0) {
+        text[length] = ' ';
+        length++;
+    }
+    out->segments = (uint8_t) (length / 4);
+
+    level = c->lastBit;
+    bit = 0;
+    for (segment = 0; segment < out->segments; segment++) {
+        group[0] = encfuzzRefBlock(c->pi, OFFSETA);
+        group[1] = encfuzzRefBlock(encfuzzRef2AB(c->tp, c->pty, c->textab, segment), OFFSETB);
+        group[2] = encfuzzRefBlock((uint16_t) ((text[segment*4] << 8) | text[(segment*4)+1]), OFFSETC);
+        group[3] = encfuzzRefBlock((uint16_t) ((text[(segment*4)+2] << 8) | text[(segment*4)+3]), OFFSETD);
+        out->blocks[ENCFUZZRT+(segment*3)] = group[1];
+        out->blocks[ENCFUZZRT+(segment*3)+1] = group[2];
+        out->blocks[ENCFUZZRT+(segment*3)+2] = group[3];
+        // Output toggles on each 1 bit
+        for (block = 0; block < 4; block++) {
+            for (i = 31; i > (31-ENCFUZZBLOCKBITS); i--) {
+                level ^= ((group[block] >> i) & 0x01);
+                encfuzzPutBit(out->bits, bit, level);
+                bit++;
+            }
+        }
+    }
+}
+
+/******************************************************************************
+* Firmware, as main.c and urgent.c call it                                    *
+******************************************************************************/
+
+static void encfuzzFirmware(const encfuzzcase_t *c, encfuzzoutput_t *out) {
+    uint8_t text[ENCFUZZTEXT+1];
+    rbds_t rtBlocks[MAXRTGROUPS*2];
+    rbds_t groupA;
+    rbds_t group[4];
+    rbds_t block;
+    rtc_t time;
+    urgent_t request;
+    uint16_t bit;
+    uint8_t segment;
+    uint8_t offset;
+    uint8_t lastBit;
+    uint8_t i;
+    uint8_t j;
+
+    memset(out, 0, sizeof(*out));
+    for (offset = OFFSETA; offset <= OFFSETE; offset++) {
+        block.hex = (((uint32_t) c->pi) << 16);
+        out->blocks[ENCFUZZCRC+offset] = crcChecksum(&block, offset);
+    }
+    rbdsGroupA(&groupA, c->pi);
+    out->blocks[ENCFUZZA] = groupA.hex;
+    rbdsStaticGroupA(&block);
+    out->blocks[ENCFUZZSTATICA] = block.hex;
+    rbdsStaticGroup2AB(&block, c->textab, c->segment);
+    out->blocks[ENCFUZZSTATIC2AB] = block.hex;
+    rbdsStaticGroup0A(group, (c->segment & 0x03));
+    out->blocks[ENCFUZZSTATIC0A] = group[0].hex;
+    out->blocks[ENCFUZZSTATIC0A+1] = group[1].hex;
+
+    time = c->time;
+    rbdsGroup4A(group, c->tp, c->pty, &time);
+    for (i = 0; i < 3; i++) {
+        out->blocks[ENCFUZZ4A+i] = group[i].hex;
+    }
+
+    memset(&request, 0, sizeof(request));
+    request.blockB = c->urgent[0];
+    request.blockC = c->urgent[1];
+    request.blockD = c->urgent[2];
+    (void) urgentAdd(&request);
+    (void) urgentNext(group);
+    for (i = 0; i < 3; i++) {
+        out->blocks[ENCFUZZURGENT+i] = group[i].hex;
+    }
+
+    memcpy(text, c->text, sizeof(text));
+    out->psLength = (uint8_t) (8 + (c->segment % (PSTEXTSIZE-7)));
+    rbdsEncodePs(text, rtBlocks, out->psLength);
+    for (i = 0; i < out->psLength; i++) {
+        out->blocks[ENCFUZZPS+i] = rtBlocks[i].hex;
+    }
+
+    out->segments = rbdsPadRadiotext(text);
+    rbdsEncodeRadiotext(text, rtBlocks, out->segments);
+
+    lastBit = c->lastBit;
+    bit = 0;
+    for (segment = 0; segment < out->segments; segment++) {
+        group[0] = groupA;
+        rbdsGroup2AB(&group[1], c->tp, c->pty, c->textab, segment);
+        group[2] = rtBlocks[segment*2];
+        group[3] = rtBlocks[(segment*2)+1];
+        out->blocks[ENCFUZZRT+(segment*3)] = group[1].hex;
+        out->blocks[ENCFUZZRT+(segment*3)+1] = group[2].hex;
+        out->blocks[ENCFUZZRT+(segment*3)+2] = group[3].hex;
+        for (i = 0; i < 4; i++) {
+            block = group[i];
+            for (j = 0; j < ENCFUZZBLOCKBITS; j++) {
+                lastBit = rbdsDiffEncode(&block, lastBit);
+                encfuzzPutBit(out->bits, bit, lastBit);
+                bit++;
+            }
+        }
+    }
+}
+
+/******************************************************************************
+* Comparison                                                                  *
+******************************************************************************/
+
+static void encfuzzBlockName(int index, char *name) {
+    static const char *offsets[6] = {"A", "B", "C", "C'", "D", "E"};
+    static const char *blocks[3] = {"B", "C", "D"};
+
+    if (index < ENCFUZZA) {
+        sprintf(name, "crcChecksum offset %s", offsets[index-ENCFUZZCRC]);
+    } else if (index == ENCFUZZA) {
+        sprintf(name, "rbdsGroupA");
+    } else if (index == ENCFUZZSTATICA) {
+        sprintf(name, "rbdsStaticGroupA");
+    } else if (index == ENCFUZZSTATIC2AB) {
+        sprintf(name, "rbdsStaticGroup2AB");
+    } else if (index < ENCFUZZ4A) {
+        sprintf(name, "rbdsStaticGroup0A block %s", blocks[index-ENCFUZZSTATIC0A]);
+    } else if (index < ENCFUZZURGENT) {
+        sprintf(name, "rbdsGroup4A block %s", blocks[index-ENCFUZZ4A]);
+    } else if (index < ENCFUZZPS) {
+        sprintf(name, "urgent group block %s", blocks[index-ENCFUZZURGENT]);
+    } else if (index < ENCFUZZRT) {
+        sprintf(name, "rbdsEncodePs pair %d", index-ENCFUZZPS);
+    } else {
+        sprintf(name, "radiotext segment %d block %s", (index-ENCFUZZRT)/3, blocks[(index-ENCFUZZRT)%3]);
+    }
+}
+
+// Prints the first difference, returns FALSE if there is one
+static int encfuzzCompare(const encfuzzoutput_t *reference, const encfuzzoutput_t *firmware) {
+    char name[64];
+    int i;
+
+    if (reference->segments != firmware->segments) {
+        printf("rbdsPadRadiotext: %u segments, reference %u\n", firmware->segments, reference->segments);
+        return (FALSE);
+    } else {}
+    for (i = 0; i < ENCFUZZBLOCKS; i++) {
+        if (reference->blocks[i] != firmware->blocks[i]) {
+            encfuzzBlockName(i, name);
+            printf("%s: %08x, reference %08x\n", name, firmware->blocks[i], reference->blocks[i]);
+            return (FALSE);
+        } else {}
+    }
+    for (i = 0; i < (reference->segments*ENCFUZZGROUPBITS); i++) {
+        if (((reference->bits[i >> 3] ^ firmware->bits[i >> 3]) << (i & 0x07)) & 0x80) {
+            printf("rbdsDiffEncode: group %d bit %d differs\n", i/ENCFUZZGROUPBITS, i%ENCFUZZGROUPBITS);
+            return (FALSE);
+        } else {}
+    }
+    return (TRUE);
+}
+
+static void encfuzzFail(const uint8_t *data, size_t size) {
+    FILE *file;
+    size_t i;
+
+    printf("input");
+    for (i = 0; i < size; i++) {
+        printf(" %02x", data[i]);
+    }
+    printf("\n");
+    file = fopen("encfuzz-fail.bin", "wb");
+    if ((file == NULL) || (fwrite(data, 1, size, file) != size)) {
+        perror("encfuzz-fail.bin");
+    } else {}
+    if (file != NULL) {
+        fclose(file);
+    } else {}
+    fflush(stdout);
+}
+
+int LLVMFuzzerTestOneInput(const uint8_t *data, size_t size) {
+    encfuzzcase_t c;
+    encfuzzoutput_t reference;
+    encfuzzoutput_t firmware;
+
+    encfuzzDecode(data, size, &c);
+    encfuzzReference(&c, &reference);
+    encfuzzFirmware(&c, &firmware);
+    if (!encfuzzCompare(&reference, &firmware)) {
+        encfuzzFail(data, size);
+        abort();
+    } else {}
+    return (0);
+}
+
+#ifndef ENCFUZZLIBFUZZER
+static int encfuzzFile(const char *path) {
+    uint8_t data[ENCFUZZINPUT];
+    FILE *file;
+    size_t size;
+
+    file = fopen(path, "rb");
+    if (file == NULL) {
+        perror(path);
+        return (FALSE);
+    } else {}
+    size = fread(data, 1, sizeof(data), file);
+    fclose(file);
+    (void) LLVMFuzzerTestOneInput(data, size);
+    printf("%s: pass\n", path);
+    return (TRUE);
+}
+
+int main(int argc, char **argv) {
+    static uint8_t data[ENCFUZZBATCH][ENCFUZZINPUT];
+    static size_t sizes[ENCFUZZBATCH];
+    static encfuzzcase_t cases[ENCFUZZBATCH];
+    static encfuzzoutput_t reference[ENCFUZZBATCH];
+    static encfuzzoutput_t firmware[ENCFUZZBATCH];
+    uint64_t state;
+    uint64_t done = 0;
+    uint64_t groups = 0;
+    double referenceSeconds = 0;
+    double firmwareSeconds = 0;
+    double start;
+    size_t batch;
+    size_t i;
+    size_t j;
+    int option;
+
+    while ((option = getopt(argc, argv, "n:S:")) != -1) {
+        switch (option) {
+            case 'n': encfuzzInputs = strtoull(optarg, NULL, 0); break;
+            case 'S': encfuzzSeed = strtoull(optarg, NULL, 0); break;
+            default: encfuzzUsage();
+        }
+    }
+    if (optind < argc) {
+        for (; optind < argc; optind++) {
+            if (!encfuzzFile(argv[optind])) {
+                return (1);
+            } else {}
+        }
+        return (0);
+    } else {}
+
+    // Text is mostly printable as typed, with any byte now and then
+    state = encfuzzSeed;
+    while (done < encfuzzInputs) {
+        batch = (((encfuzzInputs - done) < ENCFUZZBATCH) ? (size_t) (encfuzzInputs - done) : ENCFUZZBATCH);
+        for (i = 0; i < batch; i++) {
+            sizes[i] = ENCFUZZHEADER + (size_t) (encfuzzRandom(&state) % (ENCFUZZTEXT+1));
+            for (j = 0; j < sizes[i]; j++) {
+                data[i][j] = (uint8_t) encfuzzRandom(&state);
+                if ((j >= ENCFUZZHEADER) && ((data[i][j] & 0x07) != 0)) {
+                    data[i][j] = (uint8_t) (' ' + (data[i][j] % 95));
+                } else {}
+            }
+            encfuzzDecode(data[i], sizes[i], &cases[i]);
+        }
+
+        start = encfuzzSeconds();
+        for (i = 0; i < batch; i++) {
+            encfuzzFirmware(&cases[i], &firmware[i]);
+        }
+        firmwareSeconds += (encfuzzSeconds() - start);
+        start = encfuzzSeconds();
+        for (i = 0; i < batch; i++) {
+            encfuzzReference(&cases[i], &reference[i]);
+        }
+        referenceSeconds += (encfuzzSeconds() - start);
+
+        for (i = 0; i < batch; i++) {
+            if (!encfuzzCompare(&reference[i], &firmware[i])) {
+                printf("input %llu of seed %llu differs\n", (unsigned long long) (done + i),
+                    (unsigned long long) encfuzzSeed);
+                encfuzzFail(data[i], sizes[i]);
+                return (1);
+            } else {}
+            groups += (firmware[i].segments + 2);
+        }
+        done += batch;
+    }
+
+    printf("%llu inputs, %llu groups: firmware %.0f groups/s, reference %.0f groups/s: pass\n",
+        (unsigned long long) done, (unsigned long long) groups, groups / firmwareSeconds, groups / referenceSeconds);
+    return (0);
+}
+#endif
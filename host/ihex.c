@@ -0,0 +1,85 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "ihex.h"
+
+long ihexRead(const char *path, uint8_t *image, uint32_t size);
+static int ihexByte(const char *text);
+
+static int ihexByte(const char *text) {
+    char digits[3] = {text[0], text[1], 0};
+    char *end;
+    long value;
+
+    value = strtol(digits, &end, 16);
+    return ((*end == 0) && (digits[1] != 0) ? (int) value : -1);
+}
+
+long ihexRead(const char *path, uint8_t *image, uint32_t size) {
+    FILE *file;
+    char line[600];
+    uint8_t record[255+5]; // Count, address, type, up to 255 data bytes & checksum
+    uint32_t base = 0;
+    uint32_t address;
+    long top = 0;
+    int length;
+    int number = 0;
+    int value;
+    int i;
+    uint8_t sum;
+
+    file = fopen(path, "r");
+    if (file == NULL) {
+        perror(path);
+        return (-1);
+    } else {}
+    while (fgets(line, sizeof(line), file) != NULL) {
+        number++;
+        line[strcspn(line, "\r\n")] = 0;
+        if (line[0] == 0) {
+            continue;
+        } else {}
+        length = ((line[0] == ':') && (strlen(line) >= 11)) ? ihexByte(&line[1]) : -1;
+        if ((length < 0) || (strlen(line) != (size_t) (11 + (length*2)))) {
+            fprintf(stderr, "%s:%d: not an intel hex record\n", path, number);
+            fclose(file);
+            return (-1);
+        } else {}
+        // Count, address, type, data & checksum, which sum to 0
+        sum = 0;
+        for (i = 0; i < (length+5); i++) {
+            value = ihexByte(&line[1+(i*2)]);
+            if (value < 0) {
+                break;
+            } else {}
+            record[i] = (uint8_t) value;
+            sum += record[i];
+        }
+        if ((i != (length+5)) || (sum != 0)) {
+            fprintf(stderr, "%s:%d: bad record checksum\n", path, number);
+            fclose(file);
+            return (-1);
+        } else {}
+
+        if (record[3] == 0x00) {
+            address = base + ((record[1]<<8) | record[2]);
+            if ((address + length) > size) {
+                fprintf(stderr, "%s:%d: data at 0x%x is past the end of the %u byte image\n", path, number, address, size);
+                fclose(file);
+                return (-1);
+            } else {}
+            memcpy(&image[address], &record[4], length);
+            if ((long) (address + length) > top) {
+                top = address + length;
+            } else {}
+        } else if (record[3] == 0x01) {
+            break;
+        } else if (record[3] == 0x02) {
+            base = ((record[4]<<8) | record[5]) << 4;
+        } else if (record[3] == 0x04) {
+            base = ((uint32_t) ((record[4]<<8) | record[5])) << 16;
+        } else {}
+    }
+    fclose(file);
+    return (top);
+}
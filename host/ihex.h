@@ -0,0 +1,14 @@
+/******************************************************************************
+* Intel Hex Module                                                            *
+*                                                                             *
+* (long) ihexRead(const char*, uint8_t*, uint32_t)                            *
+*                                      Function loads an avr-objcopy hex file *
+*                                      into an image, returns one past the    *
+*                                      highest address written or -1 after    *
+*                                      printing why the file was refused.     *
+*                                                                             *
+******************************************************************************/
+
+#include <stdint.h>
+
+extern long ihexRead(const char *path, uint8_t *image, uint32_t size);
@@ -0,0 +1,612 @@
+/*******************************************************************************
+* MPX Renderer                                                                 *
+*                                                                              *
+* Renders the FM multiplex baseband the transmitter puts on air: 19khz pilot,  *
+* RBDS on the 57khz subcarrier and optional mono audio. Groups are built by    *
+* the firmware's own rbds.c and crc.c so the bitstream is the one on air.      *
+*                                                                              *
+* Every rate is derived from one integer pilot phase accumulator, as on the    *
+* transmitter where the sample clock, pilot and subcarrier share a crystal:    *
+* the subcarrier is 3x the pilot and a symbol is 16 pilot cycles, each sent    *
+* as one sine cycle whose polarity is the differentially encoded bit.          *
+*                                                                              *
+* Output is written in chunks so renders of any length run in fixed memory.    *
+* Stations are rendered in parallel, one worker thread per job at a time.      *
+*                                                                              *
+* mpxrender [options] -o file -i pi [-t pty] [-T] radiotext                    *
+* mpxrender [options] -j jobfile                                               *
+*                                                                              *
+* Jobfile lines are "file pi pty radiotext...", # starts a comment.            *
+*                                                                              *
+*******************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <math.h>
+#include <time.h>
+#include <unistd.h>
+#include <pthread.h>
+
+#pragma pack(push, 1)
+#include "includes.h"
+#pragma pack(pop)
+
+#define MPXCHUNK 16384
+#define MPXPILOT ((uint64_t) 19000)
+#define MPXPILOTSPERSYMBOL ((uint64_t) 16)
+#define MPXMINRATE ((uint32_t) 228000)
+#define MPXMAXTEXT 64
+
+typedef float mpxVec_t __attribute__ ((vector_size (32)));
+typedef int32_t mpxVecI_t __attribute__ ((vector_size (32)));
+#define MPXLANES (sizeof(mpxVec_t)/sizeof(float))
+
+typedef enum {MPX_S16, MPX_F32, MPX_IQ} mpxFormat_t;
+
+typedef struct {
+    char output[256];
+    uint16_t picode;
+    uint8_t pty;
+    uint8_t tp;
+    char radiotext[MPXMAXTEXT+1];
+} mpxJob_t;
+
+typedef struct {
+    uint32_t rate;
+    double seconds;
+    mpxFormat_t format;
+    float pilotLevel;
+    float rdsLevel;
+    float audioLevel;
+    uint32_t toneFrequency;
+    const char *audioFile;
+    float deviation;
+} mpxOptions_t;
+
+// Bitstream state, stepped one symbol at a time
+typedef struct {
+    rbds_t groups[MAXRTGROUPS][4];
+    uint8_t groupCount;
+    uint8_t group;
+    uint8_t block;
+    uint8_t bitsLeft;
+    rbds_t shift;
+    uint8_t lastBit;
+} mpxBits_t;
+
+static mpxOptions_t mpxOptions = {MPXMINRATE, 10.0, MPX_S16, 0.09f, 0.04f, 0.0f, 0, NULL, 75000.0f};
+static mpxJob_t *mpxJobs;
+static int mpxJobCount;
+static int mpxNextJob;
+static pthread_mutex_t mpxReportLock = PTHREAD_MUTEX_INITIALIZER;
+
+static void mpxUsage(void) {
+    fprintf(stderr,
+        "usage: mpxrender [options] -o file -i pi [-t pty] [-T] radiotext\n"
+        "       mpxrender [options] -j jobfile\n"
+        "  -r rate     output sample rate, at least %u (default %u)\n"
+        "  -d seconds  length to render (default 10)\n"
+        "  -f format   s16 or f32 wav, or iq for raw FM modulated cf32 (default s16)\n"
+        "  -p level    pilot level (default 0.09)\n"
+        "  -l level    rds level (default 0.04)\n"
+        "  -a hz       add an audio tone\n"
+        "  -A file     add mono 16 bit wav audio at the output rate\n"
+        "  -L level    audio level (default 0.8 when audio is added)\n"
+        "  -D hz       FM deviation for iq output (default 75000)\n"
+        "  -n threads  worker threads (default one per cpu)\n",
+        MPXMINRATE, MPXMINRATE);
+    exit(1);
+}
+
+/******************************************************************************
+* Bitstream                                                                   *
+******************************************************************************/
+
+static void mpxBitsInit(mpxBits_t *bits, mpxJob_t *job) {
+    uint8_t text[MPXMAXTEXT+1];
+    rbds_t blocks[MAXRTGROUPS*2];
+    rbds_t groupA;
+    uint8_t segment;
+
+    memcpy(text, job->radiotext, sizeof(text));
+    bits->groupCount = rbdsPadRadiotext(text);
+    rbdsEncodeRadiotext(text, blocks, bits->groupCount);
+    rbdsGroupA(&groupA, job->picode);
+    for (segment = 0; segment < bits->groupCount; segment++) {
+        bits->groups[segment][0] = groupA;
+        rbdsGroup2AB(&bits->groups[segment][1], job->tp, job->pty, A, segment);
+        bits->groups[segment][2] = blocks[segment*2];
+        bits->groups[segment][3] = blocks[(segment*2)+1];
+    }
+    bits->group = 0;
+    bits->block = 0;
+    bits->shift = bits->groups[0][0];
+    bits->bitsLeft = 26;
+    bits->lastBit = 0;
+}
+
+static float mpxBitsNext(mpxBits_t *bits) {
+    if (bits->bitsLeft == 0) {
+        bits->block++;
+        if (bits->block >= 4) {
+            bits->block = 0;
+            bits->group++;
+            if (bits->group >= bits->groupCount) {
+                bits->group = 0;
+            } else {}
+        } else {}
+        bits->shift = bits->groups[bits->group][bits->block];
+        bits->bitsLeft = 26;
+    } else {}
+    bits->bitsLeft--;
+    bits->lastBit = rbdsDiffEncode(&bits->shift, bits->lastBit);
+    return (bits->lastBit ? 1.0f : -1.0f);
+}
+
+/******************************************************************************
+* Vector sine                                                                 *
+******************************************************************************/
+
+// sin(2*pi*x) for x >= 0 in cycles, error below 4e-6
+static inline mpxVec_t mpxSin(mpxVec_t x) {
+    const mpxVec_t half = {0.5f, 0.5f, 0.5f, 0.5f, 0.5f, 0.5f, 0.5f, 0.5f};
+    const mpxVecI_t sign = {INT32_MIN, INT32_MIN, INT32_MIN, INT32_MIN, INT32_MIN, INT32_MIN, INT32_MIN, INT32_MIN};
+    mpxVecI_t whole;
+    mpxVecI_t negative;
+    mpxVecI_t fold;
+    mpxVec_t a;
+    mpxVec_t b;
+    mpxVec_t x2;
+    mpxVec_t p;
+
+    // Fraction of a cycle, second half is the first half negated
+    whole = __builtin_convertvector(x, mpxVecI_t);
+    x = x - __builtin_convertvector(whole, mpxVec_t);
+    negative = (x >= half);
+    a = x - (mpxVec_t) ((mpxVecI_t) half & negative);
+    // Quarter wave symmetry
+    b = half - a;
+    fold = (b < a);
+    a = (mpxVec_t) (((mpxVecI_t) b & fold) | ((mpxVecI_t) a & ~fold));
+    a = a * (float) (2*M_PI);
+    x2 = a * a;
+    p = (x2 * (1.0f/362880.0f)) - (1.0f/5040.0f);
+    p = (p * x2) + (1.0f/120.0f);
+    p = (p * x2) - (1.0f/6.0f);
+    p = (p * x2) + 1.0f;
+    p = p * a;
+    return ((mpxVec_t) ((mpxVecI_t) p ^ (sign & negative)));
+}
+
+/******************************************************************************
+* Output                                                                      *
+******************************************************************************/
+
+static void mpxPut16(uint8_t *buffer, uint16_t value) {
+    buffer[0] = (uint8_t) value;
+    buffer[1] = (uint8_t) (value>>8);
+}
+
+static void mpxPut32(uint8_t *buffer, uint32_t value) {
+    mpxPut16(buffer, (uint16_t) value);
+    mpxPut16(&buffer[2], (uint16_t) (value>>16));
+}
+
+static void mpxWavHeader(FILE *file, uint32_t rate, uint64_t dataBytes) {
+    uint8_t header[44];
+    uint16_t bytesPerSample;
+    uint32_t riffBytes;
+    uint32_t chunkBytes;
+
+    if (mpxOptions.format == MPX_S16) {
+        bytesPerSample = 2;
+    } else {
+        bytesPerSample = 4;
+    }
+    // Sizes that don't fit are left at the maximum, readers take that as streaming
+    chunkBytes = (dataBytes > (UINT32_MAX - 36)) ? UINT32_MAX : (uint32_t) dataBytes;
+    riffBytes = (dataBytes > (UINT32_MAX - 36)) ? UINT32_MAX : (uint32_t) (dataBytes + 36);
+    memcpy(header, "RIFF", 4);
+    mpxPut32(&header[4], riffBytes);
+    memcpy(&header[8], "WAVEfmt ", 8);
+    mpxPut32(&header[16], 16);
+    mpxPut16(&header[20], (mpxOptions.format == MPX_S16) ? 1 : 3);
+    mpxPut16(&header[22], 1);
+    mpxPut32(&header[24], rate);
+    mpxPut32(&header[28], rate*bytesPerSample);
+    mpxPut16(&header[32], bytesPerSample);
+    mpxPut16(&header[34], bytesPerSample*8);
+    memcpy(&header[36], "data", 4);
+    mpxPut32(&header[40], chunkBytes);
+    fwrite(header, sizeof(header), 1, file);
+}
+
+// Skips to the data chunk of a mono 16 bit wav, returns 0 if it isn't one
+static int mpxAudioOpen(FILE *file, uint32_t rate) {
+    uint8_t chunk[8];
+    uint8_t format[16];
+    uint32_t size;
+    int formatOk = 0;
+
+    if ((fread(chunk, 4, 1, file) != 1) || (memcmp(chunk, "RIFF", 4) != 0)) {
+        return (0);
+    } else {}
+    if ((fread(chunk, 8, 1, file) != 1) || (memcmp(&chunk[4], "WAVE", 4) != 0)) {
+        return (0);
+    } else {}
+    while (fread(chunk, 8, 1, file) == 1) {
+        size = chunk[4] | (chunk[5]<<8) | (chunk[6]<<16) | ((uint32_t) chunk[7]<<24);
+        if (memcmp(chunk, "data", 4) == 0) {
+            return (formatOk);
+        } else if ((memcmp(chunk, "fmt ", 4) == 0) && (size >= 16)) {
+            if (fread(format, 16, 1, file) != 1) {
+                return (0);
+            } else {}
+            formatOk = (format[0] == 1) && (format[2] == 1)
+                && ((format[4] | (format[5]<<8) | (format[6]<<16) | ((uint32_t) format[7]<<24)) == rate)
+                && (format[14] == 16);
+            size -= 16;
+        } else {}
+        if (fseek(file, (long) (size + (size & 1)), SEEK_CUR) != 0) {
+            return (0);
+        } else {}
+    }
+    return (0);
+}
+
+
+/******************************************************************************
+* Rendering                                                                   *
+******************************************************************************/
+
+// Per worker chunk buffers, aligned for vector access
+typedef struct {
+    float *phase;    // Position in symbol, 0 to 1
+    float *polarity; // Differentially encoded symbol, +-1
+    float *tone;     // Audio tone phase in cycles
+    float *audio;
+    float *mpx;
+    float *out;      // Interleaved I/Q for iq output
+} mpxBuffers_t;
+
+static void mpxMix(mpxBuffers_t *buffers) {
+    mpxVec_t *phase = (mpxVec_t *) buffers->phase;
+    mpxVec_t *polarity = (mpxVec_t *) buffers->polarity;
+    mpxVec_t *tone = (mpxVec_t *) buffers->tone;
+    mpxVec_t *audio = (mpxVec_t *) buffers->audio;
+    mpxVec_t *mpx = (mpxVec_t *) buffers->mpx;
+    mpxVec_t sample;
+    uint32_t i;
+
+    for (i = 0; i < (MPXCHUNK/MPXLANES); i++) {
+        // Pilot is 16 cycles per symbol, subcarrier 48
+        sample = mpxOptions.pilotLevel * mpxSin(phase[i] * 16.0f);
+        sample += (mpxOptions.rdsLevel * polarity[i]) * mpxSin(phase[i]) * mpxSin(phase[i] * 48.0f);
+        if (mpxOptions.toneFrequency != 0) {
+            audio[i] += mpxSin(tone[i]);
+        } else {}
+        mpx[i] = sample + (mpxOptions.audioLevel * audio[i]);
+    }
+}
+
+// Writes count samples of the chunk, returns bytes written. Reuses the phase,
+// polarity and audio buffers for iq output.
+static uint64_t mpxWrite(FILE *output, mpxBuffers_t *buffers, uint32_t count, double *fmPhase, double fmStep) {
+    uint8_t pcm[MPXCHUNK*2];
+    mpxVec_t *carrier = (mpxVec_t *) buffers->phase;
+    mpxVec_t *in = (mpxVec_t *) buffers->audio;
+    mpxVec_t *quadrature = (mpxVec_t *) buffers->polarity;
+    float sample;
+    uint32_t i;
+
+    if (mpxOptions.format == MPX_S16) {
+        for (i = 0; i < count; i++) {
+            sample = buffers->mpx[i] * 32767.0f;
+            sample = (sample > 32767.0f) ? 32767.0f : ((sample < -32768.0f) ? -32768.0f : sample);
+            mpxPut16(&pcm[i*2], (uint16_t) (int16_t) lrintf(sample));
+        }
+        return (fwrite(pcm, 2, count, output) * 2);
+    } else if (mpxOptions.format == MPX_F32) {
+        // Hosts are little endian like wav
+        return (fwrite(buffers->mpx, sizeof(float), count, output) * sizeof(float));
+    } else {
+        // Carrier phase is a running sum so it stays scalar, in cycles and in
+        // double so hours of output don't drift. Deviation is under a cycle per sample.
+        for (i = 0; i < MPXCHUNK; i++) {
+            buffers->phase[i] = (float) *fmPhase;
+            *fmPhase += fmStep * buffers->mpx[i];
+            if (*fmPhase >= 1.0) {
+                *fmPhase -= 1.0;
+            } else if (*fmPhase < 0.0) {
+                *fmPhase += 1.0;
+            } else {}
+        }
+        for (i = 0; i < (MPXCHUNK/MPXLANES); i++) {
+            in[i] = mpxSin(carrier[i] + 0.25f);
+            quadrature[i] = mpxSin(carrier[i]);
+        }
+        for (i = 0; i < count; i++) {
+            buffers->out[i*2] = buffers->audio[i];
+            buffers->out[(i*2)+1] = buffers->polarity[i];
+        }
+        return (fwrite(buffers->out, sizeof(float)*2, count, output) * sizeof(float)*2);
+    }
+}
+
+static int mpxRender(mpxJob_t *job, mpxBuffers_t *buffers) {
+    mpxBits_t bits;
+    FILE *output;
+    FILE *audio = NULL;
+    uint8_t pcm[MPXCHUNK*2];
+    uint64_t totalSamples;
+    uint64_t done;
+    uint64_t symbolPhase = 0;  // In 1/rate pilot cycles
+    uint64_t symbolPeriod;
+    uint64_t tonePhase = 0;    // In 1/rate cycles
+    uint64_t dataBytes = 0;
+    double fmPhase = 0.0;
+    float polarity;
+    float symbolScale;
+    float toneScale;
+    uint32_t count;
+    uint32_t i;
+    size_t got;
+
+    output = fopen(job->output, "wb");
+    if (output == NULL) {
+        perror(job->output);
+        return (FALSE);
+    } else {}
+    if (mpxOptions.audioFile != NULL) {
+        audio = fopen(mpxOptions.audioFile, "rb");
+        if ((audio == NULL) || !mpxAudioOpen(audio, mpxOptions.rate)) {
+            fprintf(stderr, "%s: not a mono 16 bit wav at %u hz\n", mpxOptions.audioFile, mpxOptions.rate);
+            if (audio != NULL) {
+                fclose(audio);
+            } else {}
+            fclose(output);
+            return (FALSE);
+        } else {}
+    } else {}
+
+    // Header is patched with the real size at the end
+    if (mpxOptions.format != MPX_IQ) {
+        mpxWavHeader(output, mpxOptions.rate, 0);
+    } else {}
+
+    mpxBitsInit(&bits, job);
+    totalSamples = (uint64_t) llround(mpxOptions.seconds * mpxOptions.rate);
+    symbolPeriod = MPXPILOTSPERSYMBOL * mpxOptions.rate;
+    symbolScale = 1.0f / (float) symbolPeriod;
+    toneScale = 1.0f / (float) mpxOptions.rate;
+    polarity = mpxBitsNext(&bits);
+
+    for (done = 0; done < totalSamples; done += count) {
+        count = ((totalSamples - done) < MPXCHUNK) ? (uint32_t) (totalSamples - done) : MPXCHUNK;
+
+        // Exact integer phases, the symbol clock steps here. The last chunk
+        // is rendered whole and cut short when written.
+        for (i = 0; i < MPXCHUNK; i++) {
+            buffers->phase[i] = (float) symbolPhase * symbolScale;
+            buffers->polarity[i] = polarity;
+            buffers->tone[i] = (float) tonePhase * toneScale;
+            symbolPhase += MPXPILOT;
+            if (symbolPhase >= symbolPeriod) {
+                symbolPhase -= symbolPeriod;
+                polarity = mpxBitsNext(&bits);
+            } else {}
+            tonePhase += mpxOptions.toneFrequency;
+            if (tonePhase >= mpxOptions.rate) {
+                tonePhase -= mpxOptions.rate;
+            } else {}
+        }
+
+        // Audio runs out to silence
+        memset(buffers->audio, 0, MPXCHUNK*sizeof(float));
+        if (audio != NULL) {
+            got = fread(pcm, 2, count, audio);
+            for (i = 0; i < got; i++) {
+                buffers->audio[i] = (float) (int16_t) (pcm[i*2] | (pcm[(i*2)+1]<<8)) * (1.0f/32768.0f);
+            }
+        } else {}
+
+        mpxMix(buffers);
+        dataBytes += mpxWrite(output, buffers, count, &fmPhase, (double) mpxOptions.deviation / mpxOptions.rate);
+    }
+
+    if ((mpxOptions.format != MPX_IQ) && (fseek(output, 0, SEEK_SET) == 0)) {
+        mpxWavHeader(output, mpxOptions.rate, dataBytes);
+    } else {}
+    if (audio != NULL) {
+        fclose(audio);
+    } else {}
+    if ((fclose(output) != 0) || (dataBytes == 0 && totalSamples != 0)) {
+        fprintf(stderr, "%s: write failed\n", job->output);
+        return (FALSE);
+    } else {}
+    return (TRUE);
+}
+
+/******************************************************************************
+* Jobs                                                                        *
+******************************************************************************/
+
+static void *mpxWorker(void *argument) {
+    mpxBuffers_t buffers;
+    struct timespec start;
+    struct timespec end;
+    double elapsed;
+    int job;
+    int *failed = (int *) argument;
+
+    buffers.phase = aligned_alloc(sizeof(mpxVec_t), MPXCHUNK*sizeof(float));
+    buffers.polarity = aligned_alloc(sizeof(mpxVec_t), MPXCHUNK*sizeof(float));
+    buffers.tone = aligned_alloc(sizeof(mpxVec_t), MPXCHUNK*sizeof(float));
+    buffers.audio = aligned_alloc(sizeof(mpxVec_t), MPXCHUNK*sizeof(float));
+    buffers.mpx = aligned_alloc(sizeof(mpxVec_t), MPXCHUNK*sizeof(float));
+    buffers.out = aligned_alloc(sizeof(mpxVec_t), MPXCHUNK*2*sizeof(float));
+    if (!buffers.phase || !buffers.polarity || !buffers.tone || !buffers.audio || !buffers.mpx || !buffers.out) {
+        fprintf(stderr, "out of memory\n");
+        exit(1);
+    } else {}
+
+    for (job = __atomic_fetch_add(&mpxNextJob, 1, __ATOMIC_RELAXED); job < mpxJobCount;
+            job = __atomic_fetch_add(&mpxNextJob, 1, __ATOMIC_RELAXED)) {
+        clock_gettime(CLOCK_MONOTONIC, &start);
+        if (mpxRender(&mpxJobs[job], &buffers)) {
+            clock_gettime(CLOCK_MONOTONIC, &end);
+            elapsed = (double) (end.tv_sec - start.tv_sec) + ((end.tv_nsec - start.tv_nsec) / 1e9);
+            pthread_mutex_lock(&mpxReportLock);
+            printf("%s: %.1f s in %.2f s, %.1f Msps\n", mpxJobs[job].output, mpxOptions.seconds, elapsed,
+                (mpxOptions.seconds * mpxOptions.rate) / (elapsed * 1e6));
+            pthread_mutex_unlock(&mpxReportLock);
+        } else {
+            __atomic_store_n(failed, 1, __ATOMIC_RELAXED);
+        }
+    }
+
+    free(buffers.phase);
+    free(buffers.polarity);
+    free(buffers.tone);
+    free(buffers.audio);
+    free(buffers.mpx);
+    free(buffers.out);
+    return (NULL);
+}
+
+static int mpxParseJob(mpxJob_t *job, const char *line) {
+    unsigned int picode;
+    unsigned int pty;
+    int text;
+    size_t length;
+
+    memset(job, 0, sizeof(mpxJob_t));
+    if (sscanf(line, "%255s %x %u %n", job->output, &picode, &pty, &text) < 3) {
+        return (FALSE);
+    } else {}
+    if ((picode == 0) || (picode > 0xffff) || (pty > 31)) {
+        return (FALSE);
+    } else {}
+    job->picode = (uint16_t) picode;
+    job->pty = (uint8_t) pty;
+    strncpy(job->radiotext, &line[text], MPXMAXTEXT);
+    length = strlen(job->radiotext);
+    while ((length > 0) && ((job->radiotext[length-1] == '\n') || (job->radiotext[length-1] == '\r'))) {
+        length--;
+        job->radiotext[length] = 0;
+    }
+    return (TRUE);
+}
+
+static void mpxLoadJobs(const char *path) {
+    FILE *file;
+    char line[512];
+    int number = 0;
+    int size = 16;
+
+    file = fopen(path, "r");
+    if (file == NULL) {
+        perror(path);
+        exit(1);
+    } else {}
+    mpxJobs = malloc(size*sizeof(mpxJob_t));
+    while (fgets(line, sizeof(line), file) != NULL) {
+        number++;
+        if ((line[strspn(line, " \t\r\n")] == 0) || (line[strspn(line, " \t")] == '#')) {
+            continue;
+        } else {}
+        if (mpxJobCount == size) {
+            size *= 2;
+            mpxJobs = realloc(mpxJobs, size*sizeof(mpxJob_t));
+        } else {}
+        if ((mpxJobs == NULL) || !mpxParseJob(&mpxJobs[mpxJobCount], line)) {
+            fprintf(stderr, "%s:%d: expected \"file pi pty radiotext\"\n", path, number);
+            exit(1);
+        } else {}
+        mpxJobCount++;
+    }
+    fclose(file);
+}
+
+int main(int argc, char **argv) {
+    mpxJob_t single;
+    pthread_t *threads;
+    const char *jobFile = NULL;
+    const char *format = "s16";
+    long threadCount;
+    int audioLevelSet = FALSE;
+    int picodeSet = FALSE;
+    int failed = 0;
+    int option;
+    int i;
+
+    memset(&single, 0, sizeof(single));
+    threadCount = sysconf(_SC_NPROCESSORS_ONLN);
+    while ((option = getopt(argc, argv, "r:d:f:p:l:a:A:L:D:n:j:o:i:t:T")) != -1) {
+        switch (option) {
+            case 'r': mpxOptions.rate = (uint32_t) strtoul(optarg, NULL, 0); break;
+            case 'd': mpxOptions.seconds = strtod(optarg, NULL); break;
+            case 'f': format = optarg; break;
+            case 'p': mpxOptions.pilotLevel = strtof(optarg, NULL); break;
+            case 'l': mpxOptions.rdsLevel = strtof(optarg, NULL); break;
+            case 'a': mpxOptions.toneFrequency = (uint32_t) strtoul(optarg, NULL, 0); break;
+            case 'A': mpxOptions.audioFile = optarg; break;
+            case 'L': mpxOptions.audioLevel = strtof(optarg, NULL); audioLevelSet = TRUE; break;
+            case 'D': mpxOptions.deviation = strtof(optarg, NULL); break;
+            case 'n': threadCount = strtol(optarg, NULL, 0); break;
+            case 'j': jobFile = optarg; break;
+            case 'o': strncpy(single.output, optarg, sizeof(single.output)-1); break;
+            case 'i': single.picode = (uint16_t) strtoul(optarg, NULL, 16); picodeSet = TRUE; break;
+            case 't': single.pty = (uint8_t) strtoul(optarg, NULL, 0); break;
+            case 'T': single.tp = 1; break;
+            default: mpxUsage();
+        }
+    }
+
+    if (strcmp(format, "s16") == 0) {
+        mpxOptions.format = MPX_S16;
+    } else if (strcmp(format, "f32") == 0) {
+        mpxOptions.format = MPX_F32;
+    } else if (strcmp(format, "iq") == 0) {
+        mpxOptions.format = MPX_IQ;
+    } else {
+        mpxUsage();
+    }
+    if ((mpxOptions.rate < MPXMINRATE) || (mpxOptions.seconds < 0) || (threadCount < 1)
+            || (mpxOptions.toneFrequency >= (mpxOptions.rate/2))) {
+        mpxUsage();
+    } else {}
+    if (!audioLevelSet && ((mpxOptions.toneFrequency != 0) || (mpxOptions.audioFile != NULL))) {
+        mpxOptions.audioLevel = 0.8f;
+    } else {}
+
+    if (jobFile != NULL) {
+        mpxLoadJobs(jobFile);
+    } else if ((single.output[0] != 0) && picodeSet && (single.picode != 0) && (single.pty <= 31)) {
+        if (optind < argc) {
+            strncpy(single.radiotext, argv[optind], MPXMAXTEXT);
+        } else {}
+        mpxJobs = &single;
+        mpxJobCount = 1;
+    } else {
+        mpxUsage();
+    }
+
+    if (threadCount > mpxJobCount) {
+        threadCount = mpxJobCount;
+    } else {}
+    threads = malloc(threadCount*sizeof(pthread_t));
+    for (i = 0; i < threadCount; i++) {
+        if (pthread_create(&threads[i], NULL, mpxWorker, &failed) != 0) {
+            fprintf(stderr, "can't start worker thread\n");
+            exit(1);
+        } else {}
+    }
+    for (i = 0; i < threadCount; i++) {
+        pthread_join(threads[i], NULL);
+    }
+    free(threads);
+    return (failed ? 1 : 0);
+}
@@ -0,0 +1,412 @@
+/*******************************************************************************
+* Profile Dump Symbolizer                                                      *
+*                                                                              *
+* Adds up the PC histograms a profiling build (make PROFILE=1) sends in answer *
+* to a 'P' command (lines starting 'H', see firmware/profile.h) and spreads    *
+* each bucket over the functions of the firmware ELF it covers, in proportion  *
+* to the bytes of each in the bucket, into a flat per function profile.        *
+*                                                                              *
+* profdump [-b] elf [file]                                                     *
+*                                                                              *
+* Reads stdin without a file. Any line not starting 'H' is skipped. Symbols    *
+* come from the ELF symbol table, so the ELF has to match the flashed hex.     *
+*                                                                              *
+*******************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <unistd.h>
+
+#pragma pack(push, 1)
+#include "includes.h"
+#pragma pack(pop)
+
+#define PROFDUMPSAMPLEMS 16.0 // Watchdog interrupt period, nominal, drifts with voltage & temperature
+#define PROFDUMPHEADER 9
+#define PROFDUMPLINE 4096
+#define PROFDUMPFLASHLIMIT 0x800000 // AVR ELF data and EEPROM are mapped above flash
+#define PROFDUMPNAME 40
+
+// ELF32 little endian, only the fields used here
+#define ELFSECTIONSYMTAB 2
+#define ELFSECTIONEXEC 0x4
+#define ELFSYMBOLNOTYPE 0
+#define ELFSYMBOLFUNC 2
+
+typedef struct {
+    const char *name;
+    uint32_t start;
+    uint32_t end;
+    uint8_t func;
+    double samples;
+} symbol_t;
+
+static uint8_t *profdumpElf;
+static long profdumpElfSize;
+static symbol_t *profdumpSymbols;
+static int profdumpSymbolCount;
+
+static uint16_t profdumpRead16(uint32_t offset) {
+    return ((uint16_t) (profdumpElf[offset] | (profdumpElf[offset + 1] << 8)));
+}
+
+static uint32_t profdumpRead32(uint32_t offset) {
+    return (profdumpRead16(offset) | ((uint32_t) profdumpRead16(offset + 2) << 16));
+}
+
+static int profdumpSymbolOrder(const void *a, const void *b) {
+    const symbol_t *left = a;
+    const symbol_t *right = b;
+
+    if (left->start != right->start) {
+        return ((left->start < right->start) ? -1 : 1);
+    } else if (left->func != right->func) {
+        return (right->func - left->func); // Functions ahead of labels at the same address
+    } else {
+        return (0);
+    }
+}
+
+static int profdumpSampleOrder(const void *a, const void *b) {
+    const symbol_t *left = a;
+    const symbol_t *right = b;
+
+    if (left->samples != right->samples) {
+        return ((left->samples > right->samples) ? -1 : 1);
+    } else {
+        return (0);
+    }
+}
+
+// Linker section markers share addresses with code and say nothing about it
+static int profdumpMarker(const char *name) {
+    size_t length = strlen(name);
+
+    if (name[0] == '.' || name[0] == '\0' || strcmp(name, "_etext") == 0) {
+        return (1);
+    } else if (length > 6 && strcmp(name + length - 6, "_start") == 0) {
+        return (1);
+    } else if (length > 4 && strcmp(name + length - 4, "_end") == 0) {
+        return (1);
+    } else {
+        return (0);
+    }
+}
+
+// Loads the code symbols of the ELF sorted by address, returns -1 on a bad file
+static int profdumpLoadSymbols(const char *path) {
+    FILE *file;
+    uint32_t sections;
+    uint16_t sectionSize;
+    uint16_t sectionCount;
+    uint32_t header;
+    uint32_t symbols = 0;
+    uint32_t symbolsSize = 0;
+    uint32_t symbolSize = 16;
+    uint32_t strings = 0;
+    uint32_t stringsSize = 0;
+    uint32_t symbol;
+    uint32_t value;
+    uint16_t section;
+    uint8_t type;
+    int i;
+    int kept;
+
+    file = fopen(path, "rb");
+    if (file == NULL) {
+        perror(path);
+        return (-1);
+    } else {}
+    fseek(file, 0, SEEK_END);
+    profdumpElfSize = ftell(file);
+    rewind(file);
+    profdumpElf = malloc(profdumpElfSize);
+    if (profdumpElf == NULL || fread(profdumpElf, 1, profdumpElfSize, file) != (size_t) profdumpElfSize) {
+        fprintf(stderr, "profdump: can't read %s\n", path);
+        fclose(file);
+        return (-1);
+    } else {}
+    fclose(file);
+
+    if (profdumpElfSize < 52 || memcmp(profdumpElf, "\177ELF", 4) != 0 || profdumpElf[4] != 1 || profdumpElf[5] != 1) {
+        fprintf(stderr, "profdump: %s is not a 32 bit little endian ELF\n", path);
+        return (-1);
+    } else {}
+    sections = profdumpRead32(32);
+    sectionSize = profdumpRead16(46);
+    sectionCount = profdumpRead16(48);
+    if (sectionSize < 40 || sections + (uint64_t) sectionSize * sectionCount > (uint64_t) profdumpElfSize) {
+        fprintf(stderr, "profdump: %s has a bad section table\n", path);
+        return (-1);
+    } else {}
+
+    for (i = 0; i < sectionCount; i++) {
+        header = sections + i * sectionSize;
+        if (profdumpRead32(header + 4) == ELFSECTIONSYMTAB) {
+            symbols = profdumpRead32(header + 16);
+            symbolsSize = profdumpRead32(header + 20);
+            if (profdumpRead32(header + 36) >= 16) {
+                symbolSize = profdumpRead32(header + 36);
+            } else {}
+            // Linked string table
+            if (profdumpRead32(header + 24) < sectionCount) {
+                header = sections + profdumpRead32(header + 24) * sectionSize;
+                strings = profdumpRead32(header + 16);
+                stringsSize = profdumpRead32(header + 20);
+            } else {}
+            break;
+        } else {}
+    }
+    if (symbolsSize == 0 || stringsSize == 0 || symbols + symbolsSize > profdumpElfSize || strings + stringsSize > profdumpElfSize) {
+        fprintf(stderr, "profdump: %s has no symbol table, was it stripped?\n", path);
+        return (-1);
+    } else {}
+
+    profdumpSymbols = calloc(symbolsSize / symbolSize, sizeof(symbol_t));
+    for (symbol = symbols; symbol + symbolSize <= symbols + symbolsSize; symbol += symbolSize) {
+        type = profdumpElf[symbol + 12] & 0x0f;
+        section = profdumpRead16(symbol + 14);
+        value = profdumpRead32(symbol + 4);
+        if ((type != ELFSYMBOLFUNC && type != ELFSYMBOLNOTYPE) || section == 0 || section >= sectionCount) {
+            continue;
+        } else {}
+        if (!(profdumpRead32(sections + section * sectionSize + 8) & ELFSECTIONEXEC) || value >= PROFDUMPFLASHLIMIT) {
+            continue;
+        } else {}
+        if (profdumpRead32(symbol) >= stringsSize) {
+            continue;
+        } else {}
+        profdumpSymbols[profdumpSymbolCount].name = (const char *) &profdumpElf[strings + profdumpRead32(symbol)];
+        if (profdumpMarker(profdumpSymbols[profdumpSymbolCount].name)) {
+            continue;
+        } else {}
+        profdumpSymbols[profdumpSymbolCount].start = value;
+        profdumpSymbols[profdumpSymbolCount].end = value + profdumpRead32(symbol + 8);
+        profdumpSymbols[profdumpSymbolCount].func = (type == ELFSYMBOLFUNC);
+        profdumpSymbolCount++;
+    }
+    qsort(profdumpSymbols, profdumpSymbolCount, sizeof(symbol_t), profdumpSymbolOrder);
+
+    // One symbol per address, symbols without a size run up to the next one
+    kept = 0;
+    for (i = 0; i < profdumpSymbolCount; i++) {
+        if (kept && profdumpSymbols[kept - 1].start == profdumpSymbols[i].start) {
+            continue;
+        } else {}
+        profdumpSymbols[kept++] = profdumpSymbols[i];
+    }
+    profdumpSymbolCount = kept;
+    for (i = 0; i < profdumpSymbolCount; i++) {
+        if (profdumpSymbols[i].end == profdumpSymbols[i].start) {
+            profdumpSymbols[i].end = (i + 1 < profdumpSymbolCount) ? profdumpSymbols[i + 1].start : profdumpSymbols[i].start + 2;
+        } else {}
+    }
+    return (profdumpSymbolCount);
+}
+
+// Spreads the samples in [start, end) over the symbols, returns what no symbol covers
+static double profdumpAttribute(uint32_t start, uint32_t end, double samples) {
+    double perByte = samples / (end - start);
+    double covered = 0;
+    uint32_t from;
+    uint32_t to;
+    int i;
+
+    for (i = 0; i < profdumpSymbolCount; i++) {
+        from = (profdumpSymbols[i].start > start) ? profdumpSymbols[i].start : start;
+        to = (profdumpSymbols[i].end < end) ? profdumpSymbols[i].end : end;
+        if (from < to) {
+            profdumpSymbols[i].samples += perByte * (to - from);
+            covered += perByte * (to - from);
+        } else {}
+    }
+    return ((samples > covered) ? samples - covered : 0);
+}
+
+// Most of a bucket, for the bucket listing
+static const char *profdumpBucketName(uint32_t start, uint32_t end) {
+    uint32_t best = 0;
+    uint32_t from;
+    uint32_t to;
+    const char *name = "?";
+    int i;
+
+    for (i = 0; i < profdumpSymbolCount; i++) {
+        from = (profdumpSymbols[i].start > start) ? profdumpSymbols[i].start : start;
+        to = (profdumpSymbols[i].end < end) ? profdumpSymbols[i].end : end;
+        if (from < to && to - from > best) {
+            best = to - from;
+            name = profdumpSymbols[i].name;
+        } else {}
+    }
+    return (name);
+}
+
+static int profdumpHex(char c) {
+    if (c >= '0' && c <= '9') {
+        return (c - '0');
+    } else if (c >= 'a' && c <= 'f') {
+        return (c - 'a' + 10);
+    } else if (c >= 'A' && c <= 'F') {
+        return (c - 'A' + 10);
+    } else {
+        return (-1);
+    }
+}
+
+// Hex after the report letter to bytes, returns the byte count or -1
+static int profdumpParse(const char *line, uint8_t *bytes, int size) {
+    int length = 0;
+    int high;
+    int low;
+
+    for (line++; *line && *line != '\r' && *line != '\n'; line += 2) {
+        high = profdumpHex(line[0]);
+        low = (high < 0) ? -1 : profdumpHex(line[1]);
+        if (low < 0 || length >= size) {
+            return (-1);
+        } else {}
+        bytes[length++] = (uint8_t) ((high << 4) | low);
+    }
+    return (length);
+}
+
+static void profdumpUsage(void) {
+    fprintf(stderr,
+        "usage: profdump [-b] elf [file]\n"
+        "  -b  also list the busy buckets\n");
+    exit(1);
+}
+
+int main(int argc, char **argv) {
+    FILE *input = stdin;
+    char line[PROFDUMPLINE];
+    uint8_t bytes[PROFDUMPLINE / 2];
+    uint64_t counts[PROFILEBUCKETS];
+    uint64_t samples = 0;
+    uint64_t outside = 0;
+    uint64_t binned = 0;
+    uint32_t buckets;
+    uint32_t bucket;
+    uint16_t count;
+    uint8_t shift = 0;
+    int listBuckets = FALSE;
+    int saturated = FALSE;
+    int dumps = 0;
+    int length;
+    int option;
+    int i;
+    double unknown = 0;
+    double cumulative = 0;
+
+    while ((option = getopt(argc, argv, "b")) != -1) {
+        switch (option) {
+            case 'b':
+                listBuckets = TRUE;
+                break;
+            default:
+                profdumpUsage();
+        }
+    }
+    if (optind >= argc) {
+        profdumpUsage();
+    } else {}
+    length = profdumpLoadSymbols(argv[optind]);
+    if (length < 0) {
+        return (1);
+    } else if (length == 0) {
+        fprintf(stderr, "profdump: no code symbols in %s\n", argv[optind]);
+        return (1);
+    } else {}
+    if (optind + 1 < argc) {
+        input = fopen(argv[optind + 1], "r");
+        if (input == NULL) {
+            perror(argv[optind + 1]);
+            return (1);
+        } else {}
+    } else {}
+
+    memset(counts, 0, sizeof(counts));
+    while (fgets(line, sizeof(line), input)) {
+        if (line[0] != PROFILEREPORT) {
+            continue;
+        } else {}
+        length = profdumpParse(line, bytes, sizeof(bytes));
+        if (length < PROFDUMPHEADER) {
+            fprintf(stderr, "profdump: bad dump %d\n", dumps + 1);
+            continue;
+        } else {}
+        buckets = bytes[7] | (bytes[8] << 8);
+        if (buckets > PROFILEBUCKETS || length != PROFDUMPHEADER + (int) buckets * 2) {
+            fprintf(stderr, "profdump: dump %d of %d bytes doesn't hold %u buckets\n", dumps + 1, length, buckets);
+            continue;
+        } else {}
+        if (dumps && bytes[0] != shift) {
+            fprintf(stderr, "profdump: dump %d has a different bucket size, from another build?\n", dumps + 1);
+            continue;
+        } else {}
+        shift = bytes[0];
+        samples += bytes[1] | (bytes[2] << 8) | (bytes[3] << 16) | ((uint32_t) bytes[4] << 24);
+        outside += bytes[5] | (bytes[6] << 8);
+        for (bucket = 0; bucket < buckets; bucket++) {
+            count = bytes[PROFDUMPHEADER + bucket * 2] | (bytes[PROFDUMPHEADER + bucket * 2 + 1] << 8);
+            if (count == 0xffff) {
+                saturated = TRUE;
+            } else {}
+            counts[bucket] += count;
+            binned += count;
+        }
+        dumps++;
+    }
+    if (dumps == 0) {
+        fprintf(stderr, "profdump: no profile dumps found\n");
+        return (1);
+    } else {}
+    if (binned + outside == 0) {
+        fprintf(stderr, "profdump: dumps hold no samples\n");
+        return (1);
+    } else {}
+
+    for (bucket = 0; bucket < PROFILEBUCKETS; bucket++) {
+        if (counts[bucket]) {
+            unknown += profdumpAttribute(bucket << shift, (bucket + 1) << shift, counts[bucket]);
+        } else {}
+    }
+
+    printf("%d dumps, %llu samples (about %.1f s), %u byte buckets\n", dumps, (unsigned long long) samples,
+        samples * PROFDUMPSAMPLEMS / 1000.0, 1u << shift);
+    if (saturated) {
+        printf("some buckets saturated, dump more often\n");
+    } else {}
+    if (binned + outside != samples) {
+        printf("%llu samples lost to saturated counters\n", (unsigned long long) (samples - binned - outside));
+    } else {}
+
+    if (listBuckets) {
+        printf("\n  %-15s %8s  %s\n", "address", "samples", "mostly");
+        for (bucket = 0; bucket < PROFILEBUCKETS; bucket++) {
+            if (counts[bucket]) {
+                printf("  %06x-%06x %8llu  %s\n", bucket << shift, ((bucket + 1) << shift) - 1,
+                    (unsigned long long) counts[bucket], profdumpBucketName(bucket << shift, (bucket + 1) << shift));
+            } else {}
+        }
+    } else {}
+
+    qsort(profdumpSymbols, profdumpSymbolCount, sizeof(symbol_t), profdumpSampleOrder);
+    printf("\n  %6s %6s %10s  %s\n", "%", "cum %", "samples", "function");
+    for (i = 0; i < profdumpSymbolCount && profdumpSymbols[i].samples > 0; i++) {
+        cumulative += profdumpSymbols[i].samples;
+        printf("  %6.2f %6.2f %10.1f  %.*s\n", 100.0 * profdumpSymbols[i].samples / (binned + outside),
+            100.0 * cumulative / (binned + outside), profdumpSymbols[i].samples, PROFDUMPNAME, profdumpSymbols[i].name);
+    }
+    if (unknown > 0) {
+        printf("  %6.2f %6s %10.1f  (no symbol)\n", 100.0 * unknown / (binned + outside), "", unknown);
+    } else {}
+    if (outside) {
+        printf("  %6.2f %6s %10llu  (past the buckets, bootloader?)\n", 100.0 * outside / (binned + outside), "",
+            (unsigned long long) outside);
+    } else {}
+    return (0);
+}
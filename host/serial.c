@@ -0,0 +1,111 @@
+#include <stdio.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <termios.h>
+#include <unistd.h>
+#include "serial.h"
+
+int serialOpen(const char *path, uint32_t baud);
+int serialSetBaud(int fd, uint32_t baud);
+int serialRead(int fd, uint8_t *buffer, int count, int timeout);
+int serialWrite(int fd, const uint8_t *buffer, int count);
+static speed_t serialSpeed(uint32_t baud);
+
+static speed_t serialSpeed(uint32_t baud) {
+    switch (baud) {
+        case 9600: return (B9600);
+        case 19200: return (B19200);
+        case 38400: return (B38400);
+        case 57600: return (B57600);
+        case 115200: return (B115200);
+        case 230400: return (B230400);
+        case 460800: return (B460800);
+        case 500000: return (B500000);
+        case 921600: return (B921600);
+        case 1000000: return (B1000000);
+        default: return (B0);
+    }
+}
+
+int serialOpen(const char *path, uint32_t baud) {
+    int fd;
+
+    fd = open(path, O_RDWR | O_NOCTTY | O_CLOEXEC);
+    if (fd < 0) {
+        perror(path);
+        return (-1);
+    } else {}
+    if (serialSetBaud(fd, baud) < 0) {
+        close(fd);
+        return (-1);
+    } else {}
+    tcflush(fd, TCIOFLUSH);
+    return (fd);
+}
+
+int serialSetBaud(int fd, uint32_t baud) {
+    struct termios settings;
+    speed_t speed = serialSpeed(baud);
+
+    if (speed == B0) {
+        fprintf(stderr, "%u baud not supported\n", baud);
+        return (-1);
+    } else {}
+    if (tcgetattr(fd, &settings) < 0) {
+        perror("tcgetattr");
+        return (-1);
+    } else {}
+    cfmakeraw(&settings);
+    settings.c_cflag |= (CLOCAL | CREAD);
+    settings.c_cflag &= ~(CSTOPB | CRTSCTS);
+    settings.c_cc[VMIN] = 0;
+    settings.c_cc[VTIME] = 0;
+    cfsetispeed(&settings, speed);
+    cfsetospeed(&settings, speed);
+    if (tcsetattr(fd, TCSANOW, &settings) < 0) {
+        perror("tcsetattr");
+        return (-1);
+    } else {}
+    return (0);
+}
+
+int serialRead(int fd, uint8_t *buffer, int count, int timeout) {
+    struct pollfd wait = {fd, POLLIN, 0};
+    int done = 0;
+    ssize_t got;
+
+    while (done < count) {
+        if (poll(&wait, 1, timeout) <= 0) {
+            break;
+        } else {}
+        got = read(fd, &buffer[done], count-done);
+        if (got > 0) {
+            done += got;
+        } else if ((got < 0) && ((errno == EAGAIN) || (errno == EINTR))) {
+            continue;
+        } else {
+            break; // Hung up
+        }
+    }
+    return (done);
+}
+
+int serialWrite(int fd, const uint8_t *buffer, int count) {
+    ssize_t sent;
+
+    while (count > 0) {
+        sent = write(fd, buffer, count);
+        if (sent < 0) {
+            if (errno == EINTR) {
+                continue;
+            } else {}
+            perror("write");
+            return (-1);
+        } else {}
+        buffer += sent;
+        count -= sent;
+    }
+    tcdrain(fd);
+    return (0);
+}
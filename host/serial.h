@@ -0,0 +1,27 @@
+/******************************************************************************
+* Serial Module                                                               *
+*                                                                             *
+* Raw 8N1 serial ports for the host tools, works on ptys as well.             *
+*                                                                             *
+* (int) serialOpen(const char*, uint32_t)                                     *
+*                                      Function opens a port raw at a baud    *
+*                                      rate, returns fd or -1.                *
+* (int) serialSetBaud(int, uint32_t)   Function changes baud rate, returns    *
+*                                      -1 if the rate isn't supported.        *
+* (int) serialRead(int, uint8_t*, int, int)                                   *
+*                                      Function reads exactly count bytes     *
+*                                      unless timeout ms pass without one,    *
+*                                      returns bytes read.                    *
+* (int) serialWrite(int, const uint8_t*, int)                                 *
+*                                      Function writes all bytes and waits    *
+*                                      for them to go out, returns -1 on      *
+*                                      error.                                 *
+*                                                                             *
+******************************************************************************/
+
+#include <stdint.h>
+
+extern int serialOpen(const char *path, uint32_t baud);
+extern int serialSetBaud(int fd, uint32_t baud);
+extern int serialRead(int fd, uint8_t *buffer, int count, int timeout);
+extern int serialWrite(int fd, const uint8_t *buffer, int count);
@@ -0,0 +1,14 @@
+/******************************************************************************
+* Host shim for <avr/eeprom.h>                                                *
+*                                                                             *
+******************************************************************************/
+
+#include <stdint.h>
+#include <stddef.h>
+
+extern uint8_t eeprom_read_byte(const uint8_t *address);
+extern void eeprom_read_block(void *destination, const void *source, size_t size);
+extern void eeprom_update_block(const void *source, void *destination, size_t size);
+extern uint8_t eeprom_is_ready(void);
+extern void eeprom_write_byte(uint8_t *address, uint8_t value);
+extern void eeprom_busy_wait(void);
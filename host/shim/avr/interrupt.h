@@ -0,0 +1,13 @@
+/******************************************************************************
+* Host shim for <avr/interrupt.h>                                             *
+*                                                                             *
+* Turning interrupts off tells the simulator who did it, so it can hold the   *
+* sample interrupt off for as long as that code would.                        *
+*                                                                             *
+******************************************************************************/
+
+extern void simAtomic(const char *where);
+
+#define ISR(vector, ...) void vector(void); void vector(void)
+#define sei()
+#define cli() simAtomic(__func__)
@@ -0,0 +1,84 @@
+/******************************************************************************
+* Host shim for <avr/io.h>                                                    *
+*                                                                             *
+* Lets firmware sources build for the host. Registers are plain variables,    *
+* only unitsim defines them and runs code that touches hardware. UDR0 is 16   *
+* bits so the simulator can tell a write from an idle register.               *
+*                                                                             *
+******************************************************************************/
+
+#include <stdint.h>
+
+extern volatile uint8_t MCUSR, PRR, ACSR;
+extern volatile uint8_t PORTB, DDRB, PORTD, DDRD;
+extern volatile uint8_t TCCR0A, TCCR0B, OCR0A;
+extern volatile uint8_t TCCR1A, TCCR1B, TIMSK1, TIFR1, OCR1AH, OCR1AL;
+extern volatile uint16_t TCNT1, OCR1A;
+extern volatile uint8_t TCCR2A, TCCR2B, OCR2A;
+extern volatile uint8_t UCSR0A, UCSR0B, UCSR0C, UBRR0H, UBRR0L;
+extern volatile uint16_t UDR0;
+extern volatile uint8_t GPIOR1, GPIOR2;
+extern uint8_t simRam[];
+
+#define RAMEND ((uintptr_t) &simRam[0x8ff])
+
+// MCUSR
+#define PORF 0
+#define EXTRF 1
+#define BORF 2
+#define WDRF 3
+
+// PRR
+#define PRADC 0
+#define PRUSART0 1
+#define PRSPI 2
+#define PRTIM1 3
+#define PRTIM0 5
+#define PRTIM2 6
+#define PRTWI 7
+
+// ACSR
+#define ACD 7
+
+#define PB1 1
+#define PB2 2
+#define PB3 3
+#define PB5 5
+#define PD1 1
+#define PD2 2
+#define PD3 3
+#define PD5 5
+#define PD6 6
+
+// Timers
+#define WGM01 1
+#define COM0A0 6
+#define CS00 0
+#define CS10 0
+#define CS11 1
+#define CS12 2
+#define WGM12 3
+#define COM1B0 4
+#define OCIE1A 1
+#define OCIE1B 2
+#define OCF1A 1
+#define OCF1B 2
+#define WGM21 1
+#define COM2B0 4
+#define CS21 1
+
+// USART0
+#define U2X0 1
+#define DOR0 3
+#define UDRE0 5
+#define TXC0 6
+#define RXC0 7
+#define UCSZ00 1
+#define UCSZ01 2
+#define TXEN0 3
+#define RXEN0 4
+#define UDRIE0 5
+#define RXCIE0 7
+
+// SPI, for the sample stub model
+#define SPIF 7
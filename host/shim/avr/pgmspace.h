@@ -0,0 +1,13 @@
+/******************************************************************************
+* Host shim for <avr/pgmspace.h>                                              *
+*                                                                             *
+* Host has one address space, flash tables are plain const data.              *
+*                                                                             *
+******************************************************************************/
+
+#include <stdint.h>
+
+#define PROGMEM
+#define pgm_read_byte(address) (*((const uint8_t *) (address)))
+#define pgm_read_word(address) (*((const uint16_t *) (address)))
+#define pgm_read_dword(address) (*((const uint32_t *) (address)))
@@ -0,0 +1,14 @@
+/******************************************************************************
+* Host shim for <avr/sleep.h>                                                 *
+*                                                                             *
+* Sleeping hands the CPU to the simulator until the next interrupt.           *
+*                                                                             *
+******************************************************************************/
+
+extern void simSleep(void);
+
+#define SLEEP_MODE_IDLE 0
+#define set_sleep_mode(mode)
+#define sleep_enable()
+#define sleep_disable()
+#define sleep_cpu() simSleep()
@@ -0,0 +1,14 @@
+/******************************************************************************
+* Host shim for <avr/wdt.h>                                                   *
+*                                                                             *
+* Enabling and disabling turn interrupts off for the timed write sequence.    *
+*                                                                             *
+******************************************************************************/
+
+extern void simAtomic(const char *where);
+
+#define WDTO_15MS 0
+#define WDTO_250MS 4
+#define wdt_enable(timeout) simAtomic("wdt_enable")
+#define wdt_disable() simAtomic("wdt_disable")
+#define wdt_reset()
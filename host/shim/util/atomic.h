@@ -0,0 +1,12 @@
+/******************************************************************************
+* Host shim for <util/atomic.h>                                               *
+*                                                                             *
+* The block runs as plain code, the simulator is told who turned interrupts   *
+* off as for cli().                                                           *
+*                                                                             *
+******************************************************************************/
+
+extern void simAtomic(const char *where);
+
+#define ATOMIC_RESTORESTATE
+#define ATOMIC_BLOCK(type) simAtomic(__func__);
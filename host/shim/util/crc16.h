@@ -0,0 +1,14 @@
+/******************************************************************************
+* Host shim for <util/crc16.h>                                                *
+*                                                                             *
+* Same algorithm as the avr-libc version so checksums match the firmware.     *
+*                                                                             *
+******************************************************************************/
+
+#include <stdint.h>
+
+static inline uint16_t _crc_ccitt_update(uint16_t crc, uint8_t data) {
+    data ^= (uint8_t) crc;
+    data ^= (uint8_t) (data<<4);
+    return ((((uint16_t) data<<8) | (crc>>8)) ^ (uint8_t) (data>>4) ^ ((uint16_t) data<<3));
+}
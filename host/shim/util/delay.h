@@ -0,0 +1,11 @@
+/******************************************************************************
+* Host shim for <util/delay.h>                                                *
+*                                                                             *
+* Busy waits hand the time to the simulator, interrupts run meanwhile.        *
+*                                                                             *
+******************************************************************************/
+
+extern void simDelay(double us);
+
+#define _delay_us(us) simDelay(us)
+#define _delay_ms(ms) simDelay((ms)*1000.0)
@@ -0,0 +1,341 @@
+/*******************************************************************************
+* Trace Dump Decoder                                                           *
+*                                                                              *
+* Decodes the trace ring dumps a unit sends in answer to a 'D' command (lines  *
+* starting 'R', see firmware/trace.h) into a timeline and histograms of        *
+* sample interrupt latency, group spacing, LCD update time and the time from   *
+* a received UART byte to the end of the LCD update it caused.                 *
+*                                                                              *
+* tracedump [-s] [file]                                                        *
+*                                                                              *
+* Reads stdin without a file, so a capture can be piped straight in. Any line  *
+* not starting 'R' is skipped, telemetry reports can stay in the capture.      *
+*                                                                              *
+*******************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <unistd.h>
+
+#pragma pack(push, 1)
+#include "includes.h"
+#pragma pack(pop)
+
+#define TRACEDUMPCPUHZ 16000000.0
+#define TRACEDUMPTICKCYCLES 421 // Timer 1 OCR1A+1, one sample period
+#define TRACEDUMPGROUPTICKS (104*SAMPLESPERSYMBOL)
+#define TRACEDUMPMAXENTRIES 256
+#define TRACEDUMPLINE 4096
+#define TRACEDUMPBINS 32
+#define TRACEDUMPBAR 50
+
+typedef struct {
+    const char *title;
+    const char *unit;
+    double base;
+    double width;
+    uint32_t bins[TRACEDUMPBINS];
+    uint32_t under;
+    uint32_t over;
+    uint32_t count;
+    double min;
+    double max;
+    double sum;
+} histogram_t;
+
+static const char *tracedumpEvents[] = {"epoch", "sample", "group", "late", "uartrx", "lcd", "state"};
+static const char *tracedumpScreens[] = {"?", "frequency", "message", "dwell", "transmit"};
+static const char *tracedumpStates[] = {"frequency input", "data input", "encoding", "transmission"};
+
+static double tracedumpMs(uint64_t ticks) {
+    return (ticks * (TRACEDUMPTICKCYCLES * 1000.0 / TRACEDUMPCPUHZ));
+}
+
+static void histogramAdd(histogram_t *histogram, double value) {
+    int32_t bin;
+
+    if (histogram->count == 0 || value < histogram->min) {
+        histogram->min = value;
+    } else {}
+    if (histogram->count == 0 || value > histogram->max) {
+        histogram->max = value;
+    } else {}
+    histogram->count++;
+    histogram->sum += value;
+
+    if (value < histogram->base) {
+        histogram->under++;
+        return;
+    } else {}
+    bin = (int32_t) ((value - histogram->base) / histogram->width);
+    if (bin >= TRACEDUMPBINS) {
+        histogram->over++;
+    } else {
+        histogram->bins[bin]++;
+    }
+}
+
+static void histogramPrint(histogram_t *histogram) {
+    uint32_t peak = 1;
+    uint32_t bar;
+    int first = TRACEDUMPBINS;
+    int last = -1;
+    int i;
+
+    printf("\n%s (%s)\n", histogram->title, histogram->unit);
+    if (histogram->count == 0) {
+        printf("  no samples\n");
+        return;
+    } else {}
+    printf("  n %u  min %.3f  mean %.3f  max %.3f\n", histogram->count, histogram->min,
+        histogram->sum / histogram->count, histogram->max);
+
+    // Only print the bins between the first and last used
+    for (i = 0; i < TRACEDUMPBINS; i++) {
+        if (histogram->bins[i]) {
+            if (i < first) {
+                first = i;
+            } else {}
+            last = i;
+            if (histogram->bins[i] > peak) {
+                peak = histogram->bins[i];
+            } else {}
+        } else {}
+    }
+    if (histogram->under) {
+        printf("  %10s < %-8.3f %6u\n", "", histogram->base, histogram->under);
+    } else {}
+    for (i = first; i <= last; i++) {
+        bar = (histogram->bins[i] * TRACEDUMPBAR + peak - 1) / peak;
+        printf("  %10.3f - %-8.3f %6u ", histogram->base + i * histogram->width,
+            histogram->base + (i + 1) * histogram->width, histogram->bins[i]);
+        while (bar--) {
+            putchar('#');
+        }
+        putchar('\n');
+    }
+    if (histogram->over) {
+        printf("  %10s >= %-7.3f %6u\n", "", histogram->base + TRACEDUMPBINS * histogram->width, histogram->over);
+    } else {}
+}
+
+static int tracedumpHex(char c) {
+    if (c >= '0' && c <= '9') {
+        return (c - '0');
+    } else if (c >= 'a' && c <= 'f') {
+        return (c - 'a' + 10);
+    } else if (c >= 'A' && c <= 'F') {
+        return (c - 'A' + 10);
+    } else {
+        return (-1);
+    }
+}
+
+// Hex after the report letter to bytes, returns the byte count or -1
+static int tracedumpParse(const char *line, uint8_t *bytes, int size) {
+    int length = 0;
+    int high;
+    int low;
+
+    for (line++; *line && *line != '\r' && *line != '\n'; line += 2) {
+        high = tracedumpHex(line[0]);
+        low = (high < 0) ? -1 : tracedumpHex(line[1]);
+        if (low < 0 || length >= size) {
+            return (-1);
+        } else {}
+        bytes[length++] = (uint8_t) ((high << 4) | low);
+    }
+    return (length);
+}
+
+static void tracedumpDecode(uint8_t *bytes, int length, int summary, histogram_t *histograms) {
+    trace_t entries[TRACEDUMPMAXENTRIES];
+    uint64_t times[TRACEDUMPMAXENTRIES];
+    uint16_t dumpEpoch;
+    uint16_t dumpTicks;
+    uint8_t count;
+    uint32_t epoch;
+    uint64_t lastGroup = 0;
+    uint64_t lcdStart[8] = {0};
+    uint64_t rxPending = 0;
+    int haveGroup = FALSE;
+    int haveRx = FALSE;
+    int first = -1;
+    int i;
+
+    if (length < 5) {
+        fprintf(stderr, "tracedump: short dump\n");
+        return;
+    } else {}
+    dumpEpoch = bytes[0] | (bytes[1] << 8);
+    dumpTicks = bytes[2] | (bytes[3] << 8);
+    count = bytes[4];
+    if (length != 5 + count * (int) sizeof(trace_t)) {
+        fprintf(stderr, "tracedump: dump of %d bytes doesn't hold %u entries\n", length, count);
+        return;
+    } else {}
+    memcpy(entries, &bytes[5], count * sizeof(trace_t));
+
+    // Epoch markers carry the high 16 bits for what follows them. Entries
+    // ahead of the first surviving marker belong to the epoch before it, or
+    // with no marker left in the ring to the epoch the dump was taken in.
+    for (i = 0; i < count; i++) {
+        if (entries[i].event == TRACEEPOCH) {
+            first = i;
+            break;
+        } else {}
+    }
+    if (first >= 0) {
+        epoch = (uint16_t) (entries[first].time - 1);
+    } else if (count && entries[0].time > dumpTicks) {
+        epoch = (uint16_t) (dumpEpoch - 1);
+    } else {
+        epoch = dumpEpoch;
+    }
+    for (i = 0; i < count; i++) {
+        if (entries[i].event == TRACEEPOCH) {
+            epoch = entries[i].time;
+        } else {}
+        times[i] = (((uint64_t) epoch) << 16) | entries[i].time;
+    }
+
+    printf("dump at %.3f ms, %u entries\n", tracedumpMs((((uint64_t) dumpEpoch) << 16) | dumpTicks), count);
+    for (i = 0; i < count; i++) {
+        uint8_t event = entries[i].event;
+        uint8_t data = entries[i].data;
+
+        if (!summary && event != TRACEEPOCH) {
+            printf("%12.3f ms  %-8s", tracedumpMs(times[i]),
+                event < sizeof(tracedumpEvents) / sizeof(tracedumpEvents[0]) ? tracedumpEvents[event] : "?");
+            switch (event) {
+                case TRACESAMPLE:
+                    printf("latency %u cycles", data * 2);
+                    break;
+                case TRACEGROUP:
+                    printf("%s", data ? "resent" : "next");
+                    break;
+                case TRACEUARTRX:
+                    if (data >= ' ' && data < 0x7f) {
+                        printf("'%c'", data);
+                    } else {
+                        printf("0x%02x", data);
+                    }
+                    break;
+                case TRACELCD:
+                    printf("%s %s", tracedumpScreens[(data & 0x07) < 5 ? (data & 0x07) : 0],
+                        (data & TRACELCDEND) ? "end" : "start");
+                    break;
+                case TRACESTATE:
+                    printf("%s", data < 4 ? tracedumpStates[data] : "?");
+                    break;
+                default:
+                    break;
+            }
+            putchar('\n');
+        } else {}
+
+        switch (event) {
+            case TRACESAMPLE:
+                histogramAdd(&histograms[0], data * 2);
+                break;
+            case TRACEGROUP:
+                if (haveGroup) {
+                    histogramAdd(&histograms[1], (double) (times[i] - lastGroup));
+                } else {}
+                lastGroup = times[i];
+                haveGroup = TRUE;
+                break;
+            case TRACEUARTRX:
+                // Latency counts from the first byte since the last update
+                if (!haveRx) {
+                    rxPending = times[i];
+                    haveRx = TRUE;
+                } else {}
+                break;
+            case TRACELCD:
+                if (data & TRACELCDEND) {
+                    if (lcdStart[data & 0x07]) {
+                        histogramAdd(&histograms[2], tracedumpMs(times[i] - lcdStart[data & 0x07]));
+                        lcdStart[data & 0x07] = 0;
+                    } else {}
+                    if (haveRx) {
+                        histogramAdd(&histograms[3], tracedumpMs(times[i] - rxPending));
+                        haveRx = FALSE;
+                    } else {}
+                } else {
+                    lcdStart[data & 0x07] = times[i] ? times[i] : 1;
+                }
+                break;
+            default:
+                break;
+        }
+    }
+}
+
+static void tracedumpUsage(void) {
+    fprintf(stderr,
+        "usage: tracedump [-s] [file]\n"
+        "  -s  histograms only, no timeline\n");
+    exit(1);
+}
+
+int main(int argc, char **argv) {
+    FILE *input = stdin;
+    char line[TRACEDUMPLINE];
+    uint8_t bytes[TRACEDUMPLINE / 2];
+    int summary = FALSE;
+    int dumps = 0;
+    int length;
+    int option;
+    int i;
+    histogram_t histograms[4] = {
+        {"Sample interrupt latency", "cycles", 0, 8},
+        {"Group interval", "sample periods", TRACEDUMPGROUPTICKS - 8, 1},
+        {"LCD update", "ms", 0, 0.25},
+        {"UART byte to LCD updated", "ms", 0, 0.5},
+    };
+
+    while ((option = getopt(argc, argv, "s")) != -1) {
+        switch (option) {
+            case 's':
+                summary = TRUE;
+                break;
+            default:
+                tracedumpUsage();
+        }
+    }
+    if (optind < argc) {
+        input = fopen(argv[optind], "r");
+        if (input == NULL) {
+            perror(argv[optind]);
+            return (1);
+        } else {}
+    } else {}
+
+    while (fgets(line, sizeof(line), input)) {
+        if (line[0] != TRACEREPORT) {
+            continue;
+        } else {}
+        length = tracedumpParse(line, bytes, sizeof(bytes));
+        if (length < 0) {
+            fprintf(stderr, "tracedump: bad hex in dump %d\n", dumps + 1);
+            continue;
+        } else {}
+        if (dumps) {
+            putchar('\n');
+        } else {}
+        tracedumpDecode(bytes, length, summary, histograms);
+        dumps++;
+    }
+    if (dumps == 0) {
+        fprintf(stderr, "tracedump: no trace dumps found\n");
+        return (1);
+    } else {}
+
+    for (i = 0; i < 4; i++) {
+        histogramPrint(&histograms[i]);
+    }
+    return (0);
+}
@@ -0,0 +1,1014 @@
+/*******************************************************************************
+* Multi-Unit Controller Daemon                                                 *
+*                                                                              *
+* Keeps a serial session open to every transmitter in the units file and      *
+* programs them through the same keystrokes as the front panel: BACKSPACE to  *
+* leave air, frequency digits, each message and its dwell, then an empty      *
+* message to finish the carousel. Every port and control client shares one    *
+* epoll loop with nonblocking I/O and a timer heap, so hundreds of units cost  *
+* nothing while idle. Keystrokes are paced per unit so the 32 byte Rx ring    *
+* never overruns while the unit redraws its LCD, and the waits for encoding   *
+* and EEPROM writes come from the firmware's own delays.                       *
+*                                                                              *
+* Updates queue per unit and merge while they wait, so a frequency change and  *
+* new text sent close together cost one trip off air. A session ends when the *
+* unit answers a telemetry request from air; it is timed from queueing and     *
+* retried if the unit dropped keystrokes on the way.                           *
+*                                                                              *
+* unitd [-s socket] [-g ms] [-b bytes] [-p seconds] units.conf                 *
+*                                                                              *
+* units.conf has a unit per line, "name port [baud]", # starts a comment.      *
+* Commands on the control socket, one per line, each answered by lines ending  *
+* in a lone '.':                                                               *
+*   set <unit|*> <MHz> <dwell> <message>[|<message>...]                        *
+*   freq <unit|*> <MHz>                                                        *
+*   text <unit|*> <dwell> <message>[|<message>...]                             *
+*   status [unit]                                                              *
+* A unit that doesn't answer telemetry is taken to be at the frequency prompt. *
+* What a unit holds is unknown until it has been sent a set.                   *
+*                                                                              *
+* Test against unitsim, giving each unit the pty it prints.                    *
+*                                                                              *
+*******************************************************************************/
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <stdarg.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+
+#pragma pack(push, 1)
+#include "includes.h"
+#pragma pack(pop)
+#include "serial.h"
+
+#define UNITDMAXUNITS 1024
+#define UNITDSCRIPT 512
+#define UNITDLINE 1024
+#define UNITDEVENTS 64
+#define UNITDMINFREQUENCY 7000 // 10kHz steps, the range the firmware accepts
+#define UNITDMAXFREQUENCY 15000
+#define UNITDMAXTEXT 64
+
+// Timing in ms
+#define UNITDPROBEWAIT 400    // Telemetry answer, a report is 70 chars at 9600 baud
+#define UNITDPROBETRIES 3
+#define UNITDCONFIRMTRIES 40  // Polls at UNITDPROBEWAIT after the last keystroke
+#define UNITDREOPEN 5000
+#define UNITDAIREXIT 150      // Leaving air, DAC off and the frequency screen drawn
+#define UNITDSCREEN 50        // Next entry screen drawn
+#define UNITDENCODE 1700      // 14 x 70ms progress bar and up to 128 EEPROM bytes at 3.4ms
+#define UNITDRETRIES 3        // Sessions in a row a unit may fail before the update is dropped
+
+typedef enum {UNITDOFFLINE, UNITDPROBING, UNITDIDLE, UNITDONAIR, UNITDPROGRAMMING, UNITDCONFIRMING} unitdState_t;
+typedef enum {UNITDLISTENER, UNITDCLIENT, UNITDUNIT} unitdKind_t;
+
+typedef struct {
+    uint16_t frequency; // 10kHz steps, 0 when unknown
+    uint8_t count;      // Messages, 0 when unknown
+    uint8_t dwell[MAXRTMESSAGES];
+    char text[MAXRTMESSAGES][UNITDMAXTEXT+1];
+} unitdConfig_t;
+
+typedef struct {
+    uint8_t byte;
+    uint16_t pause; // ms to leave the unit after this byte
+} unitdStep_t;
+
+typedef struct {
+    unitdKind_t kind;   // First, epoll events carry a pointer to it
+    int fd;
+    char name[32];
+    char port[256];
+    uint32_t baud;
+    unitdState_t state;
+    uint8_t tries;
+    uint8_t awaiting;   // Telemetry request outstanding
+    uint64_t probeAt;
+    uint64_t at;        // Timer due
+    int heap;           // Timer heap position, -1 when none
+    unitdStep_t script[UNITDSCRIPT];
+    uint16_t scriptLength;
+    uint16_t scriptIndex;
+    double tokens;      // Keystrokes that may go out now
+    uint64_t tokensAt;
+    char line[UNITDLINE];
+    uint16_t lineLength;
+    unitdConfig_t active;  // What the unit holds as far as is known
+    unitdConfig_t pending; // Merged updates waiting for a session
+    unitdConfig_t session; // Being programmed
+    uint8_t hasPending;
+    uint64_t queuedAt;
+    uint64_t sessionQueuedAt;
+    uint16_t sessionOverruns;
+    uint8_t failStreak;
+    uint32_t sessions;
+    uint32_t failures;
+    uint32_t merged;
+    double latencyLast;    // Queued to on air
+    double latencySum;
+    double latencyMax;
+    double rttLast;        // Telemetry request to report
+    double rttMax;
+    telemetry_t telemetry;
+    uint8_t hasTelemetry;
+} unitdUnit_t;
+
+typedef struct {
+    unitdKind_t kind;
+    int fd;
+    char in[UNITDLINE];
+    uint16_t inLength;
+    char *out;
+    size_t outLength;
+    size_t outSize;
+} unitdClient_t;
+
+static const char *unitdStateNames[] = {"offline", "probing", "idle", "onair", "programming", "confirming"};
+static unitdKind_t unitdListener = UNITDLISTENER;
+static unitdUnit_t *unitdUnits[UNITDMAXUNITS];
+static int unitdUnitCount = 0;
+static unitdUnit_t *unitdHeap[UNITDMAXUNITS];
+static int unitdHeapSize = 0;
+static int unitdEpoll;
+static uint64_t unitdStart;
+static double unitdGap = 3.0; // ms between keystrokes, a message char redraws a whole LCD line
+static double unitdBurst = 8;
+static uint64_t unitdPollEvery = 10000;
+
+static uint64_t unitdNow(void) {
+    struct timespec now;
+
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return ((now.tv_sec * 1000ULL) + (now.tv_nsec / 1000000));
+}
+
+static void unitdLog(unitdUnit_t *unit, const char *format, ...) __attribute__ ((format (printf, 2, 3)));
+static void unitdLog(unitdUnit_t *unit, const char *format, ...) {
+    va_list args;
+
+    printf("[%10.3f] %s ", (unitdNow() - unitdStart) / 1000.0, unit->name);
+    va_start(args, format);
+    vprintf(format, args);
+    va_end(args);
+    putchar('\n');
+    fflush(stdout);
+}
+
+/*******************************************************************************
+* Timer heap, one entry per unit ordered by due time                           *
+*******************************************************************************/
+static void unitdHeapSwap(int a, int b) {
+    unitdUnit_t *unit = unitdHeap[a];
+
+    unitdHeap[a] = unitdHeap[b];
+    unitdHeap[b] = unit;
+    unitdHeap[a]->heap = a;
+    unitdHeap[b]->heap = b;
+}
+
+static void unitdHeapFix(int i) {
+    int child;
+
+    while ((i > 0) && (unitdHeap[(i-1)/2]->at > unitdHeap[i]->at)) {
+        unitdHeapSwap(i, (i-1)/2);
+        i = ((i-1)/2);
+    }
+    for (;;) {
+        child = ((2*i)+1);
+        if (child >= unitdHeapSize) {
+            return;
+        } else {}
+        if (((child+1) < unitdHeapSize) && (unitdHeap[child+1]->at < unitdHeap[child]->at)) {
+            child++;
+        } else {}
+        if (unitdHeap[child]->at >= unitdHeap[i]->at) {
+            return;
+        } else {}
+        unitdHeapSwap(i, child);
+        i = child;
+    }
+}
+
+static void unitdTimer(unitdUnit_t *unit, uint64_t at) {
+    unit->at = at;
+    if (unit->heap < 0) {
+        unit->heap = unitdHeapSize;
+        unitdHeap[unitdHeapSize++] = unit;
+    } else {}
+    unitdHeapFix(unit->heap);
+}
+
+static void unitdTimerClear(unitdUnit_t *unit) {
+    int i = unit->heap;
+
+    if (i < 0) {
+        return;
+    } else {}
+    unitdHeapSize--;
+    if (i != unitdHeapSize) {
+        unitdHeap[i] = unitdHeap[unitdHeapSize];
+        unitdHeap[i]->heap = i;
+        unitdHeapFix(i);
+    } else {}
+    unit->heap = -1;
+}
+
+/*******************************************************************************
+* Unit sessions                                                                *
+*******************************************************************************/
+static int unitdWrite(unitdUnit_t *unit, const uint8_t *bytes, int count) {
+    ssize_t written;
+
+    if (unit->fd < 0) {
+        return (0);
+    } else {}
+    written = write(unit->fd, bytes, count);
+    if (written < 0) {
+        return (((errno == EAGAIN) || (errno == EINTR)) ? 0 : -1);
+    } else {}
+    return ((int) written);
+}
+
+static void unitdProbe(unitdUnit_t *unit, uint64_t now) {
+    uint8_t request = TELEMETRYREQUEST;
+
+    if (unitdWrite(unit, &request, 1) == 1) {
+        unit->awaiting = TRUE;
+        unit->probeAt = now;
+    } else {}
+    unit->tries++;
+    unitdTimer(unit, now + UNITDPROBEWAIT);
+}
+
+static void unitdAdd(unitdUnit_t *unit, uint8_t byte, uint16_t pause) {
+    if (unit->scriptLength < UNITDSCRIPT) {
+        unit->script[unit->scriptLength].byte = byte;
+        unit->script[unit->scriptLength].pause = pause;
+        unit->scriptLength++;
+    } else {}
+}
+
+// Keystrokes for the whole carousel, the same as entering it on the panel
+static void unitdScript(unitdUnit_t *unit, uint8_t fromAir) {
+    unitdConfig_t *config = &unit->session;
+    char digits[8];
+    uint8_t i;
+    uint8_t j;
+
+    unit->scriptLength = 0;
+    unit->scriptIndex = 0;
+    if (fromAir) {
+        unitdAdd(unit, BACKSPACE, UNITDAIREXIT);
+    } else {
+        // Clear anything half typed at the frequency prompt, ignored when empty
+        for (i = 0; i < 5; i++) {
+            unitdAdd(unit, BACKSPACE, 0);
+        }
+    }
+
+    // Five digits fill the buffer, RETURN takes it
+    snprintf(digits, sizeof(digits), "%05u", config->frequency);
+    for (i = 0; i < 5; i++) {
+        unitdAdd(unit, digits[i], 0);
+    }
+    unitdAdd(unit, RETURN, UNITDSCREEN);
+
+    for (i = 0; i < config->count; i++) {
+        for (j = 0; config->text[i][j] != 0x00; j++) {
+            unitdAdd(unit, config->text[i][j], 0);
+        }
+        unitdAdd(unit, RETURN, UNITDSCREEN);
+        snprintf(digits, sizeof(digits), "%u", config->dwell[i]);
+        for (j = 0; digits[j] != 0x00; j++) {
+            unitdAdd(unit, digits[j], 0);
+        }
+        unitdAdd(unit, RETURN, UNITDENCODE);
+    }
+    // A full carousel goes to air by itself, otherwise an empty message ends it
+    if (config->count < MAXRTMESSAGES) {
+        unitdAdd(unit, RETURN, UNITDENCODE);
+    } else {}
+}
+
+static void unitdSessionStart(unitdUnit_t *unit, uint64_t now) {
+    unit->session = unit->pending;
+    unit->hasPending = FALSE;
+    unit->sessionQueuedAt = unit->queuedAt;
+    unit->sessionOverruns = unit->hasTelemetry ? unit->telemetry.uartOverruns : 0;
+    unitdScript(unit, (unit->state == UNITDONAIR));
+    unitdLog(unit, "programming %u.%02u MHz, messages %u, keystrokes %u", unit->session.frequency / 100,
+        unit->session.frequency % 100, unit->session.count, unit->scriptLength);
+    unit->state = UNITDPROGRAMMING;
+    unit->awaiting = FALSE;
+    unit->tokens = unitdBurst;
+    unit->tokensAt = now;
+    unitdTimer(unit, now);
+}
+
+// Session didn't make it to air, try again unless something newer is queued
+static void unitdSessionFailed(unitdUnit_t *unit, const char *why) {
+    unit->failures++;
+    unit->failStreak++;
+    if (unit->hasPending) {
+        unitdLog(unit, "session failed, %s", why);
+    } else if (unit->failStreak < UNITDRETRIES) {
+        unitdLog(unit, "session failed, %s, retrying", why);
+        unit->pending = unit->session;
+        unit->queuedAt = unit->sessionQueuedAt;
+        unit->hasPending = TRUE;
+    } else {
+        unitdLog(unit, "session failed, %s, giving up", why);
+        unit->failStreak = 0;
+    }
+}
+
+static void unitdOpen(unitdUnit_t *unit, uint64_t now);
+
+static void unitdClose(unitdUnit_t *unit, uint64_t now) {
+    if ((unit->state == UNITDPROGRAMMING) || (unit->state == UNITDCONFIRMING)) {
+        unitdSessionFailed(unit, "port closed");
+    } else {}
+    if (unit->fd >= 0) {
+        epoll_ctl(unitdEpoll, EPOLL_CTL_DEL, unit->fd, NULL);
+        close(unit->fd);
+        unit->fd = -1;
+    } else {}
+    unitdLog(unit, "offline");
+    unit->state = UNITDOFFLINE;
+    unitdTimer(unit, now + UNITDREOPEN);
+}
+
+static void unitdOpen(unitdUnit_t *unit, uint64_t now) {
+    struct epoll_event event;
+
+    unit->fd = serialOpen(unit->port, unit->baud);
+    if (unit->fd < 0) {
+        unit->state = UNITDOFFLINE;
+        unitdTimer(unit, now + UNITDREOPEN);
+        return;
+    } else {}
+    fcntl(unit->fd, F_SETFL, fcntl(unit->fd, F_GETFL) | O_NONBLOCK);
+    event.events = EPOLLIN;
+    event.data.ptr = unit;
+    epoll_ctl(unitdEpoll, EPOLL_CTL_ADD, unit->fd, &event);
+    unit->lineLength = 0;
+    unit->state = UNITDPROBING;
+    unit->tries = 0;
+    unitdTimer(unit, now);
+}
+
+// Sends what the pacing allows up to the next pause
+static void unitdPump(unitdUnit_t *unit, uint64_t now) {
+    uint8_t bytes[UNITDSCRIPT];
+    uint16_t pause = 0;
+    int count = 0;
+    int written;
+
+    unit->tokens += ((now - unit->tokensAt) / unitdGap);
+    if (unit->tokens > unitdBurst) {
+        unit->tokens = unitdBurst;
+    } else {}
+    unit->tokensAt = now;
+
+    while ((unit->scriptIndex + count) < unit->scriptLength && (unit->tokens >= (count+1))) {
+        bytes[count] = unit->script[unit->scriptIndex + count].byte;
+        pause = unit->script[unit->scriptIndex + count].pause;
+        count++;
+        if (pause != 0) {
+            break;
+        } else {}
+    }
+    written = unitdWrite(unit, bytes, count);
+    if (written < 0) {
+        unitdClose(unit, now);
+        return;
+    } else {}
+    unit->scriptIndex += written;
+    unit->tokens -= written;
+    if (written < count) {
+        pause = 0; // Port is backed up, the pause belongs to a byte not sent yet
+    } else {}
+
+    if (unit->scriptIndex >= unit->scriptLength) {
+        unit->state = UNITDCONFIRMING;
+        unit->tries = 0;
+        unitdTimer(unit, now + pause);
+    } else if (pause != 0) {
+        unitdTimer(unit, now + pause);
+    } else {
+        unitdTimer(unit, now + (uint64_t) unitdGap);
+    }
+}
+
+static void unitdDue(unitdUnit_t *unit, uint64_t now) {
+    switch (unit->state) {
+        case UNITDOFFLINE:
+            unitdOpen(unit, now);
+            break;
+        case UNITDPROBING:
+            if (unit->tries >= UNITDPROBETRIES) {
+                // Not on air, so sitting at a prompt
+                unitdLog(unit, "no telemetry, taken to be at the frequency prompt");
+                unit->state = UNITDIDLE;
+                unit->awaiting = FALSE;
+                if (unit->hasPending) {
+                    unitdSessionStart(unit, now);
+                } else {
+                    unitdTimer(unit, now + unitdPollEvery);
+                }
+            } else {
+                unitdProbe(unit, now);
+            }
+            break;
+        case UNITDIDLE:
+            // Someone may have put it on air from the panel, the prompt ignores '?'
+            unit->state = UNITDPROBING;
+            unit->tries = 0;
+            unitdProbe(unit, now);
+            break;
+        case UNITDONAIR:
+            if (unit->awaiting && (unit->tries >= UNITDPROBETRIES)) {
+                unitdLog(unit, "stopped answering on air");
+                unit->state = UNITDPROBING;
+                unit->tries = 0;
+                unitdTimer(unit, now);
+            } else {
+                unitdProbe(unit, now);
+            }
+            break;
+        case UNITDPROGRAMMING:
+            unitdPump(unit, now);
+            break;
+        case UNITDCONFIRMING:
+            if (unit->tries >= UNITDCONFIRMTRIES) {
+                unit->state = UNITDPROBING;
+                unit->tries = 0;
+                unitdSessionFailed(unit, "never came back on air");
+                unitdTimer(unit, now);
+            } else {
+                unitdProbe(unit, now);
+            }
+            break;
+    }
+}
+
+static int unitdHex(char c) {
+    if ((c >= '0') && (c <= '9')) {
+        return (c - '0');
+    } else if ((c >= 'a') && (c <= 'f')) {
+        return (c - 'a' + 10);
+    } else {
+        return (-1);
+    }
+}
+
+static void unitdTelemetry(unitdUnit_t *unit, uint64_t now) {
+    telemetry_t report;
+    uint8_t *bytes = (uint8_t *) &report;
+    double latency;
+    uint16_t i;
+    int high;
+    int low;
+
+    if (unit->lineLength != (1 + (2*sizeof(telemetry_t)))) {
+        return;
+    } else {}
+    for (i = 0; i < sizeof(telemetry_t); i++) {
+        high = unitdHex(unit->line[1 + (2*i)]);
+        low = unitdHex(unit->line[2 + (2*i)]);
+        if ((high < 0) || (low < 0)) {
+            return;
+        } else {}
+        bytes[i] = (uint8_t) ((high << 4) | low);
+    }
+    unit->telemetry = report;
+    unit->hasTelemetry = TRUE;
+    if (unit->awaiting) {
+        unit->rttLast = (double) (now - unit->probeAt);
+        if (unit->rttLast > unit->rttMax) {
+            unit->rttMax = unit->rttLast;
+        } else {}
+        unit->awaiting = FALSE;
+    } else {}
+
+    switch (unit->state) {
+        case UNITDPROBING:
+        case UNITDIDLE:
+            unitdLog(unit, "on air");
+            // Fall through
+        case UNITDONAIR:
+            unit->state = UNITDONAIR;
+            unit->tries = 0;
+            if (unit->hasPending) {
+                unitdSessionStart(unit, now);
+            } else {
+                unitdTimer(unit, now + unitdPollEvery);
+            }
+            break;
+        case UNITDCONFIRMING:
+            unit->state = UNITDONAIR;
+            unit->tries = 0;
+            if (report.uartOverruns != unit->sessionOverruns) {
+                // Lost keystrokes, what went on air can't be trusted
+                unit->active.frequency = 0;
+                unit->active.count = 0;
+                unitdSessionFailed(unit, "unit dropped keystrokes");
+            } else {
+                latency = (double) (now - unit->sessionQueuedAt);
+                unit->active = unit->session;
+                unit->sessions++;
+                unit->failStreak = 0;
+                unit->latencyLast = latency;
+                unit->latencySum += latency;
+                if (latency > unit->latencyMax) {
+                    unit->latencyMax = latency;
+                } else {}
+                unitdLog(unit, "on air, %.3f s after queueing", latency / 1000.0);
+            }
+            if (unit->hasPending) {
+                unitdSessionStart(unit, now);
+            } else {
+                unitdTimer(unit, now + unitdPollEvery);
+            }
+            break;
+        default:
+            break;
+    }
+}
+
+static void unitdRead(unitdUnit_t *unit, uint64_t now) {
+    uint8_t buffer[512];
+    ssize_t count;
+    ssize_t i;
+
+    for (;;) {
+        // Ports are opened with VMIN 0, so drained reads 0 rather than EAGAIN
+        count = read(unit->fd, buffer, sizeof(buffer));
+        if ((count == 0) || ((count < 0) && ((errno == EAGAIN) || (errno == EINTR)))) {
+            return;
+        } else if (count < 0) {
+            unitdClose(unit, now);
+            return;
+        } else {}
+        for (i = 0; i < count; i++) {
+            if ((buffer[i] == '\r') || (buffer[i] == '\n')) {
+                if ((unit->lineLength > 0) && (unit->line[0] == TELEMETRYREPORT)) {
+                    unitdTelemetry(unit, now);
+                } else {}
+                unit->lineLength = 0;
+            } else if ((buffer[i] >= ' ') && (unit->lineLength < (UNITDLINE-1))) {
+                unit->line[unit->lineLength++] = buffer[i];
+            } else {}
+        }
+    }
+}
+
+/*******************************************************************************
+* Updates                                                                      *
+*******************************************************************************/
+#define UNITDSETFREQUENCY 0x01
+#define UNITDSETTEXT 0x02
+
+// Merges an update into what the unit will hold, returns an error or NULL
+static const char *unitdQueue(unitdUnit_t *unit, const unitdConfig_t *update, uint8_t fields, uint64_t now) {
+    unitdConfig_t merged;
+
+    if (unit->hasPending) {
+        merged = unit->pending;
+    } else if ((unit->state == UNITDPROGRAMMING) || (unit->state == UNITDCONFIRMING)) {
+        merged = unit->session;
+    } else {
+        merged = unit->active;
+    }
+    if (fields & UNITDSETFREQUENCY) {
+        merged.frequency = update->frequency;
+    } else {}
+    if (fields & UNITDSETTEXT) {
+        merged.count = update->count;
+        memcpy(merged.dwell, update->dwell, sizeof(merged.dwell));
+        memcpy(merged.text, update->text, sizeof(merged.text));
+    } else {}
+    if (merged.frequency == 0) {
+        return ("frequency unknown, use set");
+    } else if (merged.count == 0) {
+        return ("messages unknown, use set");
+    } else {}
+
+    if (unit->hasPending) {
+        unit->merged++;
+    } else {
+        unit->queuedAt = now;
+    }
+    unit->pending = merged;
+    unit->hasPending = TRUE;
+    if ((unit->state == UNITDONAIR) || (unit->state == UNITDIDLE)) {
+        unitdSessionStart(unit, now);
+    } else {}
+    return (NULL);
+}
+
+static const char *unitdParseFrequency(const char *text, unitdConfig_t *update) {
+    char *end;
+    double mhz = strtod(text, &end);
+    long frequency = (long) ((mhz * 100) + 0.5);
+
+    if ((end == text) || (*end != 0x00) || (frequency < UNITDMINFREQUENCY) || (frequency > UNITDMAXFREQUENCY)) {
+        return ("frequency must be 70.00 to 150.00 MHz");
+    } else {}
+    update->frequency = (uint16_t) frequency;
+    return (NULL);
+}
+
+static const char *unitdParseText(const char *dwellText, const char *text, unitdConfig_t *update) {
+    char *end;
+    long dwell = strtol(dwellText, &end, 10);
+    const char *start = text;
+    uint8_t length;
+
+    if ((end == dwellText) || (*end != 0x00) || (dwell < 1) || (dwell > 255)) {
+        return ("dwell must be 1 to 255 seconds");
+    } else {}
+    update->count = 0;
+    for (;;) {
+        if (update->count >= MAXRTMESSAGES) {
+            return ("too many messages");
+        } else {}
+        for (length = 0; (start[length] != 0x00) && (start[length] != '|'); length++) {
+            if ((length >= UNITDMAXTEXT) || (start[length] < ' ') || (start[length] > '~')) {
+                return ("messages are 1 to 64 printable characters");
+            } else {}
+        }
+        if (length == 0) {
+            return ("messages are 1 to 64 printable characters");
+        } else {}
+        memcpy(update->text[update->count], start, length);
+        update->text[update->count][length] = 0x00;
+        update->dwell[update->count] = (uint8_t) dwell;
+        update->count++;
+        if (start[length] == 0x00) {
+            return (NULL);
+        } else {}
+        start += (length + 1);
+    }
+}
+
+/*******************************************************************************
+* Control clients                                                              *
+*******************************************************************************/
+static void unitdReply(unitdClient_t *client, const char *format, ...) __attribute__ ((format (printf, 2, 3)));
+static void unitdReply(unitdClient_t *client, const char *format, ...) {
+    va_list args;
+    int length;
+
+    for (;;) {
+        va_start(args, format);
+        length = vsnprintf(client->out + client->outLength, client->outSize - client->outLength, format, args);
+        va_end(args);
+        if ((length >= 0) && ((client->outLength + length) < client->outSize)) {
+            client->outLength += length;
+            return;
+        } else {}
+        client->outSize = ((client->outSize * 2) + length + 1);
+        client->out = realloc(client->out, client->outSize);
+    }
+}
+
+static void unitdStatus(unitdClient_t *client, unitdUnit_t *unit) {
+    unitdReply(client, "%s %s", unit->name, unitdStateNames[unit->state]);
+    if (unit->active.frequency != 0) {
+        unitdReply(client, " freq=%u.%02u", unit->active.frequency / 100, unit->active.frequency % 100);
+    } else {
+        unitdReply(client, " freq=?");
+    }
+    if (unit->active.count != 0) {
+        unitdReply(client, " messages=%u", unit->active.count);
+    } else {
+        unitdReply(client, " messages=?");
+    }
+    unitdReply(client, " pending=%s sessions=%u failed=%u merged=%u", unit->hasPending ? "yes" : "no",
+        unit->sessions, unit->failures, unit->merged);
+    unitdReply(client, " latency=%.0f/%.0f/%.0fms rtt=%.0f/%.0fms", unit->latencyLast,
+        unit->sessions ? (unit->latencySum / unit->sessions) : 0.0, unit->latencyMax, unit->rttLast, unit->rttMax);
+    if (unit->hasTelemetry) {
+        unitdReply(client, " groups=%u underruns=%u overruns=%u", unit->telemetry.groups,
+            unit->telemetry.underruns, unit->telemetry.uartOverruns);
+    } else {}
+    unitdReply(client, "\n");
+}
+
+// Next space separated word of a command, NULL at the end of the line
+static char *unitdWord(char **rest) {
+    char *word;
+
+    while (**rest == ' ') {
+        (*rest)++;
+    }
+    if (**rest == 0x00) {
+        return (NULL);
+    } else {}
+    word = *rest;
+    while ((**rest != ' ') && (**rest != 0x00)) {
+        (*rest)++;
+    }
+    if (**rest == ' ') {
+        *(*rest)++ = 0x00;
+    } else {}
+    return (word);
+}
+
+static void unitdCommand(unitdClient_t *client, char *line, uint64_t now) {
+    unitdConfig_t update;
+    const char *error = NULL;
+    char *command;
+    char *target;
+    char *word;
+    char *rest = line;
+    uint8_t fields = 0;
+    int matched = 0;
+    int i;
+
+    memset(&update, 0, sizeof(update));
+    command = unitdWord(&rest);
+    target = unitdWord(&rest);
+    if (command == NULL) {
+        return;
+    } else {}
+
+    if (strcmp(command, "status") == 0) {
+        for (i = 0; i < unitdUnitCount; i++) {
+            if ((target == NULL) || (strcmp(target, unitdUnits[i]->name) == 0)) {
+                unitdStatus(client, unitdUnits[i]);
+                matched++;
+            } else {}
+        }
+        if (matched == 0) {
+            unitdReply(client, "error no unit %s\n", target);
+        } else {}
+        unitdReply(client, ".\n");
+        return;
+    } else {}
+
+    // Message text is the rest of the line and keeps its spaces
+    if ((target != NULL) && (strcmp(command, "set") == 0) && ((word = unitdWord(&rest)) != NULL)) {
+        error = unitdParseFrequency(word, &update);
+        if ((error == NULL) && ((word = unitdWord(&rest)) != NULL)) {
+            error = unitdParseText(word, rest, &update);
+        } else if (error == NULL) {
+            error = "usage: set <unit|*> <MHz> <dwell> <message>[|<message>...]";
+        } else {}
+        fields = (UNITDSETFREQUENCY | UNITDSETTEXT);
+    } else if ((target != NULL) && (strcmp(command, "freq") == 0) && ((word = unitdWord(&rest)) != NULL)) {
+        error = unitdParseFrequency(word, &update);
+        fields = UNITDSETFREQUENCY;
+    } else if ((target != NULL) && (strcmp(command, "text") == 0) && ((word = unitdWord(&rest)) != NULL)) {
+        error = unitdParseText(word, rest, &update);
+        fields = UNITDSETTEXT;
+    } else {
+        error = "usage: set|freq|text <unit|*> ..., status [unit]";
+    }
+    if (error != NULL) {
+        unitdReply(client, "error %s\n.\n", error);
+        return;
+    } else {}
+
+    for (i = 0; i < unitdUnitCount; i++) {
+        if ((strcmp(target, "*") == 0) || (strcmp(target, unitdUnits[i]->name) == 0)) {
+            matched++;
+            error = unitdQueue(unitdUnits[i], &update, fields, now);
+            if (error != NULL) {
+                unitdReply(client, "error %s %s\n", unitdUnits[i]->name, error);
+            } else {
+                unitdReply(client, "queued %s\n", unitdUnits[i]->name);
+            }
+        } else {}
+    }
+    if (matched == 0) {
+        unitdReply(client, "error no unit %s\n", target);
+    } else {}
+    unitdReply(client, ".\n");
+}
+
+static void unitdClientClose(unitdClient_t *client) {
+    epoll_ctl(unitdEpoll, EPOLL_CTL_DEL, client->fd, NULL);
+    close(client->fd);
+    free(client->out);
+    free(client);
+}
+
+// Returns FALSE once the client is gone
+static int unitdClientFlush(unitdClient_t *client) {
+    struct epoll_event event;
+    ssize_t written;
+
+    while (client->outLength > 0) {
+        written = write(client->fd, client->out, client->outLength);
+        if ((written < 0) && (errno == EAGAIN)) {
+            break;
+        } else if (written <= 0) {
+            unitdClientClose(client);
+            return (FALSE);
+        } else {}
+        memmove(client->out, client->out + written, client->outLength - written);
+        client->outLength -= written;
+    }
+    event.events = ((client->outLength > 0) ? (EPOLLIN | EPOLLOUT) : EPOLLIN);
+    event.data.ptr = client;
+    epoll_ctl(unitdEpoll, EPOLL_CTL_MOD, client->fd, &event);
+    return (TRUE);
+}
+
+static void unitdClientRead(unitdClient_t *client, uint64_t now) {
+    char buffer[512];
+    ssize_t count;
+    ssize_t i;
+
+    for (;;) {
+        count = read(client->fd, buffer, sizeof(buffer));
+        if ((count < 0) && (errno == EAGAIN)) {
+            break;
+        } else if (count <= 0) {
+            unitdClientClose(client);
+            return;
+        } else {}
+        for (i = 0; i < count; i++) {
+            if (buffer[i] == '\n') {
+                if ((client->inLength > 0) && (client->in[client->inLength-1] == '\r')) {
+                    client->inLength--;
+                } else {}
+                client->in[client->inLength] = 0x00;
+                unitdCommand(client, client->in, now);
+                client->inLength = 0;
+            } else if (client->inLength < (UNITDLINE-1)) {
+                client->in[client->inLength++] = buffer[i];
+            } else {}
+        }
+    }
+    (void) unitdClientFlush(client);
+}
+
+static void unitdAccept(int listener) {
+    struct epoll_event event;
+    unitdClient_t *client;
+    int fd;
+
+    while ((fd = accept4(listener, NULL, NULL, SOCK_NONBLOCK | SOCK_CLOEXEC)) >= 0) {
+        client = calloc(1, sizeof(unitdClient_t));
+        client->kind = UNITDCLIENT;
+        client->fd = fd;
+        client->outSize = 4096;
+        client->out = malloc(client->outSize);
+        event.events = EPOLLIN;
+        event.data.ptr = client;
+        epoll_ctl(unitdEpoll, EPOLL_CTL_ADD, fd, &event);
+    }
+}
+
+static int unitdLoadUnits(const char *path) {
+    char line[UNITDLINE];
+    char name[32];
+    char port[256];
+    unsigned baud;
+    unitdUnit_t *unit;
+    FILE *file;
+    int fields;
+
+    file = fopen(path, "r");
+    if (file == NULL) {
+        perror(path);
+        return (-1);
+    } else {}
+    while (fgets(line, sizeof(line), file)) {
+        baud = 9600;
+        fields = sscanf(line, "%31s %255s %u", name, port, &baud);
+        if ((fields < 2) || (name[0] == '#')) {
+            continue;
+        } else {}
+        if (unitdUnitCount >= UNITDMAXUNITS) {
+            fprintf(stderr, "%s: more than %d units\n", path, UNITDMAXUNITS);
+            break;
+        } else {}
+        unit = calloc(1, sizeof(unitdUnit_t));
+        unit->kind = UNITDUNIT;
+        unit->fd = -1;
+        unit->heap = -1;
+        unit->baud = baud;
+        strcpy(unit->name, name);
+        strcpy(unit->port, port);
+        unitdUnits[unitdUnitCount++] = unit;
+    }
+    fclose(file);
+    return (unitdUnitCount);
+}
+
+static void unitdUsage(void) {
+    fprintf(stderr,
+        "usage: unitd [-s socket] [-g ms] [-b bytes] [-p seconds] units.conf\n"
+        "  -s socket   control socket (default /tmp/unitd.sock)\n"
+        "  -g ms       time between keystrokes (default 3)\n"
+        "  -b bytes    keystrokes sent back to back after a pause (default 8)\n"
+        "  -p seconds  telemetry poll of units on air (default 10)\n");
+    exit(1);
+}
+
+int main(int argc, char **argv) {
+    struct epoll_event events[UNITDEVENTS];
+    struct epoll_event event;
+    struct sockaddr_un address;
+    const char *socketPath = "/tmp/unitd.sock";
+    unitdUnit_t *unit;
+    uint64_t now;
+    int listener;
+    int timeout;
+    int option;
+    int count;
+    int i;
+
+    while ((option = getopt(argc, argv, "s:g:b:p:")) != -1) {
+        switch (option) {
+            case 's': socketPath = optarg; break;
+            case 'g': unitdGap = atof(optarg); break;
+            case 'b': unitdBurst = atof(optarg); break;
+            case 'p': unitdPollEvery = (uint64_t) (atof(optarg) * 1000); break;
+            default: unitdUsage();
+        }
+    }
+    if ((optind >= argc) || (unitdGap <= 0) || (unitdBurst < 1) || (unitdPollEvery == 0)) {
+        unitdUsage();
+    } else {}
+    if (unitdLoadUnits(argv[optind]) <= 0) {
+        fprintf(stderr, "%s: no units\n", argv[optind]);
+        return (1);
+    } else {}
+    signal(SIGPIPE, SIG_IGN);
+
+    unitdEpoll = epoll_create1(EPOLL_CLOEXEC);
+    listener = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    memset(&address, 0, sizeof(address));
+    address.sun_family = AF_UNIX;
+    strncpy(address.sun_path, socketPath, sizeof(address.sun_path) - 1);
+    unlink(socketPath);
+    if ((bind(listener, (struct sockaddr *) &address, sizeof(address)) < 0) || (listen(listener, 16) < 0)) {
+        perror(socketPath);
+        return (1);
+    } else {}
+    event.events = EPOLLIN;
+    event.data.ptr = &unitdListener;
+    epoll_ctl(unitdEpoll, EPOLL_CTL_ADD, listener, &event);
+
+    unitdStart = unitdNow();
+    for (i = 0; i < unitdUnitCount; i++) {
+        unitdOpen(unitdUnits[i], unitdStart);
+    }
+    printf("unitd: %d units, control on %s\n", unitdUnitCount, socketPath);
+    fflush(stdout);
+
+    for (;;) {
+        now = unitdNow();
+        if (unitdHeapSize == 0) {
+            timeout = -1;
+        } else if (unitdHeap[0]->at <= now) {
+            timeout = 0;
+        } else {
+            timeout = (int) (unitdHeap[0]->at - now);
+        }
+        count = epoll_wait(unitdEpoll, events, UNITDEVENTS, timeout);
+        now = unitdNow();
+        for (i = 0; i < count; i++) {
+            switch (*((unitdKind_t *) events[i].data.ptr)) {
+                case UNITDLISTENER:
+                    unitdAccept(listener);
+                    break;
+                case UNITDCLIENT:
+                    if (events[i].events & EPOLLIN) {
+                        unitdClientRead(events[i].data.ptr, now);
+                    } else {
+                        (void) unitdClientFlush(events[i].data.ptr);
+                    }
+                    break;
+                case UNITDUNIT:
+                    unit = events[i].data.ptr;
+                    if ((unit->fd >= 0) && (events[i].events & (EPOLLHUP | EPOLLERR))) {
+                        unitdClose(unit, now);
+                    } else if (unit->fd >= 0) {
+                        unitdRead(unit, now);
+                    } else {}
+                    break;
+            }
+        }
+        while ((unitdHeapSize > 0) && (unitdHeap[0]->at <= now)) {
+            unit = unitdHeap[0];
+            unitdTimerClear(unit);
+            unitdDue(unit, now);
+        }
+    }
+}
@@ -0,0 +1,2600 @@
+/*******************************************************************************
+* Transmitter Unit Simulator                                                   *
+*                                                                              *
+* Runs the transmitter firmware on the host with its UART on a pty, as a       *
+* local stand-in for a unit when testing host tools such as unitd. main.c,     *
+* uart.c, eeprom.c, rbds.c, crc.c, trace.c, rtc.c & urgent.c are built         *
+* unchanged against the register shim; the LCD, DAC and EEPROM are modelled    *
+* here, and the interrupt stubs are run from sample.c's own asm with each      *
+* instruction's cycles. Simulated time follows real time, so UART              *
+* pacing, LCD busy waits and EEPROM writes cost what they do on the part and   *
+* an overrun here is an overrun there.                                         *
+*                                                                              *
+* unitsim [-a mix] [-c] [-e eeprom.bin] [-f count] [-i level] [-j] [-l]        *
+*         [-p text] [-s step] [-u count] [-v trace.vcd] [-x speed]             *
+*         [-R capture] [-r capture [-g ms] [-m ms]]                            *
+*                                                                              *
+* Prints the pty to use. -e keeps the EEPROM in a file so a unit restarted     *
+* with it goes straight to air, -l prints the LCD each time it settles with    *
+* new contents, -x runs the clock faster or slower than real time. -R appends  *
+* every byte the host sends to a capture file. DAC tuning                      *
+* changes are always printed. The bootloader request is not modelled, the      *
+* firmware waits forever for a watchdog reset that never comes.                *
+*                                                                              *
+* -c sets the unit clock to host UTC once on air, then demodulates the sample  *
+* DAC and prints each 4A clock time group with how far its first bit went out  *
+* from the minute edge it marks, timed from the set.                           *
+*                                                                              *
+* -p sets the PS text once on air, then demodulates the 0A groups and prints   *
+* each name a receiver would put together from four segments in a row, timed   *
+* from the last one, only when it differs.                                     *
+*                                                                              *
+* -a sets the group mix once on air, then records a minute of demodulated      *
+* bits and has a receiver join them at random points over many trials. It      *
+* syncs on two blocks in a row, and is done with PS once it holds all four     *
+* segments, with radiotext once it holds every segment up to the \r of one     *
+* text A/B. Prints the time from joining to PI, PS and full radiotext, and     *
+* the 0A and 2A group rates, then exits.                                       *
+*                                                                              *
+* -i switches the injection level between level and full at a random point     *
+* every second or so once on air, demodulating the sample DAC and printing     *
+* any symbol it loses lock on. A change that isn't glitch free shows up there. *
+*                                                                              *
+* -s steps the injection level from 0 to full once on air, measuring the peak  *
+* of the sample DAC about its midpoint for two symbols at each level. Exits at *
+* full, failing unless each peak is above the last and within a code of the    *
+* level's share of the full swing, which a wave wrapping past the DAC's 12     *
+* bits can't be.                                                               *
+*                                                                              *
+* -u sends count urgent 8A groups one at a time at random points in the group  *
+* cycle and times each from the last char of its command to its first bit on   *
+* air. Exits once all are in, failing if any took longer than the firmware     *
+* promises: a group and a main loop pass, or two groups with -c.               *
+*                                                                              *
+* -f sends count channel switches one at a time at random points in the group  *
+* cycle, mostly on the FM band raster and some off it, and times each from the *
+* last char of its command to data back on air after the quiet symbols. The    *
+* VCO is modelled as a first order loop on the channel A code; each switch     *
+* prints how far it was off the new code when data resumed, and how far it     *
+* would have been with a plain step. Exits once all are in, failing if any     *
+* took longer than a group, a main loop pass and the longest hold, or resumed  *
+* with the VCO further off than the tolerance.                                 *
+*                                                                              *
+* -j enters the sample interrupt stub anywhere in the window it pads out, not  *
+* just when it would on the part, and checks every LDAC rise the asm makes     *
+* comes the same cycles after its compare match with the word the handler      *
+* loaded. On air it sends commands that keep the UART busy both ways and trace *
+* every sample; a compare match while interrupts are off, in a UART stub as    *
+* its asm runs or in C as counted in unitsimMaskedCode, enters as late as that *
+* holds it off instead. Exits after a second on air, failing on any jitter or  *
+* wrong word.                                                                  *
+*                                                                              *
+* -v records CS on PD5, SCK, MOSI, LDAC on PB1, the pilot on PB2 and the       *
+* carrier on PD6 to a VCD file for a second from going on air, with a channel  *
+* switch there and back in it. Sample frames are timed by running the stub's   *
+* asm as for -j, entered anywhere in its window, and channel A frames by a     *
+* count of the instructions spiUpdateDac's C compiles to, started about where  *
+* the handler reaches them. Every frame is checked against the MCP4822 minimum *
+* times, each after the first against the last latch, each sample latch        *
+* against a sample period after the last, each symbol latch against the pilot  *
+* phase of the first, and the carrier against 3x pilot. Prints the closest     *
+* each rule came then exits, failing if any broke. make check runs it with -j  *
+* and -s on a unit put on air from typed keys.                                 *
+*                                                                              *
+* -r replays a capture into the UART once the firmware first sleeps, a byte    *
+* every -g ms (default 0, back to back at 9600 baud), and follows each key     *
+* from its frame landing, to the firmware taking it from the Rx ring, to the   *
+* last LCD command it drew before the next key was taken. Keys the Rx ring had *
+* no room for are dropped. Once a second passes with nothing happening, prints *
+* each key and the latency spread then exits, failing on any drop or on a key  *
+* slower than -m ms if given. With -l every LCD command is printed as it       *
+* completes, timed from the start of the replay. Nothing else should be sent   *
+* on the pty meanwhile.                                                        *
+*                                                                              *
+*******************************************************************************/
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <math.h>
+#include <poll.h>
+#include <termios.h>
+#include <time.h>
+#include <unistd.h>
+
+#pragma pack(push, 1)
+#include "includes.h"
+#pragma pack(pop)
+
+#define UNITSIMCPUHZ 16000000.0
+#define UNITSIMTICK ((uint64_t) 421) // Timer 1 OCR1A+1, one sample period
+#define UNITSIMCHAR ((uint64_t) (10*16000000/9600)) // UART frame at 9600 baud
+#define UNITSIMSLACK ((uint64_t) 32000) // Simulated time may run 2ms ahead of real time
+#define UNITSIMFOREVER UINT64_MAX
+#define UNITSIMUDRIDLE ((uint16_t) 0xffff)
+#define UNITSIMRXFIFO 4096 // Must be a power of 2
+#define UNITSIMEEPROM 1024
+#define UNITSIMEEPROMWRITE 3400.0 // us per byte erase & write
+#define UNITSIMLCDCMD 43.0 // us per LCD command or char
+#define UNITSIMGROUPBITS 104
+#define UNITSIMMJDUNIX 40587 // MJD of 1 Jan 1970
+#define UNITSIMGROUP8A ((uint8_t) 0x10)
+#define UNITSIMGROUPCYCLES ((uint64_t) (UNITSIMGROUPBITS*SAMPLESPERSYMBOL*UNITSIMTICK))
+#define UNITSIMLOOPPASS ((uint64_t) 32000) // Allowance for the main loop to take the command, 2ms
+#define UNITSIMSYMBOLCYCLES ((uint64_t) (SAMPLESPERSYMBOL*UNITSIMTICK))
+#define UNITSIMVCOTAU 1.2e-3 // VCO loop time constant, seconds
+#define UNITSIMVCOTOLERANCE 2.0 // Codes the VCO may be off the new code when data resumes
+#define UNITSIMREPLAYQUIET ((uint64_t) 16000000) // Replay ends after a second with no key or LCD command
+#define UNITSIMACQUIREBITS ((size_t) 71250) // Bits recorded for -a, a minute
+#define UNITSIMACQUIRETRIALS 10000
+#define UNITSIMVCDSCALE ((uint64_t) 625) // VCD 100ps units per cycle at 16MHz
+#define UNITSIMVCDCYCLES ((uint64_t) 16000000) // Cycles recorded for -v, a second
+#define UNITSIMVCDEDGES 4096 // Edges waiting to be written in time order
+#define UNITSIMSTUBLINES 256 // Stub lines once .rept is expanded
+#define UNITSIMSTUBSTEPS 1024 // Instructions the stub may take before it is given up on
+#define UNITSIMSPIBYTE 16 // Cycles from SPDR written to SPIF, F_CPU/2 SPI
+#define SAMPLEASM(x) SAMPLEASMSTRING(x) // As in sample.c, for its asm
+#define SAMPLEASMSTRING(x) #x
+#define UNITSIMHANDLERLEAD ((uint64_t) 120) // Handler cycles ahead of a channel A write, roughly
+#define UNITSIMINTERRUPTENTRY 7 // Cycles to respond to an interrupt and take the vector jump
+#define UNITSIMJITTERGAP ((uint64_t) 1600000) // Between the commands -j sends, 100ms
+// Timing rules for -v, indexes into unitsimVcdRules
+#define UNITSIMRULECSS 0
+#define UNITSIMRULESU 1
+#define UNITSIMRULEHD 2
+#define UNITSIMRULEHI 3
+#define UNITSIMRULELO 4
+#define UNITSIMRULECHS 5
+#define UNITSIMRULEIDLE 6
+#define UNITSIMRULELS 7
+#define UNITSIMRULELD 8
+#define UNITSIMRULECLOCKS 9
+#define UNITSIMRULEOVERLAP 10
+#define UNITSIMRULESAMPLE 11
+#define UNITSIMRULESYMBOL 12
+#define UNITSIMRULEPHASE 13
+#define UNITSIMRULES 14
+
+// Registers, see shim/avr/io.h
+volatile uint8_t MCUSR, PRR, ACSR;
+volatile uint8_t PORTB, DDRB, PORTD, DDRD;
+volatile uint8_t TCCR0A, TCCR0B, OCR0A;
+volatile uint8_t TCCR1A, TCCR1B, TIMSK1, TIFR1, OCR1AH, OCR1AL;
+volatile uint16_t TCNT1, OCR1A;
+volatile uint8_t TCCR2A, TCCR2B, OCR2A;
+volatile uint8_t UCSR0A, UCSR0B, UCSR0C, UBRR0H, UBRR0L;
+volatile uint16_t UDR0 = UNITSIMUDRIDLE;
+volatile uint8_t GPIOR1, GPIOR2;
+uint8_t simRam[0x900];
+
+// Sample stub, see sample.c
+volatile uint16_t sampleEntry;
+
+// Firmware entry points, main.c is built with main renamed
+extern int firmwareMain(void);
+extern void mainResetInit(void);
+extern void __vector_sample(void);
+extern volatile uint8_t mainSleeping;
+extern void TIMER1_COMPB_vect(void);
+extern void __vector_uartrx(void);
+extern void __vector_uarttx(void);
+extern uint16_t *mainTxWave;
+extern uint8_t mainTxSample;
+extern config_t mainConfig;
+extern uint8_t __real_uartRx(void);
+
+// Pins and values in the -v trace
+typedef enum {UNITSIMVCDCS, UNITSIMVCDSCK, UNITSIMVCDMOSI, UNITSIMVCDLDAC, UNITSIMVCDPILOT, UNITSIMVCDCARRIER,
+    UNITSIMVCDSYMBOL, UNITSIMVCDDACA, UNITSIMVCDDACB, UNITSIMVCDSIGNALS} unitsimvcdsignal_t;
+
+typedef struct {
+    uint64_t time;       // Cycle
+    uint32_t order;      // Made before any later edge at the same cycle
+    uint8_t signal;
+    uint16_t value;
+} unitsimedge_t;
+
+// Timing rule, held by every measurement at least limit, or exactly with exact
+typedef struct {
+    const char *name;
+    double limit;        // ns, below 0 to take the first measurement
+    uint8_t exact;
+    double least;
+    double most;
+    uint32_t measured;
+    uint32_t broken;
+    uint64_t first;      // Cycle first broken
+} unitsimrule_t;
+
+// A replayed key from its frame landing to its last LCD command, cycles
+typedef struct {
+    uint8_t byte;
+    uint8_t dropped;
+    uint64_t arrived;
+    uint64_t taken;
+    uint64_t drawn;
+    uint16_t writes;
+} unitsimkey_t;
+
+// Interrupt stub instructions, see unitsimStubLoad
+typedef enum {UNITSIMOPNOP, UNITSIMOPPUSH, UNITSIMOPPOP, UNITSIMOPIN, UNITSIMOPOUT, UNITSIMOPLDS, UNITSIMOPSTS,
+    UNITSIMOPTST, UNITSIMOPBREQ, UNITSIMOPBRLO, UNITSIMOPLDI, UNITSIMOPSUBI, UNITSIMOPSBCI, UNITSIMOPCPI,
+    UNITSIMOPCLR, UNITSIMOPIJMP, UNITSIMOPCBI, UNITSIMOPSBI, UNITSIMOPSBRS, UNITSIMOPRJMP, UNITSIMOPJMP,
+    UNITSIMOPSEI, UNITSIMOPS} unitsimop_t;
+
+// I/O and data the stubs touch, by their asm operand names, handlers last
+typedef enum {UNITSIMIONONE, UNITSIMIOSREG, UNITSIMIOTCNTL, UNITSIMIOTCNTH, UNITSIMIOLOW, UNITSIMIOHIGH,
+    UNITSIMIOSPDR, UNITSIMIOSPSR, UNITSIMIOPORTD, UNITSIMIOPORTB, UNITSIMIOENTRY, UNITSIMIOUCSR0A, UNITSIMIOUCSR0B,
+    UNITSIMIOUDR0, UNITSIMIORXSTATUS, UNITSIMIORXBYTE, UNITSIMIOHANDLER, UNITSIMIORXHANDLER,
+    UNITSIMIOTXHANDLER} unitsimio_t;
+
+// Stubs in sample.c, by the vector each starts at
+typedef enum {UNITSIMVECTORSAMPLE, UNITSIMVECTORRX, UNITSIMVECTORTX, UNITSIMVECTORS} unitsimvector_t;
+
+// Code that turns interrupts off, by the function it is in, and the cycles
+// from the cli to the first an interrupt can be taken
+typedef struct {
+    const char *where;
+    uint16_t cycles;
+} unitsimmasked_t;
+
+typedef struct {
+    uint8_t op;
+    int8_t label;        // Local label on the line, -1 for none
+    uint8_t reg;
+    uint8_t io;
+    uint8_t value;       // Immediate, or bit for cbi, sbi & sbrs
+    uint16_t target;     // Line branched to
+    uint16_t word;       // Program word address
+    char text[32];
+} unitsimasm_t;
+
+// DAC frame pin changes, cycles after the stub's compare match or spiUpdateDac's call
+typedef struct {
+    uint16_t select;     // CS falls
+    uint16_t load[2];    // SPDR written, low byte then high
+    uint16_t word;       // As sent
+    uint16_t deselect;   // CS rises
+    uint16_t latch[2];   // LDAC falls & rises
+    uint16_t exit;       // Handler entered
+} unitsimstub_t;
+
+static uint64_t unitsimCycles = 0;
+static uint64_t unitsimNextTick = UNITSIMTICK;
+static uint64_t unitsimTickPrescale = 1;
+static uint64_t unitsimRxNext = 0;
+static uint64_t unitsimTxFree = 0;
+static struct timespec unitsimEpoch;
+static double unitsimSpeed = 1.0;
+static int unitsimPty;
+static uint8_t unitsimRx[UNITSIMRXFIFO];
+static uint16_t unitsimRxHead = 0;
+static uint16_t unitsimRxTail = 0;
+static uint8_t unitsimEeprom[UNITSIMEEPROM];
+static int unitsimEepromFile = -1;
+static uint64_t unitsimEepromReady;
+static uint8_t unitsimLcd[2][16];
+static uint8_t unitsimLcdShown[2][16];
+static uint8_t unitsimLcdRow = 0;
+static uint8_t unitsimLcdCol = 0;
+static int unitsimLcdEcho = FALSE;
+static uint16_t unitsimTuning = 0;
+static uint8_t unitsimOnAir = FALSE;
+static int unitsimClock = FALSE;
+static uint8_t unitsimClockSent = FALSE;
+static uint64_t unitsimClockSetAt; // Cycle the last char of the clock set arrives
+static int64_t unitsimClockSetUnix; // UTC the set carried
+static int unitsimUrgent = 0; // Urgent groups to time
+static int unitsimUrgentDone = 0;
+static uint16_t unitsimUrgentSequence = 0; // Block D of the group in flight, 0 for none
+static uint64_t unitsimUrgentAt = 0; // Cycle to send the next, or its last char arrives
+static uint64_t unitsimUrgentWorst = 0;
+static uint64_t unitsimUrgentTotal = 0;
+static int unitsimChannel = 0; // Channel switches to time
+static int unitsimChannelDone = 0;
+static uint16_t unitsimChannelFrequency = 0; // Switch in flight, 0 for none
+static uint16_t unitsimChannelFrom; // Code before it
+static uint64_t unitsimChannelAt = 0; // Cycle to send the next, or its last char arrives
+static uint32_t unitsimChannelQuiet = 0; // Quiet samples in a row
+static uint64_t unitsimChannelWorst = 0;
+static uint64_t unitsimChannelTotal = 0;
+static double unitsimChannelOff = 0; // Most the VCO was off when data resumed, codes
+static double unitsimVco = 0; // Code the VCO is at
+static uint64_t unitsimVcoAt = 0; // Cycle it was worked out
+static const char *unitsimPs = NULL; // PS text to set
+static uint8_t unitsimPsSent = FALSE;
+static char unitsimPsName[9]; // Name being put together
+static char unitsimPsShown[9];
+static uint8_t unitsimPsSegments = 0; // Segments of it in a row
+static uint64_t unitsimPsAt; // Cycle the set's last char arrives, then the last name changed
+static int unitsimInjection = -1; // Level to switch to and from, -1 for none
+static uint8_t unitsimInjectionNow = INJECTIONFULL;
+static uint64_t unitsimInjectionAt = 0; // Cycle to send the next switch
+static int unitsimSweep = 0; // Injection step for -s, 0 for none
+static int unitsimSweepLevel = -1; // Level being measured, -1 before the first
+static uint64_t unitsimSweepFrom; // Cycle measuring starts, once the level is on air
+static uint64_t unitsimSweepUntil;
+static int32_t unitsimSweepPeak; // Furthest from DACMID at this level
+static int32_t unitsimSweepLast = -1; // Peak at the level before
+static uint8_t unitsimSweepFailed = FALSE;
+static int unitsimAcquire = -1; // Group mix to measure, -1 for none
+static uint8_t unitsimAcquireSent = FALSE;
+static uint64_t unitsimAcquireFrom; // Cycle recording starts, once the mix is on air
+static uint8_t unitsimAcquireBits[UNITSIMACQUIREBITS];
+static uint64_t unitsimAcquireTimes[UNITSIMACQUIREBITS];
+static size_t unitsimAcquireLength = 0;
+static FILE *unitsimVcd = NULL;
+static uint64_t unitsimVcdStart; // Cycle recording started
+static unitsimedge_t unitsimVcdEdges[UNITSIMVCDEDGES];
+static uint16_t unitsimVcdCount = 0;
+static uint32_t unitsimVcdOrder = 0;
+static uint16_t unitsimVcdLevel[UNITSIMVCDSIGNALS]; // Last written
+static uint64_t unitsimVcdAt[UNITSIMVCDSIGNALS]; // Cycle each last changed
+static uint8_t unitsimVcdClocks; // SCK rises in the frame
+static uint64_t unitsimVcdBusy = 0; // Cycle the last frame's latch ends
+static uint64_t unitsimVcdCarrierAt = 0; // Next carrier toggle, 0 before the timer runs
+static uint32_t unitsimVcdCarrierToggles = 0;
+static uint64_t unitsimVcdCarrierFirst;
+static uint8_t unitsimVcdRecording = FALSE;
+static uint64_t unitsimVcdWritten = UNITSIMFOREVER; // Cycle of the last time written
+static uint8_t unitsimVcdPilot = 0;
+static uint64_t unitsimVcdCarrierLast;
+static uint64_t unitsimVcdRise = 0; // Cycle SCK last rose
+static uint8_t unitsimVcdSymbol = FALSE; // Sample the stub latches next starts a symbol
+static uint64_t unitsimVcdSampleLatch = 0;
+static uint64_t unitsimVcdSymbolLatch = 0;
+static uint64_t unitsimVcdPilotRise = 0;
+static uint8_t unitsimVcdSwitches = 0; // Channel switches sent
+static uint16_t unitsimVcdFrequency;
+static uint8_t unitsimInSample = FALSE; // Sample handler running, channel A writes come after the stub's
+// MCP4822 minimum times, then what the sample engine holds to
+static unitsimrule_t unitsimVcdRules[UNITSIMRULES] = {
+    {"CS low to first SCK rise", 40.0, FALSE},
+    {"MOSI setup to SCK rise", 15.0, FALSE},
+    {"MOSI hold after SCK rise", 10.0, FALSE},
+    {"SCK high", 15.0, FALSE},
+    {"SCK low", 15.0, FALSE},
+    {"last SCK rise to CS high", 15.0, FALSE},
+    {"CS high between frames", 15.0, FALSE},
+    {"CS high to LDAC low", 40.0, FALSE},
+    {"LDAC low", 100.0, FALSE},
+    {"SCK rises a frame", 16.0, TRUE},
+    {"frame start to last latch", 0.0, FALSE},
+    {"sample latch period", (UNITSIMTICK*1e9/UNITSIMCPUHZ), TRUE},
+    {"symbol latch period", (SAMPLESPERSYMBOL*UNITSIMTICK*1e9/UNITSIMCPUHZ), TRUE},
+    {"pilot rise to symbol latch", -1.0, TRUE},
+};
+static uint16_t unitsimDemodSamples[SAMPLESPERSYMBOL];
+static uint64_t unitsimDemodTimes[SAMPLESPERSYMBOL];
+static uint8_t unitsimDemodCount = 0; // Samples into the symbol, SAMPLESPERSYMBOL while hunting
+static uint8_t unitsimDemodLocked = FALSE;
+static uint8_t unitsimDemodLevel = 0;
+static uint8_t unitsimDemodBits[UNITSIMGROUPBITS]; // Last group of bits, oldest first
+static uint64_t unitsimDemodBitTimes[UNITSIMGROUPBITS];
+static int unitsimJitter = FALSE;
+static uint32_t unitsimJitterSamples = 0;
+static uint16_t unitsimJitterEntry[2] = {0xffff, 0}; // Fewest & most cycles in
+static uint16_t unitsimJitterLatch[2] = {0xffff, 0}; // Fewest & most cycles to the DAC latch
+static uint32_t unitsimJitterWrong = 0; // Words sent other than the one loaded
+static uint32_t unitsimJitterHeld = 0; // Samples held off by interrupts being off
+static uint16_t unitsimJitterMost = 0; // Longest any was held off
+static const char *unitsimJitterBy = "nothing";
+static uint8_t unitsimJitterSent = 0; // Commands sent
+static uint64_t unitsimJitterAt = 0; // Cycle to send the next, 0 before going on air
+static uint64_t unitsimMaskedFrom = 0; // Cycle interrupts last went off
+static uint64_t unitsimMaskedUntil = 0; // First cycle after it an interrupt can be taken
+static const char *unitsimMaskedBy = "";
+// Interrupts off in the firmware's C and in avr-libc, counted by hand as
+// avr-gcc -Os compiles them, with 4 for the instruction after interrupts come
+// back on. The UART stubs are timed from their asm instead.
+static const unitsimmasked_t unitsimMaskedCode[] = {
+    {"traceRecord", 27},        // Ticks, epoch & mark loaded, head loaded & stored
+    {"traceDumpStart", 22},     // Epoch & ticks copied
+    {"rtcNextMinute", 18},      // Seconds & countdown loaded
+    {"mainTelemetryStart", 22}, // One 32 bit count copied
+    {"mainUrgentPreempt", 22},  // Flags tested, held & next stored
+    {"mainClockSplice", 12},    // Block, bit & sample loaded
+    {"mainSleep", 14},          // TCNT1 loaded & stored
+    {"eeprom_write_byte", 12},  // EEMPE & EEPE set, the CPU halts 2 for the write
+    {"wdt_enable", 11},         // Change enable & new setting written
+    {"wdt_disable", 14},        // Read, change enable & off written
+};
+static const char unitsimStubAsm[] =
+#include "unitsim-stub.h"
+    "";
+static unitsimasm_t unitsimStub[UNITSIMSTUBLINES];
+static uint16_t unitsimStubLength = 0;
+static uint16_t unitsimStubVector[UNITSIMVECTORS]; // Line each stub starts at
+static int unitsimCaptureFile = -1;
+static unitsimkey_t *unitsimReplay = NULL; // Keys of the capture being replayed
+static size_t unitsimReplayLength = 0;
+static size_t unitsimReplayFed = 0; // Keys queued for the UART
+static size_t unitsimReplayArrived = 0; // Keys landed in UDR0
+static size_t unitsimReplayTaken = 0; // Keys taken or dropped
+static size_t unitsimReplayDrawing = 0; // Key the LCD is answering, 1 based, 0 for none
+static uint8_t unitsimReplayStarted = FALSE;
+static uint64_t unitsimReplayStart; // Cycle the replay started
+static uint64_t unitsimReplayAt; // Cycle the next key is due to land
+static uint64_t unitsimReplayLast; // Cycle anything last happened
+static double unitsimReplayGap = 0;
+static double unitsimReplayBound = 0;
+
+static void unitsimSampleStub(void);
+static uint16_t unitsimUartStub(uint8_t vector);
+
+static uint64_t unitsimRealCycles(void) {
+    struct timespec now;
+
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return ((uint64_t) ((((now.tv_sec - unitsimEpoch.tv_sec) * 1e9) + (now.tv_nsec - unitsimEpoch.tv_nsec))
+        * (UNITSIMCPUHZ / 1e9) * unitsimSpeed));
+}
+
+// Waits up to cycles of real time for the host to send, forever if UNITSIMFOREVER
+static void unitsimWait(uint64_t cycles) {
+    struct pollfd wait = {unitsimPty, POLLIN, 0};
+    struct timespec timeout;
+    double seconds;
+
+    if (cycles == UNITSIMFOREVER) {
+        (void) ppoll(&wait, 1, NULL, NULL);
+    } else {
+        seconds = cycles / (UNITSIMCPUHZ * unitsimSpeed);
+        timeout.tv_sec = (time_t) seconds;
+        timeout.tv_nsec = (long) ((seconds - timeout.tv_sec) * 1e9);
+        (void) ppoll(&wait, 1, &timeout, NULL);
+    }
+}
+
+// Bytes from the host queue up and reach the UART one frame apart
+static void unitsimPump(void) {
+    uint8_t buffer[256];
+    uint64_t arrival;
+    ssize_t count;
+    ssize_t i;
+
+    for (;;) {
+        count = read(unitsimPty, buffer, sizeof(buffer));
+        if (count <= 0) {
+            return;
+        } else {}
+        if ((unitsimCaptureFile >= 0) && (write(unitsimCaptureFile, buffer, count) != count)) {
+            perror("capture");
+        } else {}
+        if (unitsimRxHead == unitsimRxTail) {
+            arrival = unitsimRealCycles();
+            if (arrival < unitsimCycles) {
+                arrival = unitsimCycles;
+            } else {}
+            if (arrival > unitsimRxNext) {
+                unitsimRxNext = arrival;
+            } else {}
+        } else {}
+        for (i = 0; i < count; i++) {
+            if (((unitsimRxHead+1) & (UNITSIMRXFIFO-1)) != unitsimRxTail) {
+                unitsimRx[unitsimRxHead] = buffer[i];
+                unitsimRxHead = ((unitsimRxHead+1) & (UNITSIMRXFIFO-1));
+            } else {}
+        }
+    }
+}
+
+// Firmware wrote UDR0 since the last look
+static void unitsimTxCheck(void) {
+    uint8_t byte;
+
+    if (UDR0 == UNITSIMUDRIDLE) {
+        return;
+    } else {}
+    byte = (uint8_t) UDR0;
+    UDR0 = UNITSIMUDRIDLE;
+    if (write(unitsimPty, &byte, 1) != 1) {} // Nobody listening drops it, as on the wire
+    UCSR0A &= ~((1<<UDRE0)|(1<<TXC0));
+    unitsimTxFree = unitsimCycles + UNITSIMCHAR;
+}
+
+// Next replayed key goes in once the last has landed, no sooner than its time
+static void unitsimReplayFeed(void) {
+    if (!unitsimReplayStarted || (unitsimReplayFed >= unitsimReplayLength) || (unitsimRxHead != unitsimRxTail)) {
+        return;
+    } else {}
+    if (unitsimRxNext < unitsimReplayAt) {
+        unitsimRxNext = unitsimReplayAt;
+    } else {}
+    unitsimRx[unitsimRxHead] = unitsimReplay[unitsimReplayFed].byte;
+    unitsimRxHead = ((unitsimRxHead+1) & (UNITSIMRXFIFO-1));
+    unitsimReplayFed++;
+    unitsimReplayAt += (uint64_t) (unitsimReplayGap * (UNITSIMCPUHZ / 1e3));
+}
+
+static int unitsimReplayCompare(const void *a, const void *b) {
+    uint64_t x = *(const uint64_t *) a;
+    uint64_t y = *(const uint64_t *) b;
+
+    return ((x > y) - (x < y));
+}
+
+/*******************************************************************************
+* Prints each key and the spread of latency over the keys that were drawn,     *
+* then exits. Fails on a dropped key or one drawn slower than the bound.       *
+*******************************************************************************/
+static void unitsimReplayReport(void) {
+    unitsimkey_t *key;
+    uint64_t *latency;
+    uint64_t total = 0;
+    size_t drawn = 0;
+    size_t dropped = 0;
+    size_t silent = 0;
+    size_t i;
+    double worst;
+    int pass;
+
+    latency = calloc(unitsimReplayLength + 1, sizeof(uint64_t));
+    for (i = 0; i < unitsimReplayLength; i++) {
+        key = &unitsimReplay[i];
+        printf("key %zu 0x%02x at %.3f ms: ", i, key->byte, (key->arrived - unitsimReplayStart) * 1000.0 / UNITSIMCPUHZ);
+        if (key->dropped) {
+            printf("dropped\n");
+            dropped++;
+        } else if (key->writes == 0) {
+            printf("taken %.3f ms later, not drawn\n", (key->taken - key->arrived) * 1000.0 / UNITSIMCPUHZ);
+            silent++;
+        } else {
+            printf("taken %.3f ms later, drawn %.3f ms later in %u LCD commands\n",
+                (key->taken - key->arrived) * 1000.0 / UNITSIMCPUHZ, (key->drawn - key->arrived) * 1000.0 / UNITSIMCPUHZ,
+                key->writes);
+            latency[drawn] = (key->drawn - key->arrived);
+            total += latency[drawn];
+            drawn++;
+        }
+    }
+    qsort(latency, drawn, sizeof(uint64_t), unitsimReplayCompare);
+    worst = ((drawn != 0) ? (latency[drawn-1] * 1000.0 / UNITSIMCPUHZ) : 0);
+    pass = ((dropped == 0) && ((unitsimReplayBound == 0) || (worst <= unitsimReplayBound)));
+    printf("replay %zu keys %.3f ms apart, %zu dropped, %zu not drawn, latency mean %.3f median %.3f p99 %.3f worst %.3f ms",
+        unitsimReplayLength, unitsimReplayGap, dropped, silent,
+        (drawn != 0) ? (total * 1000.0 / UNITSIMCPUHZ / drawn) : 0, latency[drawn/2] * 1000.0 / UNITSIMCPUHZ,
+        latency[(drawn*99)/100] * 1000.0 / UNITSIMCPUHZ, worst);
+    if (unitsimReplayBound != 0) {
+        printf(", bound %.3f ms", unitsimReplayBound);
+    } else {}
+    printf(": %s\n", pass ? "pass" : "FAIL");
+    exit(pass ? 0 : 1);
+}
+
+/*******************************************************************************
+* LCD command done, drawn for the key the firmware took last                   *
+*******************************************************************************/
+static void unitsimLcdWrite(const char *command, int argument) {
+    if (unitsimReplay == NULL) {
+        return;
+    } else {}
+    unitsimReplayLast = unitsimCycles;
+    if (unitsimReplayDrawing != 0) {
+        unitsimReplay[unitsimReplayDrawing-1].drawn = unitsimCycles;
+        unitsimReplay[unitsimReplayDrawing-1].writes++;
+    } else {}
+    if (unitsimLcdEcho && unitsimReplayStarted) {
+        printf("lcd %.3f ms %s", (unitsimCycles - unitsimReplayStart) * 1000.0 / UNITSIMCPUHZ, command);
+        if (argument >= 0) {
+            printf(" %d", argument);
+        } else {}
+        printf("\n");
+    } else {}
+}
+
+/*******************************************************************************
+* Firmware calls to uartRx come here, linked with --wrap=uartRx. A byte taken  *
+* is the next replayed key that wasn't dropped.                                *
+*******************************************************************************/
+uint8_t __wrap_uartRx(void) {
+    uint8_t ready;
+
+    ready = uartRxReady();
+    if (ready && (unitsimReplay != NULL)) {
+        while ((unitsimReplayTaken < unitsimReplayArrived) && unitsimReplay[unitsimReplayTaken].dropped) {
+            unitsimReplayTaken++;
+        }
+        if (unitsimReplayTaken < unitsimReplayArrived) {
+            unitsimReplay[unitsimReplayTaken].taken = unitsimCycles;
+            unitsimReplayTaken++;
+            unitsimReplayDrawing = unitsimReplayTaken;
+            unitsimReplayLast = unitsimCycles;
+        } else {}
+    } else {}
+    return (__real_uartRx());
+}
+
+static uint8_t unitsimTimerRunning(void) {
+    return (!(PRR & (1<<PRTIM1)) && (TCCR1B & ((1<<CS12)|(1<<CS11)|(1<<CS10))));
+}
+
+// Cycles to a timer 1 count, the clock select's prescaler
+static uint64_t unitsimTimerPrescale(void) {
+    static const uint64_t prescale[8] = {1, 1, 8, 64, 256, 1024, 1, 1};
+
+    return (prescale[TCCR1B & ((1<<CS12)|(1<<CS11)|(1<<CS10))]);
+}
+
+/*******************************************************************************
+* Interrupts go off at cycle from for cycles, with -j or -v a compare match    *
+* after from and before the end waits for them. Of two that overlap the one    *
+* ending later is kept, the other holds nothing off past it.                   *
+*******************************************************************************/
+static void unitsimMask(uint64_t from, uint16_t cycles, const char *by) {
+    if ((from + cycles) > unitsimMaskedUntil) {
+        unitsimMaskedFrom = from;
+        unitsimMaskedUntil = (from + cycles);
+        unitsimMaskedBy = by;
+    } else {}
+}
+
+/*******************************************************************************
+* Runs simulated time up to until, or to the first interrupt if toInterrupt.   *
+* Events are sample period compare matches, UART Rx bytes & Tx frames ending,  *
+* and the data register empty interrupt while the firmware Tx ring has bytes.  *
+* Interrupts only ever run from here, at a sleep or busy wait, which is the    *
+* only place the firmware would notice them.                                   *
+*******************************************************************************/
+static void unitsimRun(uint64_t until, uint8_t toInterrupt) {
+    uint64_t next;
+    uint64_t real;
+    uint16_t overruns;
+    uint8_t fired;
+
+    for (;;) {
+        unitsimTxCheck();
+        unitsimPump();
+        unitsimReplayFeed();
+
+        // A stopped or newly prescaled timer restarts a whole period from now
+        if (!unitsimTimerRunning() || (unitsimNextTick <= unitsimCycles) || (unitsimTimerPrescale() != unitsimTickPrescale)) {
+            unitsimTickPrescale = unitsimTimerPrescale();
+            unitsimNextTick = unitsimCycles + (UNITSIMTICK*unitsimTickPrescale);
+        } else {}
+
+        next = until;
+        if (unitsimTimerRunning() && (TIMSK1 & ((1<<OCIE1A)|(1<<OCIE1B))) && (unitsimNextTick < next)) {
+            next = unitsimNextTick;
+        } else {}
+        if ((unitsimRxHead != unitsimRxTail) && (unitsimRxNext < next)) {
+            next = unitsimRxNext;
+        } else {}
+        if (!(UCSR0A & (1<<UDRE0)) && (unitsimTxFree < next)) {
+            next = unitsimTxFree;
+        } else if ((UCSR0A & (1<<UDRE0)) && (UCSR0B & (1<<UDRIE0))) {
+            next = unitsimCycles; // Tx ring has bytes for an empty UDR0
+        } else {}
+        if (unitsimReplayStarted && (unitsimReplayArrived >= unitsimReplayLength)
+            && ((unitsimReplayLast + UNITSIMREPLAYQUIET) < next)) {
+            next = (unitsimReplayLast + UNITSIMREPLAYQUIET);
+        } else {}
+
+        real = unitsimRealCycles();
+        if ((next == UNITSIMFOREVER) || (next > (real + UNITSIMSLACK))) {
+            unitsimWait((next == UNITSIMFOREVER) ? UNITSIMFOREVER : (next - real));
+            continue;
+        } else {}
+        if (next > unitsimCycles) {
+            unitsimCycles = next;
+        } else {}
+
+        fired = FALSE;
+        if (!(UCSR0A & (1<<UDRE0)) && (unitsimCycles >= unitsimTxFree)) {
+            UCSR0A |= ((1<<UDRE0)|(1<<TXC0));
+        } else {}
+        if ((UCSR0A & (1<<UDRE0)) && (UCSR0B & (1<<UDRIE0))) {
+            unitsimMask(unitsimCycles, unitsimUartStub(UNITSIMVECTORTX), "USART_UDRE_vect");
+            unitsimTxCheck();
+            fired = TRUE;
+        } else {}
+        if ((unitsimRxHead != unitsimRxTail) && (unitsimCycles >= unitsimRxNext)) {
+            UDR0 = unitsimRx[unitsimRxTail];
+            unitsimRxTail = ((unitsimRxTail+1) & (UNITSIMRXFIFO-1));
+            unitsimRxNext += UNITSIMCHAR;
+            overruns = uartOverruns;
+            if ((UCSR0B & (1<<RXEN0)) && (UCSR0B & (1<<RXCIE0))) {
+                unitsimMask(unitsimCycles, unitsimUartStub(UNITSIMVECTORRX), "USART_RX_vect");
+                fired = TRUE;
+            } else {
+                overruns--; // Lost with nothing to take it
+            }
+            if (unitsimReplayStarted && (unitsimReplayArrived < unitsimReplayFed)) {
+                unitsimReplay[unitsimReplayArrived].arrived = unitsimCycles;
+                unitsimReplay[unitsimReplayArrived].dropped = (overruns != uartOverruns);
+                unitsimReplayArrived++;
+                unitsimReplayLast = unitsimCycles;
+            } else {}
+            UDR0 = UNITSIMUDRIDLE;
+        } else {}
+        if (unitsimTimerRunning() && (unitsimCycles >= unitsimNextTick)) {
+            unitsimNextTick += (UNITSIMTICK*unitsimTimerPrescale());
+            OCR1A = ((OCR1AH<<8) | OCR1AL);
+            TIFR1 = 0x00; // Flags clear by writing one, and the simulator is never late
+            if (TIMSK1 & (1<<OCIE1A)) {
+                unitsimSampleStub();
+                fired = TRUE;
+            } else if (TIMSK1 & (1<<OCIE1B)) {
+                TIMER1_COMPB_vect();
+                fired = TRUE;
+            } else {}
+        } else {}
+        TCNT1 = (uint16_t) (((UNITSIMTICK*unitsimTimerPrescale()) - (unitsimNextTick - unitsimCycles)) / unitsimTimerPrescale());
+        if (unitsimReplayStarted && (unitsimReplayArrived >= unitsimReplayLength)
+            && (unitsimCycles >= (unitsimReplayLast + UNITSIMREPLAYQUIET))) {
+            unitsimReplayReport();
+        } else {}
+
+        if ((toInterrupt && fired) || (unitsimCycles >= until)) {
+            unitsimTxCheck();
+            return;
+        } else {}
+    }
+}
+
+static char unitsimLcdChar(uint8_t c) {
+    // Custom characters 1 & 2 are the left arrow and the progress block
+    if (c == 1) {
+        return ('<');
+    } else if (c == 2) {
+        return ('#');
+    } else if ((c < ' ') || (c > '~')) {
+        return ('?');
+    } else {
+        return ((char) c);
+    }
+}
+
+static void unitsimLcdShow(void) {
+    int row;
+    int col;
+
+    if (!unitsimLcdEcho || (memcmp(unitsimLcd, unitsimLcdShown, sizeof(unitsimLcd)) == 0)) {
+        return;
+    } else {}
+    memcpy(unitsimLcdShown, unitsimLcd, sizeof(unitsimLcd));
+    printf("lcd");
+    for (row = 0; row < 2; row++) {
+        printf(" [");
+        for (col = 0; col < 16; col++) {
+            putchar(unitsimLcdChar(unitsimLcd[row][col]));
+        }
+        printf("]");
+    }
+    printf("\n");
+    fflush(stdout);
+}
+
+/*******************************************************************************
+* Hooks from the shim, sleeping or busy waiting lets interrupts run            *
+*******************************************************************************/
+void simSleep(void) {
+    if ((unitsimReplay != NULL) && !unitsimReplayStarted) {
+        unitsimReplayStarted = TRUE;
+        unitsimReplayStart = unitsimCycles;
+        unitsimReplayAt = unitsimCycles;
+        unitsimReplayLast = unitsimCycles;
+    } else {}
+    unitsimLcdShow();
+    unitsimRun(UNITSIMFOREVER, TRUE);
+}
+
+void simDelay(double us) {
+    unitsimRun(unitsimCycles + (uint64_t) (us * (UNITSIMCPUHZ / 1e6)), FALSE);
+}
+
+/*******************************************************************************
+* Code turning interrupts off on air, other than in the sample handler where   *
+* they are off anyway. Where it runs against the next compare match isn't      *
+* known, so with -j or -v it is taken to start anywhere up to the match and    *
+* hold it off. Code not in unitsimMaskedCode fails the run.                    *
+*******************************************************************************/
+void simAtomic(const char *where) {
+    size_t i;
+
+    if (unitsimInSample || !(TIMSK1 & (1<<OCIE1A)) || (!unitsimJitter && (unitsimVcd == NULL))) {
+        return;
+    } else {}
+    for (i = 0; (i < (sizeof(unitsimMaskedCode)/sizeof(unitsimMaskedCode[0])))
+        && (strcmp(where, unitsimMaskedCode[i].where) != 0); i++) {}
+    if (i >= (sizeof(unitsimMaskedCode)/sizeof(unitsimMaskedCode[0]))) {
+        fprintf(stderr, "interrupts off on air in %s, not modelled\n", where);
+        exit(1);
+    } else {}
+    unitsimMask(unitsimNextTick - (uint64_t) (rand() % unitsimMaskedCode[i].cycles), unitsimMaskedCode[i].cycles,
+        unitsimMaskedCode[i].where);
+}
+
+/*******************************************************************************
+* EEPROM, 1KB kept in a file if given. A byte write leaves it busy for         *
+* UNITSIMEEPROMWRITE, the block update waits its writes out.                   *
+*******************************************************************************/
+static void unitsimEepromFlush(void) {
+    if (unitsimEepromFile >= 0) {
+        if (pwrite(unitsimEepromFile, unitsimEeprom, UNITSIMEEPROM, 0) != UNITSIMEEPROM) {
+            perror("eeprom");
+        } else {}
+    } else {}
+}
+
+uint8_t eeprom_read_byte(const uint8_t *address) {
+    return (unitsimEeprom[((uintptr_t) address) % UNITSIMEEPROM]);
+}
+
+void eeprom_read_block(void *destination, const void *source, size_t size) {
+    size_t i;
+
+    for (i = 0; i < size; i++) {
+        ((uint8_t *) destination)[i] = unitsimEeprom[(((uintptr_t) source) + i) % UNITSIMEEPROM];
+    }
+}
+
+void eeprom_update_block(const void *source, void *destination, size_t size) {
+    uintptr_t address;
+    uint16_t written = 0;
+    size_t i;
+
+    eeprom_busy_wait();
+    for (i = 0; i < size; i++) {
+        address = ((((uintptr_t) destination) + i) % UNITSIMEEPROM);
+        if (unitsimEeprom[address] != ((const uint8_t *) source)[i]) {
+            unitsimEeprom[address] = ((const uint8_t *) source)[i];
+            written++;
+        } else {}
+    }
+    if (written != 0) {
+        unitsimEepromFlush();
+    } else {}
+    simDelay(written * UNITSIMEEPROMWRITE); // Only changed bytes are written
+}
+
+uint8_t eeprom_is_ready(void) {
+    return (unitsimCycles >= unitsimEepromReady);
+}
+
+void eeprom_write_byte(uint8_t *address, uint8_t value) {
+    eeprom_busy_wait();
+    simAtomic("eeprom_write_byte");
+    unitsimEeprom[((uintptr_t) address) % UNITSIMEEPROM] = value;
+    unitsimEepromFlush();
+    unitsimEepromReady = unitsimCycles + (uint64_t) (UNITSIMEEPROMWRITE * (UNITSIMCPUHZ / 1e6));
+}
+
+void eeprom_busy_wait(void) {
+    if (!eeprom_is_ready()) {
+        unitsimRun(unitsimEepromReady, FALSE);
+    } else {}
+}
+
+/*******************************************************************************
+* Queues a command as if the host sent it, a frame per char. Returns the cycle *
+* its last char reaches the UART, 0 if the host's bytes are still going in.    *
+*******************************************************************************/
+static uint64_t unitsimInject(uint8_t type, const void *bytes, size_t length) {
+    char command[64];
+    size_t i;
+
+    if (unitsimRxHead != unitsimRxTail) {
+        return (0);
+    } else {}
+    command[0] = (char) type;
+    for (i = 0; i < length; i++) {
+        sprintf(&command[1+(i*2)], "%02x", ((const uint8_t *) bytes)[i]);
+    }
+    if (unitsimRxNext < unitsimCycles) {
+        unitsimRxNext = unitsimCycles;
+    } else {}
+    for (i = 0; command[i] != 0; i++) {
+        unitsimRx[unitsimRxHead] = (uint8_t) command[i];
+        unitsimRxHead = ((unitsimRxHead+1) & (UNITSIMRXFIFO-1));
+    }
+    return (unitsimRxNext + ((i-1) * UNITSIMCHAR));
+}
+
+/*******************************************************************************
+* Clock set, the set's last char is the reference the 4A groups are timed      *
+* against                                                                      *
+*******************************************************************************/
+static void unitsimClockSet(void) {
+    struct timespec now;
+    rtc_t time;
+    int64_t second;
+
+    clock_gettime(CLOCK_REALTIME, &now);
+    unitsimClockSetUnix = now.tv_sec;
+    second = (unitsimClockSetUnix % 86400);
+    time.mjd = (uint32_t) ((unitsimClockSetUnix / 86400) + UNITSIMMJDUNIX);
+    time.hour = (uint8_t) (second / 3600);
+    time.minute = (uint8_t) ((second / 60) % 60);
+    time.second = (uint8_t) (second % 60);
+    time.offset = 0;
+
+    unitsimClockSetAt = unitsimInject(CLOCKSET, &time, sizeof(time));
+    if (unitsimClockSetAt == 0) {
+        return; // Try again behind what the host sent
+    } else {}
+    unitsimClockSent = TRUE;
+    printf("clock set mjd %u %02u:%02u:%02u UTC\n", time.mjd, time.hour, time.minute, time.second);
+    fflush(stdout);
+}
+
+// Block of 26 bits MSB first checks out with the given offset
+static uint8_t unitsimDemodBlock(const uint8_t *bits, uint8_t offset, rbds_t *block) {
+    uint8_t i;
+
+    block->hex = 0;
+    for (i = 0; i < 26; i++) {
+        block->hex |= (((uint32_t) bits[i]) << (31-i));
+    }
+    return (crcChecksum(block, offset) == ((block->hex >> 6) & 0x3ff));
+}
+
+/*******************************************************************************
+* Urgent 8A group with a fresh sequence number in block D, sent at a random    *
+* point up to a second after the last one went out                             *
+*******************************************************************************/
+static void unitsimUrgentSend(void) {
+    urgent_t request;
+
+    if ((unitsimUrgentSequence != 0) || (unitsimCycles < unitsimUrgentAt)) {
+        return;
+    } else {}
+    memset(&request, 0, sizeof(request));
+    request.priority = 1;
+    request.blockB = (UNITSIMGROUP8A<<11);
+    request.blockC = 0x8000;
+    request.blockD = (uint16_t) (unitsimUrgentDone+1);
+    unitsimUrgentAt = unitsimInject(URGENTGROUP, &request, sizeof(request));
+    if (unitsimUrgentAt != 0) {
+        unitsimUrgentSequence = request.blockD;
+    } else {}
+}
+
+static void unitsimUrgentCheck(rbds_t *blocks) {
+    uint64_t latency;
+    uint64_t bound;
+
+    if ((unitsimUrgentSequence == 0) || ((blocks[3].hex>>16) != unitsimUrgentSequence)) {
+        return;
+    } else {}
+    latency = (unitsimDemodBitTimes[0] - unitsimUrgentAt);
+    printf("urgent %u on air %.3f ms after its command\n", unitsimUrgentSequence, latency * 1000.0 / UNITSIMCPUHZ);
+    if (latency > unitsimUrgentWorst) {
+        unitsimUrgentWorst = latency;
+    } else {}
+    unitsimUrgentTotal += latency;
+    unitsimUrgentDone++;
+    unitsimUrgentSequence = 0;
+    unitsimUrgentAt = unitsimCycles + (uint64_t) ((rand() / (RAND_MAX + 1.0)) * UNITSIMCPUHZ);
+
+    if (unitsimUrgentDone >= unitsimUrgent) {
+        bound = (unitsimClock ? (2*UNITSIMGROUPCYCLES) : UNITSIMGROUPCYCLES) + UNITSIMLOOPPASS;
+        printf("urgent %d groups, mean %.3f ms, worst %.3f ms, bound %.3f ms: %s\n", unitsimUrgentDone,
+            unitsimUrgentTotal * 1000.0 / UNITSIMCPUHZ / unitsimUrgentDone, unitsimUrgentWorst * 1000.0 / UNITSIMCPUHZ,
+            bound * 1000.0 / UNITSIMCPUHZ, (unitsimUrgentWorst <= bound) ? "pass" : "FAIL");
+        exit((unitsimUrgentWorst <= bound) ? 0 : 1);
+    } else {}
+}
+
+// PS set with the default step, cut to what fits
+static void unitsimPsSet(void) {
+    pstext_t ps;
+
+    memset(&ps, ' ', sizeof(ps));
+    ps.length = (uint8_t) ((strlen(unitsimPs) > PSTEXTSIZE) ? PSTEXTSIZE : strlen(unitsimPs));
+    ps.repeats = PSREPEATSDEFAULT;
+    memcpy(ps.text, unitsimPs, ps.length);
+    unitsimPsAt = unitsimInject(PSSET, &ps, sizeof(ps));
+    if (unitsimPsAt == 0) {
+        return;
+    } else {}
+    unitsimPsSent = TRUE;
+    printf("ps set \"%.*s\"\n", ps.length, unitsimPs);
+    fflush(stdout);
+}
+
+// Receivers only take a name whose four segments came in order
+static void unitsimPsCheck(rbds_t *blocks) {
+    uint8_t segment;
+
+    segment = blocks[1].type0groupb.c;
+    if (segment != unitsimPsSegments) {
+        unitsimPsSegments = 0;
+        if (segment != 0) {
+            return;
+        } else {}
+    } else {}
+    unitsimPsName[segment*2] = (char) blocks[3].type2groupcd.hichar;
+    unitsimPsName[(segment*2)+1] = (char) blocks[3].type2groupcd.lowchar;
+    unitsimPsSegments++;
+    if (unitsimPsSegments < 4) {
+        return;
+    } else {}
+    unitsimPsSegments = 0;
+    if (strcmp(unitsimPsName, unitsimPsShown) != 0) {
+        printf("ps \"%s\" %.3f s after the last\n", unitsimPsName, (unitsimDemodBitTimes[0] - unitsimPsAt) / UNITSIMCPUHZ);
+        fflush(stdout);
+        strcpy(unitsimPsShown, unitsimPsName);
+        unitsimPsAt = unitsimDemodBitTimes[0];
+    } else {}
+}
+
+// Injection level switch, back to full the next time
+static void unitsimInjectionSwitch(void) {
+    uint8_t level;
+
+    if (unitsimCycles < unitsimInjectionAt) {
+        return;
+    } else {}
+    level = ((unitsimInjectionNow == INJECTIONFULL) ? (uint8_t) unitsimInjection : INJECTIONFULL);
+    unitsimInjectionAt = unitsimInject(INJECTIONSET, &level, sizeof(level));
+    if (unitsimInjectionAt == 0) {
+        return;
+    } else {}
+    unitsimInjectionNow = level;
+    printf("injection %u at %.3f s\n", level, unitsimInjectionAt / UNITSIMCPUHZ);
+    fflush(stdout);
+    unitsimInjectionAt += (uint64_t) ((0.5 + (rand() / (RAND_MAX + 1.0))) * UNITSIMCPUHZ);
+}
+
+// Group mix set, recording starts once the group filled meanwhile is out too
+static void unitsimAcquireSet(void) {
+    uint8_t mix;
+
+    mix = (uint8_t) unitsimAcquire;
+    unitsimAcquireFrom = unitsimInject(GROUPMIXSET, &mix, sizeof(mix));
+    if (unitsimAcquireFrom == 0) {
+        return;
+    } else {}
+    unitsimAcquireFrom += (2*UNITSIMGROUPCYCLES);
+    unitsimAcquireSent = TRUE;
+    printf("group mix %02x\n", mix);
+    fflush(stdout);
+}
+
+// Block's place in its group from the offset it checks out with, 4 for none
+static uint8_t unitsimAcquireBlock(size_t bit, rbds_t *block) {
+    if (unitsimDemodBlock(&unitsimAcquireBits[bit], OFFSETA, block)) {
+        return (0);
+    } else if (unitsimDemodBlock(&unitsimAcquireBits[bit], OFFSETB, block)) {
+        return (1);
+    } else if (unitsimDemodBlock(&unitsimAcquireBits[bit], OFFSETC, block)
+        || unitsimDemodBlock(&unitsimAcquireBits[bit], OFFSETC2, block)) {
+        return (2);
+    } else if (unitsimDemodBlock(&unitsimAcquireBits[bit], OFFSETD, block)) {
+        return (3);
+    } else {
+        return (4);
+    }
+}
+
+/*******************************************************************************
+* A receiver joining the recording at bit join. Fills the seconds from joining *
+* to PI, PS and full radiotext, returns FALSE if the recording ran out first.  *
+* A new text A/B drops the radiotext held so far. PS is left at 0 without 0A.  *
+*******************************************************************************/
+static uint8_t unitsimAcquireTrial(size_t join, double *seconds) {
+    rbds_t blocks[4];
+    size_t done[3] = {0, 0, 0}; // Bit after the block that completed each
+    size_t bit;
+    uint16_t rtSegments = 0;
+    uint8_t rtLast = (MAXRTGROUPS-1); // Segment with the \r, the last until one is seen
+    uint8_t textAb = 0xff;
+    uint8_t psSegments = ((unitsimAcquire & GROUPMIX0A) ? 0 : 0x0f);
+    uint8_t segment;
+    uint8_t index = 4;
+    uint8_t i;
+
+    // Sync on a block then the one after it, PI from the first block A
+    for (bit = join; (bit + 52) <= unitsimAcquireLength; bit++) {
+        index = unitsimAcquireBlock(bit, &blocks[0]);
+        if ((index < 4) && (unitsimAcquireBlock(bit+26, &blocks[1]) == ((index+1) & 0x03))) {
+            break;
+        } else {}
+    }
+    if ((bit + 52) > unitsimAcquireLength) {
+        return (FALSE);
+    } else {}
+    done[0] = (bit + (((4-index) & 0x03)*26) + 26);
+    if (done[0] < (bit + 52)) {
+        done[0] = (bit + 52);
+    } else {}
+    if (psSegments == 0x0f) {
+        done[1] = join;
+    } else {}
+
+    // Then group by group from the first block B
+    for (bit += (((5-index) & 0x03)*26); ((bit + 78) < unitsimAcquireLength) && ((done[1] == 0) || (done[2] == 0)); bit += 104) {
+        if (!unitsimDemodBlock(&unitsimAcquireBits[bit], OFFSETB, &blocks[1])
+            || !unitsimDemodBlock(&unitsimAcquireBits[bit+52], OFFSETD, &blocks[3])) {
+            continue;
+        } else if (blocks[1].type0groupb.grouptype == GROUP0A) {
+            psSegments |= (1<<blocks[1].type0groupb.c);
+            if ((psSegments == 0x0f) && (done[1] == 0)) {
+                done[1] = (bit + 78);
+            } else {}
+        } else if ((blocks[1].type2groupb.grouptype == GROUP2A) && unitsimDemodBlock(&unitsimAcquireBits[bit+26], OFFSETC, &blocks[2])) {
+            if (blocks[1].type2groupb.textab != textAb) {
+                textAb = blocks[1].type2groupb.textab;
+                rtSegments = 0;
+                rtLast = (MAXRTGROUPS-1);
+            } else {}
+            segment = blocks[1].type2groupb.segmentaddress;
+            rtSegments |= ((uint16_t) 1<<segment);
+            for (i = 2; i <= 3; i++) {
+                if (((blocks[i].type2groupcd.hichar == '\r') || (blocks[i].type2groupcd.lowchar == '\r')) && (segment < rtLast)) {
+                    rtLast = segment;
+                } else {}
+            }
+            if (((rtSegments & ((2<<rtLast)-1)) == ((2<<rtLast)-1)) && (done[2] == 0)) {
+                done[2] = (bit + 78);
+            } else {}
+        } else {}
+    }
+    if ((done[1] == 0) || (done[2] == 0)) {
+        return (FALSE);
+    } else {}
+    for (i = 0; i < 3; i++) {
+        seconds[i] = ((unitsimAcquireTimes[done[i]] - unitsimAcquireTimes[join]) / UNITSIMCPUHZ);
+    }
+    return (TRUE);
+}
+
+static int unitsimAcquireCompare(const void *a, const void *b) {
+    double x = *(const double *) a;
+    double y = *(const double *) b;
+
+    return ((x > y) - (x < y));
+}
+
+/*******************************************************************************
+* Joins the recording at random points in its first half, so the second half   *
+* is there to finish in, then prints the spread of each time and exits         *
+*******************************************************************************/
+static void unitsimAcquireReport(void) {
+    static double seconds[3][UNITSIMACQUIRETRIALS];
+    static const char *names[3] = {"PI", "PS", "radiotext"};
+    rbds_t block;
+    double trial[3];
+    double span;
+    double total;
+    uint32_t groups[2] = {0, 0};
+    size_t bit;
+    int done = 0;
+    int i;
+    int k;
+
+    for (i = 0; i < UNITSIMACQUIRETRIALS; i++) {
+        if (unitsimAcquireTrial((size_t) ((rand() / (RAND_MAX + 1.0)) * (unitsimAcquireLength/2)), trial)) {
+            for (k = 0; k < 3; k++) {
+                seconds[k][done] = trial[k];
+            }
+            done++;
+        } else {}
+    }
+
+    // Group rates from every block B that checks out
+    for (bit = 0; (bit + 26) <= unitsimAcquireLength; bit++) {
+        if (unitsimDemodBlock(&unitsimAcquireBits[bit], OFFSETB, &block)) {
+            if (block.type0groupb.grouptype == GROUP0A) {
+                groups[0]++;
+            } else if (block.type2groupb.grouptype == GROUP2A) {
+                groups[1]++;
+            } else {}
+            bit += 103;
+        } else {}
+    }
+    span = ((unitsimAcquireTimes[unitsimAcquireLength-1] - unitsimAcquireTimes[0]) / UNITSIMCPUHZ);
+    printf("acquire %d of %d trials done over %.1f s, 0A %.2f and 2A %.2f groups a second\n", done, UNITSIMACQUIRETRIALS,
+        span, groups[0] / span, groups[1] / span);
+    if (done == 0) {
+        printf("acquire no receiver finished: FAIL\n");
+        exit(1);
+    } else {}
+    for (k = 0; k < 3; k++) {
+        if ((k == 1) && !(unitsimAcquire & GROUPMIX0A)) {
+            continue;
+        } else {}
+        qsort(seconds[k], (size_t) done, sizeof(double), unitsimAcquireCompare);
+        total = 0;
+        for (i = 0; i < done; i++) {
+            total += seconds[k][i];
+        }
+        printf("acquire %s mean %.3f s, median %.3f s, 95%% %.3f s, worst %.3f s\n", names[k], total / done,
+            seconds[k][done/2], seconds[k][(done*95)/100], seconds[k][done-1]);
+    }
+    exit(0);
+}
+
+// Recording for -a, the trials run once it is full
+static void unitsimAcquireRecord(uint8_t bit, uint64_t time) {
+    if (!unitsimAcquireSent || (time < unitsimAcquireFrom)) {
+        return;
+    } else {}
+    unitsimAcquireBits[unitsimAcquireLength] = bit;
+    unitsimAcquireTimes[unitsimAcquireLength] = time;
+    unitsimAcquireLength++;
+    if (unitsimAcquireLength >= UNITSIMACQUIREBITS) {
+        unitsimAcquireReport();
+    } else {}
+}
+
+/*******************************************************************************
+* Injection sweep. Each level goes on air by the symbol after the command is   *
+* taken, half a second is allowed for that and the config save before it.      *
+*******************************************************************************/
+static void unitsimSweepSample(uint16_t data) {
+    int32_t expected;
+    uint8_t level;
+
+    if ((unitsimSweepLevel >= 0) && (unitsimCycles < unitsimSweepUntil)) {
+        if ((unitsimCycles >= unitsimSweepFrom) && (abs(((int32_t) data) - DACMID) > unitsimSweepPeak)) {
+            unitsimSweepPeak = abs(((int32_t) data) - DACMID);
+        } else {}
+        return;
+    } else if (unitsimSweepLevel >= 0) {
+        expected = ((DACSWING*unitsimSweepLevel)/INJECTIONFULL);
+        if ((unitsimSweepPeak <= unitsimSweepLast) || (abs(unitsimSweepPeak - expected) > 1)) {
+            unitsimSweepFailed = TRUE;
+        } else {}
+        printf("injection %d peak %d codes, expected %d\n", unitsimSweepLevel, unitsimSweepPeak, expected);
+        fflush(stdout);
+        if (unitsimSweepLevel >= INJECTIONFULL) {
+            printf("injection sweep in steps of %d: %s\n", unitsimSweep, unitsimSweepFailed ? "FAIL" : "pass");
+            exit(unitsimSweepFailed ? 1 : 0);
+        } else {}
+    } else {}
+
+    level = (uint8_t) ((unitsimSweepLevel < 0) ? 0 : (((unitsimSweepLevel + unitsimSweep) > INJECTIONFULL) ? INJECTIONFULL
+        : (unitsimSweepLevel + unitsimSweep)));
+    unitsimSweepFrom = unitsimInject(INJECTIONSET, &level, sizeof(level));
+    if (unitsimSweepFrom == 0) {
+        return;
+    } else {}
+    unitsimSweepFrom += (uint64_t) (UNITSIMCPUHZ / 2);
+    unitsimSweepUntil = (unitsimSweepFrom + (2*UNITSIMSYMBOLCYCLES));
+    unitsimSweepLast = ((unitsimSweepLevel < 0) ? -1 : unitsimSweepPeak);
+    unitsimSweepLevel = level;
+    unitsimSweepPeak = 0;
+}
+
+// VCO closes on the last channel A code written
+static double unitsimVcoNow(void) {
+    unitsimVco += ((unitsimTuning - unitsimVco) * (1.0 - exp(-((unitsimCycles - unitsimVcoAt) / UNITSIMCPUHZ) / UNITSIMVCOTAU)));
+    unitsimVcoAt = unitsimCycles;
+    return (unitsimVco);
+}
+
+/*******************************************************************************
+* Channel switch to a random channel, three in four on the tabled FM band      *
+* raster, sent at a random point up to a second after the last one resumed     *
+*******************************************************************************/
+static void unitsimChannelSend(void) {
+    uint16_t frequency;
+
+    if ((unitsimChannelFrequency != 0) || (unitsimCycles < unitsimChannelAt)) {
+        return;
+    } else {}
+    if ((rand() % 4) != 0) {
+        frequency = (uint16_t) (TUNINGTABLEFIRST + ((rand() % (((TUNINGTABLELAST-TUNINGTABLEFIRST)/TUNINGTABLESTEP)+1)) * TUNINGTABLESTEP));
+    } else {
+        frequency = (uint16_t) (7000 + (rand() % 8001));
+    }
+    unitsimChannelAt = unitsimInject(CHANNELSET, &frequency, sizeof(frequency));
+    if (unitsimChannelAt != 0) {
+        unitsimChannelFrequency = frequency;
+        unitsimChannelFrom = unitsimTuning;
+        unitsimChannelQuiet = 0;
+    } else {}
+}
+
+/*******************************************************************************
+* Quiet symbols are the flat mid level, which no data symbol holds for long.   *
+* The first sample off it after a whole symbol of them is data resuming.       *
+*******************************************************************************/
+static void unitsimChannelCheck(uint16_t data) {
+    uint16_t code;
+    uint64_t latency;
+    uint64_t bound;
+    double off;
+    double plain;
+
+    if (data == (mainTxWave[0] & 0x0fff)) {
+        unitsimChannelQuiet++;
+        return;
+    } else if ((unitsimChannelFrequency == 0) || (unitsimChannelQuiet < SAMPLESPERSYMBOL) || (unitsimCycles < unitsimChannelAt)) {
+        unitsimChannelQuiet = 0;
+        return;
+    } else {}
+
+    code = (TUNINGCODE(unitsimChannelFrequency) & 0x0fff);
+    latency = (unitsimCycles - unitsimChannelAt);
+    off = fabs(unitsimVcoNow() - code);
+    if (unitsimTuning != code) {
+        off = fabs(unitsimTuning - (double) code) + off; // Left on the wrong code
+    } else {}
+    plain = (fabs(code - (double) unitsimChannelFrom) * exp(-((unitsimChannelQuiet * UNITSIMTICK) / UNITSIMCPUHZ) / UNITSIMVCOTAU));
+    printf("channel %u.%02u MHz code %u, on air %.3f ms after its command, %u quiet symbols, VCO %.2f codes off (%.2f with a plain step)\n",
+        unitsimChannelFrequency / 100, unitsimChannelFrequency % 100, code, latency * 1000.0 / UNITSIMCPUHZ,
+        (unsigned) (unitsimChannelQuiet / SAMPLESPERSYMBOL), off, plain);
+    fflush(stdout);
+    if (latency > unitsimChannelWorst) {
+        unitsimChannelWorst = latency;
+    } else {}
+    if (off > unitsimChannelOff) {
+        unitsimChannelOff = off;
+    } else {}
+    unitsimChannelTotal += latency;
+    unitsimChannelDone++;
+    unitsimChannelFrequency = 0;
+    unitsimChannelQuiet = 0;
+    unitsimChannelAt = unitsimCycles + (uint64_t) ((rand() / (RAND_MAX + 1.0)) * UNITSIMCPUHZ);
+
+    if (unitsimChannelDone >= unitsimChannel) {
+        bound = UNITSIMGROUPCYCLES + UNITSIMLOOPPASS + (TUNESETTLEMAX * UNITSIMSYMBOLCYCLES);
+        printf("channel %d switches, mean %.3f ms, worst %.3f ms, bound %.3f ms, VCO worst %.2f codes off, tolerance %.2f: %s\n",
+            unitsimChannelDone, unitsimChannelTotal * 1000.0 / UNITSIMCPUHZ / unitsimChannelDone,
+            unitsimChannelWorst * 1000.0 / UNITSIMCPUHZ, bound * 1000.0 / UNITSIMCPUHZ, unitsimChannelOff, UNITSIMVCOTOLERANCE,
+            ((unitsimChannelWorst <= bound) && (unitsimChannelOff <= UNITSIMVCOTOLERANCE)) ? "pass" : "FAIL");
+        exit(((unitsimChannelWorst <= bound) && (unitsimChannelOff <= UNITSIMVCOTOLERANCE)) ? 0 : 1);
+    } else {}
+}
+
+// Looks for a whole 0A, 4A or 8A group ending with the bit just in
+static void unitsimDemodGroup(void) {
+    rbds_t blocks[4];
+    int64_t edge;
+    double error;
+    uint32_t mjd;
+    uint8_t hour;
+    int8_t offset;
+
+    if (!unitsimDemodBlock(&unitsimDemodBits[0], OFFSETA, &blocks[0])
+        || !unitsimDemodBlock(&unitsimDemodBits[26], OFFSETB, &blocks[1])
+        || !unitsimDemodBlock(&unitsimDemodBits[52], OFFSETC, &blocks[2])
+        || !unitsimDemodBlock(&unitsimDemodBits[78], OFFSETD, &blocks[3])) {
+        return;
+    } else if (blocks[1].type0groupb.grouptype == GROUP0A) {
+        if (unitsimPs != NULL) {
+            unitsimPsCheck(blocks);
+        } else {}
+        return;
+    } else if (blocks[1].type4agroupb.grouptype == UNITSIMGROUP8A) {
+        unitsimUrgentCheck(blocks);
+        return;
+    } else if (blocks[1].type4agroupb.grouptype != GROUP4A) {
+        return;
+    } else {}
+
+    mjd = ((((uint32_t) blocks[1].type4agroupb.mjdhigh) << 15) | blocks[2].type4agroupc.mjdlow);
+    hour = ((blocks[2].type4agroupc.hourhigh << 4) | blocks[3].type4agroupd.hourlow);
+    offset = (int8_t) (blocks[3].type4agroupd.offsetsign ? -blocks[3].type4agroupd.offset : blocks[3].type4agroupd.offset);
+    edge = ((((int64_t) mjd - UNITSIMMJDUNIX) * 86400) + (hour * 3600) + (blocks[3].type4agroupd.minute * 60));
+    error = ((((double) unitsimDemodBitTimes[0]) - unitsimClockSetAt) / UNITSIMCPUHZ) - (edge - unitsimClockSetUnix);
+    printf("ct mjd %u %02u:%02u offset %+.1fh, %+.3f ms from the minute edge\n", mjd, hour,
+        blocks[3].type4agroupd.minute, offset / 2.0, error * 1000.0);
+    fflush(stdout);
+}
+
+/*******************************************************************************
+* Sample DAC demodulator. Each symbol is the sine table forwards or backwards, *
+* hunted for sample by sample until one matches, then taken whole. The level  *
+* toggles for each 1 bit, the bit's time is that of its first sample.          *
+*******************************************************************************/
+static void unitsimDemod(uint16_t data) {
+    uint8_t forwards = TRUE;
+    uint8_t backwards = TRUE;
+    uint8_t level;
+    uint8_t i;
+
+    if (unitsimDemodCount >= SAMPLESPERSYMBOL) {
+        memmove(unitsimDemodSamples, &unitsimDemodSamples[1], sizeof(unitsimDemodSamples)-sizeof(uint16_t));
+        memmove(unitsimDemodTimes, &unitsimDemodTimes[1], sizeof(unitsimDemodTimes)-sizeof(uint64_t));
+        unitsimDemodCount = (SAMPLESPERSYMBOL-1);
+    } else {}
+    unitsimDemodSamples[unitsimDemodCount] = data;
+    unitsimDemodTimes[unitsimDemodCount] = unitsimCycles;
+    unitsimDemodCount++;
+    if (unitsimDemodCount < SAMPLESPERSYMBOL) {
+        return;
+    } else {}
+
+    // Only the 12 bits of the DAC data field reach it
+    for (i = 0; i < SAMPLESPERSYMBOL; i++) {
+        if (unitsimDemodSamples[i] != (mainTxWave[i] & 0x0fff)) {
+            forwards = FALSE;
+        } else {}
+        if (unitsimDemodSamples[i] != (mainTxWave[(SAMPLESPERSYMBOL-1)-i] & 0x0fff)) {
+            backwards = FALSE;
+        } else {}
+    }
+    if (!forwards && !backwards) {
+        if (unitsimDemodLocked && (unitsimInjection >= 0)) {
+            printf("demod lost lock at %.3f s\n", unitsimDemodTimes[0] / UNITSIMCPUHZ);
+            fflush(stdout);
+        } else {}
+        unitsimDemodLocked = FALSE; // Hunt on from the next sample
+        return;
+    } else {}
+    level = forwards;
+    unitsimDemodCount = 0;
+
+    if (unitsimDemodLocked) {
+        memmove(unitsimDemodBits, &unitsimDemodBits[1], UNITSIMGROUPBITS-1);
+        memmove(unitsimDemodBitTimes, &unitsimDemodBitTimes[1], sizeof(unitsimDemodBitTimes)-sizeof(uint64_t));
+        unitsimDemodBits[UNITSIMGROUPBITS-1] = (level ^ unitsimDemodLevel);
+        unitsimDemodBitTimes[UNITSIMGROUPBITS-1] = unitsimDemodTimes[0];
+        unitsimDemodGroup();
+        if (unitsimAcquire >= 0) {
+            unitsimAcquireRecord(unitsimDemodBits[UNITSIMGROUPBITS-1], unitsimDemodTimes[0]);
+        } else {}
+    } else {}
+    unitsimDemodLevel = level;
+    unitsimDemodLocked = TRUE;
+}
+
+static double unitsimVcdNs(uint64_t cycles) {
+    return (cycles * 1e9 / UNITSIMCPUHZ);
+}
+
+static void unitsimVcdMeasure(uint8_t rule, double ns, uint64_t time) {
+    unitsimrule_t *check;
+
+    check = &unitsimVcdRules[rule];
+    if (check->limit < 0) {
+        check->limit = ns;
+    } else {}
+    if ((check->measured == 0) || (ns < check->least)) {
+        check->least = ns;
+    } else {}
+    if ((check->measured == 0) || (ns > check->most)) {
+        check->most = ns;
+    } else {}
+    check->measured++;
+    if (check->exact ? (ns != check->limit) : (ns < check->limit)) {
+        if (check->broken == 0) {
+            check->first = time;
+        } else {}
+        check->broken++;
+    } else {}
+}
+
+static int unitsimVcdCompare(const void *a, const void *b) {
+    const unitsimedge_t *x = a;
+    const unitsimedge_t *y = b;
+
+    if (x->time != y->time) {
+        return ((x->time > y->time) - (x->time < y->time));
+    } else {}
+    return ((x->order > y->order) - (x->order < y->order));
+}
+
+// Edge against the rules, before it is written
+static void unitsimVcdCheck(const unitsimedge_t *edge) {
+    uint64_t time;
+
+    time = edge->time;
+    switch (edge->signal) {
+        case UNITSIMVCDCS:
+            if (edge->value == 0) {
+                if (unitsimVcdAt[UNITSIMVCDCS] != 0) {
+                    unitsimVcdMeasure(UNITSIMRULEIDLE, unitsimVcdNs(time - unitsimVcdAt[UNITSIMVCDCS]), time);
+                } else {}
+                unitsimVcdClocks = 0;
+            } else {
+                unitsimVcdMeasure(UNITSIMRULECHS, unitsimVcdNs(time - unitsimVcdRise), time);
+                unitsimVcdMeasure(UNITSIMRULECLOCKS, unitsimVcdClocks, time);
+            }
+            break;
+        case UNITSIMVCDSCK:
+            if (unitsimVcdLevel[UNITSIMVCDCS] != 0) {
+                break;
+            } else if (edge->value != 0) {
+                if (unitsimVcdClocks == 0) {
+                    unitsimVcdMeasure(UNITSIMRULECSS, unitsimVcdNs(time - unitsimVcdAt[UNITSIMVCDCS]), time);
+                } else {
+                    unitsimVcdMeasure(UNITSIMRULELO, unitsimVcdNs(time - unitsimVcdAt[UNITSIMVCDSCK]), time);
+                }
+                unitsimVcdMeasure(UNITSIMRULESU, unitsimVcdNs(time - unitsimVcdAt[UNITSIMVCDMOSI]), time);
+                unitsimVcdClocks++;
+                unitsimVcdRise = time;
+            } else {
+                unitsimVcdMeasure(UNITSIMRULEHI, unitsimVcdNs(time - unitsimVcdRise), time);
+            }
+            break;
+        case UNITSIMVCDMOSI:
+            if ((unitsimVcdLevel[UNITSIMVCDCS] == 0) && (unitsimVcdClocks != 0)) {
+                unitsimVcdMeasure(UNITSIMRULEHD, unitsimVcdNs(time - unitsimVcdRise), time);
+            } else {}
+            break;
+        case UNITSIMVCDLDAC:
+            if (edge->value == 0) {
+                unitsimVcdMeasure(UNITSIMRULELS, ((unitsimVcdLevel[UNITSIMVCDCS] != 0) ? unitsimVcdNs(time - unitsimVcdAt[UNITSIMVCDCS]) : 0), time);
+            } else {
+                unitsimVcdMeasure(UNITSIMRULELD, unitsimVcdNs(time - unitsimVcdAt[UNITSIMVCDLDAC]), time);
+            }
+            break;
+        case UNITSIMVCDPILOT:
+            if (edge->value != 0) {
+                unitsimVcdPilotRise = time;
+            } else {}
+            break;
+        case UNITSIMVCDSYMBOL:
+            if (edge->value != 0) {
+                if (unitsimVcdSymbolLatch != 0) {
+                    unitsimVcdMeasure(UNITSIMRULESYMBOL, unitsimVcdNs(time - unitsimVcdSymbolLatch), time);
+                } else {}
+                if (unitsimVcdPilotRise != 0) {
+                    unitsimVcdMeasure(UNITSIMRULEPHASE, unitsimVcdNs(time - unitsimVcdPilotRise), time);
+                } else {}
+                unitsimVcdSymbolLatch = time;
+            } else {}
+            break;
+        default: break;
+    }
+}
+
+/*******************************************************************************
+* Writes the edges before until in time order, each checked against the        *
+* rules first. Edges that don't change their signal are left out.              *
+*******************************************************************************/
+static void unitsimVcdFlush(uint64_t until) {
+    unitsimedge_t *edge;
+    uint16_t kept = 0;
+    uint16_t i;
+    int8_t bit;
+
+    qsort(unitsimVcdEdges, unitsimVcdCount, sizeof(unitsimedge_t), unitsimVcdCompare);
+    for (i = 0; i < unitsimVcdCount; i++) {
+        edge = &unitsimVcdEdges[i];
+        if (edge->time >= until) {
+            unitsimVcdEdges[kept] = *edge;
+            kept++;
+            continue;
+        } else if (edge->value == unitsimVcdLevel[edge->signal]) {
+            continue;
+        } else {}
+        unitsimVcdCheck(edge);
+        if (edge->time != unitsimVcdWritten) {
+            fprintf(unitsimVcd, "#%llu\n", (unsigned long long) ((edge->time - unitsimVcdStart) * UNITSIMVCDSCALE));
+            unitsimVcdWritten = edge->time;
+        } else {}
+        if (edge->signal < UNITSIMVCDDACA) {
+            fprintf(unitsimVcd, "%u%c\n", edge->value, '!'+edge->signal);
+        } else {
+            fputc('b', unitsimVcd);
+            for (bit = 11; bit >= 0; bit--) {
+                fputc('0'+((edge->value>>bit) & 0x01), unitsimVcd);
+            }
+            fprintf(unitsimVcd, " %c\n", '!'+edge->signal);
+        }
+        unitsimVcdLevel[edge->signal] = edge->value;
+        unitsimVcdAt[edge->signal] = edge->time;
+    }
+    unitsimVcdCount = kept;
+}
+
+static void unitsimVcdEdge(uint64_t time, uint8_t signal, uint16_t value) {
+    if (unitsimVcdCount >= UNITSIMVCDEDGES) {
+        unitsimVcdFlush(UNITSIMFOREVER);
+    } else {}
+    unitsimVcdEdges[unitsimVcdCount].time = time;
+    unitsimVcdEdges[unitsimVcdCount].order = unitsimVcdOrder++;
+    unitsimVcdEdges[unitsimVcdCount].signal = signal;
+    unitsimVcdEdges[unitsimVcdCount].value = value;
+    unitsimVcdCount++;
+}
+
+/*******************************************************************************
+* spiUpdateDac's frame, cycles from its call. It has no asm to run, so this    *
+* counts the instructions its C compiles to: cbi, then for each byte out SPDR, *
+* the in, sbrs & rjmp poll until SPIF and in SPDR, then sbi and each _delay_us *
+* a cycle then two before cbi & sbi.                                           *
+*******************************************************************************/
+static void unitsimVcdSpiFrame(unitsimstub_t *frame) {
+    uint16_t time = 0;
+    uint16_t spif;
+    uint8_t k;
+
+    memset(frame, 0, sizeof(unitsimstub_t));
+    time += 2; // cbi
+    frame->select = time;
+    for (k = 0; k < 2; k++) {
+        time++; // out SPDR
+        frame->load[k] = time;
+        spif = (time + UNITSIMSPIBYTE);
+        while (time < spif) {
+            time += 4;
+        }
+        time += 4; // in & sbrs skipping the rjmp, in SPDR
+    }
+    time += 2; // sbi
+    frame->deselect = time;
+    time += 3; // _delay_us(0.04) & cbi
+    frame->latch[0] = time;
+    time += 4; // _delay_us(0.1) & sbi
+    frame->latch[1] = time;
+}
+
+/*******************************************************************************
+* Edges of a DAC frame whose pins change the cycles in frame after time,       *
+* returns the cycle LDAC rises. SPI runs at F_CPU/2 MSB first from each SPDR   *
+* write. Every frame but the first is also measured from the last latch.       *
+*******************************************************************************/
+static uint64_t unitsimVcdFrame(uint64_t time, dac_t word, const unitsimstub_t *frame) {
+    uint64_t start;
+    uint8_t byte;
+    uint8_t i;
+    uint8_t k;
+
+    // Before the last frame's latch is negative, frames overlap
+    start = (time + frame->select);
+    if (unitsimVcdBusy != 0) {
+        unitsimVcdMeasure(UNITSIMRULEOVERLAP, ((start < unitsimVcdBusy) ? -unitsimVcdNs(unitsimVcdBusy - start)
+            : unitsimVcdNs(start - unitsimVcdBusy)), start);
+    } else {}
+    unitsimVcdEdge(start, UNITSIMVCDCS, 0);
+    for (k = 0; k < 2; k++) {
+        byte = (uint8_t) ((k == 0) ? word.spi : (word.spi>>8));
+        for (i = 0; i < 8; i++) {
+            unitsimVcdEdge(time+frame->load[k]+(2*i), UNITSIMVCDMOSI, ((byte>>(7-i)) & 0x01));
+            unitsimVcdEdge(time+frame->load[k]+(2*i)+1, UNITSIMVCDSCK, 1);
+            unitsimVcdEdge(time+frame->load[k]+(2*i)+2, UNITSIMVCDSCK, 0);
+        }
+    }
+    unitsimVcdEdge(time+frame->deselect, UNITSIMVCDCS, 1);
+    unitsimVcdEdge(time+frame->latch[0], UNITSIMVCDLDAC, 0);
+    unitsimVcdEdge(time+frame->latch[1], UNITSIMVCDLDAC, 1);
+    unitsimVcdEdge(time+frame->latch[1], ((word.bit.channel == CHA) ? UNITSIMVCDDACA : UNITSIMVCDDACB), word.bit.data);
+    unitsimVcdBusy = (time + frame->latch[1]);
+    return (unitsimVcdBusy);
+}
+
+// VCD header, all lines idle at the DAC write that puts the unit on air
+static void unitsimVcdBegin(void) {
+    static const char *names[UNITSIMVCDSIGNALS] = {"cs_pd5", "sck_pb5", "mosi_pb3", "ldac_pb1", "pilot_pb2",
+        "carrier_pd6", "symbol", "dac_a", "dac_b"};
+    uint8_t signal;
+
+    unitsimVcdStart = unitsimCycles;
+    unitsimVcdRecording = TRUE;
+    fprintf(unitsimVcd, "$version unitsim $end\n$timescale 100ps $end\n$scope module unit $end\n");
+    for (signal = 0; signal < UNITSIMVCDSIGNALS; signal++) {
+        fprintf(unitsimVcd, "$var wire %u %c %s $end\n", ((signal < UNITSIMVCDDACA) ? 1 : 12), '!'+signal, names[signal]);
+    }
+    fprintf(unitsimVcd, "$upscope $end\n$enddefinitions $end\n#0\n$dumpvars\n");
+    unitsimVcdLevel[UNITSIMVCDCS] = 1;
+    unitsimVcdLevel[UNITSIMVCDLDAC] = 1;
+    for (signal = 0; signal < UNITSIMVCDSIGNALS; signal++) {
+        if (signal < UNITSIMVCDDACA) {
+            fprintf(unitsimVcd, "%u%c\n", unitsimVcdLevel[signal], '!'+signal);
+        } else {
+            fprintf(unitsimVcd, "b0 %c\n", '!'+signal);
+        }
+    }
+    fprintf(unitsimVcd, "$end\n");
+    unitsimVcdWritten = unitsimVcdStart;
+    printf("vcd recording\n");
+    fflush(stdout);
+}
+
+/*******************************************************************************
+* Prints each rule with the closest it came and the carrier against 3x pilot,  *
+* then exits, failing on anything broken or never measured                     *
+*******************************************************************************/
+static void unitsimVcdReport(void) {
+    unitsimrule_t *check;
+    double pilot;
+    double carrier;
+    double ppm;
+    uint8_t failed = FALSE;
+    uint8_t rule;
+
+    unitsimVcdFlush(UNITSIMFOREVER);
+    fclose(unitsimVcd);
+    for (rule = 0; rule < UNITSIMRULES; rule++) {
+        check = &unitsimVcdRules[rule];
+        if (check->measured == 0) {
+            printf("vcd %s: never seen: FAIL\n", check->name);
+            failed = TRUE;
+            continue;
+        } else {}
+        printf("vcd %s: %u, least %.1f most %.1f, %s %.1f: %s", check->name, check->measured, check->least,
+            check->most, (check->exact ? "exactly" : "at least"), check->limit, (check->broken == 0) ? "pass" : "FAIL");
+        if (check->broken != 0) {
+            printf(", %u broken, first at %.6f s", check->broken, (check->first - unitsimVcdStart) / UNITSIMCPUHZ);
+            failed = TRUE;
+        } else {}
+        printf("\n");
+    }
+
+    // The carrier divides down on its own, only its rate is held
+    pilot = (UNITSIMCPUHZ / (2.0 * UNITSIMTICK));
+    if (unitsimVcdCarrierToggles < 2) {
+        printf("vcd carrier: never seen: FAIL\n");
+        failed = TRUE;
+    } else {
+        carrier = ((unitsimVcdCarrierToggles-1) * UNITSIMCPUHZ / (2.0 * (unitsimVcdCarrierLast - unitsimVcdCarrierFirst)));
+        ppm = (fabs(carrier - (3*pilot)) * 1e6 / (3*pilot));
+        printf("vcd carrier %.1f Hz against 3x pilot %.1f Hz, %.0f ppm, at most %u: %s\n", carrier, 3*pilot, ppm,
+            CARRIERTOLERANCEPPM, (ppm <= CARRIERTOLERANCEPPM) ? "pass" : "FAIL");
+        if (ppm > CARRIERTOLERANCEPPM) {
+            failed = TRUE;
+        } else {}
+    }
+    exit(failed ? 1 : 0);
+}
+
+/*******************************************************************************
+* Pilot and carrier edges up to the next compare match, after writing what     *
+* came before this one. Ends the recording once it is long enough.             *
+*******************************************************************************/
+static void unitsimVcdTick(uint64_t match) {
+    uint64_t period;
+
+    unitsimVcdFlush(match);
+    if ((match - unitsimVcdStart) >= UNITSIMVCDCYCLES) {
+        unitsimVcdReport();
+    } else {}
+    if (TCCR1A & (1<<COM1B0)) {
+        unitsimVcdPilot ^= 0x01;
+        unitsimVcdEdge(match, UNITSIMVCDPILOT, unitsimVcdPilot);
+    } else {}
+    if (!(TCCR0B & (1<<CS00))) {
+        unitsimVcdCarrierAt = 0;
+        return;
+    } else if (unitsimVcdCarrierAt == 0) {
+        unitsimVcdCarrierAt = match;
+        unitsimVcdCarrierFirst = match;
+    } else {}
+    period = (((uint64_t) OCR0A)+1);
+    for (; unitsimVcdCarrierAt < (match + UNITSIMTICK); unitsimVcdCarrierAt += period) {
+        unitsimVcdEdge(unitsimVcdCarrierAt, UNITSIMVCDCARRIER, ((unitsimVcdCarrierToggles+1) & 0x01));
+        unitsimVcdCarrierLast = unitsimVcdCarrierAt;
+        unitsimVcdCarrierToggles++;
+    }
+}
+
+// Channel switch a channel up a third of the way in, back two thirds in
+static void unitsimVcdChannel(void) {
+    uint16_t frequency;
+
+    if ((unitsimVcdSwitches >= 2) || ((unitsimCycles - unitsimVcdStart) < (((unitsimVcdSwitches+1) * UNITSIMVCDCYCLES) / 3))) {
+        return;
+    } else if (unitsimVcdSwitches == 0) {
+        unitsimVcdFrequency = mainConfig.frequency;
+        frequency = (uint16_t) ((unitsimVcdFrequency >= TUNINGTABLELAST) ? (unitsimVcdFrequency-TUNINGTABLESTEP)
+            : (unitsimVcdFrequency+TUNINGTABLESTEP));
+    } else {
+        frequency = unitsimVcdFrequency;
+    }
+    if (unitsimInject(CHANNELSET, &frequency, sizeof(frequency)) == 0) {
+        return;
+    } else {}
+    unitsimVcdSwitches++;
+    printf("channel %u.%02u MHz at %.3f s\n", frequency / 100, frequency % 100, (unitsimCycles - unitsimVcdStart) / UNITSIMCPUHZ);
+    fflush(stdout);
+}
+
+/*******************************************************************************
+* Interrupt stub model. sample.c's asm is taken as written, the makefile pulls *
+* its lines out, and run an instruction at a time with the cycles the AVR      *
+* instruction set manual gives. Anything it doesn't know fails the run rather  *
+* than being guessed at.                                                       *
+*******************************************************************************/
+static void unitsimStubFail(const char *text, const char *why) {
+    fprintf(stderr, "interrupt stub: %s: %s\n", text, why);
+    exit(1);
+}
+
+// Line the local label reference at names, Nf after line or Nb at or before it
+static uint16_t unitsimStubLabel(const char **at, uint16_t line, const char *text) {
+    char *end;
+    long label;
+    int i;
+
+    label = strtol(*at, &end, 10);
+    *at = (end+1);
+    if (*end == 'f') {
+        for (i = (line+1); i < unitsimStubLength; i++) {
+            if (unitsimStub[i].label == label) {
+                return ((uint16_t) i);
+            } else {}
+        }
+    } else if (*end == 'b') {
+        for (i = line; i >= 0; i--) {
+            if (unitsimStub[i].label == label) {
+                return ((uint16_t) i);
+            } else {}
+        }
+    } else {}
+    unitsimStubFail(text, "no such label");
+    return (0);
+}
+
+// Immediate operand: numbers, named constants, + & -, brackets, lo8, hi8 & pm of a label
+static long unitsimStubValue(const char **at, uint16_t line, const char *text);
+
+static long unitsimStubTerm(const char **at, uint16_t line, const char *text) {
+    long value;
+    char *end;
+
+    while (**at == ' ') {
+        (*at)++;
+    }
+    if (strncmp(*at, "%[rxc]", 6) == 0) {
+        *at += 6;
+        value = RXC0;
+    } else if (strncmp(*at, "%[control]", 10) == 0) {
+        *at += 10;
+        value = UARTCONTROL;
+    } else if (**at == '-') {
+        (*at)++;
+        value = -unitsimStubTerm(at, line, text);
+    } else if ((**at == '(') || (strncmp(*at, "lo8(", 4) == 0) || (strncmp(*at, "hi8(", 4) == 0)
+        || (strncmp(*at, "pm(", 3) == 0)) {
+        end = strchr(*at, '(');
+        value = (((*at)[0] == 'h') ? 8 : 0);
+        if ((*at)[0] == 'p') {
+            *at = (end+1);
+            value = unitsimStub[unitsimStubLabel(at, line, text)].word;
+        } else {
+            *at = (end+1);
+            value = (unitsimStubValue(at, line, text) >> value);
+            value = ((end[-1] == '8') ? (value & 0xff) : value);
+        }
+        if (**at != ')') {
+            unitsimStubFail(text, "unbalanced brackets");
+        } else {}
+        (*at)++;
+    } else {
+        value = strtol(*at, &end, 0);
+        if (end == *at) {
+            unitsimStubFail(text, "can't read the value");
+        } else {}
+        *at = end;
+    }
+    while (**at == ' ') {
+        (*at)++;
+    }
+    return (value);
+}
+
+static long unitsimStubValue(const char **at, uint16_t line, const char *text) {
+    long value;
+
+    value = unitsimStubTerm(at, line, text);
+    while ((**at == '+') || (**at == '-')) {
+        (*at)++;
+        value += ((((*at)[-1] == '+') ? 1 : -1) * unitsimStubTerm(at, line, text));
+    }
+    return (value);
+}
+
+static uint8_t unitsimStubIo(const char *operand, const char *text) {
+    static const char *names[] = {"", "__SREG__", "%[tcntl]", "%[tcnth]", "%[low]", "%[high]", "%[spdr]",
+        "%[spsr]", "%[portd]", "%[portb]", "sampleEntry", "%[ucsr0a]", "%[ucsr0b]", "%[udr0]", "uartRxStatus",
+        "uartRxByte", "__vector_sample", "__vector_uartrx", "__vector_uarttx"};
+    uint8_t io;
+
+    for (io = UNITSIMIOSREG; io <= UNITSIMIOTXHANDLER; io++) {
+        if (strncmp(operand, names[io], strlen(names[io])) == 0) {
+            return (io);
+        } else {}
+    }
+    unitsimStubFail(text, "unknown operand");
+    return (UNITSIMIONONE);
+}
+
+static uint8_t unitsimStubReg(const char *operand, const char *text) {
+    if ((operand[0] != 'r') || (atoi(&operand[1]) > 31)) {
+        unitsimStubFail(text, "not a register");
+    } else {}
+    return ((uint8_t) atoi(&operand[1]));
+}
+
+// Splits the asm into lines, notes where each vector's stub starts, expands
+// .rept, then resolves operands once the labels are all known
+static void unitsimStubLoad(void) {
+    static const char *mnemonics[UNITSIMOPS] = {"nop", "push", "pop", "in", "out", "lds", "sts", "tst", "breq",
+        "brlo", "ldi", "subi", "sbci", "cpi", "clr", "ijmp", "cbi", "sbi", "sbrs", "rjmp", "jmp", "sei"};
+    static const char *vectors[UNITSIMVECTORS] = {"TIMER1_COMPA_vect:", "USART_RX_vect:", "USART_UDRE_vect:"};
+    char lines[UNITSIMSTUBLINES][32];
+    char mnemonic[8];
+    char *operand[2];
+    const char *at;
+    unitsimasm_t *line;
+    uint16_t word = 0;
+    uint16_t count = 0;
+    int16_t rept = -1;
+    int16_t repeats = 0;
+    uint16_t block;
+    int8_t label = -1;
+    size_t length;
+    uint16_t i;
+    int j;
+
+    for (j = 0; j < UNITSIMVECTORS; j++) {
+        unitsimStubVector[j] = UNITSIMSTUBLINES;
+    }
+    for (at = unitsimStubAsm; *at != 0; at += (length + strspn(&at[length], "\n\t"))) {
+        length = strcspn(at, "\n\t");
+        if ((length == 0) || (length >= sizeof(lines[0])) || (count >= UNITSIMSTUBLINES)) {
+            unitsimStubFail(at, "can't split the asm");
+        } else {}
+        memcpy(lines[count], at, length);
+        lines[count][length] = 0;
+        count++;
+    }
+
+    for (i = 0; i < count; i++) {
+        at = lines[i];
+        for (j = 0; (j < UNITSIMVECTORS) && (strcmp(at, vectors[j]) != 0); j++) {}
+        if (j < UNITSIMVECTORS) {
+            unitsimStubVector[j] = unitsimStubLength;
+            continue;
+        } else {}
+        if ((at[0] >= '0') && (at[0] <= '9') && (at[1] == ':')) {
+            label = (int8_t) (at[0]-'0');
+            at += (2 + strspn(&at[2], " "));
+        } else {}
+        if (strncmp(at, ".rept ", 6) == 0) {
+            rept = unitsimStubLength;
+            at += 6;
+            repeats = (int16_t) unitsimStubValue(&at, i, lines[i]);
+            continue;
+        } else if (strcmp(at, ".endr") == 0) {
+            block = (uint16_t) (unitsimStubLength-rept);
+            for (j = 1; (j < repeats) && ((unitsimStubLength+block) <= (UNITSIMSTUBLINES/2)); j++) {
+                memcpy(&unitsimStub[unitsimStubLength], &unitsimStub[rept], block*sizeof(unitsimasm_t));
+                unitsimStub[unitsimStubLength].label = -1;
+                unitsimStubLength += block;
+            }
+            if ((repeats == 0) && (rept >= 0)) {
+                unitsimStubLength = (uint16_t) rept;
+            } else {}
+            rept = -1;
+            continue;
+        } else if (unitsimStubLength >= (UNITSIMSTUBLINES/2)) {
+            unitsimStubFail(at, "too long");
+        } else {}
+        line = &unitsimStub[unitsimStubLength];
+        memset(line, 0, sizeof(unitsimasm_t));
+        line->label = label;
+        label = -1;
+        memcpy(line->text, at, strlen(at)+1);
+        unitsimStubLength++;
+    }
+
+    for (i = 0; i < unitsimStubLength; i++) {
+        line = &unitsimStub[i];
+        line->word = word;
+        if (sscanf(line->text, "%7s", mnemonic) != 1) {
+            unitsimStubFail(line->text, "no instruction");
+        } else {}
+        for (line->op = 0; (line->op < UNITSIMOPS) && (strcmp(mnemonic, mnemonics[line->op]) != 0); line->op++) {}
+        if (line->op >= UNITSIMOPS) {
+            unitsimStubFail(line->text, "instruction not modelled");
+        } else {}
+        word += (((line->op == UNITSIMOPLDS) || (line->op == UNITSIMOPSTS) || (line->op == UNITSIMOPJMP)) ? 2 : 1);
+    }
+    for (j = 0; j < UNITSIMVECTORS; j++) {
+        if (unitsimStubVector[j] >= unitsimStubLength) {
+            unitsimStubFail(vectors[j], "no stub for the vector");
+        } else {}
+    }
+
+    for (i = 0; i < unitsimStubLength; i++) {
+        line = &unitsimStub[i];
+        operand[0] = &line->text[strlen(mnemonics[line->op])];
+        operand[0] += strspn(operand[0], " ");
+        operand[1] = strchr(operand[0], ',');
+        operand[1] = ((operand[1] == NULL) ? "" : (operand[1] + 1 + strspn(&operand[1][1], " ")));
+        switch (line->op) {
+            case UNITSIMOPPUSH: case UNITSIMOPPOP: case UNITSIMOPTST: case UNITSIMOPCLR:
+                line->reg = unitsimStubReg(operand[0], line->text);
+                break;
+            case UNITSIMOPIN: case UNITSIMOPLDS:
+                line->reg = unitsimStubReg(operand[0], line->text);
+                line->io = unitsimStubIo(operand[1], line->text);
+                break;
+            case UNITSIMOPOUT: case UNITSIMOPSTS:
+                line->io = unitsimStubIo(operand[0], line->text);
+                line->reg = unitsimStubReg(operand[1], line->text);
+                break;
+            case UNITSIMOPLDI: case UNITSIMOPSUBI: case UNITSIMOPSBCI: case UNITSIMOPCPI: case UNITSIMOPSBRS:
+                line->reg = unitsimStubReg(operand[0], line->text);
+                at = operand[1];
+                line->value = (uint8_t) unitsimStubValue(&at, i, line->text);
+                break;
+            case UNITSIMOPCBI: case UNITSIMOPSBI:
+                line->io = unitsimStubIo(operand[0], line->text);
+                at = operand[1];
+                line->value = (uint8_t) unitsimStubValue(&at, i, line->text);
+                break;
+            case UNITSIMOPBREQ: case UNITSIMOPBRLO: case UNITSIMOPRJMP:
+                at = operand[0];
+                line->target = unitsimStubLabel(&at, i, line->text);
+                break;
+            case UNITSIMOPJMP:
+                line->io = unitsimStubIo(operand[0], line->text);
+                if (line->io < UNITSIMIOHANDLER) {
+                    unitsimStubFail(line->text, "jumps somewhere other than a handler");
+                } else {}
+                break;
+            default:
+                break;
+        }
+    }
+}
+
+/*******************************************************************************
+* Runs the stub entered with its TCNT1 read ending entry cycles after the      *
+* compare match. SPIF is set UNITSIMSPIBYTE cycles after SPDR is written, and  *
+* an SPSR read sees it from the cycle it starts on.                            *
+*******************************************************************************/
+static void unitsimStubRun(uint16_t entry, unitsimstub_t *stub) {
+    unitsimasm_t *line;
+    uint8_t r[32];
+    uint8_t zero = FALSE;
+    uint8_t carry = FALSE;
+    uint8_t loads = 0;
+    uint16_t steps = 0;
+    uint16_t i = unitsimStubVector[UNITSIMVECTORSAMPLE];
+    uint16_t z;
+    int32_t cycle = 0;
+    int32_t offset = 0;
+    int32_t spif = INT32_MAX;
+
+    memset(r, 0, sizeof(r));
+    memset(stub, 0, sizeof(unitsimstub_t));
+    for (;;) {
+        if ((i >= unitsimStubLength) || (++steps > UNITSIMSTUBSTEPS)) {
+            unitsimStubFail("stub", "never reaches the handler");
+        } else {}
+        line = &unitsimStub[i];
+        i++;
+        switch (line->op) {
+            case UNITSIMOPNOP: case UNITSIMOPLDI: case UNITSIMOPTST: case UNITSIMOPSUBI: case UNITSIMOPSBCI:
+            case UNITSIMOPCPI: case UNITSIMOPCLR:
+                if (line->op == UNITSIMOPLDI) {
+                    r[line->reg] = line->value;
+                } else if (line->op == UNITSIMOPTST) {
+                    zero = (r[line->reg] == 0);
+                } else if (line->op == UNITSIMOPSUBI) {
+                    carry = (line->value > r[line->reg]);
+                    r[line->reg] -= line->value;
+                    zero = (r[line->reg] == 0);
+                } else if (line->op == UNITSIMOPSBCI) {
+                    z = (uint16_t) (line->value + carry);
+                    carry = (z > r[line->reg]);
+                    r[line->reg] -= (uint8_t) z;
+                } else if (line->op == UNITSIMOPCPI) {
+                    carry = (line->value > r[line->reg]);
+                    zero = (line->value == r[line->reg]);
+                } else if (line->op == UNITSIMOPCLR) {
+                    r[line->reg] = 0;
+                    zero = TRUE;
+                } else {}
+                cycle++;
+                break;
+            case UNITSIMOPPUSH: case UNITSIMOPPOP: case UNITSIMOPSTS:
+                cycle += 2;
+                break;
+            case UNITSIMOPLDS:
+                cycle += 2;
+                if (line->io == UNITSIMIOTCNTL) {
+                    r[line->reg] = (uint8_t) entry;
+                    offset = (entry - cycle);
+                } else if (line->io == UNITSIMIOTCNTH) {
+                    r[line->reg] = (uint8_t) (entry>>8); // Latched by the low byte read
+                } else {
+                    unitsimStubFail(line->text, "loads something other than TCNT1");
+                }
+                break;
+            case UNITSIMOPIN:
+                if (line->io == UNITSIMIOLOW) {
+                    r[line->reg] = GPIOR1;
+                } else if (line->io == UNITSIMIOHIGH) {
+                    r[line->reg] = GPIOR2;
+                } else {
+                    r[line->reg] = (((line->io == UNITSIMIOSPSR) && (cycle >= spif)) ? (1<<SPIF) : 0);
+                }
+                cycle++;
+                break;
+            case UNITSIMOPOUT:
+                cycle++;
+                if ((line->io == UNITSIMIOSPDR) && (loads < 2)) {
+                    stub->word |= (uint16_t) (r[line->reg]<<(8*loads));
+                    stub->load[loads++] = (uint16_t) (cycle + offset);
+                    spif = (cycle + UNITSIMSPIBYTE);
+                } else if (line->io == UNITSIMIOSPDR) {
+                    unitsimStubFail(line->text, "writes a third byte");
+                } else {}
+                break;
+            case UNITSIMOPCBI: case UNITSIMOPSBI:
+                cycle += 2;
+                if ((line->io == UNITSIMIOPORTD) && (line->value == PD5)) {
+                    *((line->op == UNITSIMOPCBI) ? &stub->select : &stub->deselect) = (uint16_t) (cycle + offset);
+                } else if ((line->io == UNITSIMIOPORTB) && (line->value == PB1)) {
+                    stub->latch[(line->op == UNITSIMOPCBI) ? 0 : 1] = (uint16_t) (cycle + offset);
+                } else {}
+                break;
+            case UNITSIMOPBREQ: case UNITSIMOPBRLO:
+                if ((line->op == UNITSIMOPBREQ) ? zero : carry) {
+                    i = line->target;
+                    cycle += 2;
+                } else {
+                    cycle++;
+                }
+                break;
+            case UNITSIMOPSBRS:
+                if ((r[line->reg]>>line->value) & 0x01) {
+                    cycle += ((i+1) < unitsimStubLength) ? ((unitsimStub[i+1].word - unitsimStub[i].word) + 1) : 2;
+                    i++; // Skipping one word or two
+                } else {
+                    cycle++;
+                }
+                break;
+            case UNITSIMOPRJMP:
+                i = line->target;
+                cycle += 2;
+                break;
+            case UNITSIMOPIJMP:
+                z = (uint16_t) (r[30] | (r[31]<<8));
+                for (i = 0; (i < unitsimStubLength) && (unitsimStub[i].word != z); i++) {}
+                cycle += 2;
+                break;
+            case UNITSIMOPJMP:
+                cycle += 3;
+                stub->exit = (uint16_t) (cycle + offset);
+                if (line->io != UNITSIMIOHANDLER) {
+                    unitsimStubFail(line->text, "jumps to another stub's handler");
+                } else if ((loads != 2) || (stub->latch[1] == 0)) {
+                    unitsimStubFail("stub", "reaches the handler without latching a sample");
+                } else {}
+                return;
+            default:
+                unitsimStubFail(line->text, "not modelled in the sample stub");
+                break;
+        }
+    }
+}
+
+/*******************************************************************************
+* Runs a UART stub on the registers and data it names, then its handler.       *
+* Returns the cycles interrupts were off: from the interrupt being taken to    *
+* the first cycle another can be, after the instruction that follows the sei.  *
+* Fails if the stub gets to its handler with interrupts still off.             *
+*******************************************************************************/
+static uint16_t unitsimUartStub(uint8_t vector) {
+    static volatile uint8_t *data[] = {[UNITSIMIOUCSR0A] = &UCSR0A, [UNITSIMIOUCSR0B] = &UCSR0B,
+        [UNITSIMIORXSTATUS] = &uartRxStatus, [UNITSIMIORXBYTE] = &uartRxByte};
+    unitsimasm_t *line;
+    uint8_t r[32];
+    uint16_t steps = 0;
+    uint16_t i = unitsimStubVector[vector];
+    uint16_t cycle = UNITSIMINTERRUPTENTRY;
+    uint16_t masked = 0;
+    uint8_t enabled = FALSE;
+
+    memset(r, 0, sizeof(r));
+    for (;;) {
+        if ((i >= unitsimStubLength) || (++steps > UNITSIMSTUBSTEPS)) {
+            unitsimStubFail("UART stub", "never reaches its handler");
+        } else {}
+        line = &unitsimStub[i];
+        i++;
+        switch (line->op) {
+            case UNITSIMOPPUSH: case UNITSIMOPPOP:
+                cycle += 2;
+                break;
+            case UNITSIMOPLDI:
+                r[line->reg] = line->value;
+                cycle++;
+                break;
+            case UNITSIMOPLDS: case UNITSIMOPSTS:
+                cycle += 2;
+                if (line->io == UNITSIMIOUDR0) {
+                    if (line->op == UNITSIMOPLDS) {
+                        r[line->reg] = (uint8_t) UDR0;
+                    } else {
+                        UDR0 = r[line->reg];
+                    }
+                } else if ((line->io >= (sizeof(data)/sizeof(data[0]))) || (data[line->io] == NULL)) {
+                    unitsimStubFail(line->text, "touches something a UART stub shouldn't");
+                } else if (line->op == UNITSIMOPLDS) {
+                    r[line->reg] = *data[line->io];
+                } else {
+                    *data[line->io] = r[line->reg];
+                }
+                break;
+            case UNITSIMOPSBRS:
+                if ((r[line->reg]>>line->value) & 0x01) {
+                    cycle += ((i+1) < unitsimStubLength) ? ((unitsimStub[i+1].word - unitsimStub[i].word) + 1) : 2;
+                    i++; // Skipping one word or two
+                } else {
+                    cycle++;
+                }
+                break;
+            case UNITSIMOPSEI:
+                cycle++;
+                enabled = TRUE;
+                continue; // The instruction after still runs first
+            case UNITSIMOPJMP:
+                cycle += 3;
+                masked = ((masked == 0) ? cycle : masked);
+                if (!enabled) {
+                    unitsimStubFail(line->text, "reaches its handler with interrupts off");
+                } else if (line->io == UNITSIMIORXHANDLER) {
+                    __vector_uartrx();
+                } else if (line->io == UNITSIMIOTXHANDLER) {
+                    __vector_uarttx();
+                } else {
+                    unitsimStubFail(line->text, "jumps to the sample handler");
+                }
+                return (masked);
+            default:
+                unitsimStubFail(line->text, "not modelled in a UART stub");
+                break;
+        }
+        if (enabled && (masked == 0)) {
+            masked = cycle;
+        } else {}
+    }
+}
+
+/*******************************************************************************
+* -j traffic once on air, a command every UNITSIMJITTERGAP: tracing every      *
+* sample, then telemetry, a clock set and a trace dump, then telemetry again,  *
+* so the UART stubs, their handlers and the atomic blocks all run on air.      *
+*******************************************************************************/
+static void unitsimJitterTraffic(void) {
+    static const uint8_t commands[] = {TRACESAMPLES, TELEMETRYREQUEST, CLOCKSET, TELEMETRYREQUEST, TRACEDUMP};
+
+    if (unitsimJitterAt == 0) {
+        unitsimJitterAt = unitsimCycles;
+    } else if (unitsimCycles < unitsimJitterAt) {
+        return;
+    } else {}
+    if (unitsimJitterSent >= sizeof(commands)) {
+        (void) unitsimInject(TELEMETRYREQUEST, NULL, 0);
+    } else if (commands[unitsimJitterSent] == CLOCKSET) {
+        unitsimClockSet();
+        unitsimJitterSent += unitsimClockSent;
+    } else {
+        unitsimJitterSent += (unitsimInject(commands[unitsimJitterSent], NULL, 0) != 0);
+    }
+    unitsimJitterAt = (unitsimCycles + UNITSIMJITTERGAP);
+}
+
+/*******************************************************************************
+* Sample interrupt stub, run from the asm in sample.c. Entry is the fewest     *
+* cycles unless -j or -v, then as late as interrupts being off held it, or     *
+* anywhere in the window if they weren't. Samples are demodulated for -a, -c,  *
+* -i, -p & -u, watched for data resuming for -f and traced for -v.             *
+*******************************************************************************/
+static void unitsimSampleStub(void) {
+    unitsimstub_t stub;
+    uint64_t latch;
+    uint16_t entry;
+    uint16_t held = 0;
+    dac_t sample;
+
+    entry = SAMPLEENTRYMIN;
+    if ((unitsimMaskedFrom < unitsimCycles) && (unitsimCycles < unitsimMaskedUntil)) {
+        held = (uint16_t) (unitsimMaskedUntil - unitsimCycles);
+    } else {}
+    if ((unitsimJitter || (unitsimVcd != NULL)) && (held != 0)) {
+        entry += held;
+    } else if (unitsimJitter || (unitsimVcd != NULL)) {
+        entry += (uint16_t) (rand() % (SAMPLEJITTERWINDOW+1));
+    } else {}
+    unitsimStubRun(entry, &stub);
+
+    if (unitsimJitter && unitsimOnAir) {
+        unitsimJitterTraffic();
+        if (held != 0) {
+            unitsimJitterHeld++;
+            if (held > unitsimJitterMost) {
+                unitsimJitterMost = held;
+                unitsimJitterBy = unitsimMaskedBy;
+            } else {}
+        } else {}
+        unitsimJitterEntry[0] = ((entry < unitsimJitterEntry[0]) ? entry : unitsimJitterEntry[0]);
+        unitsimJitterEntry[1] = ((entry > unitsimJitterEntry[1]) ? entry : unitsimJitterEntry[1]);
+        unitsimJitterLatch[0] = ((stub.latch[1] < unitsimJitterLatch[0]) ? stub.latch[1] : unitsimJitterLatch[0]);
+        unitsimJitterLatch[1] = ((stub.latch[1] > unitsimJitterLatch[1]) ? stub.latch[1] : unitsimJitterLatch[1]);
+        unitsimJitterWrong += (stub.word != (uint16_t) (GPIOR1 | (GPIOR2<<8)));
+        unitsimJitterSamples++;
+        if (unitsimJitterSamples >= (UNITSIMCPUHZ / UNITSIMTICK)) {
+            printf("jitter %u samples, entry %u to %u cycles, DAC latch %u to %u cycles after compare match, %u wrong, "
+                "%u held off by interrupts being off, most %u cycles in %s: %s\n",
+                unitsimJitterSamples, unitsimJitterEntry[0], unitsimJitterEntry[1], unitsimJitterLatch[0],
+                unitsimJitterLatch[1], unitsimJitterWrong, unitsimJitterHeld, unitsimJitterMost, unitsimJitterBy,
+                ((unitsimJitterLatch[0] == unitsimJitterLatch[1]) && (unitsimJitterWrong == 0)) ? "pass" : "FAIL");
+            exit(((unitsimJitterLatch[0] == unitsimJitterLatch[1]) && (unitsimJitterWrong == 0)) ? 0 : 1);
+        } else {}
+    } else {}
+
+    sample.spi = stub.word;
+    if ((unitsimClock || unitsimUrgent || (unitsimPs != NULL) || (unitsimInjection >= 0) || (unitsimAcquire >= 0)) && unitsimOnAir) {
+        if (unitsimClock && !unitsimClockSent) {
+            unitsimClockSet();
+        } else if ((unitsimPs != NULL) && !unitsimPsSent) {
+            unitsimPsSet();
+        } else if ((unitsimAcquire >= 0) && !unitsimAcquireSent) {
+            unitsimAcquireSet();
+        } else if (unitsimInjection >= 0) {
+            unitsimInjectionSwitch();
+        } else if (unitsimUrgent) {
+            unitsimUrgentSend();
+        } else {}
+        unitsimDemod(sample.bit.data);
+    } else {}
+    if (unitsimSweep && unitsimOnAir) {
+        unitsimSweepSample(sample.bit.data);
+    } else {}
+    if (unitsimChannel && unitsimOnAir) {
+        unitsimChannelSend();
+        unitsimChannelCheck(sample.bit.data);
+    } else {}
+    if (unitsimVcdRecording) {
+        unitsimVcdTick(unitsimCycles);
+        latch = unitsimVcdFrame(unitsimCycles, sample, &stub);
+        if (unitsimVcdSampleLatch != 0) {
+            unitsimVcdMeasure(UNITSIMRULESAMPLE, unitsimVcdNs(latch - unitsimVcdSampleLatch), latch);
+        } else {}
+        unitsimVcdSampleLatch = latch;
+        unitsimVcdEdge(latch, UNITSIMVCDSYMBOL, unitsimVcdSymbol);
+        if (unitsimOnAir) {
+            unitsimVcdChannel();
+        } else {}
+    } else {}
+
+    sampleEntry = entry;
+    TCNT1 = stub.exit;
+    unitsimInSample = TRUE;
+    __vector_sample();
+    unitsimInSample = FALSE;
+    unitsimVcdSymbol = (mainTxSample == 0);
+}
+
+/*******************************************************************************
+* DAC, tuning changes on channel A are printed and steer the VCO model,        *
+* channel B samples only come from the sample stub. With -v every write is     *
+* traced, in the handler after the stub's frame.                               *
+*******************************************************************************/
+void spiInit(void) {}
+
+void spiUpdateDac(dac_t dacdata) {
+    unitsimstub_t frame;
+
+    unitsimVcdSpiFrame(&frame);
+    if (unitsimVcdRecording) {
+        (void) unitsimVcdFrame((unitsimInSample ? (unitsimVcdBusy + UNITSIMHANDLERLEAD) : unitsimCycles), dacdata, &frame);
+    } else if ((unitsimVcd != NULL) && (dacdata.bit.channel == CHA) && (dacdata.bit.shutdown == STARTUP)) {
+        unitsimVcdBegin();
+        (void) unitsimVcdFrame(unitsimCycles, dacdata, &frame);
+    } else {}
+    if (dacdata.bit.channel != CHA) {
+        return;
+    } else {}
+    if ((dacdata.bit.shutdown == STARTUP) && (!unitsimOnAir || (dacdata.bit.data != unitsimTuning))) {
+        if (unitsimOnAir) {
+            (void) unitsimVcoNow();
+        } else {
+            unitsimVco = dacdata.bit.data; // Settled by the time anything listens
+            unitsimVcoAt = unitsimCycles;
+        }
+        unitsimOnAir = TRUE;
+        unitsimTuning = dacdata.bit.data;
+        printf("dac tuning %u\n", unitsimTuning);
+        fflush(stdout);
+    } else if ((dacdata.bit.shutdown == SHUTDOWN) && unitsimOnAir) {
+        unitsimOnAir = FALSE;
+        printf("dac off\n");
+        fflush(stdout);
+    } else {}
+}
+
+/*******************************************************************************
+* LCD, 2x16 characters, each command takes as long as lcd.c waits for it       *
+*******************************************************************************/
+void LcdInit(void) {
+    memset(unitsimLcd, ' ', sizeof(unitsimLcd));
+    unitsimLcdRow = 0;
+    unitsimLcdCol = 0;
+    simDelay(21000.0 + (30 * UNITSIMLCDCMD)); // Power up waits and the custom characters
+    unitsimLcdWrite("init", -1);
+}
+
+void LcdCursor(uint8_t on, uint8_t blink) {
+    simDelay(UNITSIMLCDCMD);
+    unitsimLcdWrite("cursor", ((on ? 2 : 0) | (blink ? 1 : 0)));
+}
+
+void LcdClrDisp(void) {
+    memset(unitsimLcd, ' ', sizeof(unitsimLcd));
+    unitsimLcdRow = 0;
+    unitsimLcdCol = 0;
+    simDelay(2000.0 + UNITSIMLCDCMD);
+    unitsimLcdWrite("clear", -1);
+}
+
+void LcdDispChar(uint8_t c) {
+    if (unitsimLcdCol < 16) {
+        unitsimLcd[unitsimLcdRow][unitsimLcdCol] = c;
+    } else {}
+    unitsimLcdCol++;
+    simDelay(UNITSIMLCDCMD);
+    unitsimLcdWrite("char", c);
+}
+
+void LcdClrLine(uint8_t line) {
+    if ((line < 1) || (line > 2)) {
+        return;
+    } else {}
+    memset(unitsimLcd[line-1], ' ', 16);
+    unitsimLcdRow = (line-1);
+    unitsimLcdCol = 0;
+    simDelay(18 * UNITSIMLCDCMD);
+    unitsimLcdWrite("clear line", line);
+}
+
+void LcdMoveCursor(uint8_t row, uint8_t col) {
+    unitsimLcdRow = ((row == 1) ? 0 : 1);
+    unitsimLcdCol = (col-1);
+    simDelay(UNITSIMLCDCMD);
+    unitsimLcdWrite("move", ((row*100)+col));
+}
+
+void LcdDispStrg(uint8_t *s) {
+    while (*s != 0x00) {
+        LcdDispChar(*s++);
+    }
+}
+
+void LcdDispStrgP(uint8_t *s) {
+    while (pgm_read_byte(s) != 0x00) {
+        LcdDispChar(pgm_read_byte(s++));
+    }
+}
+
+static void unitsimUsage(void) {
+    fprintf(stderr,
+        "usage: unitsim [-a mix] [-c] [-e eeprom.bin] [-f count] [-i level] [-j] [-l]\n"
+        "               [-p text] [-s step] [-u count] [-v trace.vcd] [-x speed]\n"
+        "               [-R capture] [-r capture [-g ms] [-m ms]]\n"
+        "  -a mix    set the group mix once on air and time receivers tuning in, then exit\n"
+        "  -c        set the clock once on air and time the 4A groups\n"
+        "  -e file   keep the EEPROM in file\n"
+        "  -f count  time count channel switches from command to data resuming, then exit\n"
+        "  -g ms     time between replayed keys (default 0, back to back)\n"
+        "  -i level  switch injection between level and full about every second, showing lost lock\n"
+        "  -j        vary sample interrupt entry, with UART traffic, and check the DAC write for jitter, then exit\n"
+        "  -l        print the LCD when it changes, or each LCD command with -r\n"
+        "  -m ms     fail the replay if any key takes longer to draw\n"
+        "  -p text   set the PS text once on air and print each name received\n"
+        "  -R file   append the bytes the host sends to file\n"
+        "  -r file   replay file into the UART and time each key to the LCD, then exit\n"
+        "  -s step   step injection from 0 to full checking the DAC peak rises with it, then exit\n"
+        "  -u count  time count urgent groups from command to air, then exit\n"
+        "  -v file   trace the DAC, LDAC, pilot & carrier pins to a VCD file and check their timing, then exit\n"
+        "  -x speed  clock rate relative to real time (default 1)\n");
+    exit(1);
+}
+
+int main(int argc, char **argv) {
+    struct termios settings;
+    const char *eepromPath = NULL;
+    const char *replayPath = NULL;
+    uint8_t buffer[256];
+    FILE *replay;
+    size_t count;
+    size_t i;
+    int slave;
+    int option;
+
+    while ((option = getopt(argc, argv, "a:ce:f:g:i:jlm:p:R:r:s:u:v:x:")) != -1) {
+        switch (option) {
+            case 'a': unitsimAcquire = atoi(optarg); break;
+            case 'c': unitsimClock = TRUE; break;
+            case 'e': eepromPath = optarg; break;
+            case 'f': unitsimChannel = atoi(optarg); break;
+            case 'g': unitsimReplayGap = atof(optarg); break;
+            case 'i': unitsimInjection = atoi(optarg); break;
+            case 'j': unitsimJitter = TRUE; break;
+            case 'l': unitsimLcdEcho = TRUE; break;
+            case 'm': unitsimReplayBound = atof(optarg); break;
+            case 'p': unitsimPs = optarg; break;
+            case 'R':
+                unitsimCaptureFile = open(optarg, O_WRONLY | O_CREAT | O_APPEND, 0644);
+                if (unitsimCaptureFile < 0) {
+                    perror(optarg);
+                    return (1);
+                } else {}
+                break;
+            case 'r': replayPath = optarg; break;
+            case 's': unitsimSweep = atoi(optarg); break;
+            case 'u': unitsimUrgent = atoi(optarg); break;
+            case 'v':
+                unitsimVcd = fopen(optarg, "w");
+                if (unitsimVcd == NULL) {
+                    perror(optarg);
+                    return (1);
+                } else {}
+                break;
+            case 'x': unitsimSpeed = atof(optarg); break;
+            default: unitsimUsage();
+        }
+    }
+    if ((unitsimSpeed <= 0) || (unitsimReplayGap < 0) || (unitsimReplayBound < 0) || (unitsimInjection > INJECTIONFULL) || (unitsimAcquire > 0xff) || (unitsimSweep < 0)) {
+        unitsimUsage();
+    } else {}
+
+    // Whole capture up front, a key per byte
+    if (replayPath != NULL) {
+        replay = fopen(replayPath, "rb");
+        if (replay == NULL) {
+            perror(replayPath);
+            return (1);
+        } else {}
+        while ((count = fread(buffer, 1, sizeof(buffer), replay)) > 0) {
+            unitsimReplay = realloc(unitsimReplay, (unitsimReplayLength + count) * sizeof(unitsimkey_t));
+            for (i = 0; i < count; i++) {
+                memset(&unitsimReplay[unitsimReplayLength], 0, sizeof(unitsimkey_t));
+                unitsimReplay[unitsimReplayLength].byte = buffer[i];
+                unitsimReplayLength++;
+            }
+        }
+        fclose(replay);
+        if (unitsimReplayLength == 0) {
+            fprintf(stderr, "%s: nothing to replay\n", replayPath);
+            return (1);
+        } else {}
+    } else {}
+
+    unitsimStubLoad();
+
+    // Blank part reads all ones
+    memset(unitsimEeprom, 0xff, sizeof(unitsimEeprom));
+    if (eepromPath != NULL) {
+        unitsimEepromFile = open(eepromPath, O_RDWR | O_CREAT, 0644);
+        if (unitsimEepromFile < 0) {
+            perror(eepromPath);
+            return (1);
+        } else {}
+        if (pread(unitsimEepromFile, unitsimEeprom, UNITSIMEEPROM, 0) < UNITSIMEEPROM) {
+            memset(unitsimEeprom, 0xff, sizeof(unitsimEeprom));
+        } else {}
+    } else {}
+
+    // Hold the slave open so the pty doesn't hang up between clients, raw so
+    // nothing is echoed or translated
+    unitsimPty = posix_openpt(O_RDWR | O_NOCTTY | O_NONBLOCK);
+    if ((unitsimPty < 0) || (grantpt(unitsimPty) < 0) || (unlockpt(unitsimPty) < 0)) {
+        perror("pty");
+        return (1);
+    } else {}
+    slave = open(ptsname(unitsimPty), O_RDWR | O_NOCTTY);
+    if ((slave < 0) || (tcgetattr(slave, &settings) < 0)) {
+        perror(ptsname(unitsimPty));
+        return (1);
+    } else {}
+    cfmakeraw(&settings);
+    tcsetattr(slave, TCSANOW, &settings);
+    printf("%s\n", ptsname(unitsimPty));
+    fflush(stdout);
+
+    // Power on reset, .init3 runs before main
+    UCSR0A = ((1<<UDRE0)|(1<<TXC0));
+    MCUSR = (1<<PORF);
+    mainResetInit();
+    clock_gettime(CLOCK_MONOTONIC, &unitsimEpoch);
+    return (firmwareMain());
+}